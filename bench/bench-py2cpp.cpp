@@ -0,0 +1,1337 @@
+#include <Python.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <new>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "src/py2cpp.hpp"
+
+using namespace dubzzz::Py2Cpp;
+
+/** Allocations counter **/
+
+static std::atomic<std::size_t> numAllocations { 0 };
+
+// not inlined: the compiler would report a mismatch between malloc and delete expressions
+__attribute__((noinline)) void* operator new(std::size_t size)
+{
+  ++numAllocations;
+  if (void* p = std::malloc(size != 0 ? size : 1))
+  {
+    return p;
+  }
+  throw std::bad_alloc();
+}
+__attribute__((noinline)) void operator delete(void* p) noexcept
+{
+  std::free(p);
+}
+__attribute__((noinline)) void operator delete(void* p, std::size_t) noexcept
+{
+  std::free(p);
+}
+
+namespace
+{
+  // Number of runs per measure, the best one is kept
+  const unsigned NUM_RUNS { 3 };
+
+  // Prevent the compiler from removing the conversions
+  volatile std::size_t sink;
+
+  // Command line options
+  struct Options
+  {
+    std::size_t maxSize { 10000000 };
+    bool json { false };     // --json: results printed as a single JSON document
+    bool perf { false };     // --perf: cache misses counted with perf_event_open
+    std::string filter;      // --filter=text: only the benchmarks whose name contains text
+  };
+  Options options;
+
+  bool selected(std::string const& name)
+  {
+    return options.filter.empty() || name.find(options.filter) != std::string::npos;
+  }
+
+  // Hardware cache misses of the calling thread (user space), -1 when not available
+  class CacheMisses
+  {
+    int fd;
+
+  public:
+    CacheMisses() : fd(-1)
+    {
+#if defined(__linux__)
+      if (options.perf)
+      {
+        perf_event_attr attr;
+        std::memset(&attr, 0, sizeof(attr));
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.size = sizeof(attr);
+        attr.config = PERF_COUNT_HW_CACHE_MISSES;
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        fd = static_cast<int>(syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0));
+        if (fd < 0)
+        {
+          std::cerr << "perf_event_open failed: cache misses are not reported" << std::endl;
+        }
+      }
+#endif
+    }
+    ~CacheMisses()
+    {
+#if defined(__linux__)
+      if (fd >= 0)
+      {
+        close(fd);
+      }
+#endif
+    }
+    CacheMisses(CacheMisses const&) = delete;
+    CacheMisses& operator=(CacheMisses const&) = delete;
+
+    void start()
+    {
+#if defined(__linux__)
+      if (fd >= 0)
+      {
+        ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+        ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+      }
+#endif
+    }
+    long long stop()
+    {
+#if defined(__linux__)
+      long long count;
+      if (fd >= 0 && ioctl(fd, PERF_EVENT_IOC_DISABLE, 0) == 0 && read(fd, &count, sizeof(count)) == sizeof(count))
+      {
+        return count;
+      }
+#endif
+      return -1;
+    }
+  };
+
+  CacheMisses& cacheMisses()
+  {
+    static CacheMisses counter;
+    return counter;
+  }
+
+  // Best run, -1 for the values which are not measured
+  struct Measure
+  {
+    double ms;
+    long long allocations;
+    long long cacheMisses;
+  };
+
+  // Evaluate a Python expression, the caller owns the returned reference
+  std::unique_ptr<PyObject, decref> pyEval(std::string const& code)
+  {
+    std::unique_ptr<PyObject, decref> pyo { PyRun_String(code.c_str(), Py_eval_input, PyModule_GetDict(PyImport_AddModule("__main__")), NULL) };
+    if (! pyo)
+    {
+      PyErr_Print();
+      throw std::runtime_error("Unable to evaluate: " + code);
+    }
+    return pyo;
+  }
+
+  // Best time in milliseconds of fun() over NUM_RUNS runs, with the allocations and cache misses of that run
+  // keep() is called right after each run becoming the best one, to save what that run reported
+  template <class FUN, class KEEP>
+  Measure bestOf(FUN&& fun, KEEP&& keep)
+  {
+    Measure best { -1., -1, -1 };
+    for (unsigned run { 0 } ; run != NUM_RUNS ; ++run)
+    {
+      std::size_t allocations { numAllocations };
+      cacheMisses().start();
+      auto start = std::chrono::steady_clock::now();
+      sink = fun();
+      std::chrono::duration<double, std::milli> elapsed { std::chrono::steady_clock::now() - start };
+      long long misses { cacheMisses().stop() };
+      if (best.ms < 0. || elapsed.count() < best.ms)
+      {
+        best = Measure { elapsed.count(), static_cast<long long>(numAllocations - allocations), misses };
+        keep();
+      }
+    }
+    return best;
+  }
+  template <class FUN>
+  Measure bestOf(FUN&& fun)
+  {
+    return bestOf(std::forward<FUN>(fun), []() {});
+  }
+
+  std::string jsonString(std::string const& value)
+  {
+    std::string out { "\"" };
+    for (char c : value)
+    {
+      if (c == '"' || c == '\\')
+      {
+        out += '\\';
+      }
+      out += c;
+    }
+    return out + "\"";
+  }
+  std::string jsonNumber(double value)
+  {
+    if (value < 0.)
+    {
+      return "null";
+    }
+    std::ostringstream out;
+    out << std::setprecision(12) << value;
+    return out.str();
+  }
+
+  std::vector<std::string> jsonResults;
+
+  // bytes: payload converted by each run, 0 if not relevant
+  void report(std::string const& name, std::size_t size, std::string const& variant, Measure const& measure, std::size_t bytes = 0)
+  {
+    double seconds { measure.ms / 1000. };
+    double itemsPerSecond { seconds > 0. ? size / seconds : -1. };
+    double bytesPerSecond { seconds > 0. && bytes != 0 ? bytes / seconds : -1. };
+    if (options.json)
+    {
+      std::ostringstream out;
+      out << "{\"name\": " << jsonString(name) << ", \"variant\": " << jsonString(variant) << ", \"size\": " << size
+          << ", \"ms\": " << jsonNumber(measure.ms) << ", \"items_per_s\": " << jsonNumber(itemsPerSecond)
+          << ", \"bytes_per_s\": " << jsonNumber(bytesPerSecond)
+          << ", \"allocations\": " << jsonNumber(static_cast<double>(measure.allocations))
+          << ", \"cache_misses\": " << jsonNumber(static_cast<double>(measure.cacheMisses)) << "}";
+      jsonResults.push_back(out.str());
+      return;
+    }
+    std::cout << std::left << std::setw(40) << name
+              << std::right << std::setw(10) << size
+              << "  " << std::left << std::setw(12) << variant
+              << std::right << std::fixed << std::setprecision(3) << std::setw(12) << measure.ms << " ms";
+    if (itemsPerSecond >= 0.)
+    {
+      std::cout << std::setprecision(2) << std::setw(10) << itemsPerSecond / 1e6 << " Mitem/s";
+    }
+    if (bytesPerSecond >= 0.)
+    {
+      std::cout << std::setprecision(1) << std::setw(10) << bytesPerSecond / 1e6 << " MB/s";
+    }
+    if (measure.allocations >= 0)
+    {
+      std::cout << std::setw(10) << measure.allocations << " allocs";
+    }
+    if (measure.cacheMisses >= 0)
+    {
+      std::cout << std::setw(12) << measure.cacheMisses << " misses";
+    }
+    std::cout << std::endl;
+  }
+  void report(std::string const& name, std::size_t size, std::string const& variant, double ms)
+  {
+    report(name, size, variant, Measure { ms, -1, -1 });
+  }
+
+  // Sizes from 10^min to 10^max (included)
+  std::vector<std::size_t> sizes(std::size_t min, std::size_t max)
+  {
+    std::vector<std::size_t> out;
+    for (std::size_t size { min } ; size <= max ; size *= 10)
+    {
+      out.push_back(size);
+    }
+    return out;
+  }
+}
+
+/** std::map: bulk construction against per-entry insertion **/
+
+// Conversion path used by CppBuilder<std::map<K,T>> before the bulk construction
+template <class K, class T>
+static typename CppBuilder<std::map<K,T>>::value_type legacyMapBuilder(PyObject* pyo)
+{
+  typename CppBuilder<std::map<K,T>>::value_type dict;
+  PyObject *key, *value;
+  Py_ssize_t pos = 0;
+  while (PyDict_Next(pyo, &pos, &key, &value))
+  {
+    dict[ToBuildable<K>()(key)] = ToBuildable<T>()(value);
+  }
+  return dict;
+}
+
+template <class K, class T>
+static void benchMap(std::string const& name, std::string const& pyGenerator, std::size_t maxSize)
+{
+  for (std::size_t size : sizes(100000, maxSize))
+  {
+    std::ostringstream code;
+    code << "dict(" << pyGenerator << " for i in xrange(" << size << "))";
+    auto pyo = pyEval(code.str());
+    report(name, size, "per-entry", bestOf([&pyo]() { return legacyMapBuilder<K,T>(pyo.get()).size(); }));
+    report(name, size, "bulk", bestOf([&pyo]() { return CppBuilder<std::map<K,T>>()(pyo.get()).size(); }));
+  }
+}
+
+/** std::string from unicode: UTF-8 transcoder against wide narrowing **/
+
+// Conversion path used by CppBuilder<std::string> for PyUnicode before the UTF-8 transcoder
+static std::string legacyUnicodeBuilder(PyObject* pyo)
+{
+  long int size { PyUnicode_GetSize(pyo) };
+  std::vector<wchar_t> wstr(size);
+  PyUnicode_AsWideChar(reinterpret_cast<PyUnicodeObject*>(pyo), wstr.data(), size);
+  std::wstring wide(wstr.data(), size);
+  return std::string(wide.begin(), wide.end());
+}
+
+static void benchUnicode(std::string const& name, std::string const& pyPattern, std::size_t maxSize)
+{
+  // ~10^7 characters per measure split into strings of various lengths
+  for (std::size_t length : { 16, 1024, 1048576 })
+  {
+    std::size_t count { std::max<std::size_t>(1, std::min<std::size_t>(maxSize, 10000000) / length) };
+    std::ostringstream code;
+    code << "[(" << pyPattern << " * " << length << ")[:" << length << "] for i in xrange(" << count << ")]";
+    auto pyo = pyEval(code.str());
+    std::vector<PyObject*> items;
+    for (Py_ssize_t i { 0 } ; i != PyList_Size(pyo.get()) ; ++i)
+    {
+      items.push_back(PyList_GetItem(pyo.get(), i));
+    }
+    report(name + " (length " + std::to_string(length) + ")", count, "wide", bestOf([&items]() {
+        std::size_t total { 0 };
+        for (PyObject* item : items) { total += legacyUnicodeBuilder(item).size(); }
+        return total;
+    }));
+    report(name + " (length " + std::to_string(length) + ")", count, "utf-8", bestOf([&items]() {
+        std::size_t total { 0 };
+        CppBuilder<std::string> builder;
+        for (PyObject* item : items) { total += builder(item).size(); }
+        return total;
+    }));
+  }
+}
+
+/** FromDict: interned keys against per-lookup temporary strings **/
+
+namespace
+{
+  struct Record
+  {
+    int f0, f1, f2, f3, f4, f5, f6, f7, f8, f9;
+    
+    struct FromPy : CppBuilder<FromDict<Record, int, int, int, int, int, int, int, int, int, int>>
+    {
+      FromPy() : CppBuilder<FromDict<Record, int, int, int, int, int, int, int, int, int, int>>(
+          make_mapping("f0", &Record::f0), make_mapping("f1", &Record::f1), make_mapping("f2", &Record::f2)
+          , make_mapping("f3", &Record::f3), make_mapping("f4", &Record::f4), make_mapping("f5", &Record::f5)
+          , make_mapping("f6", &Record::f6), make_mapping("f7", &Record::f7), make_mapping("f8", &Record::f8)
+          , make_mapping("f9", &Record::f9))
+      {}
+    };
+  };
+}
+
+// Lookups performed by CppBuilder<FromDict<...>> before the keys were interned
+static std::vector<Record> legacyRecordsBuilder(PyObject* pyo)
+{
+  static const char* names[] = { "f0", "f1", "f2", "f3", "f4", "f5", "f6", "f7", "f8", "f9" };
+  static int Record::* members[] = { &Record::f0, &Record::f1, &Record::f2, &Record::f3, &Record::f4, &Record::f5, &Record::f6, &Record::f7, &Record::f8, &Record::f9 };
+  std::vector<Record> out;
+  out.reserve(PyList_Size(pyo));
+  for (Py_ssize_t i { 0 } ; i != PyList_Size(pyo) ; ++i)
+  {
+    Record record {};
+    for (std::size_t field { 0 } ; field != 10 ; ++field)
+    {
+      PyObject* pyo_item { PyDict_GetItemString(PyList_GetItem(pyo, i), names[field]) };
+      if (pyo_item)
+      {
+        record.*members[field] = CppBuilder<int>()(pyo_item);
+      }
+    }
+    out.push_back(record);
+  }
+  return out;
+}
+
+static void benchFromDict(std::size_t maxSize)
+{
+  for (std::size_t size : sizes(100000, std::min<std::size_t>(maxSize, 1000000)))
+  {
+    std::ostringstream code;
+    code << "[dict(('f%d' % f, i) for f in xrange(10)) for i in xrange(" << size << ")]";
+    auto pyo = pyEval(code.str());
+    report("vector<FromDict<10 ints>>", size, "string keys", bestOf([&pyo]() { return legacyRecordsBuilder(pyo.get()).size(); }));
+    report("vector<FromDict<10 ints>>", size, "interned", bestOf([&pyo]() { return CppBuilder<std::vector<Record::FromPy>>()(pyo.get()).size(); }));
+  }
+}
+
+/** FromDict over objects: cached attribute resolution against generic getattr **/
+
+namespace
+{
+  struct Point3
+  {
+    int x, y, z;
+    
+    struct FromPy : CppBuilder<FromDict<Point3, int, int, int>>
+    {
+      FromPy() : CppBuilder<FromDict<Point3, int, int, int>>(
+          make_mapping("x", &Point3::x), make_mapping("y", &Point3::y), make_mapping("z", &Point3::z))
+      {}
+    };
+  };
+}
+
+// Attribute reads performed by CppBuilder<FromDict<...>> before the cached resolution
+static std::vector<Point3> legacyObjectsBuilder(PyObject* pyo)
+{
+  static const char* names[] = { "x", "y", "z" };
+  static int Point3::* members[] = { &Point3::x, &Point3::y, &Point3::z };
+  std::vector<Point3> out;
+  out.reserve(PyList_Size(pyo));
+  for (Py_ssize_t i { 0 } ; i != PyList_Size(pyo) ; ++i)
+  {
+    Point3 point {};
+    for (std::size_t field { 0 } ; field != 3 ; ++field)
+    {
+      if (PyObject_HasAttrString(PyList_GetItem(pyo, i), names[field]))
+      {
+        std::unique_ptr<PyObject, decref> pyo_item { PyObject_GetAttrString(PyList_GetItem(pyo, i), names[field]) };
+        point.*members[field] = CppBuilder<int>()(pyo_item.get());
+      }
+    }
+    out.push_back(point);
+  }
+  return out;
+}
+
+static void benchFromObject(std::size_t maxSize)
+{
+  PyRun_SimpleString(
+      "class BenchOld:\n"
+      "   def __init__(self, i): self.x, self.y, self.z = i, i, i\n"
+      "class BenchNew(object):\n"
+      "   def __init__(self, i): self.x, self.y, self.z = i, i, i\n"
+      "class BenchSlots(object):\n"
+      "   __slots__ = ('x', 'y', 'z')\n"
+      "   def __init__(self, i): self.x, self.y, self.z = i, i, i\n");
+  for (const char* type : { "BenchOld", "BenchNew", "BenchSlots" })
+  {
+    for (std::size_t size : sizes(100000, std::min<std::size_t>(maxSize, 1000000)))
+    {
+      std::ostringstream code;
+      code << "[" << type << "(i) for i in xrange(" << size << ")]";
+      auto pyo = pyEval(code.str());
+      report(std::string("vector<FromDict<3 ints>> of ") + type, size, "getattr", bestOf([&pyo]() { return legacyObjectsBuilder(pyo.get()).size(); }));
+      report(std::string("vector<FromDict<3 ints>> of ") + type, size, "cached", bestOf([&pyo]() { return CppBuilder<std::vector<Point3::FromPy>>()(pyo.get()).size(); }));
+    }
+  }
+}
+
+/** FromDict/FromTuple: compile-time Field setters against std::function mappings **/
+
+namespace
+{
+  // same shape as examples/03-to_cpp_classes
+  class Point2
+  {
+    double x {}, y {};
+  
+  public:
+    double sum() const { return x + y; }
+    
+    struct FromPyDict : CppBuilder<FromDict<Point2, double, double>>
+    {
+      FromPyDict() : CppBuilder<FromDict<Point2, double, double>>(
+          make_mapping("x", &Point2::x), make_mapping("y", &Point2::y))
+      {}
+    };
+    struct FromPyDictFields : CppBuilder<FromDict<Point2, PY2CPP_FIELD(&Point2::x), PY2CPP_FIELD(&Point2::y)>>
+    {
+      FromPyDictFields() : CppBuilder<FromDict<Point2, PY2CPP_FIELD(&Point2::x), PY2CPP_FIELD(&Point2::y)>>("x", "y")
+      {}
+    };
+    struct FromPyTuple : CppBuilder<FromTuple<Point2, double, double>>
+    {
+      FromPyTuple() : CppBuilder<FromTuple<Point2, double, double>>(&Point2::x, &Point2::y)
+      {}
+    };
+    struct FromPyTupleFields : CppBuilder<FromTuple<Point2, PY2CPP_FIELD(&Point2::x), PY2CPP_FIELD(&Point2::y)>>
+    {};
+    PY2CPP_STRUCT(Point2, x, y);
+  };
+}
+
+template <class BUILDER>
+static double sumPoints(PyObject* pyo)
+{
+  double total { 0. };
+  for (auto const& point : CppBuilder<std::vector<BUILDER>>()(pyo))
+  {
+    total += point.sum();
+  }
+  return total;
+}
+
+static void benchFields(std::size_t maxSize)
+{
+  for (std::size_t size : sizes(100000, std::min<std::size_t>(maxSize, 1000000)))
+  {
+    std::ostringstream dicts;
+    dicts << "[{'x': float(i), 'y': 1.5} for i in xrange(" << size << ")]";
+    auto pyDicts = pyEval(dicts.str());
+    report("vector<FromDict<Point>>", size, "function", bestOf([&pyDicts]() { return sumPoints<Point2::FromPyDict>(pyDicts.get()); }));
+    report("vector<FromDict<Point>>", size, "Field", bestOf([&pyDicts]() { return sumPoints<Point2::FromPyDictFields>(pyDicts.get()); }));
+    report("vector<FromDict<Point>>", size, "schema", bestOf([&pyDicts]() { return sumPoints<Point2>(pyDicts.get()); }));
+    
+    std::ostringstream tuples;
+    tuples << "[(float(i), 1.5) for i in xrange(" << size << ")]";
+    auto pyTuples = pyEval(tuples.str());
+    report("vector<FromTuple<Point>>", size, "function", bestOf([&pyTuples]() { return sumPoints<Point2::FromPyTuple>(pyTuples.get()); }));
+    report("vector<FromTuple<Point>>", size, "Field", bestOf([&pyTuples]() { return sumPoints<Point2::FromPyTupleFields>(pyTuples.get()); }));
+  }
+}
+
+// builder constructed for every conversion, as in examples/03-to_cpp_classes
+template <class BUILDER>
+static double sumPointsOneByOne(PyObject* pyo)
+{
+  double total { 0. };
+  for (Py_ssize_t i { 0 } ; i != PyList_GET_SIZE(pyo) ; ++i)
+  {
+    total += BUILDER()(PyList_GET_ITEM(pyo, i)).sum();
+  }
+  return total;
+}
+
+static void benchBuilderConstruction(std::size_t maxSize)
+{
+  for (std::size_t size : sizes(10000, std::min<std::size_t>(maxSize, 100000)))
+  {
+    std::ostringstream dicts;
+    dicts << "[{'x': float(i), 'y': 1.5} for i in xrange(" << size << ")]";
+    auto pyDicts = pyEval(dicts.str());
+    report("new builder per FromDict<Point>", size, "function", bestOf([&pyDicts]() { return sumPointsOneByOne<Point2::FromPyDict>(pyDicts.get()); }));
+    report("new builder per FromDict<Point>", size, "Field", bestOf([&pyDicts]() { return sumPointsOneByOne<Point2::FromPyDictFields>(pyDicts.get()); }));
+    report("new builder per FromDict<Point>", size, "schema", bestOf([&pyDicts]() { return sumPointsOneByOne<Point2::FromPy>(pyDicts.get()); }));
+  }
+}
+
+/** TwoPhase: time spent holding the GIL **/
+
+template <class T>
+static void benchTwoPhase(std::string const& name, std::string const& pyGenerator, std::size_t maxSize)
+{
+  for (std::size_t size : sizes(100000, maxSize))
+  {
+    std::ostringstream code;
+    code << pyGenerator << size << "))";
+    auto pyo = pyEval(code.str());
+    report(name, size, "direct", bestOf([&pyo]() { return CppBuilder<T>()(pyo.get()).size(); }));
+    // phases of the run reported as two-phase
+    TwoPhaseStats stats {};
+    TwoPhaseStats best {};
+    report(name, size, "two-phase", bestOf([&pyo, &stats]() { return CppBuilder<TwoPhase<T>>()(pyo.get(), stats).size(); }
+        , [&stats, &best]() { best = stats; }));
+    report(name, size, "  with GIL", best.gil_held_ms);
+    report(name, size, "  GIL-free", best.gil_free_ms);
+  }
+}
+
+/** Arena: containers built into a MonotonicArena against the default allocator **/
+
+// Construction and destruction of the value are both measured
+template <class T, class ARENA_T>
+static void benchArena(std::string const& name, std::string const& pyGenerator, std::size_t maxSize)
+{
+  for (std::size_t size : sizes(10000, maxSize))
+  {
+    std::ostringstream code;
+    code << pyGenerator << size << "))";
+    auto pyo = pyEval(code.str());
+    report(name, size, "new/delete", bestOf([&pyo]() { return CppBuilder<T>()(pyo.get()).size(); }));
+    report(name, size, "arena", bestOf([&pyo]() {
+        MonotonicArena arena;
+        ArenaScope scope(&arena);
+        return CppBuilder<ARENA_T>()(pyo.get()).size();
+    }));
+    report(name, size, "arena+sizing", bestOf([&pyo]() {
+        MonotonicArena arena(estimate_arena<ARENA_T>(pyo.get()).size());
+        ArenaScope scope(&arena);
+        return CppBuilder<ARENA_T>()(pyo.get()).size();
+    }));
+  }
+}
+
+/** build_into: repeated conversions into the same object against fresh values **/
+
+template <class T>
+static void benchBuildInto(std::string const& name, std::string const& pyGenerator, std::size_t maxSize)
+{
+  for (std::size_t size : sizes(1000, std::min<std::size_t>(maxSize, 1000000)))
+  {
+    std::ostringstream code;
+    code << pyGenerator << size << "))";
+    auto pyo = pyEval(code.str());
+    report(name, size, "fresh", bestOf([&pyo]() { return CppBuilder<T>()(pyo.get()).size(); }));
+    typename CppBuilder<T>::value_type out;
+    CppBuilder<T>().build_into(out, pyo.get());
+    report(name, size, "build_into", bestOf([&pyo, &out]() {
+        CppBuilder<T>().build_into(out, pyo.get());
+        return out.size();
+    }));
+  }
+}
+
+/** Homogeneous lists of numbers: raw reads and range checks at once against per-item conversions **/
+
+// Conversion path used by CppBuilder<std::vector<T>> for lists of numbers before the homogeneous path
+template <class T>
+static std::vector<T> legacyNumbersBuilder(PyObject* pyo)
+{
+  CppBuilder<T> builder;
+  std::vector<T> out;
+  out.reserve(PyList_GET_SIZE(pyo));
+  for (Py_ssize_t i { 0 } ; i != PyList_GET_SIZE(pyo) ; ++i)
+  {
+    out.push_back(builder(PyList_GET_ITEM(pyo, i)));
+  }
+  return out;
+}
+
+template <class T>
+static void benchNumbers(std::string const& name, std::string const& pyGenerator, std::size_t maxSize)
+{
+  for (std::size_t size : sizes(1000, maxSize))
+  {
+    std::ostringstream code;
+    code << pyGenerator << size << "))";
+    auto pyo = pyEval(code.str());
+    report(name, size, "per-item", bestOf([&pyo]() { return legacyNumbersBuilder<T>(pyo.get()).size(); }));
+    report(name, size, "homogeneous", bestOf([&pyo]() { return CppBuilder<std::vector<T>>()(pyo.get()).size(); }));
+  }
+}
+
+/** FromDictScan: single dict scan against one lookup per field **/
+
+namespace
+{
+  template <std::size_t N>
+  struct WideRecord
+  {
+    std::array<int, N> values;
+  };
+  
+  template <std::size_t I> using IntField = int;
+  
+  template <std::size_t N, std::size_t I>
+  std::pair<std::string, std::function<void(WideRecord<N>&, int)>> wideMapping()
+  {
+    return make_mapping("f" + std::to_string(I), std::function<void(WideRecord<N>&, int)>([](WideRecord<N>& record, int value) { record.values[I] = value; }));
+  }
+  
+  template <template <class...> class MODE, std::size_t N, std::size_t... Is>
+  CppBuilder<MODE<WideRecord<N>, IntField<Is>...>> wideBuilder(_IndexSequence<Is...>)
+  {
+    return CppBuilder<MODE<WideRecord<N>, IntField<Is>...>>(wideMapping<N, Is>()...);
+  }
+}
+
+template <std::size_t N>
+static void benchFromDictScan(std::size_t maxSize)
+{
+  auto lookup = wideBuilder<FromDict, N>(typename _MakeIndexSequence<N>::type());
+  auto scan = wideBuilder<FromDictScan, N>(typename _MakeIndexSequence<N>::type());
+  std::size_t count { std::min<std::size_t>(maxSize, 1000000) / N };
+  
+  // dicts containing: all the fields, 10% of the fields, all the fields and 4x more unknown keys
+  const std::pair<std::string, std::string> layouts[] = {
+      { "all keys", "['f%d' % f for f in xrange(" + std::to_string(N) + ")]" },
+      { "10% keys", "['f%d' % f for f in xrange(0, " + std::to_string(N) + ", 10)]" },
+      { "+unknown", "['f%d' % f for f in xrange(" + std::to_string(N) + ")] + ['u%d' % f for f in xrange(" + std::to_string(4 * N) + ")]" } };
+  for (auto const& layout : layouts)
+  {
+    std::ostringstream code;
+    code << "[dict((k, i) for k in " << layout.second << ") for i in xrange(" << count << ")]";
+    auto pyo = pyEval(code.str());
+    std::string name { "FromDict " + std::to_string(N) + " fields, " + layout.first };
+    report(name, count, "lookup", bestOf([&pyo, &lookup]() {
+        std::size_t total { 0 };
+        for (Py_ssize_t i { 0 } ; i != PyList_GET_SIZE(pyo.get()) ; ++i) { total += lookup(PyList_GET_ITEM(pyo.get(), i)).values[N -1]; }
+        return total;
+    }));
+    report(name, count, "scan", bestOf([&pyo, &scan]() {
+        std::size_t total { 0 };
+        for (Py_ssize_t i { 0 } ; i != PyList_GET_SIZE(pyo.get()) ; ++i) { total += scan(PyList_GET_ITEM(pyo.get(), i)).values[N -1]; }
+        return total;
+    }));
+  }
+}
+
+/** InternedString: pooled handles against one std::string per item **/
+
+static void benchInterned(std::string const& name, std::string const& pyPattern, std::size_t maxSize)
+{
+  for (std::size_t size : sizes(1000, maxSize))
+  {
+    std::ostringstream code;
+    code << "list(" << pyPattern << " % (i % 2000) for i in xrange(" << size << "))";
+    auto pyo = pyEval(code.str());
+    report(name, size, "string", bestOf([&pyo]() { return CppBuilder<std::vector<std::string>>()(pyo.get()).size(); }));
+    // long-lived pool: the first run fills it
+    StringPool pool;
+    StringPoolScope scope(&pool);
+    report(name, size, "interned", bestOf([&pyo]() { return CppBuilder<std::vector<InternedString>>()(pyo.get()).size(); }));
+    pool.release_identity_cache();
+  }
+}
+
+/** LazyVector: reading a few items against converting the whole list **/
+
+static void benchLazy(std::size_t maxSize)
+{
+  for (std::size_t size : sizes(1000, maxSize))
+  {
+    std::ostringstream code;
+    code << "list(('%020d' % i, [i, i]) for i in xrange(" << size << "))";
+    auto pyo = pyEval(code.str());
+    typedef std::tuple<std::string, std::vector<int>> Item;
+    std::string name { "first 10 of vector<tuple<string,vector<int>>>" };
+    report(name, size, "vector", bestOf([&pyo]() {
+        auto items = CppBuilder<std::vector<Item>>()(pyo.get());
+        std::size_t total { 0 };
+        for (std::size_t i { 0 } ; i != 10 ; ++i) { total += std::get<1>(items[i]).size(); }
+        return total;
+    }));
+    report(name, size, "lazy", bestOf([&pyo]() {
+        auto items = CppBuilder<LazyVector<Item>>()(pyo.get());
+        std::size_t total { 0 };
+        for (std::size_t i { 0 } ; i != 10 ; ++i) { total += std::get<1>(items[i]).size(); }
+        return total;
+    }));
+  }
+}
+
+/** FromIterable: generator read directly against materialized into a list **/
+
+static void benchIterable(std::size_t maxSize)
+{
+  for (std::size_t size : sizes(1000, maxSize))
+  {
+    std::ostringstream code;
+    code << "lambda: ((i, '%020d' % i) for i in xrange(" << size << "))";
+    auto pyFactory = pyEval(code.str());
+    auto generator = [&pyFactory]() { return std::unique_ptr<PyObject, decref>(PyObject_CallObject(pyFactory.get(), nullptr)); };
+    typedef std::tuple<int, std::string> Item;
+    std::string name { "generator of tuple<int,string>" };
+    report(name, size, "list()", bestOf([&generator]() {
+        auto pyGenerator = generator();
+        std::unique_ptr<PyObject, decref> pyList { PySequence_List(pyGenerator.get()) };
+        return CppBuilder<std::vector<Item>>()(pyList.get()).size();
+    }));
+    report(name, size, "iterable", bestOf([&generator]() {
+        auto pyGenerator = generator();
+        return CppBuilder<FromIterable<Item>>()(pyGenerator.get()).size();
+    }));
+    report(name, size, "stream 1024", bestOf([&generator]() {
+        auto pyGenerator = generator();
+        return CppBuilder<FromIterable<Item>>().stream(pyGenerator.get(), 1024, [](std::vector<Item>&) {});
+    }));
+  }
+}
+
+/** PyBuilder: presized containers against PyList_Append, buffer export against one PyFloat per item **/
+
+// Hand-rolled conversion used by the modules before PyBuilder<std::vector<T>>
+static PyObject* legacyPyList(std::vector<double> const& values)
+{
+  PyObject* pyo { PyList_New(0) };
+  for (double value : values)
+  {
+    PyObject* pyo_item { PyFloat_FromDouble(value) };
+    PyList_Append(pyo, pyo_item);
+    Py_DECREF(pyo_item);
+  }
+  return pyo;
+}
+
+static void benchPyBuilder(std::size_t maxSize)
+{
+  for (std::size_t size : sizes(1000, maxSize))
+  {
+    std::vector<double> values(size, .5);
+    std::string name { "vector<double> -> Python" };
+    report(name, size, "append", bestOf([&values]() {
+        std::unique_ptr<PyObject, decref> pyo { legacyPyList(values) };
+        return static_cast<std::size_t>(PyList_GET_SIZE(pyo.get()));
+    }));
+    report(name, size, "presized", bestOf([&values]() {
+        std::unique_ptr<PyObject, decref> pyo { PyBuilder<std::vector<double>>()(values) };
+        return static_cast<std::size_t>(PyList_GET_SIZE(pyo.get()));
+    }));
+    report(name, size, "buffer", bestOf([size]() {
+        std::unique_ptr<PyObject, decref> pyo { PyBuilder<ToBuffer<double>>()(std::vector<double>(size, .5)) };
+        return static_cast<std::size_t>(pyo != nullptr);
+    }));
+  }
+}
+
+/** Every builder against a hand-written Python C API conversion **/
+
+namespace
+{
+  // Bytes of the C++ payload: numbers and characters, containers' overhead is not counted
+  template <class T> typename std::enable_if<std::is_arithmetic<T>::value, std::size_t>::type payloadBytes(T const&);
+  std::size_t payloadBytes(std::string const& value);
+  std::size_t payloadBytes(std::wstring const& value);
+  std::size_t payloadBytes(PyStringRef const& value);
+  std::size_t payloadBytes(InternedString const& value);
+  template <class T> std::size_t payloadBytes(BufferView<T> const& value);
+  template <class T1, class T2> std::size_t payloadBytes(std::pair<T1, T2> const& value);
+  template <class... Args> std::size_t payloadBytes(std::tuple<Args...> const& value);
+  template <class C> auto payloadBytes(C const& value) -> decltype(value.begin(), std::size_t());
+
+  template <class T> typename std::enable_if<std::is_arithmetic<T>::value, std::size_t>::type payloadBytes(T const&) { return sizeof(T); }
+  std::size_t payloadBytes(std::string const& value) { return value.size(); }
+  std::size_t payloadBytes(std::wstring const& value) { return value.size() * sizeof(wchar_t); }
+  std::size_t payloadBytes(PyStringRef const& value) { return value.size(); }
+  std::size_t payloadBytes(InternedString const& value) { return value.size(); }
+  template <class T> std::size_t payloadBytes(BufferView<T> const& value) { return value.size() * sizeof(T); }
+  template <class T1, class T2> std::size_t payloadBytes(std::pair<T1, T2> const& value)
+  {
+    return payloadBytes(value.first) + payloadBytes(value.second);
+  }
+  template <class TUPLE, std::size_t... Is> std::size_t tupleBytes(TUPLE const& value, _IndexSequence<Is...>)
+  {
+    std::size_t total { 0 };
+    int dummy[] = { 0, (total += payloadBytes(std::get<Is>(value)), 0)... };
+    (void)dummy;
+    return total;
+  }
+  template <class... Args> std::size_t payloadBytes(std::tuple<Args...> const& value)
+  {
+    return tupleBytes(value, typename _MakeIndexSequence<sizeof...(Args)>::type());
+  }
+  template <class C> auto payloadBytes(C const& value) -> decltype(value.begin(), std::size_t())
+  {
+    std::size_t total { 0 };
+    for (auto const& item : value)
+    {
+      total += payloadBytes(item);
+    }
+    return total;
+  }
+
+  struct SuitePoint
+  {
+    double x {}, y {};
+
+    SuitePoint() {}
+    SuitePoint(double x, double y) : x(x), y(y) {}
+
+    bool operator==(SuitePoint const& other) const { return x == other.x && y == other.y; }
+
+    typedef CppBuilder<FromTuple<SuitePoint, PY2CPP_FIELD(&SuitePoint::x), PY2CPP_FIELD(&SuitePoint::y)>> FromPyTuple;
+    struct FromPyDict : CppBuilder<FromDict<SuitePoint, PY2CPP_FIELD(&SuitePoint::x), PY2CPP_FIELD(&SuitePoint::y)>>
+    {
+      FromPyDict() : CppBuilder<FromDict<SuitePoint, PY2CPP_FIELD(&SuitePoint::x), PY2CPP_FIELD(&SuitePoint::y)>>("x", "y") {}
+    };
+    struct FromPyDictScan : CppBuilder<FromDictScan<SuitePoint, double, double>>
+    {
+      FromPyDictScan() : CppBuilder<FromDictScan<SuitePoint, double, double>>(make_mapping("x", &SuitePoint::x), make_mapping("y", &SuitePoint::y)) {}
+    };
+    PY2CPP_STRUCT(SuitePoint, x, y);
+  };
+  std::size_t payloadBytes(SuitePoint const&) { return 2 * sizeof(double); }
+
+  // Conversion of the whole PyObject by CppBuilder<T>
+  template <class T>
+  struct Build
+  {
+    typename CppBuilder<T>::value_type operator() (PyObject* pyo) const
+    {
+      return CppBuilder<T>()(pyo);
+    }
+  };
+
+  // CppBuilder<T> called on every item of a list
+  template <class T>
+  struct EachItem
+  {
+    std::vector<T> operator() (PyObject* pyo) const
+    {
+      CppBuilder<T> builder;
+      std::vector<T> out;
+      out.reserve(PyList_GET_SIZE(pyo));
+      for (Py_ssize_t i { 0 } ; i != PyList_GET_SIZE(pyo) ; ++i)
+      {
+        out.push_back(builder(PyList_GET_ITEM(pyo, i)));
+      }
+      return out;
+    }
+  };
+
+  template <class A>
+  void checkSame(A const& built, A const& expected)
+  {
+    if (! (built == expected))
+    {
+      throw std::logic_error("CppBuilder and its C API baseline disagree");
+    }
+  }
+  template <class A, class B>
+  void checkSame(A const&, B const&) {}
+}
+
+/* C API baselines */
+
+static bool capiBool(PyObject* pyo)
+{
+  if (! PyBool_Check(pyo))
+  {
+    throw std::invalid_argument("Not a PyBool instance");
+  }
+  return pyo == Py_True;
+}
+
+template <class T>
+static T capiInteger(PyObject* pyo)
+{
+  long value;
+  if (PyInt_Check(pyo))
+  {
+    value = PyInt_AS_LONG(pyo);
+  }
+  else if (PyLong_Check(pyo))
+  {
+    value = PyLong_AsLong(pyo);
+    if (value == -1 && PyErr_Occurred())
+    {
+      PyErr_Clear();
+      throw std::overflow_error("Out of range");
+    }
+  }
+  else
+  {
+    throw std::invalid_argument("Not a PyInt instance");
+  }
+  if (std::is_signed<T>::value
+      ? value < static_cast<long>(std::numeric_limits<T>::min()) || value > static_cast<long>(std::numeric_limits<T>::max())
+      : value < 0 || static_cast<unsigned long>(value) > static_cast<unsigned long>(std::numeric_limits<T>::max()))
+  {
+    throw std::overflow_error("Out of range");
+  }
+  return static_cast<T>(value);
+}
+
+static double capiDouble(PyObject* pyo)
+{
+  if (PyFloat_Check(pyo))
+  {
+    return PyFloat_AS_DOUBLE(pyo);
+  }
+  if (PyInt_Check(pyo))
+  {
+    return static_cast<double>(PyInt_AS_LONG(pyo));
+  }
+  double value { PyFloat_AsDouble(pyo) };
+  if (value == -1. && PyErr_Occurred())
+  {
+    PyErr_Clear();
+    throw std::invalid_argument("Not a number");
+  }
+  return value;
+}
+
+static std::string capiString(PyObject* pyo)
+{
+  char* data;
+  Py_ssize_t size;
+  if (PyString_Check(pyo) && PyString_AsStringAndSize(pyo, &data, &size) == 0)
+  {
+    return std::string(data, size);
+  }
+  if (PyUnicode_Check(pyo))
+  {
+    std::unique_ptr<PyObject, decref> encoded { PyUnicode_AsUTF8String(pyo) };
+    if (encoded && PyString_AsStringAndSize(encoded.get(), &data, &size) == 0)
+    {
+      return std::string(data, size);
+    }
+  }
+  PyErr_Clear();
+  throw std::invalid_argument("Neither a PyString nor a PyUnicode instance");
+}
+
+static std::wstring capiWString(PyObject* pyo)
+{
+  if (! PyUnicode_Check(pyo))
+  {
+    throw std::invalid_argument("Not a PyUnicode instance");
+  }
+  std::wstring out(PyUnicode_GET_SIZE(pyo), L'\0');
+  if (! out.empty() && PyUnicode_AsWideChar(reinterpret_cast<PyUnicodeObject*>(pyo), &out[0], out.size()) < 0)
+  {
+    PyErr_Clear();
+    throw std::runtime_error("Unable to read the PyUnicode");
+  }
+  return out;
+}
+
+// ITEM(PyObject*) on every item of a list or a tuple
+template <class T, T (*ITEM)(PyObject*)>
+static std::vector<T> capiVector(PyObject* pyo)
+{
+  if (! PyList_Check(pyo) && ! PyTuple_Check(pyo))
+  {
+    throw std::invalid_argument("Neither a PyList nor a PyTuple instance");
+  }
+  std::vector<T> out;
+  out.reserve(PySequence_Fast_GET_SIZE(pyo));
+  for (Py_ssize_t i { 0 } ; i != PySequence_Fast_GET_SIZE(pyo) ; ++i)
+  {
+    out.push_back(ITEM(PySequence_Fast_GET_ITEM(pyo, i)));
+  }
+  return out;
+}
+
+static std::vector<int> capiInts(PyObject* pyo)
+{
+  return capiVector<int, &capiInteger<int>>(pyo);
+}
+
+static std::tuple<int, double, std::string> capiTuple(PyObject* pyo)
+{
+  if (! PyTuple_Check(pyo) || PyTuple_GET_SIZE(pyo) != 3)
+  {
+    throw std::invalid_argument("Not a PyTuple of 3 items");
+  }
+  return std::make_tuple(capiInteger<int>(PyTuple_GET_ITEM(pyo, 0)), capiDouble(PyTuple_GET_ITEM(pyo, 1)), capiString(PyTuple_GET_ITEM(pyo, 2)));
+}
+
+// KEY(PyObject*) and VALUE(PyObject*) on every entry of a dict
+template <class MAP, typename MAP::key_type (*KEY)(PyObject*), typename MAP::mapped_type (*VALUE)(PyObject*)>
+static MAP capiMap(PyObject* pyo)
+{
+  if (! PyDict_Check(pyo))
+  {
+    throw std::invalid_argument("Not a PyDict instance");
+  }
+  MAP out;
+  PyObject *key, *value;
+  Py_ssize_t pos { 0 };
+  while (PyDict_Next(pyo, &pos, &key, &value))
+  {
+    out.emplace(KEY(key), VALUE(value));
+  }
+  return out;
+}
+
+// ITEM(PyObject*) on every item of a set
+template <class SET, typename SET::value_type (*ITEM)(PyObject*)>
+static SET capiSet(PyObject* pyo)
+{
+  if (! PyAnySet_Check(pyo))
+  {
+    throw std::invalid_argument("Not a PySet instance");
+  }
+  SET out;
+  std::unique_ptr<PyObject, decref> iterator { PyObject_GetIter(pyo) };
+  while (std::unique_ptr<PyObject, decref> item { PyIter_Next(iterator.get()) })
+  {
+    out.insert(ITEM(item.get()));
+  }
+  return out;
+}
+
+static SuitePoint capiTuplePoint(PyObject* pyo)
+{
+  if (! PyTuple_Check(pyo) || PyTuple_GET_SIZE(pyo) != 2)
+  {
+    throw std::invalid_argument("Not a PyTuple of 2 items");
+  }
+  return SuitePoint { capiDouble(PyTuple_GET_ITEM(pyo, 0)), capiDouble(PyTuple_GET_ITEM(pyo, 1)) };
+}
+
+static SuitePoint capiDictPoint(PyObject* pyo)
+{
+  SuitePoint point { 0., 0. };
+  if (! PyDict_Check(pyo))
+  {
+    throw std::invalid_argument("Not a PyDict instance");
+  }
+  if (PyObject* x = PyDict_GetItemString(pyo, "x"))
+  {
+    point.x = capiDouble(x);
+  }
+  if (PyObject* y = PyDict_GetItemString(pyo, "y"))
+  {
+    point.y = capiDouble(y);
+  }
+  return point;
+}
+
+static SuitePoint capiObjectPoint(PyObject* pyo)
+{
+  SuitePoint point { 0., 0. };
+  if (std::unique_ptr<PyObject, decref> x { PyObject_GetAttrString(pyo, "x") })
+  {
+    point.x = capiDouble(x.get());
+  }
+  if (std::unique_ptr<PyObject, decref> y { PyObject_GetAttrString(pyo, "y") })
+  {
+    point.y = capiDouble(y.get());
+  }
+  PyErr_Clear();
+  return point;
+}
+
+static std::vector<double> capiBuffer(PyObject* pyo)
+{
+  Py_buffer view;
+  if (PyObject_GetBuffer(pyo, &view, PyBUF_FORMAT | PyBUF_C_CONTIGUOUS) != 0)
+  {
+    PyErr_Clear();
+    throw std::invalid_argument("Not a PyObject exporting a buffer");
+  }
+  std::vector<double> out(static_cast<const double*>(view.buf), static_cast<const double*>(view.buf) + view.len / sizeof(double));
+  PyBuffer_Release(&view);
+  return out;
+}
+
+// BUILD and CAPI convert the same PyObject of size elements made by source(size),
+// CAPI being the hand-written Python C API equivalent of BUILD
+// Both results are compared when they have the same type
+template <class SOURCE, class BUILD, class CAPI>
+static void benchVsCApi(std::string const& name, SOURCE const& source, std::size_t maxSize, BUILD const& build, CAPI const& capi)
+{
+  if (! selected(name))
+  {
+    return;
+  }
+  for (std::size_t size : sizes(100, maxSize))
+  {
+    std::unique_ptr<PyObject, decref> pyo { source(size) };
+    std::size_t bytes;
+    {
+      auto built = build(pyo.get());
+      checkSame(built, capi(pyo.get()));
+      bytes = payloadBytes(built);
+    }
+    report(name, size, "C API", bestOf([&pyo, &capi]() { return capi(pyo.get()).size(); }), bytes);
+    report(name, size, "py2cpp", bestOf([&pyo, &build]() { return build(pyo.get()).size(); }), bytes);
+  }
+}
+
+template <class BUILD, class CAPI>
+static void benchVsCApi(std::string const& name, const char* pyGenerator, std::size_t maxSize, BUILD const& build, CAPI const& capi)
+{
+  auto source = [pyGenerator](std::size_t size)
+  {
+    std::ostringstream code;
+    code << pyGenerator << size << "))";
+    return pyEval(code.str());
+  };
+  benchVsCApi(name, source, maxSize, build, capi);
+}
+
+static PyObject* doubleBuffer(std::size_t size)
+{
+  return PyBuilder<ToBuffer<double>>()(std::vector<double>(size, .5));
+}
+
+// Sizes up to 10^7 for flat containers of scalars, 10^6 for strings and nested values, 10^5 for long strings
+static void benchSuite(std::size_t maxSize)
+{
+  std::size_t nestedSize { std::min<std::size_t>(maxSize, 1000000) };
+  std::size_t longSize { std::min<std::size_t>(maxSize, 100000) };
+  PyRun_SimpleString(
+      "class SuitePoint(object):\n"
+      "   def __init__(self, i): self.x, self.y = i * .5, 1.5\n");
+
+  // primitives: one conversion per item
+  benchVsCApi("bool", "list(i % 2 == 0 for i in xrange(", maxSize, EachItem<bool>(), capiVector<bool, &capiBool>);
+  benchVsCApi("int", "list(i - 500 for i in xrange(", maxSize, EachItem<int>(), capiVector<int, &capiInteger<int>>);
+  benchVsCApi("unsigned int", "list(xrange(", maxSize, EachItem<unsigned int>(), capiVector<unsigned int, &capiInteger<unsigned int>>);
+  benchVsCApi("long", "list(i - 500 for i in xrange(", maxSize, EachItem<long>(), capiVector<long, &capiInteger<long>>);
+  benchVsCApi("unsigned long", "list(xrange(", maxSize, EachItem<unsigned long>(), capiVector<unsigned long, &capiInteger<unsigned long>>);
+  benchVsCApi("long long", "list(i - 500 for i in xrange(", maxSize, EachItem<long long>(), capiVector<long long, &capiInteger<long long>>);
+  benchVsCApi("unsigned long long", "list(xrange(", maxSize, EachItem<unsigned long long>(), capiVector<unsigned long long, &capiInteger<unsigned long long>>);
+  benchVsCApi("double", "list(i * .5 for i in xrange(", maxSize, EachItem<double>(), capiVector<double, &capiDouble>);
+
+  // strings
+  benchVsCApi("vector<string> length 8", "list('%08d' % i for i in xrange(", maxSize, Build<std::vector<std::string>>(), capiVector<std::string, &capiString>);
+  benchVsCApi("vector<string> length 64", "list('%064d' % i for i in xrange(", nestedSize, Build<std::vector<std::string>>(), capiVector<std::string, &capiString>);
+  benchVsCApi("vector<string> length 1024", "list('%01024d' % i for i in xrange(", longSize, Build<std::vector<std::string>>(), capiVector<std::string, &capiString>);
+  benchVsCApi("vector<string> unicode length 64", "list(u'caf\\xe9%060d' % i for i in xrange(", nestedSize, Build<std::vector<std::string>>(), capiVector<std::string, &capiString>);
+  benchVsCApi("vector<wstring> length 64", "list(u'caf\\xe9%060d' % i for i in xrange(", nestedSize, Build<std::vector<std::wstring>>(), capiVector<std::wstring, &capiWString>);
+  benchVsCApi("vector<PyStringRef> length 64", "list('%064d' % i for i in xrange(", nestedSize, Build<std::vector<PyStringRef>>(), capiVector<std::string, &capiString>);
+  benchVsCApi("vector<InternedString> 1000 distinct", "list('category-%04d' % (i % 1000) for i in xrange(", maxSize, Build<std::vector<InternedString>>(), capiVector<std::string, &capiString>);
+
+  // containers
+  benchVsCApi("vector<int>", "list(i - 500 for i in xrange(", maxSize, Build<std::vector<int>>(), capiVector<int, &capiInteger<int>>);
+  benchVsCApi("vector<double>", "list(i * .5 for i in xrange(", maxSize, Build<std::vector<double>>(), capiVector<double, &capiDouble>);
+  benchVsCApi("vector<tuple<int,double,string>>", "list((i, i * .5, '%08d' % i) for i in xrange(", nestedSize,
+      Build<std::vector<std::tuple<int, double, std::string>>>(), capiVector<std::tuple<int, double, std::string>, &capiTuple>);
+  benchVsCApi("vector<vector<int>>", "list([i, i, i, i] for i in xrange(", nestedSize, Build<std::vector<std::vector<int>>>(), capiVector<std::vector<int>, &capiInts>);
+  benchVsCApi("map<string,int>", "dict(('%08d' % i, i) for i in xrange(", nestedSize,
+      Build<std::map<std::string, int>>(), capiMap<std::map<std::string, int>, &capiString, &capiInteger<int>>);
+  benchVsCApi("map<string,vector<int>>", "dict(('%08d' % i, [i, i]) for i in xrange(", nestedSize,
+      Build<std::map<std::string, std::vector<int>>>(), capiMap<std::map<std::string, std::vector<int>>, &capiString, &capiInts>);
+  benchVsCApi("set<int>", "set(xrange(", nestedSize, Build<std::set<int>>(), capiSet<std::set<int>, &capiInteger<int>>);
+  benchVsCApi("unordered_map<int,string>", "dict((i, '%08d' % i) for i in xrange(", nestedSize,
+      Build<std::unordered_map<int, std::string>>(), capiMap<std::unordered_map<int, std::string>, &capiInteger<int>, &capiString>);
+  benchVsCApi("unordered_set<string>", "set('%08d' % i for i in xrange(", nestedSize,
+      Build<std::unordered_set<std::string>>(), capiSet<std::unordered_set<std::string>, &capiString>);
+
+  // objects
+  benchVsCApi("vector<FromTuple<Point>>", "list((i * .5, 1.5) for i in xrange(", nestedSize,
+      Build<std::vector<SuitePoint::FromPyTuple>>(), capiVector<SuitePoint, &capiTuplePoint>);
+  benchVsCApi("vector<FromDict<Point>> of dict", "list({'x': i * .5, 'y': 1.5} for i in xrange(", nestedSize,
+      Build<std::vector<SuitePoint::FromPyDict>>(), capiVector<SuitePoint, &capiDictPoint>);
+  benchVsCApi("vector<FromDict<Point>> of object", "list(SuitePoint(i) for i in xrange(", nestedSize,
+      Build<std::vector<SuitePoint::FromPyDict>>(), capiVector<SuitePoint, &capiObjectPoint>);
+  benchVsCApi("vector<FromDictScan<Point>> of dict", "list({'x': i * .5, 'y': 1.5} for i in xrange(", nestedSize,
+      Build<std::vector<SuitePoint::FromPyDictScan>>(), capiVector<SuitePoint, &capiDictPoint>);
+  benchVsCApi("vector<PY2CPP_STRUCT Point> of dict", "list({'x': i * .5, 'y': 1.5} for i in xrange(", nestedSize,
+      Build<std::vector<SuitePoint>>(), capiVector<SuitePoint, &capiDictPoint>);
+
+  // buffers
+  benchVsCApi("FromBuffer<double>", doubleBuffer, maxSize, Build<FromBuffer<double>>(), capiBuffer);
+  benchVsCApi("BufferView<double>", doubleBuffer, maxSize, Build<BufferView<double>>(), capiBuffer);
+}
+
+/**
+ * Launch all the benchmarks
+ * Usage: py2cpp-bench.out [max_size] [--json] [--perf] [--filter=text]
+ *   max_size:      largest number of elements per measure (default: 10^7)
+ *   --json:        print the results as a single JSON document
+ *   --perf:        count the cache misses with perf_event_open (Linux)
+ *   --filter=text: only run the benchmarks whose name contains text
+ */
+
+// fun is run if its name is selected
+template <class FUN>
+static void run(std::string const& name, FUN&& fun)
+{
+  if (selected(name))
+  {
+    fun();
+  }
+}
+
+int main(int argc, char **argv)
+{
+  for (int i { 1 } ; i != argc ; ++i)
+  {
+    std::string arg { argv[i] };
+    if (arg == "--json")
+    {
+      options.json = true;
+    }
+    else if (arg == "--perf")
+    {
+      options.perf = true;
+    }
+    else if (arg.compare(0, 9, "--filter=") == 0)
+    {
+      options.filter = arg.substr(9);
+    }
+    else if (! arg.empty())
+    {
+      options.maxSize = static_cast<std::size_t>(std::strtoull(arg.c_str(), nullptr, 10));
+    }
+  }
+  std::size_t maxSize { options.maxSize };
+
+  Py_Initialize();
+  benchSuite(maxSize);
+  run("map<int,int>", [=]() { benchMap<int, int>("map<int,int>", "(i, i)", maxSize); });
+  run("map<string,vector<int>>", [=]() { benchMap<std::string, std::vector<int>>("map<string,vector<int>>", "(str(i), [i, i, i, i])", maxSize); });
+  run("string<-unicode", [=]() {
+      benchUnicode("string<-unicode ascii", "u'abcdefgh'", maxSize);
+      benchUnicode("string<-unicode latin-1", "u'caf\\xe9 '", maxSize);
+  });
+  run("vector<FromDict<10 ints>>", [=]() { benchFromDict(maxSize); });
+  run("vector<FromDict<3 ints>> of objects", [=]() { benchFromObject(maxSize); });
+  run("vector<FromDict<Point>>", [=]() { benchFields(maxSize); });
+  run("new builder per FromDict<Point>", [=]() { benchBuilderConstruction(maxSize); });
+  run("TwoPhase", [=]() {
+      benchTwoPhase<std::set<int>>("set<int>", "set(i * 7919 % 1000003 for i in xrange(", maxSize);
+      benchTwoPhase<std::map<int, std::string>>("map<int,string>", "dict((i, str(i)) for i in xrange(", maxSize);
+      benchTwoPhase<std::vector<std::vector<int>>>("vector<vector<int>>", "list([i, i] for i in xrange(", maxSize);
+  });
+  run("arena", [=]() {
+      benchArena<std::vector<std::string>, ArenaVector<ArenaString>>("vector<string>", "list('%020d' % i for i in xrange(", maxSize);
+      benchArena<std::map<std::string, std::vector<int>>, ArenaMap<ArenaString, ArenaVector<int>>>("map<string,vector<int>>", "dict(('%020d' % i, [i, i]) for i in xrange(", maxSize);
+  });
+  run("build_into", [=]() {
+      benchBuildInto<std::vector<std::tuple<int, std::string, std::vector<double>>>>("vector<tuple<int,string,vector<double>>>", "list((i, '%020d' % i, [.5] * 4) for i in xrange(", maxSize);
+      benchBuildInto<std::map<std::string, std::vector<int>>>("map<string,vector<int>>", "dict((str(i), [i, i, i, i]) for i in xrange(", maxSize);
+  });
+  run("homogeneous", [=]() {
+      benchNumbers<int>("vector<int>", "list(i - 500 for i in xrange(", maxSize);
+      benchNumbers<unsigned long>("vector<unsigned long>", "list(xrange(", maxSize);
+      benchNumbers<double>("vector<double>", "list(i * .5 for i in xrange(", maxSize);
+  });
+  run("FromDictScan", [=]() {
+      benchFromDictScan<10>(maxSize);
+      benchFromDictScan<50>(maxSize);
+      benchFromDictScan<100>(maxSize);
+  });
+  run("InternedString", [=]() {
+      benchInterned("vector<string> 2000 distinct short", "'category-%04d'", maxSize);
+      benchInterned("vector<string> 2000 distinct long", "'a/rather/long/category/path/number-%04d'", maxSize);
+  });
+  run("LazyVector", [=]() { benchLazy(maxSize); });
+  run("FromIterable", [=]() { benchIterable(maxSize); });
+  run("PyBuilder", [=]() { benchPyBuilder(maxSize); });
+  Py_Finalize();
+
+  if (options.json)
+  {
+    std::cout << "{\"max_size\": " << maxSize << ", \"runs\": " << NUM_RUNS << ", \"results\": [";
+    for (std::size_t i { 0 } ; i != jsonResults.size() ; ++i)
+    {
+      std::cout << (i != 0 ? ",\n  " : "\n  ") << jsonResults[i];
+    }
+    std::cout << "\n]}" << std::endl;
+  }
+  return 0;
+}
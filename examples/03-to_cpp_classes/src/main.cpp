@@ -23,12 +23,7 @@ class Point
       return sqrt(dX*dX + dY*dY);
     }
     
-    struct FromPy : CppBuilder<FromDict<Point, double, double>>
-    {
-      FromPy() : CppBuilder<FromDict<Point, double, double>>(
-            make_mapping("x", &Point::x)
-            , make_mapping("y", &Point::y)) {}
-    };
+    PY2CPP_STRUCT(Point, x, y);
     friend std::ostream &operator<<(std::ostream &out, Point const& p)
     {
       return (out << "[" << p.x << "," << p.y << "]");
@@ -51,9 +46,9 @@ class Path
       return length;
     }
 
-    struct FromPy : CppBuilder<FromTuple<Path, std::vector<Point::FromPy>>>
+    struct FromPy : CppBuilder<FromTuple<Path, std::vector<Point>>>
     {
-      FromPy() : CppBuilder<FromTuple<Path, std::vector<Point::FromPy>>>(&Path::pts) {}
+      FromPy() : CppBuilder<FromTuple<Path, std::vector<Point>>>(&Path::pts) {}
     };
     friend std::ostream &operator<<(std::ostream &out, Path const& path)
     {
@@ -2,22 +2,48 @@
 #define __PY2CPP_HPP__
 
 #include <Python.h>
+#include <structmember.h>
+#include <longintrepr.h>
 
+#include <algorithm>
+#include <array>
+#include <atomic>
 #include <cassert>
+#include <chrono>
 #include <climits>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
 #include <functional>
+#include <iterator>
 #include <memory>
+#include <mutex>
 #include <limits>
 #include <sstream>
 #include <stdexcept>
+#include <thread>
 #include <typeinfo>
+#include <type_traits>
 
+#include <deque>
 #include <map>
 #include <set>
 #include <string>
 #include <tuple>
+#include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#if defined(PY2CPP_STATS) && defined(__GNUG__)
+#include <cxxabi.h>
+#endif
+
 namespace dubzzz {
 namespace Py2Cpp {
 
@@ -37,835 +63,7034 @@ struct decref
   }
 };
 
-// FromTuple and FromDict are used to build cutsom and complex objects
-// based on dicts or classes
-// Syntax:
-//    CppBuilder<FromTuple<MyClass, accessors' types...>>
-//    CppBuilder<FromDict<MyClass, accessors' types...>>
-template <class OBJ, class... Args> struct FromTuple {};
-template <class OBJ, class... Args> struct FromDict {};
-
-// CppBuilder<T> implements the following methods:
-// * bool operator() (PyObject*): build the C++ object <T> corresponding to PyObject*
-// * bool eligible(PyObject*)   : true if the PyObject is eligible to build the object type
-//                                equivalent to CppBuilder does not throw std::invalid_argument for that PyObject
-template <class T> struct CppBuilder;
-
-/**
- * Internal structures
- */
-
-template <class T> struct ToBuildable : T {};
-
-/**
- * Identity builder
- */
-
-template <>
-struct CppBuilder<PyObject*>
+// Optional<T> either contains a T or nothing
+// It is returned by CppBuilder<T>::try_build to report a failure without exception
+template <class T>
+class Optional
 {
-  typedef PyObject* value_type;
-  value_type operator() (PyObject* pyo) const
-  {
-    assert(pyo);
-    return pyo;
-  }
-  bool eligible(PyObject* pyo) const
+  union
   {
-    return true;
-  }
-};
-template <> struct ToBuildable<PyObject*> : CppBuilder<PyObject*> {};
+    char empty_;
+    T value_;
+  };
+  bool engaged;
 
-/**
- * Primitives builders
- */
+public:
+  typedef T value_type;
 
-template <>
-struct CppBuilder<bool>
-{
-  typedef bool value_type;
-  value_type operator() (PyObject* pyo) const
+  Optional() : empty_(), engaged(false) {}
+  Optional(T const& value) : value_(value), engaged(true) {}
+  Optional(T&& value) : value_(std::move(value)), engaged(true) {}
+  Optional(Optional const& other) : empty_(), engaged(false)
   {
-    assert(pyo);
-    if (PyBool_Check(pyo))
+    if (other.engaged)
     {
-      return pyo == Py_True;
+      new (&value_) T(other.value_);
+      engaged = true;
     }
-    throw std::invalid_argument("Not a PyBool instance");
   }
-  bool eligible(PyObject* pyo) const
+  Optional(Optional&& other) : empty_(), engaged(false)
   {
-    return PyBool_Check(pyo);
+    if (other.engaged)
+    {
+      new (&value_) T(std::move(other.value_));
+      engaged = true;
+    }
   }
-};
-template <> struct ToBuildable<bool> : CppBuilder<bool> {};
-
-template <>
-struct CppBuilder<int>
-{
-  typedef int value_type;
-  value_type operator() (PyObject* pyo) const
+  Optional& operator=(Optional const& other)
   {
-    assert(pyo);
-    if (PyLong_Check(pyo))
+    if (this != &other)
     {
-      long v { PyLong_AsLong(pyo) };
-      if (v < INT_MIN || v > INT_MAX)
+      reset();
+      if (other.engaged)
       {
-        throw std::overflow_error("Out of <int> boundaries");
+        new (&value_) T(other.value_);
+        engaged = true;
       }
-      return static_cast<int>(v);
     }
-    else if (PyInt_Check(pyo))
+    return *this;
+  }
+  Optional& operator=(Optional&& other)
+  {
+    if (this != &other)
     {
-      long v { PyInt_AS_LONG(pyo) };
-      if (v < INT_MIN || v > INT_MAX)
+      reset();
+      if (other.engaged)
       {
-        throw std::overflow_error("Out of <int> boundaries");
+        new (&value_) T(std::move(other.value_));
+        engaged = true;
       }
-      return static_cast<int>(v);
     }
-    throw std::invalid_argument("Not a PyLong instance");
+    return *this;
   }
-  bool eligible(PyObject* pyo) const
+  ~Optional()
   {
-    return PyLong_Check(pyo) || PyInt_Check(pyo);
+    reset();
   }
-};
-template <> struct ToBuildable<int> : CppBuilder<int> {};
 
-template <>
-struct CppBuilder<unsigned int>
-{
-  typedef unsigned int value_type;
-  value_type operator() (PyObject* pyo) const
+  void reset()
   {
-    assert(pyo);
-    if (PyLong_Check(pyo))
-    {
-      unsigned long v { PyLong_AsUnsignedLong(pyo) };
-      if (!! PyErr_Occurred() && !! PyErr_ExceptionMatches(PyExc_OverflowError))
-      {
-        PyErr_Clear();
-        throw std::overflow_error("Out of <unsigned int> boundaries");
-      }
-      if (v > UINT_MAX)
-      {
-        throw std::overflow_error("Out of <unsigned int> boundaries");
-      }
-      return static_cast<unsigned int>(v);
-    }
-    else if (PyInt_Check(pyo))
+    if (engaged)
     {
-      long v { PyInt_AsLong(pyo) }; // PyInt is a long
-      if (v < 0 || v > UINT_MAX)
-      {
-        throw std::overflow_error("Out of <unsigned int> boundaries");
-      }
-      return static_cast<unsigned int>(v);
+      value_.~T();
+      engaged = false;
     }
-    throw std::invalid_argument("Not a PyLong instance");
-  }
-  bool eligible(PyObject* pyo) const
-  {
-    return PyLong_Check(pyo) || PyInt_Check(pyo);
   }
-};
-template <> struct ToBuildable<unsigned int> : CppBuilder<unsigned int> {};
 
-template <>
-struct CppBuilder<long>
-{
-  typedef long value_type;
-  value_type operator() (PyObject* pyo) const
+  bool has_value() const { return engaged; }
+  explicit operator bool() const { return engaged; }
+
+  T& operator*() { assert(engaged); return value_; }
+  T const& operator*() const { assert(engaged); return value_; }
+  T* operator->() { assert(engaged); return &value_; }
+  T const* operator->() const { assert(engaged); return &value_; }
+
+  T& value()
   {
-    assert(pyo);
-    if (PyLong_Check(pyo))
-    {
-      long value { PyLong_AsLong(pyo) };
-      if (!! PyErr_Occurred() && !! PyErr_ExceptionMatches(PyExc_OverflowError))
-      {
-        PyErr_Clear();
-        throw std::overflow_error("Out of <long> boundaries");
-      }
-      return value;
-    }
-    else if (PyInt_Check(pyo))
+    if (! engaged)
     {
-      return PyInt_AS_LONG(pyo);
+      throw std::logic_error("Empty Optional");
     }
-    throw std::invalid_argument("Not a PyLong instance");
+    return value_;
   }
-  bool eligible(PyObject* pyo) const
+  T const& value() const
   {
-    return PyLong_Check(pyo) || PyInt_Check(pyo);
+    if (! engaged)
+    {
+      throw std::logic_error("Empty Optional");
+    }
+    return value_;
   }
 };
-template <> struct ToBuildable<long> : CppBuilder<long> {};
 
-template <>
-struct CppBuilder<unsigned long>
+// FromTuple and FromDict are used to build cutsom and complex objects
+// based on dicts or classes
+// Syntax:
+//    CppBuilder<FromTuple<MyClass, accessors' types...>>
+//    CppBuilder<FromDict<MyClass, accessors' types...>>
+// FromDict keys are interned once, when the builder is constructed:
+// the Python interpreter has to be initialized at that time
+template <class OBJ, class... Args> struct FromTuple {};
+template <class OBJ, class... Args> struct FromDict {};
+
+// Field maps an entry of FromTuple or FromDict on a data member or a setter known at compile time
+// the value is directly stored into the object instead of going through a std::function
+// BUILDER defaults to the builder of the member's type
+// Syntax:
+//    CppBuilder<FromDict<MyClass, PY2CPP_FIELD(&MyClass::member), ...>>("key", ...)
+//    CppBuilder<FromDict<MyClass, Field<decltype(&MyClass::member), &MyClass::member, MyBuilder>, ...>>("key", ...)
+//    CppBuilder<FromTuple<MyClass, PY2CPP_FIELD(&MyClass::member), ...>>() -- only Field entries
+// Field and runtime mappings (make_mapping) can be mixed in FromDict
+template <class MEMBER> struct _FieldTraits;
+template <class MEMBER, MEMBER member, class BUILDER = typename _FieldTraits<MEMBER>::builder_type> struct Field;
+#define PY2CPP_FIELD(member) ::dubzzz::Py2Cpp::Field<decltype(member), member>
+
+// FromDictScan is a FromDict walking the dict once instead of looking up every field
+// Each key of the dict is dispatched to its field through a perfect hash table
+// built when the builder is constructed, keys without mapping are skipped
+// Faster when dicts only contain some of the mapped fields, slower when they contain many unknown keys
+// Objects which are not dicts are read as FromDict does
+// Syntax:
+//    CppBuilder<FromDictScan<MyClass, accessors' types...>>
+template <class OBJ, class... Args> struct FromDictScan {};
+
+// PY2CPP_STRUCT declares the schema of a class, read as FromDict does (dict or attributes)
+// keys are the names of the members, their types and builders are derived from the members
+// Keys are constexpr strings interned once per process and setters are dispatched at compile time:
+// the builder has no state and costs nothing to construct
+// The class becomes buildable as is: CppBuilder<MyClass>, std::vector<MyClass>, nested members...
+// Syntax, in a public section of the class, after the members (up to 16 members):
+//    PY2CPP_STRUCT(MyClass, member1, member2, ...);
+// MyClass::FromPy is the builder of the class
+template <class OBJ, class... Entries> struct FromSchema {};
+template <class KEY, class FIELD> struct SchemaEntry {};
+
+#define _PY2CPP_CAT(a, b) _PY2CPP_CAT_(a, b)
+#define _PY2CPP_CAT_(a, b) a##b
+#define _PY2CPP_COMMA() ,
+#define _PY2CPP_NOTHING()
+#define _PY2CPP_NARGS(...) _PY2CPP_NARGS_(__VA_ARGS__, 16, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1)
+#define _PY2CPP_NARGS_(_1, _2, _3, _4, _5, _6, _7, _8, _9, _10, _11, _12, _13, _14, _15, _16, N, ...) N
+// _PY2CPP_FOR_EACH(M, S, T, a, b, ...) expands to M(T, a) S() M(T, b) S() ...
+#define _PY2CPP_FOR_EACH(M, S, T, ...) _PY2CPP_CAT(_PY2CPP_EACH_, _PY2CPP_NARGS(__VA_ARGS__))(M, S, T, __VA_ARGS__)
+#define _PY2CPP_EACH_1(M, S, T, a) M(T, a)
+#define _PY2CPP_EACH_2(M, S, T, a, ...) M(T, a) S() _PY2CPP_EACH_1(M, S, T, __VA_ARGS__)
+#define _PY2CPP_EACH_3(M, S, T, a, ...) M(T, a) S() _PY2CPP_EACH_2(M, S, T, __VA_ARGS__)
+#define _PY2CPP_EACH_4(M, S, T, a, ...) M(T, a) S() _PY2CPP_EACH_3(M, S, T, __VA_ARGS__)
+#define _PY2CPP_EACH_5(M, S, T, a, ...) M(T, a) S() _PY2CPP_EACH_4(M, S, T, __VA_ARGS__)
+#define _PY2CPP_EACH_6(M, S, T, a, ...) M(T, a) S() _PY2CPP_EACH_5(M, S, T, __VA_ARGS__)
+#define _PY2CPP_EACH_7(M, S, T, a, ...) M(T, a) S() _PY2CPP_EACH_6(M, S, T, __VA_ARGS__)
+#define _PY2CPP_EACH_8(M, S, T, a, ...) M(T, a) S() _PY2CPP_EACH_7(M, S, T, __VA_ARGS__)
+#define _PY2CPP_EACH_9(M, S, T, a, ...) M(T, a) S() _PY2CPP_EACH_8(M, S, T, __VA_ARGS__)
+#define _PY2CPP_EACH_10(M, S, T, a, ...) M(T, a) S() _PY2CPP_EACH_9(M, S, T, __VA_ARGS__)
+#define _PY2CPP_EACH_11(M, S, T, a, ...) M(T, a) S() _PY2CPP_EACH_10(M, S, T, __VA_ARGS__)
+#define _PY2CPP_EACH_12(M, S, T, a, ...) M(T, a) S() _PY2CPP_EACH_11(M, S, T, __VA_ARGS__)
+#define _PY2CPP_EACH_13(M, S, T, a, ...) M(T, a) S() _PY2CPP_EACH_12(M, S, T, __VA_ARGS__)
+#define _PY2CPP_EACH_14(M, S, T, a, ...) M(T, a) S() _PY2CPP_EACH_13(M, S, T, __VA_ARGS__)
+#define _PY2CPP_EACH_15(M, S, T, a, ...) M(T, a) S() _PY2CPP_EACH_14(M, S, T, __VA_ARGS__)
+#define _PY2CPP_EACH_16(M, S, T, a, ...) M(T, a) S() _PY2CPP_EACH_15(M, S, T, __VA_ARGS__)
+
+#define _PY2CPP_SCHEMA_KEY(T, member) \
+    struct _py2cpp_key_##member { static constexpr const char* name() { return #member; } };
+#define _PY2CPP_SCHEMA_ENTRY(T, member) \
+    ::dubzzz::Py2Cpp::SchemaEntry<_py2cpp_key_##member, PY2CPP_FIELD(&T::member)>
+#define PY2CPP_STRUCT(T, ...) \
+    _PY2CPP_FOR_EACH(_PY2CPP_SCHEMA_KEY, _PY2CPP_NOTHING, T, __VA_ARGS__) \
+    typedef ::dubzzz::Py2Cpp::FromSchema<T, _PY2CPP_FOR_EACH(_PY2CPP_SCHEMA_ENTRY, _PY2CPP_COMMA, T, __VA_ARGS__)> py2cpp_schema; \
+    typedef ::dubzzz::Py2Cpp::CppBuilder<py2cpp_schema> FromPy
+
+// FromBuffer is used to copy the content of an object exporting the buffer protocol
+// into a std::vector<T> (single memcpy)
+// Syntax:
+//    CppBuilder<FromBuffer<double>>
+template <class T> struct FromBuffer {};
+
+// FromIterable<T> builds a std::vector<T> from any iterable: generators, iterators, sets, dict views...
+// capacity is reserved from __length_hint__ when it is available, lists and tuples are read as std::vector<T>
+// stream() hands fixed-size batches of converted items to a callback so that memory stays bounded
+// Iterators are consumed: their items are only checked while they are converted
+// Syntax:
+//    CppBuilder<FromIterable<T>>()(pyo)
+//    CppBuilder<FromIterable<T>>().stream(pyo, chunk_size, [](std::vector<T>& chunk) { ... })
+template <class T> struct FromIterable {};
+
+// BufferView<T> is a read-only view on the memory exported by a PyObject
+// through the buffer protocol (str, bytearray, memoryview, ctypes or NumPy arrays...)
+// No copy is performed: the view owns the Py_buffer and releases it on destruction
+// so the GIL has to be held when a BufferView is destroyed
+// Syntax:
+//    CppBuilder<BufferView<double>>
+template <class T> class BufferView;
+
+// NdArray<T,N> is a read-only N-dimensional array (row-major) built from an object
+// exporting a N-dimensional buffer (NumPy arrays, ctypes arrays of arrays...)
+// C-contiguous buffers are viewed without copy, as BufferView does
+// other strided buffers are gathered into a single contiguous block
+// Syntax:
+//    CppBuilder<NdArray<double, 3>>
+//    CppBuilder<Matrix<double>>
+template <class T, std::size_t N> class NdArray;
+template <class T> using Matrix = NdArray<T, 2>;
+
+// LazyVector<T> is a view on a PyList or a PyTuple converting its items on access with ToBuildable<T>
+// LazyMap<K,T> is a view on a PyDict converting the entries it reads, keys are looked up through PyBuilder<K>
+// Building a view only checks the type of the container: invalid items throw when they are accessed
+// The view keeps a reference on the container, so the GIL has to be held by every operation,
+// including copy and destruction. Iterators are invalidated if the container is resized
+// MEMOIZE = true keeps the converted elements, accessors then return const references
+// valid as long as the view: the container must not be modified while a memoizing view is alive
+// Syntax:
+//    CppBuilder<LazyVector<double>>()(pyo)[42]
+//    CppBuilder<LazyMap<std::string, std::vector<int>, true>>()(pyo).at("key")
+template <class T, bool MEMOIZE = false> class LazyVector;
+template <class K, class T, bool MEMOIZE = false> class LazyMap;
+
+// PyStringRef is a read-only view on the bytes of a PyString
+// or on the UTF-8 encoding of a PyUnicode
+// No copy is performed for PyString: the view keeps a reference on the object it borrows from
+// so it cannot dangle, but the GIL has to be held when a PyStringRef is copied or destroyed
+// Syntax:
+//    CppBuilder<PyStringRef>
+class PyStringRef;
+
+// InternedString is a read-only handle on a string stored once in a StringPool
+// Equal strings of a pool share the same handle: equality and hashing compare pointers only,
+// so handles coming from different pools must not be compared together
+// The pool looks the PyObject up by content: repeated values are neither copied nor allocated again
+// A pool built with an identity capacity first looks it up by identity: it then keeps a reference
+// on the last strings seen, until release_identity_cache() is called or the pool is destroyed
+// A StringPool is thread-safe and its strings stay valid, without the GIL, until it is destroyed
+// A default-constructed CppBuilder<InternedString> uses the pool installed by the innermost StringPoolScope
+// of the thread, default_string_pool() if none. The default pool is never destroyed
+// so it has no identity cache: it does not keep any PyObject alive
+// Syntax:
+//    CppBuilder<std::vector<InternedString>>()(pyo)
+//    StringPool pool;
+//    StringPoolScope scope(&pool);
+//    auto records = CppBuilder<std::vector<std::map<InternedString, int>>>()(pyo);
+class StringPool;
+class StringPoolScope;
+class InternedString;
+
+// TwoPhase<T> builds the same value as CppBuilder<T> in two phases:
+// * while holding the GIL, the PyObject is flattened into a compact buffer of tagged scalars
+// * then the GIL is released and the C++ value is built from that buffer only,
+//   the elements of a top-level std::vector, std::set or std::map being built (and sorted) by a pool of threads
+//   started once per conversion, for the chunks of at least 4096 elements and all the merge rounds
+// Supported types: bool, integers, double, std::string, std::wstring and
+// std::tuple, std::vector, std::set, std::map, std::unordered_map, std::unordered_set of supported types
+// Syntax:
+//    CppBuilder<TwoPhase<T>>(num_threads)(pyo)        -- num_threads defaults to std::thread::hardware_concurrency()
+//    CppBuilder<TwoPhase<T>>(num_threads)(pyo, stats) -- stats reports the time spent with and without the GIL
+template <class T> struct TwoPhase {};
+
+struct TwoPhaseStats
 {
-  typedef unsigned long value_type;
-  value_type operator() (PyObject* pyo) const
+  double gil_held_ms;  // flattening of the PyObject
+  double gil_free_ms;  // construction of the C++ value
+  std::size_t items;   // number of tagged scalars and sequence headers in the intermediate buffer
+};
+
+// MemoryResource is the source of memory of ArenaAllocator (C++11 equivalent of std::pmr::memory_resource)
+// MonotonicArena is a MemoryResource handing out memory from large blocks, deallocation being a no-op:
+// all the memory is given back at once when the arena is released or destroyed
+// ArenaAllocator<T> is an allocator drawing its memory from a MemoryResource
+// A default-constructed ArenaAllocator uses the resource installed by the innermost ArenaScope of the thread
+// (new/delete if none) so that every element of a nested container shares the same resource
+// estimate_arena<T>(pyo) is an optional sizing pre-pass counting the allocations and bytes
+// CppBuilder<T>()(pyo) will request, so that the whole result can be allocated from a single block
+// Syntax:
+//    MonotonicArena arena(estimate_arena<ArenaMap<ArenaString, ArenaVector<int>>>(pyo).size());
+//    ArenaScope scope(&arena);
+//    auto dict = CppBuilder<ArenaMap<ArenaString, ArenaVector<int>>>()(pyo);
+// Values built into an arena must not outlive it
+class MemoryResource;
+class MonotonicArena;
+class ArenaScope;
+template <class T> class ArenaAllocator;
+template <class T> using ArenaVector = std::vector<T, ArenaAllocator<T>>;
+template <class T> using ArenaSet = std::set<T, std::less<T>, ArenaAllocator<T>>;
+template <class K, class T> using ArenaMap = std::map<K, T, std::less<K>, ArenaAllocator<std::pair<const K, T>>>;
+template <class T> using ArenaUnorderedSet = std::unordered_set<T, std::hash<T>, std::equal_to<T>, ArenaAllocator<T>>;
+template <class K, class T> using ArenaUnorderedMap = std::unordered_map<K, T, std::hash<K>, std::equal_to<K>, ArenaAllocator<std::pair<const K, T>>>;
+typedef std::basic_string<char, std::char_traits<char>, ArenaAllocator<char>> ArenaString;
+typedef std::basic_string<wchar_t, std::char_traits<wchar_t>, ArenaAllocator<wchar_t>> ArenaWString;
+
+struct ArenaEstimate
+{
+  std::size_t allocations;
+  std::size_t bytes;
+
+  // bytes plus the worst alignment padding of each allocation
+  std::size_t size() const;
+};
+template <class T> ArenaEstimate estimate_arena(PyObject* pyo);
+
+// CppBuilder<T> implements the following methods:
+// * bool operator() (PyObject*): build the C++ object <T> corresponding to PyObject*
+// * bool eligible(PyObject*)   : true if the PyObject is eligible to build the object type
+//                                equivalent to CppBuilder does not throw std::invalid_argument for that PyObject
+// * Optional<T> try_build(PyObject*): build the C++ object <T> if the PyObject is eligible, empty Optional otherwise
+//                                     single traversal equivalent of eligible() followed by operator()
+//                                     other errors (eg.: std::overflow_error) are still thrown
+// * void build_into(T&, PyObject*): overwrite an existing C++ object with the content of PyObject*
+//                                   buffers of strings and vectors, nodes of maps and sets are reused when possible
+//                                   so that converting same-shaped PyObjects again and again does not allocate
+//                                   FromDict fields without key keep their previous value
+//                                   the object is left valid but unspecified if an exception is thrown
+template <class T, class = void> struct CppBuilder;
+
+// PyBuilder<T> is the reverse of CppBuilder<T>, it implements:
+// * PyObject* operator() (T const&): new reference on the PyObject corresponding to the C++ object
+//                                    std::runtime_error if Python fails to create it
+// Lists and tuples are created with their final size and filled in place, dicts are presized
+// bool gives Py_True or Py_False and small integers come from the cache of the interpreter
+// Supported types: the ones of CppBuilder<T>, classes declared with PY2CPP_STRUCT (dict)
+// and FromTuple or FromDict made of Field data members
+// Syntax:
+//    PyObject* pyo { PyBuilder<std::map<std::string, std::vector<int>>>()(values) };
+//    PyBuilder<FromTuple<MyClass, PY2CPP_FIELD(&MyClass::member), ...>>()(obj)
+//    PyBuilder<FromDict<MyClass, PY2CPP_FIELD(&MyClass::member), ...>>("key", ...)(obj)
+template <class T, class = void> struct PyBuilder;
+
+// ToBuffer<T> hands a std::vector<T> or a NdArray<T,N> over to a Python object exporting it through the buffer protocol
+// memoryview, NumPy or array consumers read the C++ storage without any per-item PyObject,
+// the storage is freed when the last reference (including the ones of memoryviews) is released
+// T is arithmetic or a trivially copyable struct whose struct format string is given by BufferFormat<T>
+// Syntax:
+//    PyObject* pyo { PyBuilder<ToBuffer<double>>()(std::move(values)) };
+//    template <> struct BufferFormat<MyStruct> { static const char* value() { return "T{d:x:d:y:}"; } };
+template <class T> struct ToBuffer {};
+template <class T> struct BufferFormat;
+
+// ConversionStats are the statistics recorded for a CppBuilder specialization
+// when py2cpp.hpp is included with PY2CPP_STATS defined (all the translation units must agree),
+// otherwise nothing is recorded and the builders are not instrumented at all
+// Counters are updated atomically: conversions can run in several threads
+// Syntax:
+//    #define PY2CPP_STATS
+//    #include "py2cpp.hpp"
+//    for (ConversionStats const& stats : conversion_stats()) { ... }
+//    PyObject* pyo { conversion_stats_dict() }; -- {builder: {"calls": ..., "sizes": [...]}, ...}
+//    reset_conversion_stats();
+struct ConversionStats
+{
+  std::string builder;                    // demangled type of the CppBuilder specialization
+  unsigned long long calls;               // conversions started by operator(), build_into or try_build
+  unsigned long long elements;            // items of the containers built, one per call for other builders
+  unsigned long long rejections;          // eligible() returning false and try_build returning an empty Optional
+  unsigned long long exceptions;          // conversions left by an exception
+  double seconds;                         // cumulative time of the calls, nested conversions included
+  std::vector<unsigned long long> sizes;  // histogram of the sizes of the containers built:
+                                          // sizes[0] counts the empty ones, sizes[i] the ones of [2^(i-1), 2^i) items
+};
+inline std::vector<ConversionStats> conversion_stats();
+inline void reset_conversion_stats();
+inline PyObject* conversion_stats_dict();
+
+// try_convert builds the C++ object as try_build does but reports why and where the PyObject was rejected
+// Nothing is thrown: rejected items go back up through the builders as empty Optionals,
+// each container appending the position of the item to the path of the error
+// std::overflow_error and other exceptions of the builders are caught and reported as well
+// The path and the message are only formatted when they are asked for: the error keeps references on the
+// rejected keys and attribute names, so the GIL has to be held to call path() or message() and to copy or
+// destroy a ConversionError whose path is not empty
+// Path segments: [3] item of a sequence, ['x'] value of a dict, {'x'} key of a dict or item of a set, .x attribute
+// Syntax:
+//    Expected<std::vector<Point>> points { try_convert<std::vector<Point>>(pyo) };
+//    Expected<Point> point { try_convert(CppBuilder<FromDict<Point, ...>>("x", "y"), pyo) };
+//    if (! points) { log(points.error().message()); } -- "Type mismatch at [3]['x']"
+enum class ConversionErrc
+{
+  type_mismatch,   // PyObject not eligible for the builder
+  length_mismatch, // PyTuple of another length than the std::tuple or the FromTuple
+  overflow,        // value out of the boundaries of the C++ type
+  other,           // any other exception thrown by a builder: Python error, user-defined builder...
+};
+
+class ConversionError
+{
+  struct Segment
   {
-    assert(pyo);
-    if (PyLong_Check(pyo))
-    {
-      unsigned long value { PyLong_AsUnsignedLong(pyo) };
-      if (!! PyErr_Occurred() && !! PyErr_ExceptionMatches(PyExc_OverflowError))
-      {
-        PyErr_Clear();
-        throw std::overflow_error("Out of <unsigned long> boundaries");
-      }
-      return value;
-    }
-    else if (PyInt_Check(pyo))
+    enum class Kind { Index, Item, Key, Attribute };
+    Kind kind;
+    Py_ssize_t index;
+    PyObject* name; // new reference on the key or the attribute name, nullptr for Kind::Index
+
+    Segment(Kind kind, Py_ssize_t index, PyObject* name) : kind(kind), index(index), name(name) { Py_XINCREF(name); }
+    Segment(Segment const& other) : Segment(other.kind, other.index, other.name) {}
+    Segment(Segment&& other) noexcept : kind(other.kind), index(other.index), name(other.name) { other.name = nullptr; }
+    Segment& operator=(Segment other) noexcept
     {
-      long value { PyInt_AsLong(pyo) }; // PyInt is a long, LONG_MAX < ULONG_MAX
-      if (value < 0)
-      {
-        throw std::overflow_error("Out of <unsigned long> boundaries");
-      }
-      return static_cast<unsigned long>(value);
+      kind = other.kind;
+      index = other.index;
+      std::swap(name, other.name);
+      return *this;
     }
-    throw std::invalid_argument("Not a PyLong instance");
-  }
-  bool eligible(PyObject* pyo) const
-  {
-    return PyLong_Check(pyo) || PyInt_Check(pyo);
-  }
-};
-template <> struct ToBuildable<unsigned long> : CppBuilder<unsigned long> {};
+    ~Segment() { Py_XDECREF(name); }
+  };
 
-template <>
-struct CppBuilder<long long>
-{
-  typedef long long value_type;
-  value_type operator() (PyObject* pyo) const
+  // content of a PyString between quotes, repr() of other keys
+  static std::string format(PyObject* name)
   {
-    assert(pyo);
-    if (PyLong_Check(pyo))
+    if (PyString_Check(name))
     {
-      long long value { PyLong_AsLongLong(pyo) };
-      if (!! PyErr_Occurred() && !! PyErr_ExceptionMatches(PyExc_OverflowError))
-      {
-        PyErr_Clear();
-        throw std::overflow_error("Out of <long long> boundaries");
-      }
-      return value;
+      return "'" + std::string(PyString_AS_STRING(name), PyString_GET_SIZE(name)) + "'";
     }
-    else if (PyInt_Check(pyo))
+    std::unique_ptr<PyObject, decref> repr { PyObject_Repr(name) };
+    if (repr && PyString_Check(repr.get()))
     {
-      return static_cast<long long>(PyInt_AsLong(pyo));
+      return std::string(PyString_AS_STRING(repr.get()), PyString_GET_SIZE(repr.get()));
     }
-    throw std::invalid_argument("Not a PyLong instance");
-  }
-  bool eligible(PyObject* pyo) const
-  {
-    return PyLong_Check(pyo) || PyInt_Check(pyo);
+    PyErr_Clear();
+    return "?";
   }
-};
-template <> struct ToBuildable<long long> : CppBuilder<long long> {};
 
-template <>
-struct CppBuilder<unsigned long long>
-{
-  typedef unsigned long long value_type;
-  value_type operator() (PyObject* pyo) const
+  ConversionErrc code_;
+  std::string what_;             // what() of the exception caught for ConversionErrc::other
+  std::vector<Segment> segments_; // innermost item first
+
+  friend class _ConversionTrail;
+
+public:
+  explicit ConversionError(ConversionErrc code = ConversionErrc::type_mismatch, std::string what = std::string())
+      : code_(code), what_(std::move(what)), segments_()
+  {}
+
+  ConversionErrc code() const { return code_; }
+
+  // empty when the PyObject itself is rejected or when the item could not be located (ConversionErrc::other)
+  std::string path() const
   {
-    assert(pyo);
-    if (PyLong_Check(pyo))
-    {
-      unsigned long long value { PyLong_AsUnsignedLongLong(pyo) };
-      if (!! PyErr_Occurred()
-          && (!! PyErr_ExceptionMatches(PyExc_OverflowError) || !! PyErr_ExceptionMatches(PyExc_TypeError)))
-      {
-        PyErr_Clear();
-        throw std::overflow_error("Out of <unsigned long long> boundaries");
-      }
-      return value;
-    }
-    else if (PyInt_Check(pyo))
+    std::string out;
+    for (auto it = segments_.rbegin() ; it != segments_.rend() ; ++it)
     {
-      long value { PyInt_AsLong(pyo) }; // PyInt is a long, LONG_MAX < ULLONG_MAX
-      if (value < 0)
+      switch (it->kind)
       {
-        throw std::overflow_error("Out of <unsigned long long> boundaries");
+        case Segment::Kind::Index:
+          out += "[" + std::to_string(it->index) + "]";
+          break;
+        case Segment::Kind::Item:
+          out += "[" + format(it->name) + "]";
+          break;
+        case Segment::Kind::Key:
+          out += "{" + format(it->name) + "}";
+          break;
+        case Segment::Kind::Attribute:
+          out += "." + (PyString_Check(it->name)
+              ? std::string(PyString_AS_STRING(it->name), PyString_GET_SIZE(it->name))
+              : format(it->name));
+          break;
       }
-      return static_cast<unsigned long long>(value);
     }
-    throw std::invalid_argument("Not a PyLong instance");
+    return out;
   }
-  bool eligible(PyObject* pyo) const
+
+  std::string message() const
   {
-    return PyLong_Check(pyo) || PyInt_Check(pyo);
+    std::string out;
+    switch (code_)
+    {
+      case ConversionErrc::type_mismatch:
+        out = "Type mismatch";
+        break;
+      case ConversionErrc::length_mismatch:
+        out = "PyTuple length mismatch";
+        break;
+      case ConversionErrc::overflow:
+        out = "Out of boundaries";
+        break;
+      case ConversionErrc::other:
+        out = what_;
+        break;
+    }
+    std::string where { path() };
+    return where.empty() ? out : out + " at " + where;
   }
 };
-template <> struct ToBuildable<unsigned long long> : CppBuilder<unsigned long long> {};
 
-template <>
-struct CppBuilder<double>
+// Expected<T> either contains a T or the ConversionError explaining why it could not be built
+template <class T>
+class Expected
 {
-  typedef double value_type;
-  value_type operator() (PyObject* pyo) const
+  Optional<T> value_;
+  ConversionError error_;
+
+public:
+  typedef T value_type;
+
+  Expected(Optional<T>&& value) : value_(std::move(value)), error_() {}
+  Expected(ConversionError error) : value_(), error_(std::move(error)) {}
+
+  bool has_value() const { return value_.has_value(); }
+  explicit operator bool() const { return value_.has_value(); }
+
+  T& operator*() { return *value_; }
+  T const& operator*() const { return *value_; }
+  T* operator->() { return value_.operator->(); }
+  T const* operator->() const { return value_.operator->(); }
+
+  T& value()
   {
-    assert(pyo);
-    if (PyFloat_Check(pyo))
-    {
-      double value { PyFloat_AsDouble(pyo) }; // PyFloat is a double
-      if (value ==  INFINITY || value == -INFINITY)
-      {
-        PyErr_Clear();
-        throw std::overflow_error("Out of <double> boundaries");
-      }
-      return value;
-    }
-    else if (PyLong_Check(pyo))
-    {
-      double value { PyLong_AsDouble(pyo) };
-      if (!! PyErr_Occurred() && !! PyErr_ExceptionMatches(PyExc_OverflowError))
-      {
-        PyErr_Clear();
-        throw std::overflow_error("Out of <double> boundaries");
-      }
-      return value;
-    }
-    else if (PyInt_Check(pyo))
+    if (! value_)
     {
-      return PyInt_AS_LONG(pyo);
+      throw std::logic_error("Empty Expected: " + error_.message());
     }
-    throw std::invalid_argument("Neither a PyDouble nor a PyLong instance");
+    return *value_;
   }
-  bool eligible(PyObject* pyo) const
+  T const& value() const
   {
-    return PyFloat_Check(pyo) || PyLong_Check(pyo) || PyInt_Check(pyo);
+    if (! value_)
+    {
+      throw std::logic_error("Empty Expected: " + error_.message());
+    }
+    return *value_;
   }
+
+  // meaningful only when the Expected is empty
+  ConversionError const& error() const { return error_; }
 };
-template <> struct ToBuildable<double> : CppBuilder<double> {};
+
+template <class BUILDER> Expected<typename BUILDER::value_type> try_convert(BUILDER const& builder, PyObject* pyo);
+template <class T> Expected<typename CppBuilder<T>::value_type> try_convert(PyObject* pyo);
 
 /**
- * Strings builders
+ * Internal structures
  */
 
-template <>
-struct CppBuilder<std::string>
+template <class T> struct _VoidOf { typedef void type; };
+
+// T is either a builder or a class declared with PY2CPP_STRUCT
+template <class T, class = void> struct ToBuildable : T {};
+template <class T> struct ToBuildable<T, typename _VoidOf<typename T::py2cpp_schema>::type> : CppBuilder<typename T::py2cpp_schema> {};
+template <class T> struct CppBuilder<T, typename _VoidOf<typename T::py2cpp_schema>::type> : CppBuilder<typename T::py2cpp_schema> {};
+
+// build_into of builders not implementing it (user-defined builders): plain assignment
+template <class BUILDER>
+static inline auto _buildIntoImpl(BUILDER const& builder, typename BUILDER::value_type& out, PyObject* pyo, int)
+    -> decltype(builder.build_into(out, pyo), void())
+{
+  builder.build_into(out, pyo);
+}
+template <class BUILDER>
+static inline void _buildIntoImpl(BUILDER const& builder, typename BUILDER::value_type& out, PyObject* pyo, long)
+{
+  out = builder(pyo);
+}
+template <class BUILDER>
+static inline void _buildInto(BUILDER const& builder, typename BUILDER::value_type& out, PyObject* pyo)
+{
+  _buildIntoImpl(builder, out, pyo, 0);
+}
+
+// Error filled by the try_convert running in the calling thread, if any
+// A rejected PyObject records the reason of its rejection and restarts the path,
+// the containers it goes back up through append the position of their rejected item
+// Nothing is recorded (a single thread-local read on rejections only) outside of try_convert
+class _ConversionTrail
+{
+  ConversionError* previous_;
+
+  static ConversionError*& current() noexcept
+  {
+    static thread_local ConversionError* error { nullptr };
+    return error;
+  }
+
+  static void append(ConversionError::Segment::Kind kind, Py_ssize_t index, PyObject* name)
+  {
+    ConversionError* error { current() };
+    if (! error)
+    {
+      return;
+    }
+    error->segments_.emplace_back(kind, index, name);
+  }
+
+public:
+  explicit _ConversionTrail(ConversionError* error) : previous_(current())
+  {
+    current() = error;
+  }
+  ~_ConversionTrail()
+  {
+    current() = previous_;
+  }
+  _ConversionTrail(_ConversionTrail const&) = delete;
+  _ConversionTrail& operator=(_ConversionTrail const&) = delete;
+
+  // false if no try_convert is running
+  static bool rejected(ConversionErrc code)
+  {
+    ConversionError* error { current() };
+    if (! error)
+    {
+      return false;
+    }
+    error->code_ = code;
+    error->segments_.clear();
+    return true;
+  }
+  static void atIndex(Py_ssize_t index) { append(ConversionError::Segment::Kind::Index, index, nullptr); }
+  static void atItem(PyObject* key) { append(ConversionError::Segment::Kind::Item, 0, key); }
+  static void atKey(PyObject* key) { append(ConversionError::Segment::Kind::Key, 0, key); }
+  static void atAttribute(PyObject* attr) { append(ConversionError::Segment::Kind::Attribute, 0, attr); }
+};
+
+// try_build for builders checking eligibility without traversing sub-elements
+// within try_convert, overflows are rejections as well: the numeric builders report them without throwing
+// (_tryBuildNumber), std::overflow_error is only caught for the user-defined builders
+template <class BUILDER>
+static inline Optional<typename BUILDER::value_type> _tryBuildFlat(BUILDER const& builder, PyObject* pyo)
+{
+  if (! builder.eligible(pyo))
+  {
+    _ConversionTrail::rejected(ConversionErrc::type_mismatch);
+    return Optional<typename BUILDER::value_type>();
+  }
+  try
+  {
+    return builder(pyo);
+  }
+  catch (std::overflow_error const&)
+  {
+    if (! _ConversionTrail::rejected(ConversionErrc::overflow))
+    {
+      throw;
+    }
+    return Optional<typename BUILDER::value_type>();
+  }
+}
+
+// Returned by rejecting eligible() and try_build: false or an empty Optional
+struct _Rejection
+{
+  operator bool() const { return false; }
+  template <class T> operator Optional<T>() const { return Optional<T>(); }
+};
+
+#if defined(PY2CPP_STATS)
+
+// Buckets of the histogram of container sizes: 0, [1,2), [2,4)... the last one takes the larger sizes
+static const std::size_t _STATS_BUCKETS { 40 };
+
+// Counters of a CppBuilder specialization, never moved once registered
+struct _StatsEntry
+{
+  const std::string builder;
+  std::atomic<unsigned long long> calls;
+  std::atomic<unsigned long long> elements;
+  std::atomic<unsigned long long> rejections;
+  std::atomic<unsigned long long> exceptions;
+  std::atomic<unsigned long long> nanoseconds;
+  std::atomic<unsigned long long> sizes[_STATS_BUCKETS];
+
+  explicit _StatsEntry(std::string const& builder)
+      : builder(builder), calls(0), elements(0), rejections(0), exceptions(0), nanoseconds(0)
+  {
+    for (auto& size : sizes)
+    {
+      size.store(0, std::memory_order_relaxed);
+    }
+  }
+};
+
+class _StatsRegistry
+{
+  std::mutex mutex_;
+  std::deque<_StatsEntry> entries_;
+
+public:
+  _StatsEntry& add(std::string const& builder)
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    entries_.emplace_back(builder);
+    return entries_.back();
+  }
+  template <class FUN>
+  void for_each(FUN&& fun)
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (_StatsEntry& entry : entries_)
+    {
+      fun(entry);
+    }
+  }
+};
+
+// Never destroyed: conversions may be recorded until the very end of the process
+inline _StatsRegistry& _statsRegistry()
+{
+  static _StatsRegistry* registry { new _StatsRegistry() };
+  return *registry;
+}
+
+template <class T>
+inline std::string _typeName()
+{
+#if defined(__GNUG__)
+  int status { 0 };
+  std::unique_ptr<char, void (*)(void*)> demangled { abi::__cxa_demangle(typeid(T).name(), nullptr, nullptr, &status), std::free };
+  if (status == 0 && demangled)
+  {
+    return demangled.get();
+  }
+#endif
+  return typeid(T).name();
+}
+
+// Registered on first use, shared by all the translation units
+template <class BUILDER>
+inline _StatsEntry& _statsOf()
+{
+  static _StatsEntry& entry { _statsRegistry().add(_typeName<BUILDER>()) };
+  return entry;
+}
+
+static inline std::size_t _statsBucket(std::size_t size)
+{
+  std::size_t bucket { 0 };
+  for ( ; size != 0 && bucket != _STATS_BUCKETS -1 ; size >>= 1)
+  {
+    ++bucket;
+  }
+  return bucket;
+}
+
+// Records one conversion of BUILDER, from its construction to its destruction
+// elements(size) is called once the size of the container being built is known
+template <class BUILDER>
+class _StatsScope
+{
+  _StatsEntry& entry_;
+  const std::chrono::steady_clock::time_point start_;
+  std::size_t elements_;
+#if __cplusplus >= 201703L
+  const int exceptions_;
+#endif
+
+public:
+  _StatsScope()
+      : entry_(_statsOf<BUILDER>()), start_(std::chrono::steady_clock::now()), elements_(1)
+#if __cplusplus >= 201703L
+      , exceptions_(std::uncaught_exceptions())
+#endif
+  {}
+  _StatsScope(_StatsScope const&) = delete;
+  _StatsScope& operator=(_StatsScope const&) = delete;
+  ~_StatsScope()
+  {
+    entry_.calls.fetch_add(1, std::memory_order_relaxed);
+    entry_.nanoseconds.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start_).count(), std::memory_order_relaxed);
+#if __cplusplus >= 201703L
+    if (std::uncaught_exceptions() > exceptions_)
+#else
+    if (std::uncaught_exception())
+#endif
+    {
+      entry_.exceptions.fetch_add(1, std::memory_order_relaxed);
+    }
+    else
+    {
+      entry_.elements.fetch_add(elements_, std::memory_order_relaxed);
+    }
+  }
+
+  void elements(std::size_t size)
+  {
+    elements_ = size;
+    entry_.sizes[_statsBucket(size)].fetch_add(1, std::memory_order_relaxed);
+  }
+};
+
+template <class BUILDER>
+static inline _Rejection _rejected()
+{
+  _statsOf<BUILDER>().rejections.fetch_add(1, std::memory_order_relaxed);
+  return _Rejection();
+}
+
+#else
+
+// Without PY2CPP_STATS, the instrumentation is compiled out
+template <class BUILDER>
+struct _StatsScope
+{
+  _StatsScope() {}
+  void elements(std::size_t) {}
+};
+
+template <class BUILDER>
+static inline _Rejection _rejected()
+{
+  return _Rejection();
+}
+
+#endif
+
+// Result of a try_build of BUILDER, an empty one being a rejection
+template <class BUILDER, class T>
+static inline Optional<T> _tried(Optional<T>&& result)
+{
+  if (! result)
+  {
+    _rejected<BUILDER>();
+  }
+  return std::move(result);
+}
+
+// Rejection of the PyObject itself by try_build, rather than of one of its items
+template <class BUILDER>
+static inline _Rejection _rejectedHere(ConversionErrc code = ConversionErrc::type_mismatch)
+{
+  _ConversionTrail::rejected(code);
+  return _rejected<BUILDER>();
+}
+
+/**
+ * Identity builder
+ */
+
+template <>
+struct CppBuilder<PyObject*>
+{
+  typedef PyObject* value_type;
+  value_type operator() (PyObject* pyo) const
+  {
+    assert(pyo);
+    _StatsScope<CppBuilder> stats;
+    return pyo;
+  }
+  bool eligible(PyObject* pyo) const
+  {
+    return true;
+  }
+  Optional<value_type> try_build(PyObject* pyo) const
+  {
+    return _tryBuildFlat(*this, pyo);
+  }
+  void build_into(value_type& out, PyObject* pyo) const
+  {
+    out = (*this)(pyo);
+  }
+};
+template <> struct ToBuildable<PyObject*> : CppBuilder<PyObject*> {};
+
+/**
+ * Primitives builders
+ */
+
+template <>
+struct CppBuilder<bool>
+{
+  typedef bool value_type;
+  value_type operator() (PyObject* pyo) const
+  {
+    assert(pyo);
+    _StatsScope<CppBuilder> stats;
+    if (PyBool_Check(pyo))
+    {
+      return pyo == Py_True;
+    }
+    throw std::invalid_argument("Not a PyBool instance");
+  }
+  bool eligible(PyObject* pyo) const
+  {
+    return PyBool_Check(pyo) || _rejected<CppBuilder>();
+  }
+  Optional<value_type> try_build(PyObject* pyo) const
+  {
+    return _tryBuildFlat(*this, pyo);
+  }
+  void build_into(value_type& out, PyObject* pyo) const
+  {
+    out = (*this)(pyo);
+  }
+};
+template <> struct ToBuildable<bool> : CppBuilder<bool> {};
+
+// Range-checked conversions of a PyInt or a PyLong, false when out of the boundaries of the C++ type
+// They neither throw nor leave a Python error behind, so that try_convert rejects overflows cheaply
+static inline bool _asLong(PyObject* pyo, long& out)
+{
+  if (PyInt_Check(pyo))
+  {
+    out = PyInt_AS_LONG(pyo);
+    return true;
+  }
+  int overflow;
+  out = PyLong_AsLongAndOverflow(pyo, &overflow);
+  return ! overflow;
+}
+static inline bool _asLongLong(PyObject* pyo, long long& out)
+{
+  if (PyInt_Check(pyo))
+  {
+    out = PyInt_AS_LONG(pyo);
+    return true;
+  }
+  int overflow;
+  out = PyLong_AsLongLongAndOverflow(pyo, &overflow);
+  return ! overflow;
+}
+static inline bool _asUnsignedLongLong(PyObject* pyo, unsigned long long& out)
+{
+  if (PyInt_Check(pyo))
+  {
+    long value { PyInt_AS_LONG(pyo) }; // PyInt is a long, LONG_MAX < ULLONG_MAX
+    out = static_cast<unsigned long long>(value);
+    return value >= 0;
+  }
+  if (Py_SIZE(pyo) < 0) // negative PyLong
+  {
+    return false;
+  }
+  out = PyLong_AsUnsignedLongLong(pyo);
+  if (out == static_cast<unsigned long long>(-1) && PyErr_Occurred())
+  {
+    PyErr_Clear();
+    return false;
+  }
+  return true;
+}
+
+// try_build of the numeric builders: BUILDER::convert reports overflows without throwing
+// within try_convert, they are rejections, outside of it std::overflow_error is still thrown
+template <class BUILDER>
+static inline Optional<typename BUILDER::value_type> _tryBuildNumber(BUILDER const& builder, PyObject* pyo)
+{
+  if (! builder.eligible(pyo))
+  {
+    _ConversionTrail::rejected(ConversionErrc::type_mismatch);
+    return Optional<typename BUILDER::value_type>();
+  }
+  _StatsScope<BUILDER> stats;
+  typename BUILDER::value_type value;
+  if (! BUILDER::convert(pyo, value))
+  {
+    if (! _ConversionTrail::rejected(ConversionErrc::overflow))
+    {
+      throw std::overflow_error(BUILDER::overflowMessage());
+    }
+    return _rejected<BUILDER>();
+  }
+  return value;
+}
+
+template <>
+struct CppBuilder<int>
+{
+  typedef int value_type;
+  value_type operator() (PyObject* pyo) const
+  {
+    assert(pyo);
+    _StatsScope<CppBuilder> stats;
+    if (! PyLong_Check(pyo) && ! PyInt_Check(pyo))
+    {
+      throw std::invalid_argument("Not a PyLong instance");
+    }
+    value_type value;
+    if (! convert(pyo, value))
+    {
+      throw std::overflow_error(overflowMessage());
+    }
+    return value;
+  }
+  bool eligible(PyObject* pyo) const
+  {
+    return PyLong_Check(pyo) || PyInt_Check(pyo) || _rejected<CppBuilder>();
+  }
+  Optional<value_type> try_build(PyObject* pyo) const
+  {
+    return _tryBuildNumber(*this, pyo);
+  }
+  void build_into(value_type& out, PyObject* pyo) const
+  {
+    out = (*this)(pyo);
+  }
+
+  // pyo is a PyInt or a PyLong
+  static bool convert(PyObject* pyo, value_type& out)
+  {
+    long value;
+    if (! _asLong(pyo, value) || value < INT_MIN || value > INT_MAX)
+    {
+      return false;
+    }
+    out = static_cast<int>(value);
+    return true;
+  }
+  static const char* overflowMessage() { return "Out of <int> boundaries"; }
+};
+template <> struct ToBuildable<int> : CppBuilder<int> {};
+
+template <>
+struct CppBuilder<unsigned int>
+{
+  typedef unsigned int value_type;
+  value_type operator() (PyObject* pyo) const
+  {
+    assert(pyo);
+    _StatsScope<CppBuilder> stats;
+    if (! PyLong_Check(pyo) && ! PyInt_Check(pyo))
+    {
+      throw std::invalid_argument("Not a PyLong instance");
+    }
+    value_type value;
+    if (! convert(pyo, value))
+    {
+      throw std::overflow_error(overflowMessage());
+    }
+    return value;
+  }
+  bool eligible(PyObject* pyo) const
+  {
+    return PyLong_Check(pyo) || PyInt_Check(pyo) || _rejected<CppBuilder>();
+  }
+  Optional<value_type> try_build(PyObject* pyo) const
+  {
+    return _tryBuildNumber(*this, pyo);
+  }
+  void build_into(value_type& out, PyObject* pyo) const
+  {
+    out = (*this)(pyo);
+  }
+
+  // pyo is a PyInt or a PyLong
+  static bool convert(PyObject* pyo, value_type& out)
+  {
+    unsigned long long value;
+    if (! _asUnsignedLongLong(pyo, value) || value > UINT_MAX)
+    {
+      return false;
+    }
+    out = static_cast<unsigned int>(value);
+    return true;
+  }
+  static const char* overflowMessage() { return "Out of <unsigned int> boundaries"; }
+};
+template <> struct ToBuildable<unsigned int> : CppBuilder<unsigned int> {};
+
+template <>
+struct CppBuilder<long>
+{
+  typedef long value_type;
+  value_type operator() (PyObject* pyo) const
+  {
+    assert(pyo);
+    _StatsScope<CppBuilder> stats;
+    if (! PyLong_Check(pyo) && ! PyInt_Check(pyo))
+    {
+      throw std::invalid_argument("Not a PyLong instance");
+    }
+    value_type value;
+    if (! convert(pyo, value))
+    {
+      throw std::overflow_error(overflowMessage());
+    }
+    return value;
+  }
+  bool eligible(PyObject* pyo) const
+  {
+    return PyLong_Check(pyo) || PyInt_Check(pyo) || _rejected<CppBuilder>();
+  }
+  Optional<value_type> try_build(PyObject* pyo) const
+  {
+    return _tryBuildNumber(*this, pyo);
+  }
+  void build_into(value_type& out, PyObject* pyo) const
+  {
+    out = (*this)(pyo);
+  }
+
+  // pyo is a PyInt or a PyLong
+  static bool convert(PyObject* pyo, value_type& out)
+  {
+    return _asLong(pyo, out);
+  }
+  static const char* overflowMessage() { return "Out of <long> boundaries"; }
+};
+template <> struct ToBuildable<long> : CppBuilder<long> {};
+
+template <>
+struct CppBuilder<unsigned long>
+{
+  typedef unsigned long value_type;
+  value_type operator() (PyObject* pyo) const
+  {
+    assert(pyo);
+    _StatsScope<CppBuilder> stats;
+    if (! PyLong_Check(pyo) && ! PyInt_Check(pyo))
+    {
+      throw std::invalid_argument("Not a PyLong instance");
+    }
+    value_type value;
+    if (! convert(pyo, value))
+    {
+      throw std::overflow_error(overflowMessage());
+    }
+    return value;
+  }
+  bool eligible(PyObject* pyo) const
+  {
+    return PyLong_Check(pyo) || PyInt_Check(pyo) || _rejected<CppBuilder>();
+  }
+  Optional<value_type> try_build(PyObject* pyo) const
+  {
+    return _tryBuildNumber(*this, pyo);
+  }
+  void build_into(value_type& out, PyObject* pyo) const
+  {
+    out = (*this)(pyo);
+  }
+
+  // pyo is a PyInt or a PyLong
+  static bool convert(PyObject* pyo, value_type& out)
+  {
+    unsigned long long value;
+    if (! _asUnsignedLongLong(pyo, value) || value > ULONG_MAX)
+    {
+      return false;
+    }
+    out = static_cast<unsigned long>(value);
+    return true;
+  }
+  static const char* overflowMessage() { return "Out of <unsigned long> boundaries"; }
+};
+template <> struct ToBuildable<unsigned long> : CppBuilder<unsigned long> {};
+
+template <>
+struct CppBuilder<long long>
+{
+  typedef long long value_type;
+  value_type operator() (PyObject* pyo) const
+  {
+    assert(pyo);
+    _StatsScope<CppBuilder> stats;
+    if (! PyLong_Check(pyo) && ! PyInt_Check(pyo))
+    {
+      throw std::invalid_argument("Not a PyLong instance");
+    }
+    value_type value;
+    if (! convert(pyo, value))
+    {
+      throw std::overflow_error(overflowMessage());
+    }
+    return value;
+  }
+  bool eligible(PyObject* pyo) const
+  {
+    return PyLong_Check(pyo) || PyInt_Check(pyo) || _rejected<CppBuilder>();
+  }
+  Optional<value_type> try_build(PyObject* pyo) const
+  {
+    return _tryBuildNumber(*this, pyo);
+  }
+  void build_into(value_type& out, PyObject* pyo) const
+  {
+    out = (*this)(pyo);
+  }
+
+  // pyo is a PyInt or a PyLong
+  static bool convert(PyObject* pyo, value_type& out)
+  {
+    return _asLongLong(pyo, out);
+  }
+  static const char* overflowMessage() { return "Out of <long long> boundaries"; }
+};
+template <> struct ToBuildable<long long> : CppBuilder<long long> {};
+
+template <>
+struct CppBuilder<unsigned long long>
+{
+  typedef unsigned long long value_type;
+  value_type operator() (PyObject* pyo) const
+  {
+    assert(pyo);
+    _StatsScope<CppBuilder> stats;
+    if (! PyLong_Check(pyo) && ! PyInt_Check(pyo))
+    {
+      throw std::invalid_argument("Not a PyLong instance");
+    }
+    value_type value;
+    if (! convert(pyo, value))
+    {
+      throw std::overflow_error(overflowMessage());
+    }
+    return value;
+  }
+  bool eligible(PyObject* pyo) const
+  {
+    return PyLong_Check(pyo) || PyInt_Check(pyo) || _rejected<CppBuilder>();
+  }
+  Optional<value_type> try_build(PyObject* pyo) const
+  {
+    return _tryBuildNumber(*this, pyo);
+  }
+  void build_into(value_type& out, PyObject* pyo) const
+  {
+    out = (*this)(pyo);
+  }
+
+  // pyo is a PyInt or a PyLong
+  static bool convert(PyObject* pyo, value_type& out)
+  {
+    return _asUnsignedLongLong(pyo, out);
+  }
+  static const char* overflowMessage() { return "Out of <unsigned long long> boundaries"; }
+};
+template <> struct ToBuildable<unsigned long long> : CppBuilder<unsigned long long> {};
+
+template <>
+struct CppBuilder<double>
+{
+  typedef double value_type;
+  value_type operator() (PyObject* pyo) const
+  {
+    assert(pyo);
+    _StatsScope<CppBuilder> stats;
+    if (! PyFloat_Check(pyo) && ! PyLong_Check(pyo) && ! PyInt_Check(pyo))
+    {
+      throw std::invalid_argument("Neither a PyDouble nor a PyLong instance");
+    }
+    value_type value;
+    if (! convert(pyo, value))
+    {
+      throw std::overflow_error(overflowMessage());
+    }
+    return value;
+  }
+  bool eligible(PyObject* pyo) const
+  {
+    return PyFloat_Check(pyo) || PyLong_Check(pyo) || PyInt_Check(pyo) || _rejected<CppBuilder>();
+  }
+  Optional<value_type> try_build(PyObject* pyo) const
+  {
+    return _tryBuildNumber(*this, pyo);
+  }
+  void build_into(value_type& out, PyObject* pyo) const
+  {
+    out = (*this)(pyo);
+  }
+
+  // pyo is a PyFloat, a PyInt or a PyLong
+  static bool convert(PyObject* pyo, value_type& out)
+  {
+    if (PyFloat_Check(pyo))
+    {
+      out = PyFloat_AS_DOUBLE(pyo); // PyFloat is a double
+      return out != INFINITY && out != -INFINITY;
+    }
+    else if (PyInt_Check(pyo))
+    {
+      out = PyInt_AS_LONG(pyo);
+      return true;
+    }
+    out = PyLong_AsDouble(pyo);
+    if (out == -1. && PyErr_Occurred())
+    {
+      PyErr_Clear();
+      return false;
+    }
+    return true;
+  }
+  static const char* overflowMessage() { return "Out of <double> boundaries"; }
+};
+template <> struct ToBuildable<double> : CppBuilder<double> {};
+
+/**
+ * Strings builders
+ */
+
+// Copy the leading ASCII code units of src into dst
+// Return the number of copied units: it stops on the first non-ASCII unit
+static inline std::size_t _narrowAscii(const Py_UNICODE* src, std::size_t size, char* dst)
+{
+  std::size_t i { 0 };
+#if defined(__SSE2__) && Py_UNICODE_SIZE == 4
+  const __m128i nonAscii { _mm_set1_epi32(~0x7f) };
+  const __m128i zero { _mm_setzero_si128() };
+  for ( ; i + 8 <= size ; i += 8)
+  {
+    __m128i low { _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i)) };
+    __m128i high { _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i + 4)) };
+    __m128i flags { _mm_and_si128(_mm_or_si128(low, high), nonAscii) };
+    if (_mm_movemask_epi8(_mm_cmpeq_epi32(flags, zero)) != 0xffff)
+    {
+      break;
+    }
+    __m128i packed { _mm_packs_epi32(low, high) };
+    _mm_storel_epi64(reinterpret_cast<__m128i*>(dst + i), _mm_packus_epi16(packed, packed));
+  }
+#elif defined(__SSE2__) && Py_UNICODE_SIZE == 2
+  const __m128i nonAscii { _mm_set1_epi16(~0x7f) };
+  const __m128i zero { _mm_setzero_si128() };
+  for ( ; i + 16 <= size ; i += 16)
+  {
+    __m128i low { _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i)) };
+    __m128i high { _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i + 8)) };
+    __m128i flags { _mm_and_si128(_mm_or_si128(low, high), nonAscii) };
+    if (_mm_movemask_epi8(_mm_cmpeq_epi16(flags, zero)) != 0xffff)
+    {
+      break;
+    }
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_packus_epi16(low, high));
+  }
+#endif
+  for ( ; i != size && static_cast<std::uint32_t>(src[i]) < 0x80 ; ++i)
+  {
+    dst[i] = static_cast<char>(src[i]);
+  }
+  return i;
+}
+
+// Read the code point starting at src[i] and move i after it
+// UTF-16 surrogate pairs are combined, as Python's own UTF-8 codec does
+static inline std::uint32_t _readCodePoint(const Py_UNICODE* src, std::size_t size, std::size_t& i)
+{
+  std::uint32_t cp { static_cast<std::uint32_t>(src[i++]) };
+  if (cp >= 0xd800 && cp < 0xdc00 && i != size)
+  {
+    std::uint32_t next { static_cast<std::uint32_t>(src[i]) };
+    if (next >= 0xdc00 && next < 0xe000)
+    {
+      ++i;
+      return 0x10000 + ((cp - 0xd800) << 10) + (next - 0xdc00);
+    }
+  }
+  return cp;
+}
+
+static inline std::size_t _utf8Length(std::uint32_t cp)
+{
+  return cp < 0x80 ? 1 : cp < 0x800 ? 2 : cp < 0x10000 ? 3 : 4;
+}
+
+static inline char* _writeUtf8(std::uint32_t cp, char* dst)
+{
+  if (cp < 0x80)
+  {
+    *dst++ = static_cast<char>(cp);
+  }
+  else if (cp < 0x800)
+  {
+    *dst++ = static_cast<char>(0xc0 | (cp >> 6));
+    *dst++ = static_cast<char>(0x80 | (cp & 0x3f));
+  }
+  else if (cp < 0x10000)
+  {
+    *dst++ = static_cast<char>(0xe0 | (cp >> 12));
+    *dst++ = static_cast<char>(0x80 | ((cp >> 6) & 0x3f));
+    *dst++ = static_cast<char>(0x80 | (cp & 0x3f));
+  }
+  else
+  {
+    *dst++ = static_cast<char>(0xf0 | (cp >> 18));
+    *dst++ = static_cast<char>(0x80 | ((cp >> 12) & 0x3f));
+    *dst++ = static_cast<char>(0x80 | ((cp >> 6) & 0x3f));
+    *dst++ = static_cast<char>(0x80 | (cp & 0x3f));
+  }
+  return dst;
+}
+
+// Encode a Py_UNICODE buffer to UTF-8, directly into the buffer of out
+// Pure ASCII strings are copied in a single pass without intermediate buffer
+template <class STRING>
+static inline void _unicodeToUtf8(const Py_UNICODE* src, std::size_t size, STRING& out)
+{
+  out.resize(size);
+  std::size_t ascii { size != 0 ? _narrowAscii(src, size, &out[0]) : 0 };
+  if (ascii == size)
+  {
+    return;
+  }
+  
+  std::size_t length { ascii };
+#if Py_UNICODE_SIZE == 4
+  // branchless so that the compiler can vectorize it
+  // surrogate pairs are over-estimated (6 bytes instead of 4), fixed after the write loop
+  for (std::size_t i { ascii } ; i != size ; ++i)
+  {
+    std::uint32_t cp { static_cast<std::uint32_t>(src[i]) };
+    length += 1 + (cp >= 0x80) + (cp >= 0x800) + (cp >= 0x10000);
+  }
+#else
+  for (std::size_t i { ascii } ; i != size ; )
+  {
+    length += _utf8Length(_readCodePoint(src, size, i));
+  }
+#endif
+  out.resize(length);
+  
+  char* dst { &out[ascii] };
+  for (std::size_t i { ascii } ; i != size ; )
+  {
+    std::uint32_t cp { static_cast<std::uint32_t>(src[i]) };
+    if (cp >= 0x80)
+    {
+      dst = _writeUtf8(_readCodePoint(src, size, i), dst);
+    }
+    else if (i + 16 <= size && static_cast<std::uint32_t>(src[i + 15]) < 0x80)
+    {
+      // probably a long ASCII run
+      std::size_t copied { _narrowAscii(src + i, size - i, dst) };
+      i += copied;
+      dst += copied;
+    }
+    else
+    {
+      *dst++ = static_cast<char>(cp);
+      ++i;
+    }
+  }
+  out.resize(static_cast<std::size_t>(dst - &out[0]));
+}
+
+// Decode a UTF-8 buffer directly into the buffer of out
+// Invalid sequences are replaced by U+FFFD
+template <class WSTRING>
+static inline void _utf8ToWide(const char* src, std::size_t size, WSTRING& out)
+{
+  out.resize(size); // never more code units than bytes
+  typename WSTRING::value_type* dst { size != 0 ? &out[0] : nullptr };
+  const unsigned char* it { reinterpret_cast<const unsigned char*>(src) };
+  const unsigned char* end { it + size };
+  while (it != end)
+  {
+    std::uint32_t cp { *it };
+    std::size_t extra = cp < 0x80 ? 0 : cp >= 0xc2 && cp < 0xe0 ? 1 : cp >= 0xe0 && cp < 0xf0 ? 2 : cp >= 0xf0 && cp < 0xf5 ? 3 : 4;
+    if (extra == 0)
+    {
+      *dst++ = static_cast<typename WSTRING::value_type>(cp);
+      ++it;
+      continue;
+    }
+    bool valid { extra != 4 && static_cast<std::size_t>(end - it) > extra };
+    if (valid)
+    {
+      cp &= 0x3f >> extra;
+      for (std::size_t k { 1 } ; k <= extra && valid ; ++k)
+      {
+        valid = (it[k] & 0xc0) == 0x80;
+        cp = (cp << 6) | (it[k] & 0x3f);
+      }
+      valid = valid && _utf8Length(cp) == extra +1 && (cp < 0xd800 || cp >= 0xe000) && cp < 0x110000;
+    }
+    if (! valid)
+    {
+      *dst++ = static_cast<typename WSTRING::value_type>(0xfffd);
+      ++it;
+      continue;
+    }
+    it += extra +1;
+    if (sizeof(typename WSTRING::value_type) == 2 && cp >= 0x10000)
+    {
+      *dst++ = static_cast<typename WSTRING::value_type>(0xd800 + ((cp - 0x10000) >> 10));
+      *dst++ = static_cast<typename WSTRING::value_type>(0xdc00 + ((cp - 0x10000) & 0x3ff));
+    }
+    else
+    {
+      *dst++ = static_cast<typename WSTRING::value_type>(cp);
+    }
+  }
+  out.resize(size != 0 ? dst - &out[0] : 0);
+}
+
+// Any allocator is accepted: CppBuilder<std::string>, CppBuilder<ArenaString>...
+template <class ALLOC>
+struct CppBuilder<std::basic_string<char, std::char_traits<char>, ALLOC>>
+{
+  typedef std::basic_string<char, std::char_traits<char>, ALLOC> value_type;
+  value_type operator() (PyObject* pyo) const
+  {
+    value_type out;
+    build_into(out, pyo);
+    return out;
+  }
+  bool eligible(PyObject* pyo) const
+  {
+    return PyString_Check(pyo) || PyUnicode_Check(pyo) || _rejected<CppBuilder>();
+  }
+  Optional<value_type> try_build(PyObject* pyo) const
+  {
+    return _tryBuildFlat(*this, pyo);
+  }
+  void build_into(value_type& out, PyObject* pyo) const
+  {
+    assert(pyo);
+    _StatsScope<CppBuilder> stats;
+    if (PyString_Check(pyo))
+    {
+      out.assign(PyString_AS_STRING(pyo), PyString_GET_SIZE(pyo));
+    }
+    else if (PyUnicode_Check(pyo))
+    {
+      _unicodeToUtf8(PyUnicode_AS_UNICODE(pyo), PyUnicode_GET_SIZE(pyo), out);
+    }
+    else
+    {
+      throw std::invalid_argument("Neither a PyString nor a PyUnicode instance");
+    }
+  }
+};
+template <class ALLOC> struct ToBuildable<std::basic_string<char, std::char_traits<char>, ALLOC>> : CppBuilder<std::basic_string<char, std::char_traits<char>, ALLOC>> {};
+
+template <class ALLOC>
+struct CppBuilder<std::basic_string<wchar_t, std::char_traits<wchar_t>, ALLOC>>
+{
+  typedef std::basic_string<wchar_t, std::char_traits<wchar_t>, ALLOC> value_type;
+  value_type operator() (PyObject* pyo) const
+  {
+    value_type out;
+    build_into(out, pyo);
+    return out;
+  }
+  bool eligible(PyObject* pyo) const
+  {
+    return PyString_Check(pyo) || PyUnicode_Check(pyo) || _rejected<CppBuilder>();
+  }
+  Optional<value_type> try_build(PyObject* pyo) const
+  {
+    return _tryBuildFlat(*this, pyo);
+  }
+  void build_into(value_type& out, PyObject* pyo) const
+  {
+    assert(pyo);
+    _StatsScope<CppBuilder> stats;
+    if (PyString_Check(pyo))
+    {
+      _utf8ToWide(PyString_AS_STRING(pyo), PyString_GET_SIZE(pyo), out);
+    }
+    else if (PyUnicode_Check(pyo))
+    {
+      Py_ssize_t size { PyUnicode_GET_SIZE(pyo) };
+      out.resize(size);
+      if (size != 0 && PyUnicode_AsWideChar(reinterpret_cast<PyUnicodeObject*>(pyo), &out[0], size) < 0)
+      {
+        PyErr_Clear();
+        throw std::runtime_error("Unable to retrieve C/C++ string from PyUnicode");
+      }
+    }
+    else
+    {
+      throw std::invalid_argument("Neither a PyString nor a PyUnicode instance");
+    }
+  }
+};
+template <class ALLOC> struct ToBuildable<std::basic_string<wchar_t, std::char_traits<wchar_t>, ALLOC>> : CppBuilder<std::basic_string<wchar_t, std::char_traits<wchar_t>, ALLOC>> {};
+
+class PyStringRef
+{
+  PyObject* owner_;
+  
+public:
+  typedef char value_type;
+  typedef const char* const_iterator;
+  
+  PyStringRef() : owner_(nullptr) {}
+  
+  // steals the reference on a PyString
+  explicit PyStringRef(PyObject* pyString) : owner_(pyString)
+  {
+    assert(! owner_ || PyString_Check(owner_));
+  }
+  PyStringRef(PyStringRef const& other) : owner_(other.owner_)
+  {
+    Py_XINCREF(owner_);
+  }
+  PyStringRef(PyStringRef&& other) : owner_(other.owner_)
+  {
+    other.owner_ = nullptr;
+  }
+  PyStringRef& operator=(PyStringRef const& other)
+  {
+    Py_XINCREF(other.owner_);
+    Py_XDECREF(owner_);
+    owner_ = other.owner_;
+    return *this;
+  }
+  PyStringRef& operator=(PyStringRef&& other)
+  {
+    if (this != &other)
+    {
+      Py_XDECREF(owner_);
+      owner_ = other.owner_;
+      other.owner_ = nullptr;
+    }
+    return *this;
+  }
+  ~PyStringRef()
+  {
+    Py_XDECREF(owner_);
+  }
+  
+  PyObject* owner() const { return owner_; }
+  const char* data() const { return owner_ ? PyString_AS_STRING(owner_) : ""; }
+  std::size_t size() const { return owner_ ? static_cast<std::size_t>(PyString_GET_SIZE(owner_)) : 0; }
+  bool empty() const { return size() == 0; }
+  const_iterator begin() const { return data(); }
+  const_iterator end() const { return data() + size(); }
+  const char& operator[] (std::size_t pos) const { return data()[pos]; }
+  std::string str() const { return std::string(data(), size()); }
+  
+  int compare(PyStringRef const& other) const
+  {
+    std::size_t common { std::min(size(), other.size()) };
+    int diff { common != 0 ? std::memcmp(data(), other.data(), common) : 0 };
+    return diff != 0 ? diff : size() < other.size() ? -1 : size() > other.size() ? 1 : 0;
+  }
+  bool operator==(PyStringRef const& other) const
+  {
+    return owner_ == other.owner_ || (size() == other.size() && std::memcmp(data(), other.data(), size()) == 0);
+  }
+  bool operator!=(PyStringRef const& other) const { return ! (*this == other); }
+  bool operator<(PyStringRef const& other) const { return compare(other) < 0; }
+  bool operator>(PyStringRef const& other) const { return compare(other) > 0; }
+  bool operator<=(PyStringRef const& other) const { return compare(other) <= 0; }
+  bool operator>=(PyStringRef const& other) const { return compare(other) >= 0; }
+  
+  // hash of the underlying PyString, computed once and cached by Python
+  std::size_t hash() const
+  {
+    return owner_ ? static_cast<std::size_t>(PyObject_Hash(owner_)) : 0;
+  }
+};
+
+template <>
+struct CppBuilder<PyStringRef>
+{
+  typedef PyStringRef value_type;
+  value_type operator() (PyObject* pyo) const
+  {
+    assert(pyo);
+    _StatsScope<CppBuilder> stats;
+    if (PyString_Check(pyo))
+    {
+      Py_INCREF(pyo);
+      return PyStringRef(pyo);
+    }
+    else if (PyUnicode_Check(pyo))
+    {
+      // Python 2 does not cache the UTF-8 encoding of unicode objects
+      // the encoded PyString is owned by the view
+      PyObject* encoded { PyUnicode_AsUTF8String(pyo) };
+      if (! encoded)
+      {
+        PyErr_Clear();
+        throw std::runtime_error("Unable to encode PyUnicode to UTF-8");
+      }
+      return PyStringRef(encoded);
+    }
+    throw std::invalid_argument("Neither a PyString nor a PyUnicode instance");
+  }
+  bool eligible(PyObject* pyo) const
+  {
+    return PyString_Check(pyo) || PyUnicode_Check(pyo) || _rejected<CppBuilder>();
+  }
+  Optional<value_type> try_build(PyObject* pyo) const
+  {
+    return _tryBuildFlat(*this, pyo);
+  }
+  void build_into(value_type& out, PyObject* pyo) const
+  {
+    out = (*this)(pyo);
+  }
+};
+template <> struct ToBuildable<PyStringRef> : CppBuilder<PyStringRef> {};
+
+/**
+ * Interned strings
+ */
+
+// FNV-1a over 8-byte words, the tail being read byte per byte
+static inline std::size_t _hashBytes(const void* data, std::size_t size)
+{
+  std::uint64_t hash { 14695981039346656037ull ^ size };
+  const unsigned char* it { static_cast<const unsigned char*>(data) };
+  const unsigned char* end { it + size };
+  for ( ; end - it >= 8 ; it += 8)
+  {
+    std::uint64_t word;
+    std::memcpy(&word, it, sizeof(word));
+    hash = (hash ^ word) * 1099511628211ull;
+    hash ^= hash >> 29;
+  }
+  for ( ; it != end ; ++it)
+  {
+    hash = (hash ^ *it) * 1099511628211ull;
+  }
+  return static_cast<std::size_t>(hash ^ (hash >> 32));
+}
+
+// Not static: all the translation units have to share the same instance
+inline std::string const& _emptyInterned()
+{
+  static const std::string empty;
+  return empty;
+}
+
+class StringPool
+{
+  // open addressing with linear probing, at most half full
+  struct ContentSlot
+  {
+    std::size_t hash;
+    const std::string* pooled; // nullptr: empty slot
+  };
+  // direct-mapped: a PyObject evicts the one stored in its slot
+  struct IdentitySlot
+  {
+    PyObject* pyo; // owned reference
+    const std::string* pooled;
+  };
+
+  mutable std::mutex mutex_;
+  std::deque<std::string> strings_; // never moved: handles point into it
+  std::vector<ContentSlot> byContent_;
+  std::vector<IdentitySlot> byIdentity_;
+  unsigned identityShift_;
+  std::string utf8_; // encoding buffer of PyUnicode
+
+  const std::string* internLocked(const char* data, std::size_t size)
+  {
+    if (size == 0)
+    {
+      return &_emptyInterned();
+    }
+    std::size_t hash { _hashBytes(data, size) };
+    std::size_t mask { byContent_.size() -1 };
+    std::size_t pos { hash & mask };
+    for ( ; byContent_[pos].pooled ; pos = (pos +1) & mask)
+    {
+      ContentSlot const& slot { byContent_[pos] };
+      if (slot.hash == hash && slot.pooled->size() == size && std::memcmp(slot.pooled->data(), data, size) == 0)
+      {
+        return slot.pooled;
+      }
+    }
+    strings_.emplace_back(data, size);
+    const std::string* pooled { &strings_.back() };
+    byContent_[pos] = ContentSlot { hash, pooled };
+    if (2 * strings_.size() > byContent_.size())
+    {
+      growContent();
+    }
+    return pooled;
+  }
+  void growContent()
+  {
+    std::vector<ContentSlot> previous(2 * byContent_.size(), ContentSlot { 0, nullptr });
+    previous.swap(byContent_);
+    std::size_t mask { byContent_.size() -1 };
+    for (ContentSlot const& slot : previous)
+    {
+      if (slot.pooled)
+      {
+        std::size_t pos { slot.hash & mask };
+        for ( ; byContent_[pos].pooled ; pos = (pos +1) & mask) {}
+        byContent_[pos] = slot;
+      }
+    }
+  }
+  IdentitySlot* slotOf(PyObject* pyo)
+  {
+    if (byIdentity_.empty())
+    {
+      return nullptr;
+    }
+    std::uint64_t address { reinterpret_cast<std::uintptr_t>(pyo) >> 3 };
+    return &byIdentity_[static_cast<std::size_t>((address * 0x9e3779b97f4a7c15ull) >> identityShift_)];
+  }
+  // The references are released by the caller once mutex_ is unlocked:
+  // deallocating a subclass of str or unicode may run Python code re-entering the pool or releasing the GIL
+  std::vector<PyObject*> takeIdentityLocked()
+  {
+    std::vector<PyObject*> taken;
+    for (auto& slot : byIdentity_)
+    {
+      if (slot.pyo)
+      {
+        taken.push_back(slot.pyo);
+      }
+      slot = IdentitySlot { nullptr, nullptr };
+    }
+    return taken;
+  }
+  static void releaseAll(std::vector<PyObject*> const& taken)
+  {
+    for (PyObject* pyo : taken)
+    {
+      Py_DECREF(pyo);
+    }
+  }
+
+public:
+  // identityCapacity: number of PyObjects remembered by identity (rounded up to a power of 2, 0 to disable)
+  explicit StringPool(std::size_t identityCapacity = 4096)
+      : byContent_(64, ContentSlot { 0, nullptr }), identityShift_(63)
+  {
+    if (identityCapacity != 0)
+    {
+      std::size_t slots { 2 };
+      for ( ; slots < identityCapacity ; slots *= 2, --identityShift_) {}
+      byIdentity_.assign(slots, IdentitySlot { nullptr, nullptr });
+    }
+  }
+  StringPool(StringPool const&) = delete;
+  StringPool& operator=(StringPool const&) = delete;
+
+  // the GIL has to be held if the identity cache is not empty
+  ~StringPool()
+  {
+    releaseAll(takeIdentityLocked());
+  }
+
+  // Pooled copy of the bytes, valid until the pool is destroyed
+  const std::string* intern(const char* data, std::size_t size)
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return internLocked(data, size);
+  }
+  const std::string* intern(std::string const& value)
+  {
+    return intern(value.data(), value.size());
+  }
+
+  // GIL held: pooled copy of a PyString or of the UTF-8 encoding of a PyUnicode
+  // pyo is remembered for the next lookups by identity
+  const std::string* intern(PyObject* pyo)
+  {
+    assert(PyString_Check(pyo) || PyUnicode_Check(pyo));
+    const std::string* pooled;
+    PyObject* evicted { nullptr }; // released once mutex_ is unlocked, see takeIdentityLocked
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      IdentitySlot* slot { slotOf(pyo) };
+      if (slot && slot->pyo == pyo)
+      {
+        return slot->pooled;
+      }
+      if (PyString_Check(pyo))
+      {
+        pooled = internLocked(PyString_AS_STRING(pyo), PyString_GET_SIZE(pyo));
+      }
+      else
+      {
+        _unicodeToUtf8(PyUnicode_AS_UNICODE(pyo), PyUnicode_GET_SIZE(pyo), utf8_);
+        pooled = internLocked(utf8_.data(), utf8_.size());
+      }
+      if (slot)
+      {
+        Py_INCREF(pyo);
+        evicted = slot->pyo;
+        *slot = IdentitySlot { pyo, pooled };
+      }
+    }
+    Py_XDECREF(evicted);
+    return pooled;
+  }
+
+  // GIL held: string remembered for this very PyObject, nullptr if unknown
+  const std::string* find(PyObject* pyo)
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    IdentitySlot* slot { slotOf(pyo) };
+    return slot && slot->pyo == pyo ? slot->pooled : nullptr;
+  }
+
+  // GIL held: forget the PyObjects remembered by identity and release their references
+  void release_identity_cache()
+  {
+    std::vector<PyObject*> taken;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      taken = takeIdentityLocked();
+    }
+    releaseAll(taken);
+  }
+
+  // number of distinct non-empty strings
+  std::size_t size() const
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return strings_.size();
+  }
+};
+
+// Never destroyed: it may be used until the very end of the process, after Py_Finalize
+// Without identity cache, so that it does not keep PyObjects alive until then
+inline StringPool* default_string_pool()
+{
+  static StringPool* pool { new StringPool(0) };
+  return pool;
+}
+
+inline StringPool*& _currentStringPool() noexcept
+{
+  static thread_local StringPool* current { nullptr };
+  return current;
+}
+
+// Pool used by the default-constructed CppBuilder<InternedString> of the calling thread
+inline StringPool* current_string_pool()
+{
+  StringPool* current { _currentStringPool() };
+  return current ? current : default_string_pool();
+}
+
+// Install a pool for the calling thread until the end of the scope
+class StringPoolScope
+{
+  StringPool* previous_;
+
+public:
+  explicit StringPoolScope(StringPool* pool) : previous_(_currentStringPool())
+  {
+    _currentStringPool() = pool;
+  }
+  ~StringPoolScope()
+  {
+    _currentStringPool() = previous_;
+  }
+  StringPoolScope(StringPoolScope const&) = delete;
+  StringPoolScope& operator=(StringPoolScope const&) = delete;
+};
+
+class InternedString
+{
+  const std::string* str_;
+
+public:
+  typedef char value_type;
+  typedef const char* const_iterator;
+
+  InternedString() : str_(&_emptyInterned()) {}
+  explicit InternedString(const std::string* pooled) : str_(pooled)
+  {
+    assert(str_);
+  }
+
+  std::string const& str() const { return *str_; }
+  const char* data() const { return str_->data(); }
+  const char* c_str() const { return str_->c_str(); }
+  std::size_t size() const { return str_->size(); }
+  bool empty() const { return str_->empty(); }
+  const_iterator begin() const { return data(); }
+  const_iterator end() const { return data() + size(); }
+  const char& operator[] (std::size_t pos) const { return data()[pos]; }
+
+  bool operator==(InternedString const& other) const { return str_ == other.str_; }
+  bool operator!=(InternedString const& other) const { return str_ != other.str_; }
+  bool operator<(InternedString const& other) const { return str_ != other.str_ && *str_ < *other.str_; }
+  bool operator>(InternedString const& other) const { return other < *this; }
+  bool operator<=(InternedString const& other) const { return ! (other < *this); }
+  bool operator>=(InternedString const& other) const { return ! (*this < other); }
+
+  std::size_t hash() const
+  {
+    return std::hash<const std::string*>()(str_);
+  }
+};
+
+template <>
+struct CppBuilder<InternedString>
+{
+  typedef InternedString value_type;
+  StringPool* pool; // nullptr: pool of the innermost StringPoolScope when the conversion runs
+
+  explicit CppBuilder(StringPool* pool = nullptr) : pool(pool) {}
+
+  value_type operator() (PyObject* pyo) const
+  {
+    assert(pyo);
+    _StatsScope<CppBuilder> stats;
+    if (! PyString_Check(pyo) && ! PyUnicode_Check(pyo))
+    {
+      throw std::invalid_argument("Neither a PyString nor a PyUnicode instance");
+    }
+    return InternedString((pool ? pool : current_string_pool())->intern(pyo));
+  }
+  bool eligible(PyObject* pyo) const
+  {
+    return PyString_Check(pyo) || PyUnicode_Check(pyo) || _rejected<CppBuilder>();
+  }
+  Optional<value_type> try_build(PyObject* pyo) const
+  {
+    return _tryBuildFlat(*this, pyo);
+  }
+  void build_into(value_type& out, PyObject* pyo) const
+  {
+    out = (*this)(pyo);
+  }
+};
+template <> struct ToBuildable<InternedString> : CppBuilder<InternedString> {};
+
+/**
+ * Tuple builder
+ */
+
+template <std::size_t... Is> struct _IndexSequence {};
+template <std::size_t N, std::size_t... Is> struct _MakeIndexSequence : _MakeIndexSequence<N -1, N -1, Is...> {};
+template <std::size_t... Is> struct _MakeIndexSequence<0, Is...> { typedef _IndexSequence<Is...> type; };
+
+template <class T, class BUILDER>
+static inline bool _tryFeedCppItem(Optional<T>& item, BUILDER const& builder, PyObject* pyo, std::size_t pos)
+{
+  item = builder.try_build(pyo);
+  if (! item)
+  {
+    _ConversionTrail::atIndex(pos);
+    return false;
+  }
+  return true;
+}
+
+// Build the std::tuple in place from the items of the PyTuple
+// PyTuple's size has to be checked by the caller
+template <class TUPLE, class INDEXES, class... Args>
+struct _CppTupleFeeder;
+
+template <class TUPLE, std::size_t... Is, class... Args>
+struct _CppTupleFeeder<TUPLE, _IndexSequence<Is...>, Args...>
+{
+  static inline TUPLE build(PyObject* root)
+  {
+    return TUPLE { ToBuildable<Args>()(PyTuple_GET_ITEM(root, Is))... };
+  }
+  static inline Optional<TUPLE> tryBuild(PyObject* root)
+  {
+    // items are built from left to right and the building stops at the first failure
+    std::tuple<Optional<typename ToBuildable<Args>::value_type>...> items;
+    bool success { true };
+    int dummy[] = { 0, (success = success && _tryFeedCppItem(std::get<Is>(items), ToBuildable<Args>(), PyTuple_GET_ITEM(root, Is), Is), 0)... };
+    (void)dummy;
+    if (! success)
+    {
+      return Optional<TUPLE>();
+    }
+    return TUPLE { std::move(*std::get<Is>(items))... };
+  }
+};
+
+template <class TUPLE, class... Args>
+static inline TUPLE _feedCppTuple(PyObject* root)
+{
+  return _CppTupleFeeder<TUPLE, typename _MakeIndexSequence<sizeof...(Args)>::type, Args...>::build(root);
+}
+
+template <class TUPLE, class... Args>
+static inline Optional<TUPLE> _tryFeedCppTuple(PyObject* root)
+{
+  return _CppTupleFeeder<TUPLE, typename _MakeIndexSequence<sizeof...(Args)>::type, Args...>::tryBuild(root);
+}
+
+template <class TUPLE, std::size_t pos>
+static inline bool _checkEligibleCppTuple(PyObject* root)
+{
+  return true;
+}
+
+template <class TUPLE, std::size_t pos, class T, class... Args>
+static inline bool _checkEligibleCppTuple(PyObject* root)
+{
+  return ToBuildable<T>().eligible(PyTuple_GET_ITEM(root, pos))
+      && _checkEligibleCppTuple<TUPLE, pos +1, Args...>(root);
+}
+
+template <class... Args>
+struct CppBuilder<std::tuple<Args...>>
+{
+  typedef std::tuple<typename ToBuildable<Args>::value_type...> value_type;
+  value_type operator() (PyObject* pyo) const
+  {
+    assert(pyo);
+    _StatsScope<CppBuilder> stats;
+    checkTuple(pyo);
+    return _feedCppTuple<value_type, Args...>(pyo);
+  }
+  bool eligible(PyObject* pyo) const
+  {
+    return (PyTuple_Check(pyo)
+            && PyTuple_Size(pyo) == sizeof...(Args)
+            && _checkEligibleCppTuple<value_type, 0, Args...>(pyo))
+        || _rejected<CppBuilder>();
+  }
+  Optional<value_type> try_build(PyObject* pyo) const
+  {
+    if (! PyTuple_Check(pyo))
+    {
+      return _rejectedHere<CppBuilder>();
+    }
+    if (PyTuple_Size(pyo) != sizeof...(Args))
+    {
+      return _rejectedHere<CppBuilder>(ConversionErrc::length_mismatch);
+    }
+    _StatsScope<CppBuilder> stats;
+    return _tried<CppBuilder>(_tryFeedCppTuple<value_type, Args...>(pyo));
+  }
+  void build_into(value_type& out, PyObject* pyo) const
+  {
+    assert(pyo);
+    _StatsScope<CppBuilder> stats;
+    checkTuple(pyo);
+    intoItems(out, pyo, typename _MakeIndexSequence<sizeof...(Args)>::type());
+  }
+
+private:
+  static void checkTuple(PyObject* pyo)
+  {
+    if (! PyTuple_Check(pyo))
+    {
+      throw std::invalid_argument("Not a PyTuple instance");
+    }
+    if (PyTuple_Size(pyo) != sizeof...(Args))
+    {
+      std::ostringstream oss;
+      oss << "PyTuple length differs from asked one: "
+          << "PyTuple(" << PyTuple_Size(pyo) << ") "
+          << "and std::tuple<...>(" << sizeof...(Args) << ")";
+      throw std::invalid_argument(oss.str());
+    }
+  }
+  template <std::size_t... Is>
+  static void intoItems(value_type& out, PyObject* pyo, _IndexSequence<Is...>)
+  {
+    int dummy[] = { 0, (_buildInto(ToBuildable<Args>(), std::get<Is>(out), PyTuple_GET_ITEM(pyo, Is)), 0)... };
+    (void)dummy;
+  }
+};
+template <class... Args> struct ToBuildable<std::tuple<Args...>> : CppBuilder<std::tuple<Args...>> {};
+
+/**
+ * Memory resources
+ */
+
+class MemoryResource
+{
+public:
+  virtual ~MemoryResource() {}
+
+  void* allocate(std::size_t bytes, std::size_t alignment = alignof(std::max_align_t))
+  {
+    return do_allocate(bytes, alignment);
+  }
+  void deallocate(void* p, std::size_t bytes, std::size_t alignment = alignof(std::max_align_t))
+  {
+    do_deallocate(p, bytes, alignment);
+  }
+  bool is_equal(MemoryResource const& other) const noexcept
+  {
+    return this == &other || do_is_equal(other);
+  }
+
+protected:
+  virtual void* do_allocate(std::size_t bytes, std::size_t alignment) = 0;
+  virtual void do_deallocate(void* p, std::size_t bytes, std::size_t alignment) = 0;
+  virtual bool do_is_equal(MemoryResource const& other) const noexcept = 0;
+};
+
+namespace
+{
+  struct _NewDeleteResource : MemoryResource
+  {
+  protected:
+    void* do_allocate(std::size_t bytes, std::size_t) override
+    {
+      return ::operator new(bytes);
+    }
+    void do_deallocate(void* p, std::size_t, std::size_t) override
+    {
+      ::operator delete(p);
+    }
+    bool do_is_equal(MemoryResource const& other) const noexcept override
+    {
+      return dynamic_cast<_NewDeleteResource const*>(&other) != nullptr;
+    }
+  };
+}
+
+// Not static: all the translation units have to share the same instances
+inline MemoryResource* new_delete_resource() noexcept
+{
+  static _NewDeleteResource resource;
+  return &resource;
+}
+
+inline MemoryResource*& _currentResource() noexcept
+{
+  static thread_local MemoryResource* current { nullptr };
+  return current;
+}
+
+// Resource used by the default-constructed ArenaAllocator of the calling thread
+inline MemoryResource* current_memory_resource() noexcept
+{
+  MemoryResource* current { _currentResource() };
+  return current ? current : new_delete_resource();
+}
+
+// Install a resource for the calling thread until the end of the scope
+class ArenaScope
+{
+  MemoryResource* previous_;
+
+public:
+  explicit ArenaScope(MemoryResource* resource) : previous_(_currentResource())
+  {
+    _currentResource() = resource;
+  }
+  ~ArenaScope()
+  {
+    _currentResource() = previous_;
+  }
+  ArenaScope(ArenaScope const&) = delete;
+  ArenaScope& operator=(ArenaScope const&) = delete;
+};
+
+// Not thread-safe: an arena has to be used by a single thread at a time
+class MonotonicArena : public MemoryResource
+{
+  struct Block
+  {
+    Block* next;
+    std::size_t size;
+  };
+
+  MemoryResource* upstream_;
+  Block* blocks_;
+  char* current_;
+  char* end_;
+  std::size_t nextSize_;
+  std::size_t used_;
+  std::size_t count_;
+
+  void grow(std::size_t bytes, std::size_t alignment)
+  {
+    std::size_t size { std::max(nextSize_, sizeof(Block) + alignment + bytes) };
+    Block* block { static_cast<Block*>(upstream_->allocate(size)) };
+    block->next = blocks_;
+    block->size = size;
+    blocks_ = block;
+    current_ = reinterpret_cast<char*>(block + 1);
+    end_ = reinterpret_cast<char*>(block) + size;
+    nextSize_ = size * 2;
+    ++count_;
+  }
+
+public:
+  // a block of initialSize usable bytes is requested to upstream immediately (none if initialSize is 0),
+  // the following blocks are twice as large as the previous one
+  explicit MonotonicArena(std::size_t initialSize = 4096, MemoryResource* upstream = new_delete_resource())
+      : upstream_(upstream), blocks_(nullptr), current_(nullptr), end_(nullptr)
+      , nextSize_(std::max<std::size_t>(initialSize, 256)), used_(0), count_(0)
+  {
+    if (initialSize != 0)
+    {
+      grow(initialSize, alignof(std::max_align_t));
+    }
+  }
+  ~MonotonicArena()
+  {
+    release();
+  }
+  MonotonicArena(MonotonicArena const&) = delete;
+  MonotonicArena& operator=(MonotonicArena const&) = delete;
+
+  // Give back all the memory to upstream
+  // values allocated from the arena must not be used (nor destroyed) afterwards
+  void release() noexcept
+  {
+    while (blocks_)
+    {
+      Block* next { blocks_->next };
+      upstream_->deallocate(blocks_, blocks_->size);
+      blocks_ = next;
+    }
+    current_ = end_ = nullptr;
+    used_ = count_ = 0;
+  }
+
+  std::size_t used() const noexcept { return used_; }     // bytes handed out, padding included
+  std::size_t blocks() const noexcept { return count_; }  // blocks requested to upstream
+
+protected:
+  void* do_allocate(std::size_t bytes, std::size_t alignment) override
+  {
+    std::uintptr_t address { reinterpret_cast<std::uintptr_t>(current_) };
+    std::size_t padding { (alignment - address % alignment) % alignment };
+    if (! current_ || static_cast<std::size_t>(end_ - current_) < padding + bytes)
+    {
+      grow(bytes, alignment);
+      address = reinterpret_cast<std::uintptr_t>(current_);
+      padding = (alignment - address % alignment) % alignment;
+    }
+    char* p { current_ + padding };
+    current_ = p + bytes;
+    used_ += padding + bytes;
+    return p;
+  }
+  void do_deallocate(void*, std::size_t, std::size_t) override
+  {}
+  bool do_is_equal(MemoryResource const& other) const noexcept override
+  {
+    return this == &other;
+  }
+};
+
+// Containers keep the resource they were built with when moved,
+// copies use the resource current at the time of the copy
+template <class T>
+class ArenaAllocator
+{
+  template <class U> friend class ArenaAllocator;
+  MemoryResource* resource_;
+
+public:
+  typedef T value_type;
+  typedef std::false_type propagate_on_container_copy_assignment;
+  typedef std::false_type propagate_on_container_move_assignment;
+  typedef std::false_type propagate_on_container_swap;
+
+  ArenaAllocator() noexcept : resource_(current_memory_resource()) {}
+  ArenaAllocator(MemoryResource* resource) noexcept : resource_(resource) {}
+  template <class U> ArenaAllocator(ArenaAllocator<U> const& other) noexcept : resource_(other.resource_) {}
+
+  T* allocate(std::size_t n)
+  {
+    return static_cast<T*>(resource_->allocate(n * sizeof(T), alignof(T)));
+  }
+  void deallocate(T* p, std::size_t n) noexcept
+  {
+    resource_->deallocate(p, n * sizeof(T), alignof(T));
+  }
+  ArenaAllocator select_on_container_copy_construction() const noexcept
+  {
+    return ArenaAllocator();
+  }
+  MemoryResource* resource() const noexcept
+  {
+    return resource_;
+  }
+};
+
+template <class T, class U>
+bool operator==(ArenaAllocator<T> const& a1, ArenaAllocator<U> const& a2) noexcept
+{
+  return a1.resource()->is_equal(*a2.resource());
+}
+template <class T, class U>
+bool operator!=(ArenaAllocator<T> const& a1, ArenaAllocator<U> const& a2) noexcept
+{
+  return ! (a1 == a2);
+}
+
+// Rebind the allocator, comparator, hash and equality of a container declared on builders' types
+// to the built types, eg.: std::less<FromTuple<...>> becomes std::less<Point>
+// user-defined functors are kept as is
+template <class ALLOC, class V>
+using _RebindAlloc = typename std::allocator_traits<ALLOC>::template rebind_alloc<V>;
+
+template <class C, class V> struct _RebindLess { typedef C type; };
+template <class T, class V> struct _RebindLess<std::less<T>, V> { typedef std::less<V> type; };
+template <class E, class V> struct _RebindEqual { typedef E type; };
+template <class T, class V> struct _RebindEqual<std::equal_to<T>, V> { typedef std::equal_to<V> type; };
+template <class H, class V> struct _RebindHash { typedef H type; };
+
+/**
+ * Vector builder
+ */
+
+// Hint the CPU that the header of pyo will be read soon
+static inline void _prefetchPyObject(PyObject* pyo)
+{
+#if defined(__GNUC__)
+  __builtin_prefetch(pyo);
+#endif
+}
+
+// Homogeneous lists of numbers
+// Items are read chunk by chunk: the type of each item is compared to the one of the first item
+// (PyInt, small PyLong or PyFloat) and its raw value copied in a tight loop,
+// then the whole chunk is range-checked at once
+// Lists failing any of these checks go through the generic per-item path
+// which reports the error of the faulty item
+
+// Bounds of T expressed as long
+template <class T>
+struct _LongRange
+{
+  static constexpr long min()
+  {
+    return ! std::is_signed<T>::value ? 0L
+        : sizeof(T) < sizeof(long) ? static_cast<long>(std::numeric_limits<T>::min()) : LONG_MIN;
+  }
+  static constexpr long max()
+  {
+    return sizeof(T) < sizeof(long) ? static_cast<long>(std::numeric_limits<T>::max()) : LONG_MAX;
+  }
+};
+
+// PyLong made of at most _SMALL_LONG_DIGITS digits fit into a long
+static const Py_ssize_t _SMALL_LONG_DIGITS { 2 * PyLong_SHIFT < sizeof(long) * CHAR_BIT - 1 ? 2 : 1 };
+
+static const std::size_t _NUMBERS_CHUNK { 256 };
+
+// Raw values of count PyInt or small PyLong (same type as the first one), false otherwise
+static inline bool _readLongs(PyObject** it, std::size_t count, long* values)
+{
+  if (Py_TYPE(*it) == &PyInt_Type)
+  {
+    for (std::size_t i { 0 } ; i != count ; ++i)
+    {
+      if (Py_TYPE(it[i]) != &PyInt_Type)
+      {
+        return false;
+      }
+      values[i] = reinterpret_cast<PyIntObject*>(it[i])->ob_ival;
+    }
+    return true;
+  }
+  if (Py_TYPE(*it) == &PyLong_Type)
+  {
+    for (std::size_t i { 0 } ; i != count ; ++i)
+    {
+      // ob_size only exists in variable-size objects: the type is checked before reading it
+      if (Py_TYPE(it[i]) != &PyLong_Type)
+      {
+        return false;
+      }
+      Py_ssize_t size { Py_SIZE(it[i]) };
+      Py_ssize_t digits { size < 0 ? -size : size };
+      if (digits > _SMALL_LONG_DIGITS)
+      {
+        return false;
+      }
+      PyLongObject* number { reinterpret_cast<PyLongObject*>(it[i]) };
+      long value { digits > 0 ? static_cast<long>(number->ob_digit[0]) : 0L };
+      if (digits > 1)
+      {
+        value |= static_cast<long>(number->ob_digit[1]) << PyLong_SHIFT;
+      }
+      values[i] = size < 0 ? -value : value;
+    }
+    return true;
+  }
+  return false;
+}
+
+// true if all the values are within [lo, hi]
+// branchless so that the compiler can vectorize it
+static inline bool _longsWithin(const long* values, std::size_t count, long lo, long hi)
+{
+  long minValue { LONG_MAX };
+  long maxValue { LONG_MIN };
+  for (std::size_t i { 0 } ; i != count ; ++i)
+  {
+    minValue = values[i] < minValue ? values[i] : minValue;
+    maxValue = values[i] > maxValue ? values[i] : maxValue;
+  }
+  return count == 0 || (minValue >= lo && maxValue <= hi);
+}
+
+// Raw values of count PyFloat, false otherwise
+static inline bool _readDoubles(PyObject** it, std::size_t count, double* values)
+{
+  for (std::size_t i { 0 } ; i != count ; ++i)
+  {
+    if (Py_TYPE(it[i]) != &PyFloat_Type)
+    {
+      return false;
+    }
+    values[i] = reinterpret_cast<PyFloatObject*>(it[i])->ob_fval;
+  }
+  return true;
+}
+
+// true if none of the values is infinite
+static inline bool _doublesFinite(const double* values, std::size_t count)
+{
+  std::size_t i { 0 };
+#if defined(__SSE2__)
+  const __m128d absMask { _mm_castsi128_pd(_mm_set1_epi64x(0x7fffffffffffffffLL)) };
+  const __m128d inf { _mm_set1_pd(INFINITY) };
+  __m128d anyInf { _mm_setzero_pd() };
+  for ( ; i + 2 <= count ; i += 2)
+  {
+    anyInf = _mm_or_pd(anyInf, _mm_cmpeq_pd(_mm_and_pd(_mm_loadu_pd(values + i), absMask), inf));
+  }
+  if (_mm_movemask_pd(anyInf) != 0)
+  {
+    return false;
+  }
+#endif
+  bool finite { true };
+  for ( ; i != count ; ++i)
+  {
+    finite &= values[i] != INFINITY && values[i] != -INFINITY;
+  }
+  return finite;
+}
+
+// Fill out with the values of the homogeneous list [it, end), false if the generic path has to be used
+// out may have been resized and partially overwritten when false is returned
+template <class T, class VECTOR>
+static inline bool _readHomogeneousIntegers(PyObject** it, PyObject** end, VECTOR& out)
+{
+  std::size_t size { static_cast<std::size_t>(end - it) };
+  if (size == 0 || (Py_TYPE(*it) != &PyInt_Type && Py_TYPE(*it) != &PyLong_Type))
+  {
+    return false;
+  }
+  out.resize(size);
+  T* dst { out.data() };
+  long values[_NUMBERS_CHUNK];
+  for (std::size_t pos { 0 } ; pos < size ; pos += _NUMBERS_CHUNK)
+  {
+    std::size_t count { std::min(_NUMBERS_CHUNK, size - pos) };
+    if (! _readLongs(it + pos, count, values)
+        || ! _longsWithin(values, count, _LongRange<T>::min(), _LongRange<T>::max()))
+    {
+      return false;
+    }
+    for (std::size_t i { 0 } ; i != count ; ++i)
+    {
+      dst[pos + i] = static_cast<T>(values[i]);
+    }
+  }
+  return true;
+}
+
+template <class VECTOR>
+static inline bool _readHomogeneousDoubles(PyObject** it, PyObject** end, VECTOR& out)
+{
+  std::size_t size { static_cast<std::size_t>(end - it) };
+  if (size == 0)
+  {
+    return false;
+  }
+  if (Py_TYPE(*it) != &PyFloat_Type)
+  {
+    return _readHomogeneousIntegers<double>(it, end, out);
+  }
+  out.resize(size);
+  double* dst { out.data() };
+  for (std::size_t pos { 0 } ; pos < size ; pos += _NUMBERS_CHUNK)
+  {
+    std::size_t count { std::min(_NUMBERS_CHUNK, size - pos) };
+    if (! _readDoubles(it + pos, count, dst + pos) || ! _doublesFinite(dst + pos, count))
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+// _HomogeneousReader<T>::read(it, end, out): fill out if T supports the homogeneous path
+template <class T>
+struct _HomogeneousReader
+{
+  template <class VECTOR>
+  static bool read(PyObject**, PyObject**, VECTOR&) { return false; }
+};
+
+template <class T>
+struct _HomogeneousIntegersReader
+{
+  template <class VECTOR>
+  static bool read(PyObject** it, PyObject** end, VECTOR& out) { return _readHomogeneousIntegers<T>(it, end, out); }
+};
+template <> struct _HomogeneousReader<int> : _HomogeneousIntegersReader<int> {};
+template <> struct _HomogeneousReader<unsigned int> : _HomogeneousIntegersReader<unsigned int> {};
+template <> struct _HomogeneousReader<long> : _HomogeneousIntegersReader<long> {};
+template <> struct _HomogeneousReader<unsigned long> : _HomogeneousIntegersReader<unsigned long> {};
+template <> struct _HomogeneousReader<long long> : _HomogeneousIntegersReader<long long> {};
+template <> struct _HomogeneousReader<unsigned long long> : _HomogeneousIntegersReader<unsigned long long> {};
+
+template <>
+struct _HomogeneousReader<double>
+{
+  template <class VECTOR>
+  static bool read(PyObject** it, PyObject** end, VECTOR& out) { return _readHomogeneousDoubles(it, end, out); }
+};
+
+template <class BUILDER, class VECTOR>
+static inline void _buildIntoItem(BUILDER const& builder, VECTOR& out, std::size_t pos, PyObject* pyo)
+{
+  _buildInto(builder, out[pos], pyo);
+}
+template <class BUILDER, class BOOL_ALLOC>
+static inline void _buildIntoItem(BUILDER const& builder, std::vector<bool, BOOL_ALLOC>& out, std::size_t pos, PyObject* pyo)
+{
+  out[pos] = builder(pyo);
+}
+
+template <class T, class ALLOC>
+struct CppBuilder<std::vector<T, ALLOC>>
+{
+  typedef std::vector<typename ToBuildable<T>::value_type, _RebindAlloc<ALLOC, typename ToBuildable<T>::value_type>> value_type;
+  value_type operator() (PyObject* pyo) const
+  {
+    value_type v;
+    build_into(v, pyo);
+    return v;
+  }
+  bool eligible(PyObject* pyo) const
+  {
+    if (! PyList_Check(pyo) && ! PyTuple_Check(pyo))
+    {
+      return _rejected<CppBuilder>();
+    }
+    std::unique_ptr<PyObject, decref> seq { PySequence_Fast(pyo, "Neither a PyList nor a PyTuple instance") };
+    PyObject** it { PySequence_Fast_ITEMS(seq.get()) };
+    PyObject** end { it + PySequence_Fast_GET_SIZE(seq.get()) };
+    
+    ToBuildable<T> builder;
+    for ( ; it != end ; ++it)
+    {
+      if (! builder.eligible(*it))
+      {
+        return _rejected<CppBuilder>();
+      }
+    }
+    return true;
+  }
+  Optional<value_type> try_build(PyObject* pyo) const
+  {
+    if (! PyList_Check(pyo) && ! PyTuple_Check(pyo))
+    {
+      return _rejectedHere<CppBuilder>();
+    }
+    _StatsScope<CppBuilder> stats;
+    std::unique_ptr<PyObject, decref> seq { PySequence_Fast(pyo, "Neither a PyList nor a PyTuple instance") };
+    PyObject** it { PySequence_Fast_ITEMS(seq.get()) };
+    PyObject** end { it + PySequence_Fast_GET_SIZE(seq.get()) };
+    stats.elements(end - it);
+    
+    value_type v;
+    if (_HomogeneousReader<T>::read(it, end, v))
+    {
+      return std::move(v);
+    }
+    v.clear();
+    
+    ToBuildable<T> builder;
+    v.reserve(end - it);
+    for ( ; it != end ; ++it)
+    {
+      if (it +1 != end)
+      {
+        _prefetchPyObject(*(it +1));
+      }
+      Optional<typename ToBuildable<T>::value_type> item { builder.try_build(*it) };
+      if (! item)
+      {
+        _ConversionTrail::atIndex(it - PySequence_Fast_ITEMS(seq.get()));
+        return _rejected<CppBuilder>();
+      }
+      v.push_back(std::move(*item));
+    }
+    return std::move(v);
+  }
+  // existing items are overwritten in place, extra ones are erased
+  void build_into(value_type& out, PyObject* pyo) const
+  {
+    assert(pyo);
+    _StatsScope<CppBuilder> stats;
+    if (! PyList_Check(pyo) && ! PyTuple_Check(pyo))
+    {
+      throw std::invalid_argument("Neither a PyList nor a PyTuple instance");
+    }
+    std::unique_ptr<PyObject, decref> seq { PySequence_Fast(pyo, "Neither a PyList nor a PyTuple instance") };
+    PyObject** it { PySequence_Fast_ITEMS(seq.get()) };
+    PyObject** end { it + PySequence_Fast_GET_SIZE(seq.get()) };
+    std::size_t size { static_cast<std::size_t>(end - it) };
+    stats.elements(size);
+    
+    if (_HomogeneousReader<T>::read(it, end, out))
+    {
+      return;
+    }
+    
+    ToBuildable<T> builder;
+    if (out.size() > size)
+    {
+      out.erase(out.begin() + size, out.end());
+    }
+    out.reserve(size);
+    for (std::size_t pos { 0 } ; it != end ; ++it, ++pos)
+    {
+      if (it +1 != end)
+      {
+        _prefetchPyObject(*(it +1));
+      }
+      if (pos < out.size())
+      {
+        _buildIntoItem(builder, out, pos, *it);
+      }
+      else
+      {
+        out.push_back(builder(*it));
+      }
+    }
+  }
+};
+template <class T, class ALLOC> struct ToBuildable<std::vector<T, ALLOC>> : CppBuilder<std::vector<T, ALLOC>> {};
+
+/**
+ * Iterable builder
+ */
+
+// number of items announced by __len__ or __length_hint__, 0 if unknown
+static inline std::size_t _lengthHint(PyObject* pyo)
+{
+  Py_ssize_t hint { _PyObject_LengthHint(pyo, 0) };
+  if (hint < 0)
+  {
+    PyErr_Clear();
+    return 0;
+  }
+  return static_cast<std::size_t>(hint);
+}
+
+// PyIter_Next with the Python error, raised by a generator for instance, turned into an exception
+static inline PyObject* _iterNext(PyObject* iterator)
+{
+  PyObject* item { PyIter_Next(iterator) };
+  if (! item && PyErr_Occurred())
+  {
+    PyErr_Clear();
+    throw std::runtime_error("Exception raised while iterating over the PyObject");
+  }
+  return item;
+}
+
+template <class T>
+struct CppBuilder<FromIterable<T>>
+{
+  typedef std::vector<typename ToBuildable<T>::value_type> value_type;
+  value_type operator() (PyObject* pyo) const
+  {
+    value_type v;
+    build_into(v, pyo);
+    return v;
+  }
+  // iterators cannot be checked without being consumed: any iterator is eligible
+  bool eligible(PyObject* pyo) const
+  {
+    if (PyList_Check(pyo) || PyTuple_Check(pyo))
+    {
+      return CppBuilder<std::vector<T>>().eligible(pyo) || _rejected<CppBuilder>();
+    }
+    std::unique_ptr<PyObject, decref> iterator { PyObject_GetIter(pyo) };
+    if (! iterator)
+    {
+      PyErr_Clear();
+      return _rejected<CppBuilder>();
+    }
+    if (iterator.get() == pyo)
+    {
+      return true;
+    }
+    ToBuildable<T> builder;
+    while (std::unique_ptr<PyObject, decref> item { _iterNext(iterator.get()) })
+    {
+      if (! builder.eligible(item.get()))
+      {
+        return _rejected<CppBuilder>();
+      }
+    }
+    return true;
+  }
+  Optional<value_type> try_build(PyObject* pyo) const
+  {
+    if (PyList_Check(pyo) || PyTuple_Check(pyo))
+    {
+      return _tried<CppBuilder>(CppBuilder<std::vector<T>>().try_build(pyo));
+    }
+    std::unique_ptr<PyObject, decref> iterator { PyObject_GetIter(pyo) };
+    if (! iterator)
+    {
+      PyErr_Clear();
+      return _rejectedHere<CppBuilder>();
+    }
+    _StatsScope<CppBuilder> stats;
+    value_type v;
+    v.reserve(_lengthHint(pyo));
+    ToBuildable<T> builder;
+    while (std::unique_ptr<PyObject, decref> item { _iterNext(iterator.get()) })
+    {
+      Optional<typename ToBuildable<T>::value_type> built { builder.try_build(item.get()) };
+      if (! built)
+      {
+        _ConversionTrail::atIndex(v.size());
+        return _rejected<CppBuilder>();
+      }
+      v.push_back(std::move(*built));
+    }
+    stats.elements(v.size());
+    return std::move(v);
+  }
+  // existing items are overwritten in place, extra ones are erased
+  void build_into(value_type& out, PyObject* pyo) const
+  {
+    assert(pyo);
+    _StatsScope<CppBuilder> stats;
+    if (PyList_Check(pyo) || PyTuple_Check(pyo))
+    {
+      CppBuilder<std::vector<T>>().build_into(out, pyo);
+      stats.elements(out.size());
+      return;
+    }
+    std::unique_ptr<PyObject, decref> iterator { PyObject_GetIter(pyo) };
+    if (! iterator)
+    {
+      PyErr_Clear();
+      throw std::invalid_argument("Not an iterable PyObject");
+    }
+    out.reserve(_lengthHint(pyo));
+    ToBuildable<T> builder;
+    std::size_t pos { 0 };
+    for ( ; std::unique_ptr<PyObject, decref> item { _iterNext(iterator.get()) } ; ++pos)
+    {
+      if (pos < out.size())
+      {
+        _buildIntoItem(builder, out, pos, item.get());
+      }
+      else
+      {
+        out.push_back(builder(item.get()));
+      }
+    }
+    out.erase(out.begin() + pos, out.end());
+    stats.elements(pos);
+  }
+
+  // Converts the items by batches of chunk_size, the last one being smaller,
+  // and calls fun(std::vector<value>&) on each batch with the GIL held
+  // The batch is overwritten in place by the next one: fun may modify or move its items
+  // Returns the number of items
+  template <class FUN>
+  std::size_t stream(PyObject* pyo, std::size_t chunk_size, FUN&& fun) const
+  {
+    assert(pyo);
+    assert(chunk_size != 0);
+    _StatsScope<CppBuilder> stats;
+    std::unique_ptr<PyObject, decref> iterator { PyObject_GetIter(pyo) };
+    if (! iterator)
+    {
+      PyErr_Clear();
+      throw std::invalid_argument("Not an iterable PyObject");
+    }
+    value_type chunk;
+    chunk.reserve(std::min(chunk_size, std::max<std::size_t>(_lengthHint(pyo), 1)));
+    ToBuildable<T> builder;
+    std::size_t total { 0 };
+    std::size_t pos { 0 };
+    while (std::unique_ptr<PyObject, decref> item { _iterNext(iterator.get()) })
+    {
+      if (pos < chunk.size())
+      {
+        _buildIntoItem(builder, chunk, pos, item.get());
+      }
+      else
+      {
+        chunk.push_back(builder(item.get()));
+      }
+      if (++pos == chunk_size)
+      {
+        fun(chunk);
+        total += pos;
+        pos = 0;
+      }
+    }
+    if (pos != 0)
+    {
+      chunk.erase(chunk.begin() + pos, chunk.end());
+      fun(chunk);
+      total += pos;
+    }
+    stats.elements(total);
+    return total;
+  }
+};
+template <class T> struct ToBuildable<FromIterable<T>> : CppBuilder<FromIterable<T>> {};
+
+/**
+ * Set builder
+ */
+
+// build_into of sets and maps keeps the nodes of the elements still present in the PyObject:
+// each element is built into a temporary, looked up and inserted if missing
+// The addresses of the elements matched by the current (possibly nested) calls are stacked here
+// so that the stale elements, and only them, are erased afterwards
+static inline std::vector<const void*>& _matchedElements()
+{
+  static thread_local std::vector<const void*> matched;
+  return matched;
+}
+
+class _MatchedScope
+{
+  std::vector<const void*>& matched;
+  const std::size_t base;
+
+public:
+  _MatchedScope() : matched(_matchedElements()), base(matched.size()) {}
+  ~_MatchedScope() { matched.resize(base); }
+  _MatchedScope(_MatchedScope const&) = delete;
+  _MatchedScope& operator=(_MatchedScope const&) = delete;
+
+  void add(const void* element) { matched.push_back(element); }
+  // distinct elements matched since the scope was opened
+  // equal to the number of Python items unless two of them are equal once converted
+  std::size_t distinct()
+  {
+    std::sort(matched.begin() + base, matched.end());
+    return std::unique(matched.begin() + base, matched.end()) - (matched.begin() + base);
+  }
+  // erase the elements of out that have not been matched since the scope was opened
+  template <class CONTAINER>
+  void eraseUnmatched(CONTAINER& out)
+  {
+    std::size_t count { distinct() };
+    if (count == out.size())
+    {
+      return;
+    }
+    auto first = matched.begin() + base;
+    auto last = first + count;
+    for (auto it = out.begin() ; it != out.end() ; )
+    {
+      if (std::binary_search(first, last, static_cast<const void*>(&*it)))
+      {
+        ++it;
+      }
+      else
+      {
+        it = out.erase(it);
+      }
+    }
+  }
+};
+
+// elements of out missing from pyo (a set or a frozenset) are erased
+template <class SET, class BUILDER>
+static inline void _updateSet(SET& out, BUILDER const& builder, PyObject* pyo)
+{
+  _MatchedScope matched;
+  typename SET::value_type item;
+  Py_ssize_t pos { 0 };
+  PyObject* key;
+  long hash;
+  while (_PySet_NextEntry(pyo, &pos, &key, &hash))
+  {
+    _buildInto(builder, item, key);
+    auto it = out.find(item);
+    if (it == out.end())
+    {
+      it = out.insert(std::move(item)).first;
+    }
+    matched.add(&*it);
+  }
+  matched.eraseUnmatched(out);
+}
+
+namespace
+{
+  // Walk the entries of a set or a frozenset without modifying it
+  // Elements are converted into a buffer, sorted once and then appended to the std::set
+  template <class T, class SET = std::set<typename ToBuildable<T>::value_type>>
+  struct CppBuilderSetHelper
+  {
+    typedef SET value_type;
+    typedef std::vector<typename ToBuildable<T>::value_type> buffer_type;
+
+    PyObject *pyo;
+
+    explicit CppBuilderSetHelper(PyObject* pyo) : pyo(pyo)
+    {}
+
+    static value_type fromBuffer(buffer_type& items)
+    {
+      std::sort(items.begin(), items.end());
+      value_type s;
+      for (auto& item : items)
+      {
+        s.emplace_hint(s.end(), std::move(item));
+      }
+      return s;
+    }
+
+    value_type build() const
+    {
+      ToBuildable<T> builder;
+      buffer_type items;
+      items.reserve(PySet_GET_SIZE(pyo));
+      Py_ssize_t pos { 0 };
+      PyObject* key;
+      long hash;
+      while (_PySet_NextEntry(pyo, &pos, &key, &hash))
+      {
+        items.push_back(builder(key));
+      }
+      return fromBuffer(items);
+    }
+    
+    bool eligible() const
+    {
+      ToBuildable<T> builder;
+      Py_ssize_t pos { 0 };
+      PyObject* key;
+      long hash;
+      while (_PySet_NextEntry(pyo, &pos, &key, &hash))
+      {
+        if (! builder.eligible(key))
+        {
+          return false;
+        }
+      }
+      return true;
+    }
+
+    Optional<value_type> tryBuild() const
+    {
+      ToBuildable<T> builder;
+      buffer_type items;
+      items.reserve(PySet_GET_SIZE(pyo));
+      Py_ssize_t pos { 0 };
+      PyObject* key;
+      long hash;
+      while (_PySet_NextEntry(pyo, &pos, &key, &hash))
+      {
+        Optional<typename ToBuildable<T>::value_type> item { builder.try_build(key) };
+        if (! item)
+        {
+          _ConversionTrail::atKey(key);
+          return Optional<value_type>();
+        }
+        items.push_back(std::move(*item));
+      }
+      return fromBuffer(items);
+    }
+  };
+}
+
+template <class T, class COMPARE, class ALLOC>
+struct CppBuilder<std::set<T, COMPARE, ALLOC>>
+{
+  typedef typename ToBuildable<T>::value_type key_type;
+  typedef std::set<key_type, typename _RebindLess<COMPARE, key_type>::type, _RebindAlloc<ALLOC, key_type>> value_type;
+  value_type operator() (PyObject* pyo) const
+  {
+    assert(pyo);
+    _StatsScope<CppBuilder> stats;
+    if (PyAnySet_Check(pyo))
+    {
+      stats.elements(PySet_GET_SIZE(pyo));
+      CppBuilderSetHelper<T, value_type> helper(pyo);
+      return helper.build();
+    }
+    throw std::invalid_argument("Neither a PySet nor a PyFrozenSet instance");
+  }
+  bool eligible(PyObject* pyo) const
+  {
+    if (! PyAnySet_Check(pyo))
+    {
+      return _rejected<CppBuilder>();
+    }
+    CppBuilderSetHelper<T, value_type> helper(pyo);
+    return helper.eligible() || _rejected<CppBuilder>();
+  }
+  Optional<value_type> try_build(PyObject* pyo) const
+  {
+    if (! PyAnySet_Check(pyo))
+    {
+      return _rejectedHere<CppBuilder>();
+    }
+    _StatsScope<CppBuilder> stats;
+    stats.elements(PySet_GET_SIZE(pyo));
+    CppBuilderSetHelper<T, value_type> helper(pyo);
+    return _tried<CppBuilder>(helper.tryBuild());
+  }
+  void build_into(value_type& out, PyObject* pyo) const
+  {
+    assert(pyo);
+    _StatsScope<CppBuilder> stats;
+    if (! PyAnySet_Check(pyo))
+    {
+      throw std::invalid_argument("Neither a PySet nor a PyFrozenSet instance");
+    }
+    stats.elements(PySet_GET_SIZE(pyo));
+    if (out.empty())
+    {
+      out = CppBuilderSetHelper<T, value_type>(pyo).build();
+    }
+    else
+    {
+      _updateSet(out, ToBuildable<T>(), pyo);
+    }
+  }
+};
+template <class T, class COMPARE, class ALLOC> struct ToBuildable<std::set<T, COMPARE, ALLOC>> : CppBuilder<std::set<T, COMPARE, ALLOC>> {};
+
+/**
+ * Map builder
+ */
+
+// keys of out missing from pyo (a dict) are erased
+// mapped values of the existing keys are updated in place
+template <class MAP, class KEY_BUILDER, class VALUE_BUILDER>
+static inline void _updateMap(MAP& out, KEY_BUILDER const& keyBuilder, VALUE_BUILDER const& valueBuilder, PyObject* pyo)
+{
+  _MatchedScope matched;
+  typename MAP::key_type cppKey;
+  PyObject *key, *value;
+  Py_ssize_t pos = 0;
+  while (PyDict_Next(pyo, &pos, &key, &value))
+  {
+    _buildInto(keyBuilder, cppKey, key);
+    auto it = out.find(cppKey);
+    if (it == out.end())
+    {
+      it = out.emplace(std::move(cppKey), valueBuilder(value)).first;
+    }
+    else
+    {
+      _buildInto(valueBuilder, it->second, value);
+    }
+    matched.add(&*it);
+  }
+  matched.eraseUnmatched(out);
+}
+
+// when several Python keys give the same C++ key (eg.: '\xc3\xa9' and u'\xe9' for std::string)
+// the last one wins, as with operator[] and _updateMap
+template <class MAP>
+static inline void _emplaceLast(MAP& out, typename MAP::key_type&& key, typename MAP::mapped_type&& value)
+{
+  auto it = out.find(key);
+  if (it == out.end())
+  {
+    out.emplace(std::move(key), std::move(value));
+  }
+  else
+  {
+    it->second = std::move(value);
+  }
+}
+
+namespace
+{
+  // Entries of the dict are converted into a reserved buffer, sorted once by key
+  // and appended to the std::map with end hints
+  // It avoids the default construction, full tree search and move assignment
+  // of each mapped value done by std::map::operator[]
+  template <class K, class T, class MAP = std::map<typename ToBuildable<K>::value_type, typename ToBuildable<T>::value_type>>
+  struct CppBuilderMapHelper
+  {
+    typedef MAP value_type;
+    typedef std::pair<typename ToBuildable<K>::value_type, typename ToBuildable<T>::value_type> entry_type;
+    typedef std::vector<entry_type> buffer_type;
+
+    PyObject *pyo;
+
+    explicit CppBuilderMapHelper(PyObject* pyo) : pyo(pyo)
+    {}
+
+    // entries are in the order of the dict: when several Python keys give the same C++ key
+    // (eg.: '\xc3\xa9' and u'\xe9' for std::string) the last one wins, as with std::map::operator[]
+    static value_type fromBuffer(buffer_type& entries)
+    {
+      std::stable_sort(entries.begin(), entries.end(), compare);
+      return fromSorted(entries);
+    }
+
+    static bool compare(entry_type const& e1, entry_type const& e2)
+    {
+      return typename value_type::key_compare()(e1.first, e2.first);
+    }
+
+    // entries sorted by key, entries with equivalent keys being in the order of the dict
+    static value_type fromSorted(buffer_type& entries)
+    {
+      value_type dict;
+      for (auto& entry : entries)
+      {
+        if (! dict.empty() && ! dict.key_comp()(std::prev(dict.end())->first, entry.first))
+        {
+          std::prev(dict.end())->second = std::move(entry.second);
+        }
+        else
+        {
+          dict.emplace_hint(dict.end(), std::move(entry.first), std::move(entry.second));
+        }
+      }
+      return dict;
+    }
+
+    value_type build() const
+    {
+      ToBuildable<K> keyBuilder;
+      ToBuildable<T> valueBuilder;
+      buffer_type entries;
+      entries.reserve(PyDict_Size(pyo));
+      PyObject *key, *value;
+      Py_ssize_t pos = 0;
+      while (PyDict_Next(pyo, &pos, &key, &value))
+      {
+        entries.emplace_back(keyBuilder(key), valueBuilder(value));
+      }
+      return fromBuffer(entries);
+    }
+
+    bool eligible() const
+    {
+      ToBuildable<K> keyBuilder;
+      ToBuildable<T> valueBuilder;
+      PyObject *key, *value;
+      Py_ssize_t pos = 0;
+      while (PyDict_Next(pyo, &pos, &key, &value))
+      {
+        if (! keyBuilder.eligible(key) || ! valueBuilder.eligible(value))
+        {
+          return false;
+        }
+      }
+      return true;
+    }
+
+    Optional<value_type> tryBuild() const
+    {
+      ToBuildable<K> keyBuilder;
+      ToBuildable<T> valueBuilder;
+      buffer_type entries;
+      entries.reserve(PyDict_Size(pyo));
+      PyObject *key, *value;
+      Py_ssize_t pos = 0;
+      while (PyDict_Next(pyo, &pos, &key, &value))
+      {
+        Optional<typename ToBuildable<K>::value_type> cppKey { keyBuilder.try_build(key) };
+        if (! cppKey)
+        {
+          _ConversionTrail::atKey(key);
+          return Optional<value_type>();
+        }
+        Optional<typename ToBuildable<T>::value_type> cppValue { valueBuilder.try_build(value) };
+        if (! cppValue)
+        {
+          _ConversionTrail::atItem(key);
+          return Optional<value_type>();
+        }
+        entries.emplace_back(std::move(*cppKey), std::move(*cppValue));
+      }
+      return fromBuffer(entries);
+    }
+  };
+}
+
+template <class K, class T, class COMPARE, class ALLOC>
+struct CppBuilder<std::map<K, T, COMPARE, ALLOC>>
+{
+  typedef typename ToBuildable<K>::value_type key_type;
+  typedef typename ToBuildable<T>::value_type mapped_type;
+  typedef std::map<key_type, mapped_type, typename _RebindLess<COMPARE, key_type>::type
+      , _RebindAlloc<ALLOC, std::pair<const key_type, mapped_type>>> value_type;
+  value_type operator() (PyObject* pyo) const
+  {
+    assert(pyo);
+    _StatsScope<CppBuilder> stats;
+    if (PyDict_Check(pyo))
+    {
+      stats.elements(PyDict_Size(pyo));
+      CppBuilderMapHelper<K, T, value_type> helper(pyo);
+      return helper.build();
+    }
+    throw std::invalid_argument("Not a PyDict instance");
+  }
+  bool eligible(PyObject* pyo) const
+  {
+    if (! PyDict_Check(pyo))
+    {
+      return _rejected<CppBuilder>();
+    }
+    CppBuilderMapHelper<K, T, value_type> helper(pyo);
+    return helper.eligible() || _rejected<CppBuilder>();
+  }
+  Optional<value_type> try_build(PyObject* pyo) const
+  {
+    if (! PyDict_Check(pyo))
+    {
+      return _rejectedHere<CppBuilder>();
+    }
+    _StatsScope<CppBuilder> stats;
+    stats.elements(PyDict_Size(pyo));
+    CppBuilderMapHelper<K, T, value_type> helper(pyo);
+    return _tried<CppBuilder>(helper.tryBuild());
+  }
+  void build_into(value_type& out, PyObject* pyo) const
+  {
+    assert(pyo);
+    _StatsScope<CppBuilder> stats;
+    if (! PyDict_Check(pyo))
+    {
+      throw std::invalid_argument("Not a PyDict instance");
+    }
+    stats.elements(PyDict_Size(pyo));
+    if (out.empty())
+    {
+      out = CppBuilderMapHelper<K, T, value_type>(pyo).build();
+    }
+    else
+    {
+      _updateMap(out, ToBuildable<K>(), ToBuildable<T>(), pyo);
+    }
+  }
+};
+template <class K, class T, class COMPARE, class ALLOC> struct ToBuildable<std::map<K, T, COMPARE, ALLOC>> : CppBuilder<std::map<K, T, COMPARE, ALLOC>> {};
+
+/**
+ * Unordered containers builders
+ */
+
+static inline std::size_t _combineHash(std::size_t seed, std::size_t hash)
+{
+  return seed ^ (hash + 0x9e3779b9 + (seed << 6) + (seed >> 2));
+}
+
+// Hash<T> is the hash functor used for the keys of the unordered containers
+// built by CppBuilder: std::hash<T> extended to std::pair, std::tuple and ArenaString
+template <class T> struct Hash;
+
+template <class T>
+struct HashOf
+{
+  typedef std::hash<T> type;
+};
+template <class T1, class T2>
+struct HashOf<std::pair<T1,T2>>
+{
+  typedef Hash<std::pair<T1,T2>> type;
+};
+template <class... Args>
+struct HashOf<std::tuple<Args...>>
+{
+  typedef Hash<std::tuple<Args...>> type;
+};
+template <class CHAR>
+struct HashOf<std::basic_string<CHAR, std::char_traits<CHAR>, ArenaAllocator<CHAR>>>
+{
+  typedef Hash<std::basic_string<CHAR, std::char_traits<CHAR>, ArenaAllocator<CHAR>>> type;
+};
+
+template <class T1, class T2>
+struct Hash<std::pair<T1,T2>>
+{
+  std::size_t operator() (std::pair<T1,T2> const& value) const
+  {
+    return _combineHash(typename HashOf<T1>::type()(value.first), typename HashOf<T2>::type()(value.second));
+  }
+};
+
+template <class... Args>
+struct Hash<std::tuple<Args...>>
+{
+  std::size_t operator() (std::tuple<Args...> const& value) const
+  {
+    return combine(value, typename _MakeIndexSequence<sizeof...(Args)>::type());
+  }
+
+private:
+  template <std::size_t... Is>
+  static std::size_t combine(std::tuple<Args...> const& value, _IndexSequence<Is...>)
+  {
+    std::size_t seed { 0 };
+    int dummy[] = { 0, (seed = _combineHash(seed, typename HashOf<Args>::type()(std::get<Is>(value))), 0)... };
+    (void)dummy;
+    return seed;
+  }
+};
+
+// std::hash is only defined for strings using std::allocator
+template <class CHAR>
+struct Hash<std::basic_string<CHAR, std::char_traits<CHAR>, ArenaAllocator<CHAR>>>
+{
+  std::size_t operator() (std::basic_string<CHAR, std::char_traits<CHAR>, ArenaAllocator<CHAR>> const& value) const
+  {
+    return _hashBytes(value.data(), value.size() * sizeof(CHAR));
+  }
+};
+
+template <class T, class V> struct _RebindHash<std::hash<T>, V> { typedef typename HashOf<V>::type type; };
+
+template <class K, class T, class HASH, class EQUAL, class ALLOC>
+struct CppBuilder<std::unordered_map<K, T, HASH, EQUAL, ALLOC>>
+{
+  typedef typename ToBuildable<K>::value_type key_type;
+  typedef typename ToBuildable<T>::value_type mapped_type;
+  typedef std::unordered_map<key_type, mapped_type, typename _RebindHash<HASH, key_type>::type, typename _RebindEqual<EQUAL, key_type>::type
+      , _RebindAlloc<ALLOC, std::pair<const key_type, mapped_type>>> value_type;
+  value_type operator() (PyObject* pyo) const
+  {
+    assert(pyo);
+    _StatsScope<CppBuilder> stats;
+    if (PyDict_Check(pyo))
+    {
+      stats.elements(PyDict_Size(pyo));
+      return build(pyo);
+    }
+    throw std::invalid_argument("Not a PyDict instance");
+  }
+  bool eligible(PyObject* pyo) const
+  {
+    if (! PyDict_Check(pyo))
+    {
+      return _rejected<CppBuilder>();
+    }
+    CppBuilderMapHelper<K,T> helper(pyo);
+    return helper.eligible() || _rejected<CppBuilder>();
+  }
+  Optional<value_type> try_build(PyObject* pyo) const
+  {
+    if (! PyDict_Check(pyo))
+    {
+      return _rejectedHere<CppBuilder>();
+    }
+    _StatsScope<CppBuilder> stats;
+    stats.elements(PyDict_Size(pyo));
+    ToBuildable<K> keyBuilder;
+    ToBuildable<T> valueBuilder;
+    value_type dict;
+    dict.reserve(PyDict_Size(pyo));
+    PyObject *key, *value;
+    Py_ssize_t pos = 0;
+    while (PyDict_Next(pyo, &pos, &key, &value))
+    {
+      Optional<typename ToBuildable<K>::value_type> cppKey { keyBuilder.try_build(key) };
+      if (! cppKey)
+      {
+        _ConversionTrail::atKey(key);
+        return _rejected<CppBuilder>();
+      }
+      Optional<typename ToBuildable<T>::value_type> cppValue { valueBuilder.try_build(value) };
+      if (! cppValue)
+      {
+        _ConversionTrail::atItem(key);
+        return _rejected<CppBuilder>();
+      }
+      _emplaceLast(dict, std::move(*cppKey), std::move(*cppValue));
+    }
+    return std::move(dict);
+  }
+  void build_into(value_type& out, PyObject* pyo) const
+  {
+    assert(pyo);
+    _StatsScope<CppBuilder> stats;
+    if (! PyDict_Check(pyo))
+    {
+      throw std::invalid_argument("Not a PyDict instance");
+    }
+    stats.elements(PyDict_Size(pyo));
+    if (out.empty())
+    {
+      out = build(pyo);
+    }
+    else
+    {
+      _updateMap(out, ToBuildable<K>(), ToBuildable<T>(), pyo);
+    }
+  }
+
+private:
+  static value_type build(PyObject* pyo)
+  {
+    ToBuildable<K> keyBuilder;
+    ToBuildable<T> valueBuilder;
+    value_type dict;
+    dict.reserve(PyDict_Size(pyo));
+    PyObject *key, *value;
+    Py_ssize_t pos = 0;
+    while (PyDict_Next(pyo, &pos, &key, &value))
+    {
+      _emplaceLast(dict, keyBuilder(key), valueBuilder(value));
+    }
+    return dict;
+  }
+};
+template <class K, class T, class HASH, class EQUAL, class ALLOC> struct ToBuildable<std::unordered_map<K, T, HASH, EQUAL, ALLOC>> : CppBuilder<std::unordered_map<K, T, HASH, EQUAL, ALLOC>> {};
+
+template <class T, class HASH, class EQUAL, class ALLOC>
+struct CppBuilder<std::unordered_set<T, HASH, EQUAL, ALLOC>>
+{
+  typedef typename ToBuildable<T>::value_type key_type;
+  typedef std::unordered_set<key_type, typename _RebindHash<HASH, key_type>::type, typename _RebindEqual<EQUAL, key_type>::type
+      , _RebindAlloc<ALLOC, key_type>> value_type;
+  value_type operator() (PyObject* pyo) const
+  {
+    assert(pyo);
+    _StatsScope<CppBuilder> stats;
+    if (PyAnySet_Check(pyo))
+    {
+      stats.elements(PySet_GET_SIZE(pyo));
+      return build(pyo);
+    }
+    throw std::invalid_argument("Neither a PySet nor a PyFrozenSet instance");
+  }
+  bool eligible(PyObject* pyo) const
+  {
+    if (! PyAnySet_Check(pyo))
+    {
+      return _rejected<CppBuilder>();
+    }
+    CppBuilderSetHelper<T> helper(pyo);
+    return helper.eligible() || _rejected<CppBuilder>();
+  }
+  Optional<value_type> try_build(PyObject* pyo) const
+  {
+    if (! PyAnySet_Check(pyo))
+    {
+      return _rejectedHere<CppBuilder>();
+    }
+    _StatsScope<CppBuilder> stats;
+    stats.elements(PySet_GET_SIZE(pyo));
+    ToBuildable<T> builder;
+    value_type s;
+    s.reserve(PySet_GET_SIZE(pyo));
+    Py_ssize_t pos { 0 };
+    PyObject* key;
+    long hash;
+    while (_PySet_NextEntry(pyo, &pos, &key, &hash))
+    {
+      Optional<typename ToBuildable<T>::value_type> item { builder.try_build(key) };
+      if (! item)
+      {
+        _ConversionTrail::atKey(key);
+        return _rejected<CppBuilder>();
+      }
+      s.insert(std::move(*item));
+    }
+    return std::move(s);
+  }
+  void build_into(value_type& out, PyObject* pyo) const
+  {
+    assert(pyo);
+    _StatsScope<CppBuilder> stats;
+    if (! PyAnySet_Check(pyo))
+    {
+      throw std::invalid_argument("Neither a PySet nor a PyFrozenSet instance");
+    }
+    stats.elements(PySet_GET_SIZE(pyo));
+    if (out.empty())
+    {
+      out = build(pyo);
+    }
+    else
+    {
+      _updateSet(out, ToBuildable<T>(), pyo);
+    }
+  }
+
+private:
+  static value_type build(PyObject* pyo)
+  {
+    ToBuildable<T> builder;
+    value_type s;
+    s.reserve(PySet_GET_SIZE(pyo));
+    Py_ssize_t pos { 0 };
+    PyObject* key;
+    long hash;
+    while (_PySet_NextEntry(pyo, &pos, &key, &hash))
+    {
+      s.insert(builder(key));
+    }
+    return s;
+  }
+};
+template <class T, class HASH, class EQUAL, class ALLOC> struct ToBuildable<std::unordered_set<T, HASH, EQUAL, ALLOC>> : CppBuilder<std::unordered_set<T, HASH, EQUAL, ALLOC>> {};
+
+/**
+ * Arena sizing pre-pass
+ */
+
+inline std::size_t ArenaEstimate::size() const
+{
+  return bytes + allocations * alignof(std::max_align_t);
+}
+
+template <class ALLOC> struct _IsArenaAlloc : std::false_type {};
+template <class T> struct _IsArenaAlloc<ArenaAllocator<T>> : std::true_type {};
+
+// Only the memory requested through an ArenaAllocator is counted
+// Node sizes are estimated from libstdc++'s layout, an arena grows anyway if the estimate is too small
+template <class T>
+struct _ArenaSizer
+{
+  static void add(PyObject*, ArenaEstimate&) {}
+};
+
+// count allocations of bytes each
+template <class ALLOC>
+static inline void _addArenaBlocks(ArenaEstimate& estimate, std::size_t count, std::size_t bytes)
+{
+  if (_IsArenaAlloc<ALLOC>::value && bytes != 0)
+  {
+    estimate.allocations += count;
+    estimate.bytes += count * bytes;
+  }
+}
+
+template <class CHAR, class ALLOC>
+struct _ArenaSizer<std::basic_string<CHAR, std::char_traits<CHAR>, ALLOC>>
+{
+  static void add(PyObject* pyo, ArenaEstimate& estimate)
+  {
+    // small strings may not allocate at all: counted anyway
+    if (PyString_Check(pyo))
+    {
+      _addArenaBlocks<ALLOC>(estimate, 1, (PyString_GET_SIZE(pyo) +1) * sizeof(CHAR));
+    }
+    else if (PyUnicode_Check(pyo))
+    {
+      std::size_t size { static_cast<std::size_t>(PyUnicode_GET_SIZE(pyo)) };
+      _addArenaBlocks<ALLOC>(estimate, 1, (size +1) * sizeof(CHAR));
+      if (sizeof(CHAR) == 1)
+      {
+        // UTF-8 encoding of non-ASCII strings resizes the buffer once: up to 4 bytes per code point
+        _addArenaBlocks<ALLOC>(estimate, 1, 4 * size +1);
+      }
+    }
+  }
+};
+
+template <class... Args>
+struct _ArenaSizer<std::tuple<Args...>>
+{
+  static void add(PyObject* pyo, ArenaEstimate& estimate)
+  {
+    if (PyTuple_Check(pyo) && PyTuple_GET_SIZE(pyo) == sizeof...(Args))
+    {
+      addItems(pyo, estimate, typename _MakeIndexSequence<sizeof...(Args)>::type());
+    }
+  }
+
+private:
+  template <std::size_t... Is>
+  static void addItems(PyObject* pyo, ArenaEstimate& estimate, _IndexSequence<Is...>)
+  {
+    int dummy[] = { 0, (_ArenaSizer<Args>::add(PyTuple_GET_ITEM(pyo, Is), estimate), 0)... };
+    (void)dummy;
+  }
+};
+
+template <class T, class ALLOC>
+struct _ArenaSizer<std::vector<T, ALLOC>>
+{
+  static void add(PyObject* pyo, ArenaEstimate& estimate)
+  {
+    if (! PyList_Check(pyo) && ! PyTuple_Check(pyo))
+    {
+      return;
+    }
+    std::unique_ptr<PyObject, decref> seq { PySequence_Fast(pyo, "Neither a PyList nor a PyTuple instance") };
+    PyObject** it { PySequence_Fast_ITEMS(seq.get()) };
+    PyObject** end { it + PySequence_Fast_GET_SIZE(seq.get()) };
+    _addArenaBlocks<ALLOC>(estimate, 1, (end - it) * sizeof(typename ToBuildable<T>::value_type));
+    for ( ; it != end ; ++it)
+    {
+      _ArenaSizer<T>::add(*it, estimate);
+    }
+  }
+};
+
+// one allocation per node: red-black tree header (color and 3 pointers) followed by the value
+template <class ALLOC, class V>
+static inline void _addArenaTreeNodes(ArenaEstimate& estimate, std::size_t count)
+{
+  _addArenaBlocks<ALLOC>(estimate, count, 4 * sizeof(void*) + sizeof(V));
+}
+
+// one allocation per node: next pointer, value and cached hash
+// plus the bucket array allocated by reserve()
+template <class ALLOC, class V>
+static inline void _addArenaHashNodes(ArenaEstimate& estimate, std::size_t count)
+{
+  _addArenaBlocks<ALLOC>(estimate, count, 2 * sizeof(void*) + sizeof(V));
+  _addArenaBlocks<ALLOC>(estimate, 1, 2 * (count +1) * sizeof(void*));
+}
+
+template <class SIZER>
+static inline void _addArenaSetItems(PyObject* pyo, ArenaEstimate& estimate)
+{
+  Py_ssize_t pos { 0 };
+  PyObject* key;
+  long hash;
+  while (_PySet_NextEntry(pyo, &pos, &key, &hash))
+  {
+    SIZER::add(key, estimate);
+  }
+}
+
+template <class KSIZER, class TSIZER>
+static inline void _addArenaDictItems(PyObject* pyo, ArenaEstimate& estimate)
+{
+  PyObject *key, *value;
+  Py_ssize_t pos = 0;
+  while (PyDict_Next(pyo, &pos, &key, &value))
+  {
+    KSIZER::add(key, estimate);
+    TSIZER::add(value, estimate);
+  }
+}
+
+template <class T, class COMPARE, class ALLOC>
+struct _ArenaSizer<std::set<T, COMPARE, ALLOC>>
+{
+  static void add(PyObject* pyo, ArenaEstimate& estimate)
+  {
+    if (PyAnySet_Check(pyo))
+    {
+      _addArenaTreeNodes<ALLOC, typename ToBuildable<T>::value_type>(estimate, PySet_GET_SIZE(pyo));
+      _addArenaSetItems<_ArenaSizer<T>>(pyo, estimate);
+    }
+  }
+};
+
+template <class K, class T, class COMPARE, class ALLOC>
+struct _ArenaSizer<std::map<K, T, COMPARE, ALLOC>>
+{
+  static void add(PyObject* pyo, ArenaEstimate& estimate)
+  {
+    if (PyDict_Check(pyo))
+    {
+      typedef std::pair<const typename ToBuildable<K>::value_type, typename ToBuildable<T>::value_type> node_value;
+      _addArenaTreeNodes<ALLOC, node_value>(estimate, PyDict_Size(pyo));
+      _addArenaDictItems<_ArenaSizer<K>, _ArenaSizer<T>>(pyo, estimate);
+    }
+  }
+};
+
+template <class T, class HASH, class EQUAL, class ALLOC>
+struct _ArenaSizer<std::unordered_set<T, HASH, EQUAL, ALLOC>>
+{
+  static void add(PyObject* pyo, ArenaEstimate& estimate)
+  {
+    if (PyAnySet_Check(pyo))
+    {
+      _addArenaHashNodes<ALLOC, typename ToBuildable<T>::value_type>(estimate, PySet_GET_SIZE(pyo));
+      _addArenaSetItems<_ArenaSizer<T>>(pyo, estimate);
+    }
+  }
+};
+
+template <class K, class T, class HASH, class EQUAL, class ALLOC>
+struct _ArenaSizer<std::unordered_map<K, T, HASH, EQUAL, ALLOC>>
+{
+  static void add(PyObject* pyo, ArenaEstimate& estimate)
+  {
+    if (PyDict_Check(pyo))
+    {
+      typedef std::pair<const typename ToBuildable<K>::value_type, typename ToBuildable<T>::value_type> node_value;
+      _addArenaHashNodes<ALLOC, node_value>(estimate, PyDict_Size(pyo));
+      _addArenaDictItems<_ArenaSizer<K>, _ArenaSizer<T>>(pyo, estimate);
+    }
+  }
+};
+
+template <class T>
+ArenaEstimate estimate_arena(PyObject* pyo)
+{
+  assert(pyo);
+  ArenaEstimate estimate { 0, 0 };
+  _ArenaSizer<T>::add(pyo, estimate);
+  return estimate;
+}
+
+/**
+ * Buffer builders
+ */
+
+enum class BufferKind { Signed, Unsigned, Floating, Boolean, Character, Other };
+
+template <class T>
+struct BufferKindOf
+{
+  static constexpr BufferKind value = std::is_same<T, bool>::value ? BufferKind::Boolean
+      : std::is_same<T, char>::value ? BufferKind::Character
+      : std::is_floating_point<T>::value ? BufferKind::Floating
+      : std::is_signed<T>::value ? BufferKind::Signed
+      : std::is_unsigned<T>::value ? BufferKind::Unsigned
+      : BufferKind::Other;
+};
+
+static inline bool _isLittleEndian()
+{
+  const std::uint16_t probe { 1 };
+  return *reinterpret_cast<const unsigned char*>(&probe) == 1;
+}
+
+static inline BufferKind _bufferKind(char format)
+{
+  switch (format)
+  {
+    case 'b': case 'h': case 'i': case 'l': case 'q': case 'n':
+      return BufferKind::Signed;
+    case 'B': case 'H': case 'I': case 'L': case 'Q': case 'N':
+      return BufferKind::Unsigned;
+    case 'f': case 'd':
+      return BufferKind::Floating;
+    case '?':
+      return BufferKind::Boolean;
+    case 'c':
+      return BufferKind::Character;
+  }
+  return BufferKind::Other;
+}
+
+// true if the items described by the Py_buffer can be read as T
+// format string has to describe a single native-endian scalar of size sizeof(T)
+template <class T>
+static inline bool _bufferMatches(Py_buffer const& view)
+{
+  if (view.itemsize != sizeof(T))
+  {
+    return false;
+  }
+  const char* format { view.format ? view.format : "B" };
+  switch (*format)
+  {
+    case '@': case '=':
+      ++format;
+      break;
+    case '<':
+      if (! _isLittleEndian()) { return false; }
+      ++format;
+      break;
+    case '>': case '!':
+      if (_isLittleEndian()) { return false; }
+      ++format;
+      break;
+  }
+  if (format[0] == '\0' || format[1] != '\0')
+  {
+    return false;
+  }
+  BufferKind kind { _bufferKind(format[0]) };
+  if (BufferKindOf<T>::value == BufferKind::Character)
+  {
+    return kind == BufferKind::Character || kind == BufferKind::Signed || kind == BufferKind::Unsigned;
+  }
+  return kind == BufferKindOf<T>::value;
+}
+
+// Acquire a C-contiguous read-only buffer compatible with T
+// On success the caller is responsible for releasing the buffer
+template <class T>
+static inline bool _acquireBuffer(PyObject* pyo, Py_buffer& view)
+{
+  if (! PyObject_CheckBuffer(pyo))
+  {
+    return false;
+  }
+  if (PyObject_GetBuffer(pyo, &view, PyBUF_C_CONTIGUOUS | PyBUF_FORMAT) != 0)
+  {
+    PyErr_Clear();
+    return false;
+  }
+  if (! _bufferMatches<T>(view))
+  {
+    PyBuffer_Release(&view);
+    return false;
+  }
+  return true;
+}
+
+template <class T>
+class BufferView
+{
+  static_assert(std::is_arithmetic<T>::value, "BufferView<T> only supports arithmetic types");
+
+  Py_buffer view;
+  bool acquired;
+
+public:
+  typedef T value_type;
+  typedef const T* const_iterator;
+
+  BufferView() : view(), acquired(false) {}
+  explicit BufferView(Py_buffer const& acquiredView) : view(acquiredView), acquired(true) {}
+  BufferView(BufferView const&) = delete;
+  BufferView(BufferView&& other) : view(other.view), acquired(other.acquired)
+  {
+    other.acquired = false;
+  }
+  BufferView& operator=(BufferView const&) = delete;
+  BufferView& operator=(BufferView&& other)
+  {
+    if (this != &other)
+    {
+      release();
+      view = other.view;
+      acquired = other.acquired;
+      other.acquired = false;
+    }
+    return *this;
+  }
+  ~BufferView()
+  {
+    release();
+  }
+
+  void release()
+  {
+    if (acquired)
+    {
+      PyBuffer_Release(&view);
+      acquired = false;
+    }
+  }
+
+  PyObject* owner() const { return acquired ? view.obj : nullptr; }
+  const T* data() const { return acquired ? static_cast<const T*>(view.buf) : nullptr; }
+  std::size_t size() const { return acquired ? static_cast<std::size_t>(view.len / view.itemsize) : 0; }
+  bool empty() const { return size() == 0; }
+  const_iterator begin() const { return data(); }
+  const_iterator end() const { return data() + size(); }
+  const T& operator[] (std::size_t pos) const { return data()[pos]; }
+};
+
+template <class T>
+struct CppBuilder<BufferView<T>>
+{
+  typedef BufferView<T> value_type;
+  value_type operator() (PyObject* pyo) const
+  {
+    assert(pyo);
+    _StatsScope<CppBuilder> stats;
+    Py_buffer view;
+    if (_acquireBuffer<T>(pyo, view))
+    {
+      value_type out(view);
+      stats.elements(out.size());
+      return out;
+    }
+    throw std::invalid_argument("Not a PyObject exporting a compatible buffer");
+  }
+  bool eligible(PyObject* pyo) const
+  {
+    Py_buffer view;
+    if (! _acquireBuffer<T>(pyo, view))
+    {
+      return _rejected<CppBuilder>();
+    }
+    PyBuffer_Release(&view);
+    return true;
+  }
+  Optional<value_type> try_build(PyObject* pyo) const
+  {
+    Py_buffer view;
+    if (! _acquireBuffer<T>(pyo, view))
+    {
+      return _rejectedHere<CppBuilder>();
+    }
+    _StatsScope<CppBuilder> stats;
+    value_type out(view);
+    stats.elements(out.size());
+    return std::move(out);
+  }
+  void build_into(value_type& out, PyObject* pyo) const
+  {
+    out = (*this)(pyo);
+  }
+};
+template <class T> struct ToBuildable<BufferView<T>> : CppBuilder<BufferView<T>> {};
+
+template <class T>
+struct CppBuilder<FromBuffer<T>>
+{
+  typedef std::vector<T> value_type;
+  value_type operator() (PyObject* pyo) const
+  {
+    assert(pyo);
+    _StatsScope<CppBuilder> stats;
+    BufferView<T> view { CppBuilder<BufferView<T>>()(pyo) };
+    stats.elements(view.size());
+    return value_type(view.begin(), view.end());
+  }
+  bool eligible(PyObject* pyo) const
+  {
+    return CppBuilder<BufferView<T>>().eligible(pyo) || _rejected<CppBuilder>();
+  }
+  Optional<value_type> try_build(PyObject* pyo) const
+  {
+    Optional<BufferView<T>> view { CppBuilder<BufferView<T>>().try_build(pyo) };
+    if (! view)
+    {
+      return _rejected<CppBuilder>();
+    }
+    _StatsScope<CppBuilder> stats;
+    stats.elements(view->size());
+    return value_type(view->begin(), view->end());
+  }
+  void build_into(value_type& out, PyObject* pyo) const
+  {
+    assert(pyo);
+    _StatsScope<CppBuilder> stats;
+    BufferView<T> view { CppBuilder<BufferView<T>>()(pyo) };
+    stats.elements(view.size());
+    out.assign(view.begin(), view.end());
+  }
+};
+template <class T> struct ToBuildable<FromBuffer<T>> : CppBuilder<FromBuffer<T>> {};
+
+template <class T, std::size_t N>
+class NdArray
+{
+  static_assert(std::is_arithmetic<T>::value, "NdArray<T,N> only supports arithmetic types");
+  static_assert(N != 0, "NdArray<T,N> needs at least one dimension");
+
+  Py_buffer view;
+  bool acquired;
+  std::vector<T> values; // gathered copy when the buffer was not C-contiguous
+  std::array<std::size_t, N> dims;
+
+public:
+  typedef T value_type;
+  typedef const T* const_iterator;
+
+  NdArray() : view(), acquired(false), values(), dims() {}
+  // takes ownership of a C-contiguous buffer
+  explicit NdArray(Py_buffer const& acquiredView) : view(acquiredView), acquired(true), values(), dims()
+  {
+    for (std::size_t dim { 0 } ; dim != N ; ++dim)
+    {
+      dims[dim] = static_cast<std::size_t>(view.shape ? view.shape[dim] : view.len / view.itemsize);
+    }
+  }
+  NdArray(std::array<std::size_t, N> const& shape, std::vector<T>&& values) : view(), acquired(false), values(std::move(values)), dims(shape) {}
+  NdArray(NdArray const&) = delete;
+  NdArray(NdArray&& other) : view(other.view), acquired(other.acquired), values(std::move(other.values)), dims(other.dims)
+  {
+    other.acquired = false;
+  }
+  NdArray& operator=(NdArray const&) = delete;
+  NdArray& operator=(NdArray&& other)
+  {
+    if (this != &other)
+    {
+      release();
+      view = other.view;
+      acquired = other.acquired;
+      values = std::move(other.values);
+      dims = other.dims;
+      other.acquired = false;
+    }
+    return *this;
+  }
+  ~NdArray()
+  {
+    release();
+  }
+
+  void release()
+  {
+    if (acquired)
+    {
+      PyBuffer_Release(&view);
+      acquired = false;
+      dims = std::array<std::size_t, N>();
+    }
+  }
+
+  // true if the data is still owned by the Python object
+  bool is_view() const { return acquired; }
+  PyObject* owner() const { return acquired ? view.obj : nullptr; }
+  const T* data() const { return acquired ? static_cast<const T*>(view.buf) : values.data(); }
+  std::array<std::size_t, N> const& shape() const { return dims; }
+  std::size_t shape(std::size_t dim) const { return dims[dim]; }
+  std::size_t size() const
+  {
+    std::size_t total { 1 };
+    for (std::size_t dim : dims)
+    {
+      total *= dim;
+    }
+    return total;
+  }
+  bool empty() const { return size() == 0; }
+  const_iterator begin() const { return data(); }
+  const_iterator end() const { return data() + size(); }
+  const T& operator[] (std::size_t pos) const { return data()[pos]; }
+
+  template <class... Indexes>
+  const T& operator() (Indexes... indexes) const
+  {
+    static_assert(sizeof...(Indexes) == N, "NdArray<T,N> needs N indexes");
+    const std::size_t index[] = { static_cast<std::size_t>(indexes)... };
+    std::size_t pos { 0 };
+    for (std::size_t dim { 0 } ; dim != N ; ++dim)
+    {
+      pos = pos * dims[dim] + index[dim];
+    }
+    return data()[pos];
+  }
+};
+
+// Acquire a N-dimensional read-only buffer of T, possibly strided
+// On success the caller is responsible for releasing the buffer
+template <class T, std::size_t N>
+static inline bool _acquireNdBuffer(PyObject* pyo, Py_buffer& view)
+{
+  if (! PyObject_CheckBuffer(pyo))
+  {
+    return false;
+  }
+  if (PyObject_GetBuffer(pyo, &view, PyBUF_RECORDS_RO) != 0)
+  {
+    PyErr_Clear();
+    return false;
+  }
+  if (view.ndim != static_cast<int>(N) || view.suboffsets || ! _bufferMatches<T>(view))
+  {
+    PyBuffer_Release(&view);
+    return false;
+  }
+  return true;
+}
+
+// Copy the items of a strided N-dimensional buffer into out, in row-major order
+template <class T, std::size_t N>
+static inline void _gatherStrided(Py_buffer const& view, T* out)
+{
+  std::size_t outer { 1 };
+  for (std::size_t dim { 0 } ; dim != N -1 ; ++dim)
+  {
+    outer *= static_cast<std::size_t>(view.shape[dim]);
+  }
+  const Py_ssize_t inner { view.shape[N -1] };
+  const Py_ssize_t innerStride { view.strides[N -1] };
+  if (outer == 0 || inner == 0)
+  {
+    return;
+  }
+  
+  std::array<Py_ssize_t, N> index {};
+  const char* row { static_cast<const char*>(view.buf) };
+  for (std::size_t line { 0 } ; line != outer ; ++line)
+  {
+    if (innerStride == static_cast<Py_ssize_t>(sizeof(T)))
+    {
+      std::memcpy(out, row, inner * sizeof(T));
+      out += inner;
+    }
+    else
+    {
+      const char* item { row };
+      for (Py_ssize_t pos { 0 } ; pos != inner ; ++pos, item += innerStride)
+      {
+        std::memcpy(out++, item, sizeof(T));
+      }
+    }
+    // next row: odometer on the outer dimensions
+    for (std::size_t dim { N -1 } ; dim != 0 ; --dim)
+    {
+      row += view.strides[dim -1];
+      if (++index[dim -1] != view.shape[dim -1])
+      {
+        break;
+      }
+      row -= view.strides[dim -1] * view.shape[dim -1];
+      index[dim -1] = 0;
+    }
+  }
+}
+
+// Build a NdArray from an acquired buffer, the buffer is released or owned by the result
+template <class T, std::size_t N>
+static inline NdArray<T, N> _ndArrayFromBuffer(Py_buffer& view)
+{
+  if (! view.strides || PyBuffer_IsContiguous(&view, 'C'))
+  {
+    return NdArray<T, N>(view);
+  }
+  std::array<std::size_t, N> shape;
+  std::size_t size { 1 };
+  for (std::size_t dim { 0 } ; dim != N ; ++dim)
+  {
+    shape[dim] = static_cast<std::size_t>(view.shape[dim]);
+    size *= shape[dim];
+  }
+  std::vector<T> values(size);
+  _gatherStrided<T, N>(view, values.data());
+  PyBuffer_Release(&view);
+  return NdArray<T, N>(shape, std::move(values));
+}
+
+template <class T, std::size_t N>
+struct CppBuilder<NdArray<T, N>>
+{
+  typedef NdArray<T, N> value_type;
+  value_type operator() (PyObject* pyo) const
+  {
+    assert(pyo);
+    _StatsScope<CppBuilder> stats;
+    Py_buffer view;
+    if (_acquireNdBuffer<T, N>(pyo, view))
+    {
+      value_type out { _ndArrayFromBuffer<T, N>(view) };
+      stats.elements(out.size());
+      return out;
+    }
+    throw std::invalid_argument("Not a PyObject exporting a compatible N-dimensional buffer");
+  }
+  bool eligible(PyObject* pyo) const
+  {
+    Py_buffer view;
+    if (! _acquireNdBuffer<T, N>(pyo, view))
+    {
+      return _rejected<CppBuilder>();
+    }
+    PyBuffer_Release(&view);
+    return true;
+  }
+  Optional<value_type> try_build(PyObject* pyo) const
+  {
+    Py_buffer view;
+    if (! _acquireNdBuffer<T, N>(pyo, view))
+    {
+      return _rejectedHere<CppBuilder>();
+    }
+    _StatsScope<CppBuilder> stats;
+    value_type out { _ndArrayFromBuffer<T, N>(view) };
+    stats.elements(out.size());
+    return std::move(out);
+  }
+  void build_into(value_type& out, PyObject* pyo) const
+  {
+    out = (*this)(pyo);
+  }
+};
+template <class T, std::size_t N> struct ToBuildable<NdArray<T, N>> : CppBuilder<NdArray<T, N>> {};
+
+/**
+ * Lazy views
+ */
+
+template <class T, bool MEMOIZE>
+class LazyVector
+{
+public:
+  typedef typename ToBuildable<T>::value_type value_type;
+  typedef typename std::conditional<MEMOIZE, value_type const&, value_type>::type reference;
+
+  class const_iterator
+  {
+    LazyVector const* view_;
+    std::size_t pos_;
+
+  public:
+    typedef std::input_iterator_tag iterator_category;
+    typedef typename LazyVector::value_type value_type;
+    typedef std::ptrdiff_t difference_type;
+    typedef const value_type* pointer;
+    typedef typename LazyVector::reference reference;
+
+    const_iterator(LazyVector const* view, std::size_t pos) : view_(view), pos_(pos) {}
+    reference operator*() const { return (*view_)[pos_]; }
+    const_iterator& operator++() { ++pos_; return *this; }
+    const_iterator operator++(int) { const_iterator previous(*this); ++pos_; return previous; }
+    bool operator==(const_iterator const& other) const { return pos_ == other.pos_; }
+    bool operator!=(const_iterator const& other) const { return pos_ != other.pos_; }
+  };
+
+private:
+  PyObject* owner_;
+  ToBuildable<T> builder_;
+  mutable std::deque<Optional<value_type>> memo_; // never moved: references handed out point into it
+
+  template <bool M = MEMOIZE>
+  typename std::enable_if<! M, reference>::type get(std::size_t pos) const
+  {
+    return builder_(PySequence_Fast_GET_ITEM(owner_, pos));
+  }
+  template <bool M = MEMOIZE>
+  typename std::enable_if<M, reference>::type get(std::size_t pos) const
+  {
+    if (memo_.size() <= pos)
+    {
+      memo_.resize(size());
+    }
+    Optional<value_type>& item { memo_[pos] };
+    if (! item)
+    {
+      item = builder_(PySequence_Fast_GET_ITEM(owner_, pos));
+    }
+    return *item;
+  }
+
+public:
+  LazyVector() : owner_(nullptr) {}
+
+  // steals the reference on a PyList or a PyTuple
+  explicit LazyVector(PyObject* pySequence) : owner_(pySequence)
+  {
+    assert(! owner_ || PyList_Check(owner_) || PyTuple_Check(owner_));
+  }
+  LazyVector(LazyVector const& other) : owner_(other.owner_), memo_(other.memo_)
+  {
+    Py_XINCREF(owner_);
+  }
+  LazyVector(LazyVector&& other) : owner_(other.owner_), memo_(std::move(other.memo_))
+  {
+    other.owner_ = nullptr;
+  }
+  LazyVector& operator=(LazyVector const& other)
+  {
+    if (this != &other)
+    {
+      Py_XINCREF(other.owner_);
+      Py_XDECREF(owner_);
+      owner_ = other.owner_;
+      memo_ = other.memo_;
+    }
+    return *this;
+  }
+  LazyVector& operator=(LazyVector&& other)
+  {
+    if (this != &other)
+    {
+      Py_XDECREF(owner_);
+      owner_ = other.owner_;
+      memo_ = std::move(other.memo_);
+      other.owner_ = nullptr;
+    }
+    return *this;
+  }
+  ~LazyVector()
+  {
+    Py_XDECREF(owner_);
+  }
+
+  PyObject* owner() const { return owner_; }
+  std::size_t size() const { return owner_ ? static_cast<std::size_t>(PySequence_Fast_GET_SIZE(owner_)) : 0; }
+  bool empty() const { return size() == 0; }
+  const_iterator begin() const { return const_iterator(this, 0); }
+  const_iterator end() const { return const_iterator(this, size()); }
+
+  // pos < size()
+  reference operator[] (std::size_t pos) const
+  {
+    assert(pos < size());
+    return get(pos);
+  }
+  reference at(std::size_t pos) const
+  {
+    if (pos >= size())
+    {
+      throw std::out_of_range("LazyVector index out of range");
+    }
+    return get(pos);
+  }
+  reference front() const { return (*this)[0]; }
+  reference back() const { return (*this)[size() -1]; }
+
+  // every item converted at once
+  std::vector<value_type> materialize() const
+  {
+    std::vector<value_type> out;
+    out.reserve(size());
+    for (std::size_t pos { 0 } ; pos != size() ; ++pos)
+    {
+      out.push_back(get(pos));
+    }
+    return out;
+  }
+};
+
+template <class T, bool MEMOIZE>
+struct CppBuilder<LazyVector<T, MEMOIZE>>
+{
+  typedef LazyVector<T, MEMOIZE> value_type;
+  value_type operator() (PyObject* pyo) const
+  {
+    assert(pyo);
+    _StatsScope<CppBuilder> stats;
+    if (! PyList_Check(pyo) && ! PyTuple_Check(pyo))
+    {
+      throw std::invalid_argument("Neither a PyList nor a PyTuple instance");
+    }
+    Py_INCREF(pyo);
+    return value_type(pyo);
+  }
+  // items are not checked: they are converted, and rejected, on access
+  bool eligible(PyObject* pyo) const
+  {
+    return PyList_Check(pyo) || PyTuple_Check(pyo) || _rejected<CppBuilder>();
+  }
+  Optional<value_type> try_build(PyObject* pyo) const
+  {
+    return _tryBuildFlat(*this, pyo);
+  }
+  void build_into(value_type& out, PyObject* pyo) const
+  {
+    out = (*this)(pyo);
+  }
+};
+template <class T, bool MEMOIZE> struct ToBuildable<LazyVector<T, MEMOIZE>> : CppBuilder<LazyVector<T, MEMOIZE>> {};
+
+template <class K, class T, bool MEMOIZE>
+class LazyMap
+{
+public:
+  typedef typename ToBuildable<K>::value_type key_type;
+  typedef typename ToBuildable<T>::value_type mapped_type;
+  typedef std::pair<key_type, mapped_type> value_type;
+  typedef typename std::conditional<MEMOIZE, mapped_type const&, mapped_type>::type mapped_reference;
+
+  // walks the dict with PyDict_Next
+  class const_iterator
+  {
+    LazyMap const* view_;
+    Py_ssize_t next_;  // position of the following entry for PyDict_Next
+    PyObject* key_;    // borrowed, nullptr at the end
+    PyObject* value_;  // borrowed
+
+    void advance()
+    {
+      if (! view_->owner_ || ! PyDict_Next(view_->owner_, &next_, &key_, &value_))
+      {
+        key_ = nullptr;
+        value_ = nullptr;
+      }
+    }
+
+  public:
+    typedef std::input_iterator_tag iterator_category;
+    typedef typename LazyMap::value_type value_type;
+    typedef std::ptrdiff_t difference_type;
+    typedef const value_type* pointer;
+    typedef value_type reference;
+
+    const_iterator(LazyMap const* view, bool atEnd) : view_(view), next_(0), key_(nullptr), value_(nullptr)
+    {
+      if (! atEnd)
+      {
+        advance();
+      }
+    }
+    key_type key() const { return view_->keyBuilder_(key_); }
+    mapped_reference value() const { return view_->getValue(value_); }
+    value_type operator*() const { return value_type(key(), value()); }
+    const_iterator& operator++() { advance(); return *this; }
+    const_iterator operator++(int) { const_iterator previous(*this); advance(); return previous; }
+    bool operator==(const_iterator const& other) const { return key_ == other.key_; }
+    bool operator!=(const_iterator const& other) const { return key_ != other.key_; }
+  };
+
+private:
+  PyObject* owner_;
+  ToBuildable<K> keyBuilder_;
+  ToBuildable<T> valueBuilder_;
+  mutable std::unordered_map<PyObject*, mapped_type> memo_; // by value object, kept alive by the dict
+
+  template <bool M = MEMOIZE>
+  typename std::enable_if<! M, mapped_reference>::type getValue(PyObject* value) const
+  {
+    return valueBuilder_(value);
+  }
+  template <bool M = MEMOIZE>
+  typename std::enable_if<M, mapped_reference>::type getValue(PyObject* value) const
+  {
+    auto it = memo_.find(value);
+    if (it == memo_.end())
+    {
+      it = memo_.emplace(value, valueBuilder_(value)).first;
+    }
+    return it->second;
+  }
+
+  // borrowed value of key, nullptr if the dict does not contain it
+  PyObject* lookup(key_type const& key) const
+  {
+    if (! owner_)
+    {
+      return nullptr;
+    }
+    std::unique_ptr<PyObject, decref> pyKey { PyBuilder<key_type>()(key) };
+    PyObject* value { PyDict_GetItem(owner_, pyKey.get()) };
+    return value;
+  }
+
+public:
+  LazyMap() : owner_(nullptr) {}
+
+  // steals the reference on a PyDict
+  explicit LazyMap(PyObject* pyDict) : owner_(pyDict)
+  {
+    assert(! owner_ || PyDict_Check(owner_));
+  }
+  LazyMap(LazyMap const& other) : owner_(other.owner_), memo_(other.memo_)
+  {
+    Py_XINCREF(owner_);
+  }
+  LazyMap(LazyMap&& other) : owner_(other.owner_), memo_(std::move(other.memo_))
+  {
+    other.owner_ = nullptr;
+  }
+  LazyMap& operator=(LazyMap const& other)
+  {
+    if (this != &other)
+    {
+      Py_XINCREF(other.owner_);
+      Py_XDECREF(owner_);
+      owner_ = other.owner_;
+      memo_ = other.memo_;
+    }
+    return *this;
+  }
+  LazyMap& operator=(LazyMap&& other)
+  {
+    if (this != &other)
+    {
+      Py_XDECREF(owner_);
+      owner_ = other.owner_;
+      memo_ = std::move(other.memo_);
+      other.owner_ = nullptr;
+    }
+    return *this;
+  }
+  ~LazyMap()
+  {
+    Py_XDECREF(owner_);
+  }
+
+  PyObject* owner() const { return owner_; }
+  std::size_t size() const { return owner_ ? static_cast<std::size_t>(PyDict_Size(owner_)) : 0; }
+  bool empty() const { return size() == 0; }
+  const_iterator begin() const { return const_iterator(this, false); }
+  const_iterator end() const { return const_iterator(this, true); }
+
+  std::size_t count(key_type const& key) const
+  {
+    return lookup(key) ? 1 : 0;
+  }
+  mapped_reference at(key_type const& key) const
+  {
+    PyObject* value { lookup(key) };
+    if (! value)
+    {
+      throw std::out_of_range("LazyMap key not found");
+    }
+    return getValue(value);
+  }
+};
+
+template <class K, class T, bool MEMOIZE>
+struct CppBuilder<LazyMap<K, T, MEMOIZE>>
+{
+  typedef LazyMap<K, T, MEMOIZE> value_type;
+  value_type operator() (PyObject* pyo) const
+  {
+    assert(pyo);
+    _StatsScope<CppBuilder> stats;
+    if (! PyDict_Check(pyo))
+    {
+      throw std::invalid_argument("Not a PyDict instance");
+    }
+    Py_INCREF(pyo);
+    return value_type(pyo);
+  }
+  // entries are not checked: they are converted, and rejected, on access
+  bool eligible(PyObject* pyo) const
+  {
+    return PyDict_Check(pyo) || _rejected<CppBuilder>();
+  }
+  Optional<value_type> try_build(PyObject* pyo) const
+  {
+    return _tryBuildFlat(*this, pyo);
+  }
+  void build_into(value_type& out, PyObject* pyo) const
+  {
+    out = (*this)(pyo);
+  }
+};
+template <class K, class T, bool MEMOIZE> struct ToBuildable<LazyMap<K, T, MEMOIZE>> : CppBuilder<LazyMap<K, T, MEMOIZE>> {};
+
+/**
+ * Two-phase builders
+ */
+
+// Item of the intermediate buffer of TwoPhase<T>
+// Containers are stored as a Sequence header followed by their elements,
+// span being the number of items used by these elements
+struct _TapeItem
+{
+  enum class Tag : unsigned char { Integer, Unsigned, Floating, Boolean, Bytes, Wide, Sequence };
+  
+  Tag tag;
+  union
+  {
+    long long integer;
+    unsigned long long uinteger;
+    double floating;
+    bool boolean;
+    struct { std::size_t offset, length; } chars;
+    struct { std::size_t count, span; } sequence;
+  };
+};
+
+struct _Tape
+{
+  std::vector<_TapeItem> items;
+  std::string bytes;   // characters of Bytes items
+  std::wstring wides;  // characters of Wide items
+  
+  void pushInteger(long long value) { _TapeItem item; item.tag = _TapeItem::Tag::Integer; item.integer = value; items.push_back(item); }
+  void pushUnsigned(unsigned long long value) { _TapeItem item; item.tag = _TapeItem::Tag::Unsigned; item.uinteger = value; items.push_back(item); }
+  void pushFloating(double value) { _TapeItem item; item.tag = _TapeItem::Tag::Floating; item.floating = value; items.push_back(item); }
+  void pushBoolean(bool value) { _TapeItem item; item.tag = _TapeItem::Tag::Boolean; item.boolean = value; items.push_back(item); }
+  void pushBytes(std::size_t offset)
+  {
+    _TapeItem item;
+    item.tag = _TapeItem::Tag::Bytes;
+    item.chars.offset = offset;
+    item.chars.length = bytes.size() - offset;
+    items.push_back(item);
+  }
+  void pushWide(std::wstring const& value)
+  {
+    _TapeItem item;
+    item.tag = _TapeItem::Tag::Wide;
+    item.chars.offset = wides.size();
+    item.chars.length = value.size();
+    wides += value;
+    items.push_back(item);
+  }
+  
+  // header of a sequence of count elements, closed by endSequence once the elements are pushed
+  std::size_t beginSequence(std::size_t count)
+  {
+    _TapeItem item;
+    item.tag = _TapeItem::Tag::Sequence;
+    item.sequence.count = count;
+    item.sequence.span = 0;
+    items.push_back(item);
+    return items.size() -1;
+  }
+  void endSequence(std::size_t header)
+  {
+    items[header].sequence.span = items.size() - header -1;
+  }
+  
+  // number of items used by the value starting at pos
+  std::size_t spanOf(std::size_t pos) const
+  {
+    return items[pos].tag == _TapeItem::Tag::Sequence ? items[pos].sequence.span +1 : 1;
+  }
+};
+
+// Sequential reader of a _Tape, never touches any PyObject
+struct _TapeReader
+{
+  _Tape const& tape;
+  std::size_t pos;
+  
+  _TapeReader(_Tape const& tape, std::size_t pos) : tape(tape), pos(pos) {}
+  
+  _TapeItem const& next(_TapeItem::Tag tag)
+  {
+    assert(pos < tape.items.size() && tape.items[pos].tag == tag);
+    return tape.items[pos++];
+  }
+};
+
+// _TwoPhase<T> flattens a PyObject into a _Tape (snapshot)
+// and builds the ToBuildable<T>::value_type back from it (rebuild)
+// trySnapshot returns false at the first rejected item instead of throwing, as try_build does
+template <class T> struct _TwoPhase;
+
+template <class T, _TapeItem::Tag TAG>
+struct _TwoPhaseScalar
+{
+  typedef T value_type;
+  static void snapshot(PyObject* pyo, _Tape& tape)
+  {
+    push(CppBuilder<T>()(pyo), tape);
+  }
+  static bool trySnapshot(PyObject* pyo, _Tape& tape)
+  {
+    Optional<value_type> value { CppBuilder<T>().try_build(pyo) };
+    if (! value)
+    {
+      return false;
+    }
+    push(*value, tape);
+    return true;
+  }
+  static void push(value_type value, _Tape& tape)
+  {
+    switch (TAG)
+    {
+      case _TapeItem::Tag::Integer: tape.pushInteger(static_cast<long long>(value)); break;
+      case _TapeItem::Tag::Unsigned: tape.pushUnsigned(static_cast<unsigned long long>(value)); break;
+      case _TapeItem::Tag::Floating: tape.pushFloating(static_cast<double>(value)); break;
+      default: tape.pushBoolean(value != value_type()); break;
+    }
+  }
+  static value_type rebuild(_TapeReader& reader)
+  {
+    _TapeItem const& item = reader.next(TAG);
+    switch (TAG)
+    {
+      case _TapeItem::Tag::Integer: return static_cast<value_type>(item.integer);
+      case _TapeItem::Tag::Unsigned: return static_cast<value_type>(item.uinteger);
+      case _TapeItem::Tag::Floating: return static_cast<value_type>(item.floating);
+      default: return static_cast<value_type>(item.boolean);
+    }
+  }
+};
+
+template <> struct _TwoPhase<bool> : _TwoPhaseScalar<bool, _TapeItem::Tag::Boolean> {};
+template <> struct _TwoPhase<int> : _TwoPhaseScalar<int, _TapeItem::Tag::Integer> {};
+template <> struct _TwoPhase<long> : _TwoPhaseScalar<long, _TapeItem::Tag::Integer> {};
+template <> struct _TwoPhase<long long> : _TwoPhaseScalar<long long, _TapeItem::Tag::Integer> {};
+template <> struct _TwoPhase<unsigned int> : _TwoPhaseScalar<unsigned int, _TapeItem::Tag::Unsigned> {};
+template <> struct _TwoPhase<unsigned long> : _TwoPhaseScalar<unsigned long, _TapeItem::Tag::Unsigned> {};
+template <> struct _TwoPhase<unsigned long long> : _TwoPhaseScalar<unsigned long long, _TapeItem::Tag::Unsigned> {};
+template <> struct _TwoPhase<double> : _TwoPhaseScalar<double, _TapeItem::Tag::Floating> {};
+
+template <>
+struct _TwoPhase<std::string>
+{
+  typedef std::string value_type;
+  static void snapshot(PyObject* pyo, _Tape& tape)
+  {
+    std::size_t offset { tape.bytes.size() };
+    if (PyString_Check(pyo))
+    {
+      tape.bytes.append(PyString_AS_STRING(pyo), PyString_GET_SIZE(pyo));
+    }
+    else
+    {
+      tape.bytes += CppBuilder<std::string>()(pyo);
+    }
+    tape.pushBytes(offset);
+  }
+  static bool trySnapshot(PyObject* pyo, _Tape& tape)
+  {
+    if (PyString_Check(pyo))
+    {
+      snapshot(pyo, tape);
+      return true;
+    }
+    Optional<value_type> value { CppBuilder<std::string>().try_build(pyo) };
+    if (! value)
+    {
+      return false;
+    }
+    std::size_t offset { tape.bytes.size() };
+    tape.bytes += *value;
+    tape.pushBytes(offset);
+    return true;
+  }
+  static value_type rebuild(_TapeReader& reader)
+  {
+    _TapeItem const& item = reader.next(_TapeItem::Tag::Bytes);
+    return value_type(reader.tape.bytes, item.chars.offset, item.chars.length);
+  }
+};
+
+template <>
+struct _TwoPhase<std::wstring>
+{
+  typedef std::wstring value_type;
+  static void snapshot(PyObject* pyo, _Tape& tape)
+  {
+    tape.pushWide(CppBuilder<std::wstring>()(pyo));
+  }
+  static bool trySnapshot(PyObject* pyo, _Tape& tape)
+  {
+    Optional<value_type> value { CppBuilder<std::wstring>().try_build(pyo) };
+    if (! value)
+    {
+      return false;
+    }
+    tape.pushWide(*value);
+    return true;
+  }
+  static value_type rebuild(_TapeReader& reader)
+  {
+    _TapeItem const& item = reader.next(_TapeItem::Tag::Wide);
+    return value_type(reader.tape.wides, item.chars.offset, item.chars.length);
+  }
+};
+
+template <class... Args>
+struct _TwoPhase<std::tuple<Args...>>
+{
+  typedef typename CppBuilder<std::tuple<Args...>>::value_type value_type;
+  static void snapshot(PyObject* pyo, _Tape& tape)
+  {
+    if (! PyTuple_Check(pyo) || PyTuple_GET_SIZE(pyo) != sizeof...(Args))
+    {
+      CppBuilder<std::tuple<Args...>>()(pyo); // throws the same error as CppBuilder
+    }
+    std::size_t header { tape.beginSequence(sizeof...(Args)) };
+    snapshotItems(pyo, tape, typename _MakeIndexSequence<sizeof...(Args)>::type());
+    tape.endSequence(header);
+  }
+  template <std::size_t... Is>
+  static void snapshotItems(PyObject* pyo, _Tape& tape, _IndexSequence<Is...>)
+  {
+    int dummy[] = { 0, (_TwoPhase<Args>::snapshot(PyTuple_GET_ITEM(pyo, Is), tape), 0)... };
+    (void)dummy;
+  }
+  static bool trySnapshot(PyObject* pyo, _Tape& tape)
+  {
+    if (! PyTuple_Check(pyo))
+    {
+      _ConversionTrail::rejected(ConversionErrc::type_mismatch);
+      return false;
+    }
+    if (PyTuple_GET_SIZE(pyo) != sizeof...(Args))
+    {
+      _ConversionTrail::rejected(ConversionErrc::length_mismatch);
+      return false;
+    }
+    std::size_t header { tape.beginSequence(sizeof...(Args)) };
+    if (! trySnapshotItems(pyo, tape, typename _MakeIndexSequence<sizeof...(Args)>::type()))
+    {
+      return false;
+    }
+    tape.endSequence(header);
+    return true;
+  }
+  template <std::size_t... Is>
+  static bool trySnapshotItems(PyObject* pyo, _Tape& tape, _IndexSequence<Is...>)
+  {
+    bool ok { true };
+    int dummy[] = { 0, (ok = ok && trySnapshotItem<Args>(PyTuple_GET_ITEM(pyo, Is), Is, tape), 0)... };
+    (void)dummy;
+    return ok;
+  }
+  template <class ARG>
+  static bool trySnapshotItem(PyObject* item, Py_ssize_t index, _Tape& tape)
+  {
+    if (! _TwoPhase<ARG>::trySnapshot(item, tape))
+    {
+      _ConversionTrail::atIndex(index);
+      return false;
+    }
+    return true;
+  }
+  static value_type rebuild(_TapeReader& reader)
+  {
+    reader.next(_TapeItem::Tag::Sequence);
+    // elements of a braced-init-list are evaluated in order
+    return value_type { _TwoPhase<Args>::rebuild(reader)... };
+  }
+};
+
+template <class T>
+struct _TwoPhase<std::vector<T>>
+{
+  typedef std::vector<typename _TwoPhase<T>::value_type> value_type;
+  static void snapshot(PyObject* pyo, _Tape& tape)
+  {
+    if (! PyList_Check(pyo) && ! PyTuple_Check(pyo))
+    {
+      throw std::invalid_argument("Neither a PyList nor a PyTuple instance");
+    }
+    PyObject** items { PySequence_Fast_ITEMS(pyo) };
+    Py_ssize_t size { PySequence_Fast_GET_SIZE(pyo) };
+    std::size_t header { tape.beginSequence(size) };
+    for (Py_ssize_t i { 0 } ; i != size ; ++i)
+    {
+      _TwoPhase<T>::snapshot(items[i], tape);
+    }
+    tape.endSequence(header);
+  }
+  static bool trySnapshot(PyObject* pyo, _Tape& tape)
+  {
+    if (! PyList_Check(pyo) && ! PyTuple_Check(pyo))
+    {
+      _ConversionTrail::rejected(ConversionErrc::type_mismatch);
+      return false;
+    }
+    PyObject** items { PySequence_Fast_ITEMS(pyo) };
+    Py_ssize_t size { PySequence_Fast_GET_SIZE(pyo) };
+    std::size_t header { tape.beginSequence(size) };
+    for (Py_ssize_t i { 0 } ; i != size ; ++i)
+    {
+      if (! _TwoPhase<T>::trySnapshot(items[i], tape))
+      {
+        _ConversionTrail::atIndex(i);
+        return false;
+      }
+    }
+    tape.endSequence(header);
+    return true;
+  }
+  static value_type rebuild(_TapeReader& reader)
+  {
+    std::size_t count { reader.next(_TapeItem::Tag::Sequence).sequence.count };
+    value_type out;
+    out.reserve(count);
+    for (std::size_t i { 0 } ; i != count ; ++i)
+    {
+      out.push_back(_TwoPhase<T>::rebuild(reader));
+    }
+    return out;
+  }
+};
+
+template <class T>
+struct _TwoPhase<std::set<T>>
+{
+  typedef std::set<typename _TwoPhase<T>::value_type> value_type;
+  static void snapshot(PyObject* pyo, _Tape& tape)
+  {
+    if (! PyAnySet_Check(pyo))
+    {
+      throw std::invalid_argument("Neither a PySet nor a PyFrozenSet instance");
+    }
+    std::size_t header { tape.beginSequence(PySet_GET_SIZE(pyo)) };
+    Py_ssize_t pos { 0 };
+    PyObject* key;
+    long hash;
+    while (_PySet_NextEntry(pyo, &pos, &key, &hash))
+    {
+      _TwoPhase<T>::snapshot(key, tape);
+    }
+    tape.endSequence(header);
+  }
+  static bool trySnapshot(PyObject* pyo, _Tape& tape)
+  {
+    if (! PyAnySet_Check(pyo))
+    {
+      _ConversionTrail::rejected(ConversionErrc::type_mismatch);
+      return false;
+    }
+    std::size_t header { tape.beginSequence(PySet_GET_SIZE(pyo)) };
+    Py_ssize_t pos { 0 };
+    PyObject* key;
+    long hash;
+    while (_PySet_NextEntry(pyo, &pos, &key, &hash))
+    {
+      if (! _TwoPhase<T>::trySnapshot(key, tape))
+      {
+        _ConversionTrail::atKey(key);
+        return false;
+      }
+    }
+    tape.endSequence(header);
+    return true;
+  }
+  static value_type rebuild(_TapeReader& reader)
+  {
+    std::size_t count { reader.next(_TapeItem::Tag::Sequence).sequence.count };
+    typename CppBuilderSetHelper<T>::buffer_type items;
+    items.reserve(count);
+    for (std::size_t i { 0 } ; i != count ; ++i)
+    {
+      items.push_back(_TwoPhase<T>::rebuild(reader));
+    }
+    return CppBuilderSetHelper<T>::fromBuffer(items);
+  }
+};
+
+template <class K, class T>
+struct _TwoPhase<std::map<K,T>>
+{
+  typedef std::map<typename _TwoPhase<K>::value_type, typename _TwoPhase<T>::value_type> value_type;
+  static void snapshot(PyObject* pyo, _Tape& tape)
+  {
+    if (! PyDict_Check(pyo))
+    {
+      throw std::invalid_argument("Not a PyDict instance");
+    }
+    std::size_t header { tape.beginSequence(PyDict_Size(pyo)) };
+    PyObject *key, *value;
+    Py_ssize_t pos = 0;
+    while (PyDict_Next(pyo, &pos, &key, &value))
+    {
+      _TwoPhase<K>::snapshot(key, tape);
+      _TwoPhase<T>::snapshot(value, tape);
+    }
+    tape.endSequence(header);
+  }
+  static bool trySnapshot(PyObject* pyo, _Tape& tape)
+  {
+    if (! PyDict_Check(pyo))
+    {
+      _ConversionTrail::rejected(ConversionErrc::type_mismatch);
+      return false;
+    }
+    std::size_t header { tape.beginSequence(PyDict_Size(pyo)) };
+    PyObject *key, *value;
+    Py_ssize_t pos = 0;
+    while (PyDict_Next(pyo, &pos, &key, &value))
+    {
+      if (! _TwoPhase<K>::trySnapshot(key, tape))
+      {
+        _ConversionTrail::atKey(key);
+        return false;
+      }
+      if (! _TwoPhase<T>::trySnapshot(value, tape))
+      {
+        _ConversionTrail::atItem(key);
+        return false;
+      }
+    }
+    tape.endSequence(header);
+    return true;
+  }
+  static value_type rebuild(_TapeReader& reader)
+  {
+    std::size_t count { reader.next(_TapeItem::Tag::Sequence).sequence.count };
+    typename CppBuilderMapHelper<K,T>::buffer_type entries;
+    entries.reserve(count);
+    for (std::size_t i { 0 } ; i != count ; ++i)
+    {
+      typename _TwoPhase<K>::value_type key { _TwoPhase<K>::rebuild(reader) };
+      entries.emplace_back(std::move(key), _TwoPhase<T>::rebuild(reader));
+    }
+    return CppBuilderMapHelper<K,T>::fromBuffer(entries);
+  }
+};
+
+template <class K, class T>
+struct _TwoPhase<std::unordered_map<K,T>>
+{
+  typedef typename CppBuilder<std::unordered_map<K,T>>::value_type value_type;
+  static void snapshot(PyObject* pyo, _Tape& tape)
+  {
+    _TwoPhase<std::map<K,T>>::snapshot(pyo, tape);
+  }
+  static bool trySnapshot(PyObject* pyo, _Tape& tape)
+  {
+    return _TwoPhase<std::map<K,T>>::trySnapshot(pyo, tape);
+  }
+  static value_type rebuild(_TapeReader& reader)
+  {
+    std::size_t count { reader.next(_TapeItem::Tag::Sequence).sequence.count };
+    value_type dict;
+    dict.reserve(count);
+    for (std::size_t i { 0 } ; i != count ; ++i)
+    {
+      typename _TwoPhase<K>::value_type key { _TwoPhase<K>::rebuild(reader) };
+      _emplaceLast(dict, std::move(key), _TwoPhase<T>::rebuild(reader));
+    }
+    return dict;
+  }
+};
+
+template <class T>
+struct _TwoPhase<std::unordered_set<T>>
+{
+  typedef typename CppBuilder<std::unordered_set<T>>::value_type value_type;
+  static void snapshot(PyObject* pyo, _Tape& tape)
+  {
+    _TwoPhase<std::set<T>>::snapshot(pyo, tape);
+  }
+  static bool trySnapshot(PyObject* pyo, _Tape& tape)
+  {
+    return _TwoPhase<std::set<T>>::trySnapshot(pyo, tape);
+  }
+  static value_type rebuild(_TapeReader& reader)
+  {
+    std::size_t count { reader.next(_TapeItem::Tag::Sequence).sequence.count };
+    value_type s;
+    s.reserve(count);
+    for (std::size_t i { 0 } ; i != count ; ++i)
+    {
+      s.insert(_TwoPhase<T>::rebuild(reader));
+    }
+    return s;
+  }
+};
+
+// numThreads -1 worker threads, plus the calling thread, kept alive for a whole rebuild
+// so that the chunks and every merge round do not start new threads
+// run(numTasks, task) runs task(0) ... task(numTasks -1) on them and returns once all of them are done,
+// the first exception thrown by a task being rethrown then
+class _ThreadPool
+{
+  std::mutex mutex_;
+  std::condition_variable wake_; // a batch of tasks is available or the pool stops
+  std::condition_variable done_; // the last task of the batch is done
+  std::function<void(std::size_t)> task_;
+  std::size_t next_;             // next task of the batch to be claimed
+  std::size_t numTasks_;
+  std::size_t pending_;          // tasks of the batch not done yet
+  std::exception_ptr error_;
+  bool stop_;
+  std::vector<std::thread> workers_;
+
+  // claim and run the tasks of the current batch until none is left
+  void drain(std::unique_lock<std::mutex>& lock)
+  {
+    while (next_ < numTasks_)
+    {
+      std::size_t id { next_++ };
+      lock.unlock();
+      std::exception_ptr error;
+      try { task_(id); }
+      catch (...) { error = std::current_exception(); }
+      lock.lock();
+      if (error && ! error_)
+      {
+        error_ = error;
+      }
+      if (--pending_ == 0)
+      {
+        done_.notify_all();
+      }
+    }
+  }
+  void work()
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true)
+    {
+      wake_.wait(lock, [this] { return stop_ || next_ < numTasks_; });
+      if (stop_)
+      {
+        return;
+      }
+      drain(lock);
+    }
+  }
+  void stop()
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stop_ = true;
+    }
+    wake_.notify_all();
+    for (auto& worker : workers_)
+    {
+      worker.join();
+    }
+  }
+
+public:
+  explicit _ThreadPool(std::size_t numThreads) : next_(0), numTasks_(0), pending_(0), stop_(false)
+  {
+    workers_.reserve(numThreads -1);
+    try
+    {
+      for (std::size_t id { 1 } ; id < numThreads ; ++id)
+      {
+        workers_.emplace_back([this] { work(); });
+      }
+    }
+    catch (...)
+    {
+      stop();
+      throw;
+    }
+  }
+  _ThreadPool(_ThreadPool const&) = delete;
+  _ThreadPool& operator=(_ThreadPool const&) = delete;
+  ~_ThreadPool() { stop(); }
+
+  std::size_t size() const { return workers_.size() +1; }
+
+  template <class TASK>
+  void run(std::size_t numTasks, TASK const& task)
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    task_ = std::cref(task);
+    next_ = 0;
+    numTasks_ = numTasks;
+    pending_ = numTasks;
+    wake_.notify_all();
+    drain(lock);
+    done_.wait(lock, [this] { return pending_ == 0; });
+    next_ = numTasks_ = 0;
+    task_ = nullptr;
+    std::exception_ptr error;
+    std::swap(error, error_);
+    if (error)
+    {
+      std::rethrow_exception(error);
+    }
+  }
+};
+
+// Number of chunks the top-level sequence of a tape is split into:
+// at most numThreads, each one made of at least 4096 elements
+static inline std::size_t _numChunks(_Tape const& tape, std::size_t numThreads)
+{
+  const std::size_t minChunk { 4096 };
+  return std::max<std::size_t>(1, std::min(numThreads, tape.items[0].sequence.count / minChunk));
+}
+
+// Elements of the top-level sequence of a tape built in consecutive chunks, one task of the pool per chunk
+// Each element is made of itemsPerElement values, returns the number of chunks (at most pool.size())
+template <class FUN>
+static inline std::size_t _rebuildChunks(_Tape const& tape, std::size_t itemsPerElement, _ThreadPool& pool, FUN const& fun)
+{
+  std::size_t count { tape.items[0].sequence.count };
+  std::size_t numChunks { pool.size() };
+  
+  // tape position of the first element of each chunk
+  std::vector<std::size_t> starts { 1 };
+  std::size_t pos { 1 };
+  for (std::size_t element { 0 } ; element != count ; ++element)
+  {
+    if (element != 0 && element % ((count + numChunks -1) / numChunks) == 0)
+    {
+      starts.push_back(pos);
+    }
+    for (std::size_t value { 0 } ; value != itemsPerElement ; ++value)
+    {
+      pos += tape.spanOf(pos);
+    }
+  }
+  std::size_t perChunk { numChunks != 0 ? (count + numChunks -1) / numChunks : 0 };
+  pool.run(starts.size(), [&](std::size_t chunk) {
+      _TapeReader reader(tape, starts[chunk]);
+      fun(chunk, reader, std::min(perChunk, count - chunk * perChunk));
+  });
+  return starts.size();
+}
+
+// Merge sorted chunks in parallel rounds, the result being in chunks[0]
+// std::merge takes the left element first on ties: equivalent elements stay in the order of the chunks
+template <class ELEMENT, class COMPARE>
+static inline void _mergeChunks(std::vector<std::vector<ELEMENT>>& chunks, COMPARE const& compare, _ThreadPool& pool)
+{
+  for (std::size_t step { 1 } ; step < chunks.size() ; step *= 2)
+  {
+    std::size_t numMerges { (chunks.size() + 2 * step -1) / (2 * step) };
+    pool.run(numMerges, [&](std::size_t merge) {
+        std::size_t left { merge * 2 * step };
+        std::size_t right { left + step };
+        if (right >= chunks.size())
+        {
+          return;
+        }
+        std::vector<ELEMENT> merged;
+        merged.reserve(chunks[left].size() + chunks[right].size());
+        std::merge(std::make_move_iterator(chunks[left].begin()), std::make_move_iterator(chunks[left].end())
+            , std::make_move_iterator(chunks[right].begin()), std::make_move_iterator(chunks[right].end())
+            , std::back_inserter(merged), compare);
+        chunks[left] = std::move(merged);
+        std::vector<ELEMENT>().swap(chunks[right]);
+    });
+  }
+}
+
+// Build the value of a tape from its beginning, top-level containers are split across threads
+template <class T>
+struct _TwoPhaseParallel
+{
+  typedef typename _TwoPhase<T>::value_type value_type;
+  static value_type rebuild(_Tape const& tape, std::size_t numThreads)
+  {
+    _TapeReader reader(tape, 0);
+    return _TwoPhase<T>::rebuild(reader);
+  }
+};
+
+template <class T>
+struct _TwoPhaseParallel<std::vector<T>>
+{
+  typedef typename _TwoPhase<std::vector<T>>::value_type value_type;
+  static value_type rebuild(_Tape const& tape, std::size_t numThreads)
+  {
+    _ThreadPool pool(_numChunks(tape, numThreads));
+    std::vector<value_type> chunks(pool.size());
+    chunks.resize(_rebuildChunks(tape, 1, pool, [&chunks](std::size_t chunk, _TapeReader& reader, std::size_t count) {
+        chunks[chunk].reserve(count);
+        for (std::size_t i { 0 } ; i != count ; ++i)
+        {
+          chunks[chunk].push_back(_TwoPhase<T>::rebuild(reader));
+        }
+    }));
+    value_type out { std::move(chunks[0]) };
+    out.reserve(tape.items[0].sequence.count);
+    for (std::size_t chunk { 1 } ; chunk < chunks.size() ; ++chunk)
+    {
+      std::move(chunks[chunk].begin(), chunks[chunk].end(), std::back_inserter(out));
+    }
+    return out;
+  }
+};
+
+template <class T>
+struct _TwoPhaseParallel<std::set<T>>
+{
+  typedef typename _TwoPhase<std::set<T>>::value_type value_type;
+  typedef typename _TwoPhase<T>::value_type element_type;
+  static value_type rebuild(_Tape const& tape, std::size_t numThreads)
+  {
+    _ThreadPool pool(_numChunks(tape, numThreads));
+    std::vector<std::vector<element_type>> chunks(pool.size());
+    chunks.resize(_rebuildChunks(tape, 1, pool, [&chunks](std::size_t chunk, _TapeReader& reader, std::size_t count) {
+        chunks[chunk].reserve(count);
+        for (std::size_t i { 0 } ; i != count ; ++i)
+        {
+          chunks[chunk].push_back(_TwoPhase<T>::rebuild(reader));
+        }
+        std::sort(chunks[chunk].begin(), chunks[chunk].end(), typename value_type::key_compare());
+    }));
+    _mergeChunks(chunks, typename value_type::key_compare(), pool);
+    value_type s;
+    for (auto& item : chunks[0])
+    {
+      s.emplace_hint(s.end(), std::move(item));
+    }
+    return s;
+  }
+};
+
+template <class K, class T>
+struct _TwoPhaseParallel<std::map<K,T>>
+{
+  typedef CppBuilderMapHelper<K,T> helper_type;
+  typedef typename _TwoPhase<std::map<K,T>>::value_type value_type;
+  typedef typename helper_type::buffer_type buffer_type;
+  static value_type rebuild(_Tape const& tape, std::size_t numThreads)
+  {
+    // chunks are stably sorted and merged in the order of the dict
+    // so that the last of equivalent keys wins, as with CppBuilder<std::map>
+    _ThreadPool pool(_numChunks(tape, numThreads));
+    std::vector<buffer_type> chunks(pool.size());
+    chunks.resize(_rebuildChunks(tape, 2, pool, [&chunks](std::size_t chunk, _TapeReader& reader, std::size_t count) {
+        chunks[chunk].reserve(count);
+        for (std::size_t i { 0 } ; i != count ; ++i)
+        {
+          typename _TwoPhase<K>::value_type key { _TwoPhase<K>::rebuild(reader) };
+          chunks[chunk].emplace_back(std::move(key), _TwoPhase<T>::rebuild(reader));
+        }
+        std::stable_sort(chunks[chunk].begin(), chunks[chunk].end(), helper_type::compare);
+    }));
+    _mergeChunks(chunks, helper_type::compare, pool);
+    return helper_type::fromSorted(chunks[0]);
+  }
+};
+
+// Release the GIL for the lifetime of the object
+struct _GilRelease
+{
+  PyThreadState* state;
+  _GilRelease() : state(PyEval_SaveThread()) {}
+  _GilRelease(_GilRelease const&) = delete;
+  ~_GilRelease() { PyEval_RestoreThread(state); }
+};
+
+template <class T>
+struct CppBuilder<TwoPhase<T>>
+{
+  typedef typename _TwoPhase<T>::value_type value_type;
+  const std::size_t numThreads;
+  
+  explicit CppBuilder(std::size_t numThreads = 0)
+      : numThreads(numThreads != 0 ? numThreads : std::max<std::size_t>(1, std::thread::hardware_concurrency()))
+  {}
+  
+  value_type operator() (PyObject* pyo) const
+  {
+    TwoPhaseStats stats;
+    return (*this)(pyo, stats);
+  }
+  value_type operator() (PyObject* pyo, TwoPhaseStats& stats) const
+  {
+    assert(pyo);
+    _StatsScope<CppBuilder> conversion;
+    typedef std::chrono::duration<double, std::milli> milliseconds;
+    
+    auto start = std::chrono::steady_clock::now();
+    _Tape tape;
+    _TwoPhase<T>::snapshot(pyo, tape);
+    auto snapshotted = std::chrono::steady_clock::now();
+    stats.gil_held_ms = milliseconds(snapshotted - start).count();
+    stats.items = tape.items.size();
+    
+    _GilRelease release;
+    value_type out { _TwoPhaseParallel<T>::rebuild(tape, numThreads) };
+    stats.gil_free_ms = milliseconds(std::chrono::steady_clock::now() - snapshotted).count();
+    return out;
+  }
+  bool eligible(PyObject* pyo) const
+  {
+    return CppBuilder<T>().eligible(pyo) || _rejected<CppBuilder>();
+  }
+  // single traversal: the snapshot stops at the first rejected item
+  Optional<value_type> try_build(PyObject* pyo) const
+  {
+    _StatsScope<CppBuilder> conversion;
+    _Tape tape;
+    if (! _TwoPhase<T>::trySnapshot(pyo, tape))
+    {
+      return _rejected<CppBuilder>();
+    }
+    _GilRelease release;
+    return _TwoPhaseParallel<T>::rebuild(tape, numThreads);
+  }
+  void build_into(value_type& out, PyObject* pyo) const
+  {
+    out = (*this)(pyo);
+  }
+};
+
+/**
+ * Objects builders
+ */
+
+template <class OBJ, class T>
+inline std::pair<std::string, std::function<void(OBJ&,T)>> make_mapping(const std::string &key, std::function<void(OBJ&,T)> fun)
+{
+  return std::make_pair(key, fun);
+}
+
+template <class OBJ, class T>
+inline std::pair<std::string, std::function<void(OBJ&,T)>> make_mapping(const std::string &key, void (OBJ::*fun)(T))
+{
+  return std::make_pair(key, fun);
+}
+
+template <class OBJ, class T>
+inline std::pair<std::string, std::function<void(OBJ&,T)>> make_mapping(const std::string &key, T OBJ::*member)
+{
+  return std::make_pair(key, [member](OBJ& obj, T&& value){ obj.*member = std::move(value); });
+}
+
+template <class OBJ, class T>
+inline std::pair<std::string, std::function<void(OBJ&,T)>> make_mapping(std::string&& key, std::function<void(OBJ&,T)> fun)
+{
+  return std::make_pair(std::move(key), fun);
+}
+
+template <class OBJ, class T>
+inline std::pair<std::string, std::function<void(OBJ&,T)>> make_mapping(std::string&& key, void (OBJ::*fun)(T))
+{
+  return std::make_pair(std::move(key), fun);
+}
+
+template <class OBJ, class T>
+inline std::pair<std::string, std::function<void(OBJ&,T)>> make_mapping(std::string&& key, T OBJ::*member)
+{
+  return std::make_pair(std::move(key), [member](OBJ& obj, T&& value){ obj.*member = std::move(value); });
+}
+
+template <class MEMBER> struct _FieldTraits;
+
+template <class OBJ, class T>
+struct _FieldTraits<T OBJ::*>
+{
+  typedef ToBuildable<T> builder_type;
+};
+
+template <class OBJ, class T>
+struct _FieldTraits<void (OBJ::*)(T)>
+{
+  typedef ToBuildable<typename std::decay<T>::type> builder_type;
+};
+
+// set_from builds directly into data members so that their buffers are reused by build_into
+template <class OBJ, class T, T OBJ::*member, class BUILDER>
+struct Field<T OBJ::*, member, BUILDER> : BUILDER
+{
+  typedef T member_type;
+  static T const& get(OBJ const& obj)
+  {
+    return obj.*member;
+  }
+  static void set(OBJ& obj, typename BUILDER::value_type&& value)
+  {
+    obj.*member = std::move(value);
+  }
+  static void set_from(OBJ& obj, BUILDER const& builder, PyObject* pyo)
+  {
+    setFrom(obj, builder, pyo, std::is_same<T, typename BUILDER::value_type>());
+  }
+
+private:
+  static void setFrom(OBJ& obj, BUILDER const& builder, PyObject* pyo, std::true_type)
+  {
+    _buildInto(builder, obj.*member, pyo);
+  }
+  // BUILDER produces a value convertible to the member
+  static void setFrom(OBJ& obj, BUILDER const& builder, PyObject* pyo, std::false_type)
+  {
+    obj.*member = builder(pyo);
+  }
+};
+
+template <class OBJ, class T, void (OBJ::*setter)(T), class BUILDER>
+struct Field<void (OBJ::*)(T), setter, BUILDER> : BUILDER
+{
+  static void set(OBJ& obj, typename BUILDER::value_type&& value)
+  {
+    (obj.*setter)(std::move(value));
+  }
+  static void set_from(OBJ& obj, BUILDER const& builder, PyObject* pyo)
+  {
+    (obj.*setter)(builder(pyo));
+  }
+};
+
+// Stores a value built by FUNCTOR into OBJ
+// runtime mappings go through std::function, Field entries call their static setter
+template <class OBJ, class FUNCTOR>
+struct _Setter
+{
+  static const bool is_static { false };
+  typedef std::function<void(OBJ&, typename FUNCTOR::value_type)> function_type;
+  typedef std::pair<std::string, function_type> mapping_type;
+  
+  const function_type fun;
+  
+  _Setter() : fun() {}
+  explicit _Setter(function_type const& fun) : fun(fun) {}
+  explicit _Setter(mapping_type const& mapping) : fun(mapping.second) {}
+  static std::string const& nameOf(mapping_type const& mapping) { return mapping.first; }
+  
+  void operator() (OBJ& obj, typename FUNCTOR::value_type&& value) const
+  {
+    fun(obj, std::move(value));
+  }
+  void from(OBJ& obj, FUNCTOR const& builder, PyObject* pyo) const
+  {
+    fun(obj, builder(pyo));
+  }
+};
+
+template <class OBJ, class MEMBER, MEMBER member, class BUILDER>
+struct _Setter<OBJ, ToBuildable<Field<MEMBER, member, BUILDER>>>
+{
+  static const bool is_static { true };
+  typedef std::string mapping_type;
+  
+  _Setter() {}
+  explicit _Setter(mapping_type const&) {}
+  static std::string const& nameOf(mapping_type const& mapping) { return mapping; }
+  
+  void operator() (OBJ& obj, typename BUILDER::value_type&& value) const
+  {
+    Field<MEMBER, member, BUILDER>::set(obj, std::move(value));
+  }
+  void from(OBJ& obj, ToBuildable<Field<MEMBER, member, BUILDER>> const& builder, PyObject* pyo) const
+  {
+    Field<MEMBER, member, BUILDER>::set_from(obj, builder, pyo);
+  }
+};
+
+// Tag building a CppBuilderHelper chain made of Field entries only
+struct _StaticFields {};
+
+template <class OBJ, std::size_t pos, class... Args>
+struct CppBuilderHelper;
+
+// Level N of the CppBuilderHelper chain starting at HELPER
+template <std::size_t N, class HELPER>
+struct _HelperAt;
+
+// Entry of the dispatch table of CppBuilder<FromDictScan<...>>
+// Setters receive the root helper of the chain so that the table stays valid when the builder is copied
+template <class OBJ, class ROOT>
+struct _ScanField
+{
+  PyObject* key;
+  long hash;
+  void (*set)(ROOT const&, OBJ&, PyObject*);
+  bool (*eligible)(ROOT const&, PyObject*);
+  bool (*trySet)(ROOT const&, OBJ&, PyObject*);
+};
+
+template <class OBJ, std::size_t pos>
+struct CppBuilderHelper<OBJ, pos>
+{
+  CppBuilderHelper() {}
+  explicit CppBuilderHelper(_StaticFields) {}
+  template <class ROOT>
+  inline void collectFields(std::vector<_ScanField<OBJ, ROOT>>& fields) const {}
+  inline void fromDict(OBJ& obj, PyObject* pyo) const {}
+  inline void fromObject(OBJ& obj, PyObject* pyo) const {}
+  inline void fromTuple(OBJ& obj, PyObject* pyo) const {}
+
+  inline bool eligibleFromDict(PyObject* pyo) const { return true; }
+  inline bool eligibleFromObject(PyObject* pyo) const { return true; }
+  inline bool eligibleFromTuple(PyObject* pyo) const { return true; }
+
+  inline bool tryFromDict(OBJ& obj, PyObject* pyo) const { return true; }
+  inline bool tryFromObject(OBJ& obj, PyObject* pyo) const { return true; }
+  inline bool tryFromTuple(OBJ& obj, PyObject* pyo) const { return true; }
+};
+
+// Attribute attr of pyo (new reference), nullptr if it has no such attribute
+// Single lookup equivalent of PyObject_HasAttr followed by PyObject_GetAttr
+static inline PyObject* _getAttrOrNull(PyObject* pyo, PyObject* attr)
+{
+  PyObject* pyo_item { PyObject_GetAttr(pyo, attr) };
+  if (! pyo_item)
+  {
+    PyErr_Clear();
+  }
+  return pyo_item;
+}
+
+// How an attribute is read on the instances of a given type
+// Resolved once per type and field, valid as long as the version tag of the type does not change
+struct _AttrCache
+{
+  enum class Kind
+  {
+    Generic,       // PyObject_GetAttr (properties, custom __getattr__...)
+    Dict,          // instance __dict__ only, absent otherwise
+    DictOrGeneric, // instance __dict__ first, PyObject_GetAttr otherwise (methods, class attributes...)
+    Slot,          // __slots__ member at a fixed offset
+  };
+  
+  PyTypeObject* type;
+  unsigned int version;
+  Kind kind;
+  Py_ssize_t offset;
+  
+  _AttrCache() : type(nullptr), version(0), kind(Kind::Generic), offset(0) {}
+  
+  void resolve(PyTypeObject* objType, PyObject* attr)
+  {
+    kind = Kind::Generic;
+    if (objType->tp_getattro == PyObject_GenericGetAttr)
+    {
+      PyObject* descr { _PyType_Lookup(objType, attr) };
+      if (! descr)
+      {
+        kind = Kind::Dict;
+      }
+      else if (Py_TYPE(descr) == &PyMemberDescr_Type
+          && reinterpret_cast<PyMemberDescrObject*>(descr)->d_member->type == T_OBJECT_EX)
+      {
+        kind = Kind::Slot;
+        offset = reinterpret_cast<PyMemberDescrObject*>(descr)->d_member->offset;
+      }
+      else if (! PyType_HasFeature(Py_TYPE(descr), Py_TPFLAGS_HAVE_CLASS) || ! Py_TYPE(descr)->tp_descr_set)
+      {
+        kind = Kind::DictOrGeneric;
+      }
+    }
+    // _PyType_Lookup assigns a version tag to the type when possible
+    bool cacheable { PyType_HasFeature(objType, Py_TPFLAGS_VALID_VERSION_TAG) };
+    type = cacheable ? objType : nullptr;
+    version = cacheable ? objType->tp_version_tag : 0;
+  }
+  
+  bool valid(PyTypeObject* objType) const
+  {
+    return type == objType
+        && PyType_HasFeature(objType, Py_TPFLAGS_VALID_VERSION_TAG)
+        && version == objType->tp_version_tag;
+  }
+};
+
+// Item of the __dict__ of pyo (new reference), nullptr if missing
+static inline PyObject* _getInstanceDictItem(PyObject* pyo, PyObject* attr)
+{
+  PyObject** dictPtr { _PyObject_GetDictPtr(pyo) };
+  PyObject* pyo_item { dictPtr && *dictPtr ? PyDict_GetItem(*dictPtr, attr) : nullptr };
+  Py_XINCREF(pyo_item);
+  return pyo_item;
+}
+
+// Attribute attr of pyo (new reference), nullptr if it has no such attribute
+// Equivalent to _getAttrOrNull but reads the instance __dict__ or __slots__ directly when possible
+static inline PyObject* _getAttrCached(PyObject* pyo, PyObject* attr, _AttrCache& cache)
+{
+  if (PyInstance_Check(pyo))
+  {
+    // old-style instance: its __dict__ has priority over its class
+    // except for special names such as __dict__ or __class__
+    PyObject* pyo_item { PyDict_GetItem(reinterpret_cast<PyInstanceObject*>(pyo)->in_dict, attr) };
+    if (pyo_item && PyString_AS_STRING(attr)[0] != '_')
+    {
+      Py_INCREF(pyo_item);
+      return pyo_item;
+    }
+    return _getAttrOrNull(pyo, attr);
+  }
+  
+  if (! cache.valid(Py_TYPE(pyo)))
+  {
+    cache.resolve(Py_TYPE(pyo), attr);
+  }
+  switch (cache.kind)
+  {
+    case _AttrCache::Kind::Dict:
+      return _getInstanceDictItem(pyo, attr);
+    case _AttrCache::Kind::DictOrGeneric:
+    {
+      PyObject* pyo_item { _getInstanceDictItem(pyo, attr) };
+      return pyo_item ? pyo_item : _getAttrOrNull(pyo, attr);
+    }
+    case _AttrCache::Kind::Slot:
+    {
+      PyObject* pyo_item { *reinterpret_cast<PyObject**>(reinterpret_cast<char*>(pyo) + cache.offset) };
+      Py_XINCREF(pyo_item);
+      return pyo_item;
+    }
+    default:
+      return _getAttrOrNull(pyo, attr);
+  }
+}
+
+template <class OBJ, std::size_t pos, class FUNCTOR, class... Args>
+struct CppBuilderHelper<OBJ,pos,FUNCTOR,Args...>
+{
+  const _Setter<OBJ, FUNCTOR> setter;
+  const PyStringRef key; // interned name of the entry, unused for tuples
+  mutable _AttrCache attrCache; // how key is read on the instances of the last type seen
+  const FUNCTOR builder;
+  const CppBuilderHelper<OBJ, pos +1, Args...> subBuilder;
+  typedef CppBuilderHelper<OBJ, pos +1, Args...> next_type;
+  
+  // tuple's constructors
+  CppBuilderHelper(std::function<void(OBJ&, typename FUNCTOR::value_type)> fun, std::function<void(OBJ&, typename Args::value_type)>... args)
+      : setter(fun), key(), attrCache(), builder(), subBuilder(args...)
+  {}
+  CppBuilderHelper(typename FUNCTOR::value_type OBJ::*member, typename Args::value_type OBJ::*... args)
+      : setter(make_mapping("", member)), key(), attrCache(), builder(), subBuilder(args...)
+  {}
+  explicit CppBuilderHelper(_StaticFields tag)
+      : setter(), key(), attrCache(), builder(), subBuilder(tag)
+  {
+    static_assert(_Setter<OBJ, FUNCTOR>::is_static, "Only Field entries can be built without mapping");
+  }
+  
+  // full constructors  
+  CppBuilderHelper(
+        typename _Setter<OBJ, FUNCTOR>::mapping_type mapping
+        , typename _Setter<OBJ, Args>::mapping_type... args)
+      : setter(mapping), key(_internKey(_Setter<OBJ, FUNCTOR>::nameOf(mapping))), attrCache(), builder(), subBuilder(args...)
+  {}
+  
+  static PyStringRef _internKey(std::string const& name)
+  {
+    PyObject* interned { PyString_InternFromString(name.c_str()) };
+    if (! interned)
+    {
+      PyErr_Clear();
+      throw std::runtime_error("Unable to intern key: " + name);
+    }
+    return PyStringRef(interned);
+  }
+  
+  inline void fromDict(OBJ& obj, PyObject* pyo) const
+  {
+    PyObject *pyo_item { PyDict_GetItem(pyo, key.owner()) };
+    if (pyo_item)
+    {
+      setter.from(obj, builder, pyo_item);
+    }
+    subBuilder.fromDict(obj, pyo);
+  }
+  inline bool eligibleFromDict(PyObject* pyo) const
+  {
+    PyObject *pyo_item { PyDict_GetItem(pyo, key.owner()) };
+    return (! pyo_item || builder.eligible(pyo_item)) && subBuilder.eligibleFromDict(pyo);
+  }
+  inline bool tryFromDict(OBJ& obj, PyObject* pyo) const
+  {
+    PyObject *pyo_item { PyDict_GetItem(pyo, key.owner()) };
+    if (pyo_item)
+    {
+      Optional<typename FUNCTOR::value_type> value { builder.try_build(pyo_item) };
+      if (! value)
+      {
+        _ConversionTrail::atItem(key.owner());
+        return false;
+      }
+      setter(obj, std::move(*value));
+    }
+    return subBuilder.tryFromDict(obj, pyo);
+  }
+  
+  inline void fromObject(OBJ& obj, PyObject* pyo) const
+  {
+    std::unique_ptr<PyObject, decref> pyo_item { _getAttrCached(pyo, key.owner(), attrCache) };
+    if (pyo_item)
+    {
+      setter.from(obj, builder, pyo_item.get());
+    }
+    subBuilder.fromObject(obj, pyo);
+  }
+  inline bool eligibleFromObject(PyObject* pyo) const
+  {
+    std::unique_ptr<PyObject, decref> pyo_item { _getAttrCached(pyo, key.owner(), attrCache) };
+    return (! pyo_item || builder.eligible(pyo_item.get())) && subBuilder.eligibleFromObject(pyo);
+  }
+  inline bool tryFromObject(OBJ& obj, PyObject* pyo) const
+  {
+    std::unique_ptr<PyObject, decref> pyo_item { _getAttrCached(pyo, key.owner(), attrCache) };
+    if (pyo_item)
+    {
+      Optional<typename FUNCTOR::value_type> value { builder.try_build(pyo_item.get()) };
+      if (! value)
+      {
+        _ConversionTrail::atAttribute(key.owner());
+        return false;
+      }
+      setter(obj, std::move(*value));
+    }
+    return subBuilder.tryFromObject(obj, pyo);
+  }
+  
+  inline void fromTuple(OBJ& obj, PyObject* pyo) const
+  {
+    setter.from(obj, builder, PyTuple_GetItem(pyo, pos));
+    subBuilder.fromTuple(obj, pyo);
+  }
+  inline bool eligibleFromTuple(PyObject* pyo) const
+  {
+    return builder.eligible(PyTuple_GetItem(pyo, pos)) && subBuilder.eligibleFromTuple(pyo);
+  }
+  inline bool tryFromTuple(OBJ& obj, PyObject* pyo) const
+  {
+    Optional<typename FUNCTOR::value_type> value { builder.try_build(PyTuple_GetItem(pyo, pos)) };
+    if (! value)
+    {
+      _ConversionTrail::atIndex(pos);
+      return false;
+    }
+    setter(obj, std::move(*value));
+    return subBuilder.tryFromTuple(obj, pyo);
+  }
+  
+  template <class ROOT>
+  inline void collectFields(std::vector<_ScanField<OBJ, ROOT>>& fields) const
+  {
+    _ScanField<OBJ, ROOT> field { key.owner(), PyObject_Hash(key.owner()), &scanSet<ROOT>, &scanEligible<ROOT>, &scanTrySet<ROOT> };
+    fields.push_back(field);
+    subBuilder.collectFields(fields);
+  }
+  template <class ROOT>
+  static void scanSet(ROOT const& root, OBJ& obj, PyObject* pyo_item)
+  {
+    CppBuilderHelper const& self = _HelperAt<pos, ROOT>::get(root);
+    self.setter.from(obj, self.builder, pyo_item);
+  }
+  template <class ROOT>
+  static bool scanEligible(ROOT const& root, PyObject* pyo_item)
+  {
+    return _HelperAt<pos, ROOT>::get(root).builder.eligible(pyo_item);
+  }
+  template <class ROOT>
+  static bool scanTrySet(ROOT const& root, OBJ& obj, PyObject* pyo_item)
+  {
+    CppBuilderHelper const& self = _HelperAt<pos, ROOT>::get(root);
+    Optional<typename FUNCTOR::value_type> value { self.builder.try_build(pyo_item) };
+    if (! value)
+    {
+      return false;
+    }
+    self.setter(obj, std::move(*value));
+    return true;
+  }
+};
+
+template <std::size_t N, class HELPER>
+struct _HelperAt
+{
+  typedef typename _HelperAt<N -1, typename HELPER::next_type>::type type;
+  static type const& get(HELPER const& helper)
+  {
+    return _HelperAt<N -1, typename HELPER::next_type>::get(helper.subBuilder);
+  }
+};
+
+template <class HELPER>
+struct _HelperAt<0, HELPER>
+{
+  typedef HELPER type;
+  static type const& get(HELPER const& helper)
+  {
+    return helper;
+  }
+};
+
+template <class OBJ, class... Args>
+struct CppBuilder<FromTuple<OBJ, Args...>>
+{
+  typedef OBJ value_type;
+  const CppBuilderHelper<OBJ, 0, ToBuildable<Args>...> subBuilder;
+  
+  CppBuilder(std::function<void(OBJ&, typename ToBuildable<Args>::value_type)>... args)
+      : subBuilder(args...)
+  {}
+  
+  CppBuilder(typename ToBuildable<Args>::value_type OBJ::*... args)
+      : subBuilder(args...)
+  {}
+  
+  // only Field entries
+  template <class TAG = _StaticFields>
+  CppBuilder()
+      : subBuilder(TAG())
+  {}
+  
+  value_type operator() (PyObject* pyo) const
+  {
+    OBJ obj;
+    build_into(obj, pyo);
+    return obj;
+  }
+  void build_into(value_type& out, PyObject* pyo) const
+  {
+    assert(pyo);
+    _StatsScope<CppBuilder> stats;
+    
+    if (PyTuple_Check(pyo))
+    {
+      if (PyTuple_Size(pyo) == sizeof...(Args))
+      {
+        subBuilder.fromTuple(out, pyo);
+        return;
+      }
+      else
+      {
+        std::ostringstream oss;
+        oss << "PyTuple length differs from asked one: "
+            << "PyTuple(" << PyTuple_Size(pyo) << ") "
+            << "and FromTuple<...>(" << sizeof...(Args) << ")";
+        throw std::invalid_argument(oss.str());
+      }
+    }
+    throw std::invalid_argument("Not a PyTuple instance");
+  }
+  bool eligible(PyObject* pyo) const
+  {
+    return (PyTuple_Check(pyo)
+            && PyTuple_Size(pyo) == sizeof...(Args)
+            && subBuilder.eligibleFromTuple(pyo))
+        || _rejected<CppBuilder>();
+  }
+  Optional<value_type> try_build(PyObject* pyo) const
+  {
+    if (! PyTuple_Check(pyo))
+    {
+      return _rejectedHere<CppBuilder>();
+    }
+    if (PyTuple_Size(pyo) != sizeof...(Args))
+    {
+      return _rejectedHere<CppBuilder>(ConversionErrc::length_mismatch);
+    }
+    _StatsScope<CppBuilder> stats;
+    OBJ obj;
+    if (! subBuilder.tryFromTuple(obj, pyo))
+    {
+      return _rejected<CppBuilder>();
+    }
+    return std::move(obj);
+  }
+};
+
+template <class OBJ, class... Args>
+struct CppBuilder<FromDict<OBJ, Args...>>
+{
+  typedef OBJ value_type;
+  CppBuilderHelper<OBJ, 0, ToBuildable<Args>...> subBuilder;
+  
+  CppBuilder(typename _Setter<OBJ, ToBuildable<Args>>::mapping_type... args)
+      : subBuilder(args...)
+  {}
+  
+  value_type operator() (PyObject* pyo) const
+  {
+    OBJ obj;
+    build_into(obj, pyo);
+    return obj;
+  }
+  void build_into(value_type& out, PyObject* pyo) const
+  {
+    assert(pyo);
+    _StatsScope<CppBuilder> stats;
+    
+    if (PyDict_Check(pyo))
+    {
+      subBuilder.fromDict(out, pyo);
+    }
+    else
+    {
+      subBuilder.fromObject(out, pyo);
+    }
+  }
+  bool eligible(PyObject* pyo) const
+  {
+    if (PyDict_Check(pyo))
+    {
+      return subBuilder.eligibleFromDict(pyo) || _rejected<CppBuilder>();
+    }
+    else
+    {
+      return subBuilder.eligibleFromObject(pyo) || _rejected<CppBuilder>();
+    }
+  }
+  Optional<value_type> try_build(PyObject* pyo) const
+  {
+    _StatsScope<CppBuilder> stats;
+    OBJ obj;
+    bool success { PyDict_Check(pyo)
+        ? subBuilder.tryFromDict(obj, pyo)
+        : subBuilder.tryFromObject(obj, pyo) };
+    if (! success)
+    {
+      return _rejected<CppBuilder>();
+    }
+    return std::move(obj);
+  }
+};
+
+
+// Key of a SchemaEntry interned on first use and kept alive until the end of the process
+static inline PyObject* _internSchemaKey(const char* name)
+{
+  PyObject* interned { PyString_InternFromString(name) };
+  if (! interned)
+  {
+    PyErr_Clear();
+    throw std::runtime_error(std::string("Unable to intern key: ") + name);
+  }
+  return interned;
+}
+
+template <class KEY>
+static inline PyObject* _schemaKey()
+{
+  static PyObject* const key { _internSchemaKey(KEY::name()) };
+  return key;
+}
+
+// Entry of CppBuilder<FromSchema<...>>: reads the value of KEY::name() and stores it with FIELD
+// the attribute cache is shared by all the builders of the entry, the GIL protects it
+template <class OBJ, class KEY, class FIELD>
+struct _SchemaSetter
+{
+  static _AttrCache& attrCache()
+  {
+    static _AttrCache cache;
+    return cache;
+  }
+  
+  static void fromDict(OBJ& obj, PyObject* pyo)
+  {
+    PyObject* pyo_item { PyDict_GetItem(pyo, _schemaKey<KEY>()) };
+    if (pyo_item)
+    {
+      FIELD::set_from(obj, FIELD(), pyo_item);
+    }
+  }
+  static bool eligibleFromDict(PyObject* pyo)
+  {
+    PyObject* pyo_item { PyDict_GetItem(pyo, _schemaKey<KEY>()) };
+    return ! pyo_item || FIELD().eligible(pyo_item);
+  }
+  static bool tryFromDict(OBJ& obj, PyObject* pyo)
+  {
+    if (! trySet(obj, PyDict_GetItem(pyo, _schemaKey<KEY>())))
+    {
+      _ConversionTrail::atItem(_schemaKey<KEY>());
+      return false;
+    }
+    return true;
+  }
+  
+  static void fromObject(OBJ& obj, PyObject* pyo)
+  {
+    std::unique_ptr<PyObject, decref> pyo_item { _getAttrCached(pyo, _schemaKey<KEY>(), attrCache()) };
+    if (pyo_item)
+    {
+      FIELD::set_from(obj, FIELD(), pyo_item.get());
+    }
+  }
+  static bool eligibleFromObject(PyObject* pyo)
+  {
+    std::unique_ptr<PyObject, decref> pyo_item { _getAttrCached(pyo, _schemaKey<KEY>(), attrCache()) };
+    return ! pyo_item || FIELD().eligible(pyo_item.get());
+  }
+  static bool tryFromObject(OBJ& obj, PyObject* pyo)
+  {
+    std::unique_ptr<PyObject, decref> pyo_item { _getAttrCached(pyo, _schemaKey<KEY>(), attrCache()) };
+    if (! trySet(obj, pyo_item.get()))
+    {
+      _ConversionTrail::atAttribute(_schemaKey<KEY>());
+      return false;
+    }
+    return true;
+  }
+
+private:
+  static bool trySet(OBJ& obj, PyObject* pyo_item)
+  {
+    if (pyo_item)
+    {
+      Optional<typename FIELD::value_type> value { FIELD().try_build(pyo_item) };
+      if (! value)
+      {
+        return false;
+      }
+      FIELD::set(obj, std::move(*value));
+    }
+    return true;
+  }
+};
+
+template <class OBJ, class... KEYS, class... FIELDS>
+struct CppBuilder<FromSchema<OBJ, SchemaEntry<KEYS, FIELDS>...>>
 {
-  typedef std::string value_type;
+  typedef OBJ value_type;
+  
   value_type operator() (PyObject* pyo) const
+  {
+    OBJ obj;
+    build_into(obj, pyo);
+    return obj;
+  }
+  void build_into(value_type& out, PyObject* pyo) const
   {
     assert(pyo);
-    if (PyString_Check(pyo))
+    _StatsScope<CppBuilder> stats;
+    
+    if (PyDict_Check(pyo))
     {
-      long int size { PyString_Size(pyo) };
-      if (size < 0)
-      {
-        throw std::runtime_error("Unable to retrieve C/C++ string from PyString");
-      }
-      return std::string(PyString_AsString(pyo), size);
+      int dummy[] = { 0, (_SchemaSetter<OBJ, KEYS, FIELDS>::fromDict(out, pyo), 0)... };
+      (void)dummy;
     }
-    else if (PyUnicode_Check(pyo))
+    else
+    {
+      int dummy[] = { 0, (_SchemaSetter<OBJ, KEYS, FIELDS>::fromObject(out, pyo), 0)... };
+      (void)dummy;
+    }
+  }
+  bool eligible(PyObject* pyo) const
+  {
+    bool success { true };
+    if (PyDict_Check(pyo))
+    {
+      int dummy[] = { 0, (success = success && _SchemaSetter<OBJ, KEYS, FIELDS>::eligibleFromDict(pyo), 0)... };
+      (void)dummy;
+    }
+    else
+    {
+      int dummy[] = { 0, (success = success && _SchemaSetter<OBJ, KEYS, FIELDS>::eligibleFromObject(pyo), 0)... };
+      (void)dummy;
+    }
+    return success || _rejected<CppBuilder>();
+  }
+  Optional<value_type> try_build(PyObject* pyo) const
+  {
+    _StatsScope<CppBuilder> stats;
+    OBJ obj;
+    bool success { true };
+    if (PyDict_Check(pyo))
+    {
+      int dummy[] = { 0, (success = success && _SchemaSetter<OBJ, KEYS, FIELDS>::tryFromDict(obj, pyo), 0)... };
+      (void)dummy;
+    }
+    else
+    {
+      int dummy[] = { 0, (success = success && _SchemaSetter<OBJ, KEYS, FIELDS>::tryFromObject(obj, pyo), 0)... };
+      (void)dummy;
+    }
+    if (! success)
+    {
+      return _rejected<CppBuilder>();
+    }
+    return std::move(obj);
+  }
+};
+
+// Perfect hash table dispatching the keys of a dict to the fields they are mapped to
+// slot of a key: (hash * multiplier) >> shift, multiplier is searched at construction
+template <class OBJ, class ROOT>
+class _ScanTable
+{
+  std::vector<_ScanField<OBJ, ROOT>> slots;
+  std::size_t multiplier;
+  unsigned shift;
+  
+  std::size_t slotOf(long hash) const
+  {
+    return (static_cast<std::size_t>(hash) * multiplier) >> shift;
+  }
+  
+public:
+  explicit _ScanTable(std::vector<_ScanField<OBJ, ROOT>> const& fields) : slots(), multiplier(1), shift(0)
+  {
+    const unsigned numBits { static_cast<unsigned>(sizeof(std::size_t) * CHAR_BIT) };
+    unsigned bits { 1 };
+    while ((std::size_t(1) << bits) < 2 * fields.size())
+    {
+      ++bits;
+    }
+    std::uint64_t seed { 0x9e3779b97f4a7c15ULL };
+    for ( ; bits < numBits && (std::size_t(1) << bits) <= 64 * fields.size() + 64 ; ++bits)
     {
-      long int size { PyUnicode_GetSize(pyo) };
-      if (size < 0)
+      for (unsigned attempt { 0 } ; attempt != 64 ; ++attempt)
       {
-        throw std::runtime_error("Unable to retrieve C/C++ string from PyUnicode");
+        seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+        multiplier = static_cast<std::size_t>(seed >> 1) | 1;
+        shift = numBits - bits;
+        slots.assign(std::size_t(1) << bits, _ScanField<OBJ, ROOT>());
+        bool perfect { true };
+        for (auto const& field : fields)
+        {
+          _ScanField<OBJ, ROOT>& slot = slots[slotOf(field.hash)];
+          if (slot.key)
+          {
+            perfect = false;
+            break;
+          }
+          slot = field;
+        }
+        if (perfect)
+        {
+          return;
+        }
       }
-      wchar_t wstr[size];
-      PyUnicode_AsWideChar(reinterpret_cast<PyUnicodeObject*>(pyo), wstr, size);
-      std::wstring wide(wstr, size);
-      return std::string(wide.begin(), wide.end());
     }
-    throw std::invalid_argument("Neither a PyString nor a PyUnicode instance");
+    throw std::invalid_argument("Unable to build a perfect hash table for FromDictScan: duplicated keys?");
   }
-  bool eligible(PyObject* pyo) const
+  
+  // field mapped to key, nullptr if none
+  _ScanField<OBJ, ROOT> const* find(PyObject* key, long hash) const
   {
-    return PyString_Check(pyo) || PyUnicode_Check(pyo);
+    _ScanField<OBJ, ROOT> const& slot = slots[slotOf(hash)];
+    if (slot.key == key)
+    {
+      return &slot;
+    }
+    if (! slot.key || slot.hash != hash)
+    {
+      return nullptr;
+    }
+    if (PyString_CheckExact(key))
+    {
+      return PyString_GET_SIZE(key) == PyString_GET_SIZE(slot.key)
+          && std::memcmp(PyString_AS_STRING(key), PyString_AS_STRING(slot.key), PyString_GET_SIZE(key)) == 0
+          ? &slot : nullptr;
+    }
+    int equal { PyObject_RichCompareBool(slot.key, key, Py_EQ) };
+    if (equal < 0)
+    {
+      PyErr_Clear();
+    }
+    return equal > 0 ? &slot : nullptr;
   }
 };
-template <> struct ToBuildable<std::string> : CppBuilder<std::string> {};
 
-template <>
-struct CppBuilder<std::wstring>
+template <class OBJ, class... Args>
+struct CppBuilder<FromDictScan<OBJ, Args...>>
 {
-  typedef std::wstring value_type;
+  typedef OBJ value_type;
+  typedef CppBuilderHelper<OBJ, 0, ToBuildable<Args>...> helper_type;
+  helper_type subBuilder;
+  _ScanTable<OBJ, helper_type> table;
+  
+  CppBuilder(typename _Setter<OBJ, ToBuildable<Args>>::mapping_type... args)
+      : subBuilder(args...), table(_collectFields(subBuilder))
+  {}
+  
+  static std::vector<_ScanField<OBJ, helper_type>> _collectFields(helper_type const& helper)
+  {
+    std::vector<_ScanField<OBJ, helper_type>> fields;
+    fields.reserve(sizeof...(Args));
+    helper.collectFields(fields);
+    return fields;
+  }
+  
   value_type operator() (PyObject* pyo) const
+  {
+    OBJ obj;
+    build_into(obj, pyo);
+    return obj;
+  }
+  void build_into(value_type& out, PyObject* pyo) const
   {
     assert(pyo);
-    if (PyString_Check(pyo))
+    _StatsScope<CppBuilder> stats;
+    
+    if (PyDict_Check(pyo))
     {
-      const char* str { PyString_AsString(pyo) };
-      long int size { PyString_Size(pyo) };
-      if (size < 0)
+      PyObject *key, *value;
+      long hash;
+      Py_ssize_t pos = 0;
+      while (_PyDict_Next(pyo, &pos, &key, &value, &hash))
       {
-        throw std::runtime_error("Unable to retrieve C/C++ string from PyString");
+        if (_ScanField<OBJ, helper_type> const* field { table.find(key, hash) })
+        {
+          field->set(subBuilder, out, value);
+        }
       }
-      wchar_t wstr[size];
-      mbstowcs(wstr, str, size);
-      return std::wstring(wstr, size);
     }
-    else if (PyUnicode_Check(pyo))
+    else
+    {
+      subBuilder.fromObject(out, pyo);
+    }
+  }
+  bool eligible(PyObject* pyo) const
+  {
+    if (PyDict_Check(pyo))
     {
-      long int size { PyUnicode_GetSize(pyo) };
-      if (size < 0)
+      PyObject *key, *value;
+      long hash;
+      Py_ssize_t pos = 0;
+      while (_PyDict_Next(pyo, &pos, &key, &value, &hash))
       {
-        throw std::runtime_error("Unable to retrieve C/C++ string from PyUnicode");
+        _ScanField<OBJ, helper_type> const* field { table.find(key, hash) };
+        if (field && ! field->eligible(subBuilder, value))
+        {
+          return _rejected<CppBuilder>();
+        }
       }
-      wchar_t wstr[size];
-      PyUnicode_AsWideChar(reinterpret_cast<PyUnicodeObject*>(pyo), wstr, size);
-      return std::wstring(wstr, size);
+      return true;
+    }
+    else
+    {
+      return subBuilder.eligibleFromObject(pyo) || _rejected<CppBuilder>();
     }
-    throw std::invalid_argument("Neither a PyString nor a PyUnicode instance");
   }
-  bool eligible(PyObject* pyo) const
+  Optional<value_type> try_build(PyObject* pyo) const
   {
-    return PyString_Check(pyo) || PyUnicode_Check(pyo);
+    _StatsScope<CppBuilder> stats;
+    OBJ obj;
+    if (PyDict_Check(pyo))
+    {
+      PyObject *key, *value;
+      long hash;
+      Py_ssize_t pos = 0;
+      while (_PyDict_Next(pyo, &pos, &key, &value, &hash))
+      {
+        _ScanField<OBJ, helper_type> const* field { table.find(key, hash) };
+        if (field && ! field->trySet(subBuilder, obj, value))
+        {
+          _ConversionTrail::atItem(key);
+          return _rejected<CppBuilder>();
+        }
+      }
+    }
+    else if (! subBuilder.tryFromObject(obj, pyo))
+    {
+      return _rejected<CppBuilder>();
+    }
+    return std::move(obj);
   }
 };
-template <> struct ToBuildable<std::wstring> : CppBuilder<std::wstring> {};
+
 
 /**
- * Tuple builder
+ * C++ towards Python
  */
 
-template <class TUPLE, std::size_t pos>
-static inline void _feedCppTuple(TUPLE& tuple, PyObject* root)
-{}
-
-template <class TUPLE, std::size_t pos, class T, class... Args>
-static inline void _feedCppTuple(TUPLE& tuple, PyObject* root)
+// Takes ownership of a new reference returned by the Python C API
+static inline PyObject* _newRef(PyObject* pyo)
 {
-  std::get<pos>(tuple) = ToBuildable<T>()(PyTuple_GetItem(root, pos));
-  _feedCppTuple<TUPLE, pos +1, Args...>(tuple, root);
+  if (! pyo)
+  {
+    PyErr_Clear();
+    throw std::runtime_error("Unable to create the PyObject");
+  }
+  return pyo;
 }
 
-template <class TUPLE, std::size_t pos>
-static inline bool _checkEligibleCppTuple(PyObject* root)
+template <>
+struct PyBuilder<PyObject*>
 {
-  return true;
-}
+  PyObject* operator() (PyObject* value) const
+  {
+    PyObject* pyo { value ? value : Py_None };
+    Py_INCREF(pyo);
+    return pyo;
+  }
+};
 
-template <class TUPLE, std::size_t pos, class T, class... Args>
-static inline bool _checkEligibleCppTuple(PyObject* root)
+template <>
+struct PyBuilder<bool>
 {
-  return ToBuildable<T>().eligible(PyTuple_GetItem(root, pos))
-      && _checkEligibleCppTuple<TUPLE, pos +1, Args...>(root);
-}
+  PyObject* operator() (bool value) const
+  {
+    PyObject* pyo { value ? Py_True : Py_False };
+    Py_INCREF(pyo);
+    return pyo;
+  }
+};
 
-template <class... Args>
-struct CppBuilder<std::tuple<Args...>>
+// PyInt when the value fits into a long, PyLong otherwise
+template <class T>
+struct _PyIntegerBuilder
 {
-  typedef std::tuple<typename ToBuildable<Args>::value_type...> value_type;
-  value_type operator() (PyObject* pyo) const
+  PyObject* operator() (T value) const
   {
-    assert(pyo);
-    if (PyTuple_Check(pyo))
+    if (std::is_signed<T>::value
+        ? (sizeof(T) <= sizeof(long) || (static_cast<long long>(value) >= LONG_MIN && static_cast<long long>(value) <= LONG_MAX))
+        : static_cast<unsigned long long>(value) <= static_cast<unsigned long long>(LONG_MAX))
     {
-      if (PyTuple_Size(pyo) == sizeof...(Args))
-      {
-        value_type tuple { std::make_tuple(typename ToBuildable<Args>::value_type()...) };
-        _feedCppTuple<value_type, 0, Args...>(tuple, pyo);
-        return tuple;
-      }
-      else
-      {
-        std::ostringstream oss;
-        oss << "PyTuple length differs from asked one: "
-            << "PyTuple(" << PyTuple_Size(pyo) << ") "
-            << "and std::tuple<...>(" << sizeof...(Args) << ")";
-        throw std::invalid_argument(oss.str());
-      }
+      return _newRef(PyInt_FromLong(static_cast<long>(value)));
     }
-    throw std::invalid_argument("Not a PyTuple instance");
+    return _newRef(std::is_signed<T>::value
+        ? PyLong_FromLongLong(static_cast<long long>(value))
+        : PyLong_FromUnsignedLongLong(static_cast<unsigned long long>(value)));
   }
-  bool eligible(PyObject* pyo) const
+};
+template <> struct PyBuilder<int> : _PyIntegerBuilder<int> {};
+template <> struct PyBuilder<unsigned int> : _PyIntegerBuilder<unsigned int> {};
+template <> struct PyBuilder<long> : _PyIntegerBuilder<long> {};
+template <> struct PyBuilder<unsigned long> : _PyIntegerBuilder<unsigned long> {};
+template <> struct PyBuilder<long long> : _PyIntegerBuilder<long long> {};
+template <> struct PyBuilder<unsigned long long> : _PyIntegerBuilder<unsigned long long> {};
+
+template <>
+struct PyBuilder<double>
+{
+  PyObject* operator() (double value) const
   {
-    return PyTuple_Check(pyo)
-        && PyTuple_Size(pyo) == sizeof...(Args)
-        && _checkEligibleCppTuple<value_type, 0, Args...>(pyo);
+    return _newRef(PyFloat_FromDouble(value));
   }
 };
-template <class... Args> struct ToBuildable<std::tuple<Args...>> : CppBuilder<std::tuple<Args...>> {};
 
-/**
- * Vector builder
- */
+template <class ALLOC>
+struct PyBuilder<std::basic_string<char, std::char_traits<char>, ALLOC>>
+{
+  PyObject* operator() (std::basic_string<char, std::char_traits<char>, ALLOC> const& value) const
+  {
+    return _newRef(PyString_FromStringAndSize(value.data(), value.size()));
+  }
+};
 
-template <class T>
-struct CppBuilder<std::vector<T>>
+template <class ALLOC>
+struct PyBuilder<std::basic_string<wchar_t, std::char_traits<wchar_t>, ALLOC>>
 {
-  typedef std::vector<typename ToBuildable<T>::value_type> value_type;
-  value_type operator() (PyObject* pyo) const
+  PyObject* operator() (std::basic_string<wchar_t, std::char_traits<wchar_t>, ALLOC> const& value) const
   {
-    assert(pyo);
-    if (PyList_Check(pyo))
-    {
-      unsigned int i { 0 };
-      value_type v(PyList_Size(pyo));
-      for (typename value_type::iterator it { v.begin() } ; it != v.end() ; ++it, ++i)
-      {
-        *it = ToBuildable<T>()(PyList_GetItem(pyo, i));
-      }
-      return v;
-    }
-    throw std::invalid_argument("Not a PyList instance");
+    return _newRef(PyUnicode_FromWideChar(value.data(), value.size()));
   }
-  bool eligible(PyObject* pyo) const
+};
+
+template <>
+struct PyBuilder<InternedString>
+{
+  PyObject* operator() (InternedString const& value) const
   {
-    if (! PyList_Check(pyo))
-    {
-      return false;
-    }
-    for (Py_ssize_t i { 0 } ; i != PyList_Size(pyo) ; ++i)
+    return _newRef(PyString_FromStringAndSize(value.data(), value.size()));
+  }
+};
+
+// the PyString the view borrows from
+template <>
+struct PyBuilder<PyStringRef>
+{
+  PyObject* operator() (PyStringRef const& value) const
+  {
+    if (! value.owner())
     {
-      if (! ToBuildable<T>().eligible(PyList_GetItem(pyo, i)))
-      {
-        return false;
-      }
+      return _newRef(PyString_FromStringAndSize("", 0));
     }
-    return true;
+    Py_INCREF(value.owner());
+    return value.owner();
   }
 };
-template <class T> struct ToBuildable<std::vector<T>> : CppBuilder<std::vector<T>> {};
-
-/**
- * Set builder
- */
 
-namespace
+template <class... Args>
+struct PyBuilder<std::tuple<Args...>>
 {
-  template <class T>
-  struct CppBuilderSetHelper
+  PyObject* operator() (std::tuple<Args...> const& value) const
   {
-    typedef std::set<typename ToBuildable<T>::value_type> value_type;
+    std::unique_ptr<PyObject, decref> pyo { _newRef(PyTuple_New(sizeof...(Args))) };
+    fill(pyo.get(), value, typename _MakeIndexSequence<sizeof...(Args)>::type());
+    return pyo.release();
+  }
 
-    PyObject *pyo;
-    std::vector<PyObject*> backup;
+private:
+  template <std::size_t... Is>
+  static void fill(PyObject* pyo, std::tuple<Args...> const& value, _IndexSequence<Is...>)
+  {
+    int dummy[] = { 0, (PyTuple_SET_ITEM(pyo, Is, PyBuilder<Args>()(std::get<Is>(value))), 0)... };
+    (void)dummy;
+  }
+};
 
-    CppBuilderSetHelper(PyObject* pyo) : pyo(pyo), backup()
-    {}
+template <class T, class ALLOC>
+struct PyBuilder<std::vector<T, ALLOC>>
+{
+  PyObject* operator() (std::vector<T, ALLOC> const& value) const
+  {
+    std::unique_ptr<PyObject, decref> pyo { _newRef(PyList_New(value.size())) };
+    PyBuilder<T> builder;
+    Py_ssize_t pos { 0 };
+    for (auto const& item : value)
+    {
+      PyList_SET_ITEM(pyo.get(), pos++, builder(item));
+    }
+    return pyo.release();
+  }
+};
 
-    value_type build()
+// Python has no presized set
+template <class SET>
+static inline PyObject* _pySetOf(SET const& value)
+{
+  std::unique_ptr<PyObject, decref> pyo { _newRef(PySet_New(nullptr)) };
+  PyBuilder<typename SET::key_type> builder;
+  for (auto const& item : value)
+  {
+    std::unique_ptr<PyObject, decref> pyo_item { builder(item) };
+    if (PySet_Add(pyo.get(), pyo_item.get()) != 0)
     {
-      value_type s;
-      long size { PySet_Size(pyo) };
-      for (long i { 0 } ; i != size ; ++i)
-      {
-        PyObject* popped { PySet_Pop(pyo) };
-        backup.push_back(popped);
-        s.insert(ToBuildable<T>()(popped));
-      }
-      return s;
+      PyErr_Clear();
+      throw std::runtime_error("Unable to add an item to the PySet");
     }
-    
-    bool eligible()
+  }
+  return pyo.release();
+}
+
+template <class MAP>
+static inline PyObject* _pyDictOf(MAP const& value)
+{
+  std::unique_ptr<PyObject, decref> pyo { _newRef(_PyDict_NewPresized(value.size())) };
+  PyBuilder<typename MAP::key_type> keyBuilder;
+  PyBuilder<typename MAP::mapped_type> valueBuilder;
+  for (auto const& item : value)
+  {
+    std::unique_ptr<PyObject, decref> pyo_key { keyBuilder(item.first) };
+    std::unique_ptr<PyObject, decref> pyo_value { valueBuilder(item.second) };
+    if (PyDict_SetItem(pyo.get(), pyo_key.get(), pyo_value.get()) != 0)
     {
-      long size { PySet_Size(pyo) };
-      for (long i { 0 } ; i != size ; ++i)
-      {
-        PyObject* popped { PySet_Pop(pyo) };
-        backup.push_back(popped);
-        if (! ToBuildable<T>().eligible(popped))
-        {
-          return false;
-        }
-      }
-      return true;
+      PyErr_Clear();
+      throw std::runtime_error("Unable to add an item to the PyDict");
     }
+  }
+  return pyo.release();
+}
+
+template <class T, class COMPARE, class ALLOC>
+struct PyBuilder<std::set<T, COMPARE, ALLOC>>
+{
+  PyObject* operator() (std::set<T, COMPARE, ALLOC> const& value) const
+  {
+    return _pySetOf(value);
+  }
+};
+
+template <class T, class HASH, class EQUAL, class ALLOC>
+struct PyBuilder<std::unordered_set<T, HASH, EQUAL, ALLOC>>
+{
+  PyObject* operator() (std::unordered_set<T, HASH, EQUAL, ALLOC> const& value) const
+  {
+    return _pySetOf(value);
+  }
+};
+
+template <class K, class T, class COMPARE, class ALLOC>
+struct PyBuilder<std::map<K, T, COMPARE, ALLOC>>
+{
+  PyObject* operator() (std::map<K, T, COMPARE, ALLOC> const& value) const
+  {
+    return _pyDictOf(value);
+  }
+};
 
-    ~CppBuilderSetHelper()
-    {
-      for (auto& popped : backup)
-      {
-         PySet_Add(pyo, popped);
-         Py_DECREF(popped);
-      }
-    }
-  };
+template <class K, class T, class HASH, class EQUAL, class ALLOC>
+struct PyBuilder<std::unordered_map<K, T, HASH, EQUAL, ALLOC>>
+{
+  PyObject* operator() (std::unordered_map<K, T, HASH, EQUAL, ALLOC> const& value) const
+  {
+    return _pyDictOf(value);
+  }
+};
+
+// Stores the data member of FIELD into the dict pyo
+template <class FIELD, class OBJ>
+static inline void _setDictField(PyObject* pyo, PyObject* key, OBJ const& value)
+{
+  std::unique_ptr<PyObject, decref> pyo_value { PyBuilder<typename FIELD::member_type>()(FIELD::get(value)) };
+  if (PyDict_SetItem(pyo, key, pyo_value.get()) != 0)
+  {
+    PyErr_Clear();
+    throw std::runtime_error("Unable to add an item to the PyDict");
+  }
 }
 
-template <class T>
-struct CppBuilder<std::set<T>>
+// Classes declared with PY2CPP_STRUCT give a dict
+template <class OBJ, class... KEYS, class... FIELDS>
+struct PyBuilder<FromSchema<OBJ, SchemaEntry<KEYS, FIELDS>...>>
 {
-  typedef std::set<typename ToBuildable<T>::value_type> value_type;
-  value_type operator() (PyObject* pyo) const
+  PyObject* operator() (OBJ const& value) const
   {
-    assert(pyo);
-    if (PySet_Check(pyo))
-    {
-      CppBuilderSetHelper<T> helper(pyo);
-      return helper.build();
-    }
-    throw std::invalid_argument("Not a PySet instance");
+    std::unique_ptr<PyObject, decref> pyo { _newRef(_PyDict_NewPresized(sizeof...(FIELDS))) };
+    int dummy[] = { 0, (_setDictField<FIELDS>(pyo.get(), _schemaKey<KEYS>(), value), 0)... };
+    (void)dummy;
+    return pyo.release();
   }
-  bool eligible(PyObject* pyo) const
+};
+template <class T> struct PyBuilder<T, typename _VoidOf<typename T::py2cpp_schema>::type> : PyBuilder<typename T::py2cpp_schema> {};
+
+template <class OBJ, class... FIELDS>
+struct PyBuilder<FromTuple<OBJ, FIELDS...>>
+{
+  PyObject* operator() (OBJ const& value) const
   {
-    if (! PySet_Check(pyo))
-    {
-      return false;
-    }
-    CppBuilderSetHelper<T> helper(pyo);
-    return helper.eligible();
+    std::unique_ptr<PyObject, decref> pyo { _newRef(PyTuple_New(sizeof...(FIELDS))) };
+    fill(pyo.get(), value, typename _MakeIndexSequence<sizeof...(FIELDS)>::type());
+    return pyo.release();
+  }
+
+private:
+  template <std::size_t... Is>
+  static void fill(PyObject* pyo, OBJ const& value, _IndexSequence<Is...>)
+  {
+    int dummy[] = { 0, (PyTuple_SET_ITEM(pyo, Is, PyBuilder<typename FIELDS::member_type>()(FIELDS::get(value))), 0)... };
+    (void)dummy;
   }
 };
-template <class T> struct ToBuildable<std::set<T>> : CppBuilder<std::set<T>> {};
 
-/**
- * Map builder
- */
+template <class OBJ, class... FIELDS>
+struct PyBuilder<FromDict<OBJ, FIELDS...>>
+{
+  const std::array<PyStringRef, sizeof...(FIELDS)> keys; // interned when the builder is constructed
 
-template <class K, class T>
-struct CppBuilder<std::map<K,T>>
+  template <class... Keys>
+  explicit PyBuilder(Keys const&... names)
+      : keys {{ PyStringRef(_newRef(PyString_InternFromString(std::string(names).c_str())))... }}
+  {
+    static_assert(sizeof...(Keys) == sizeof...(FIELDS), "PyBuilder<FromDict<...>> needs one key per field");
+  }
+
+  PyObject* operator() (OBJ const& value) const
+  {
+    std::unique_ptr<PyObject, decref> pyo { _newRef(_PyDict_NewPresized(sizeof...(FIELDS))) };
+    fill(pyo.get(), value, typename _MakeIndexSequence<sizeof...(FIELDS)>::type());
+    return pyo.release();
+  }
+
+private:
+  template <std::size_t... Is>
+  void fill(PyObject* pyo, OBJ const& value, _IndexSequence<Is...>) const
+  {
+    int dummy[] = { 0, (_setDictField<FIELDS>(pyo, keys[Is].owner(), value), 0)... };
+    (void)dummy;
+  }
+};
+
+// Views give back the object they read
+template <class T>
+struct PyBuilder<BufferView<T>>
 {
-  typedef std::map<typename ToBuildable<K>::value_type, typename ToBuildable<T>::value_type> value_type;
-  value_type operator() (PyObject* pyo) const
+  PyObject* operator() (BufferView<T> const& value) const
   {
-    assert(pyo);
-    if (PyDict_Check(pyo))
-    {
-      value_type dict;
-      PyObject *key, *value;
-      Py_ssize_t pos = 0;
-      while (PyDict_Next(pyo, &pos, &key, &value))
-      {
-        dict[ToBuildable<K>()(key)] = ToBuildable<T>()(value);
-      }
-      return dict;
-    }
-    throw std::invalid_argument("Not a PyDict instance");
+    return PyBuilder<PyObject*>()(value.owner());
   }
-  bool eligible(PyObject* pyo) const
+};
+template <class T, bool MEMOIZE>
+struct PyBuilder<LazyVector<T, MEMOIZE>>
+{
+  PyObject* operator() (LazyVector<T, MEMOIZE> const& value) const
   {
-    if (! PyDict_Check(pyo))
-    {
-      return false;
-    }
-    PyObject *key, *value;
-    Py_ssize_t pos = 0;
-    while (PyDict_Next(pyo, &pos, &key, &value))
-    {
-      if (! ToBuildable<K>().eligible(key) || ! ToBuildable<T>().eligible(value))
-      {
-        return false;
-      }
-    }
-    return true;
+    return PyBuilder<PyObject*>()(value.owner());
+  }
+};
+template <class K, class T, bool MEMOIZE>
+struct PyBuilder<LazyMap<K, T, MEMOIZE>>
+{
+  PyObject* operator() (LazyMap<K, T, MEMOIZE> const& value) const
+  {
+    return PyBuilder<PyObject*>()(value.owner());
   }
 };
-template <class K, class T> struct ToBuildable<std::map<K,T>> : CppBuilder<std::map<K,T>> {};
 
 /**
- * Objects builders
+ * Buffer export
  */
 
-template <class OBJ, class T>
-inline std::pair<std::string, std::function<void(OBJ&,T)>> make_mapping(const std::string &key, std::function<void(OBJ&,T)> fun)
+template <> struct BufferFormat<bool> { static const char* value() { return "?"; } };
+template <> struct BufferFormat<char> { static const char* value() { return "c"; } };
+template <> struct BufferFormat<signed char> { static const char* value() { return "b"; } };
+template <> struct BufferFormat<unsigned char> { static const char* value() { return "B"; } };
+template <> struct BufferFormat<short> { static const char* value() { return "h"; } };
+template <> struct BufferFormat<unsigned short> { static const char* value() { return "H"; } };
+template <> struct BufferFormat<int> { static const char* value() { return "i"; } };
+template <> struct BufferFormat<unsigned int> { static const char* value() { return "I"; } };
+template <> struct BufferFormat<long> { static const char* value() { return "l"; } };
+template <> struct BufferFormat<unsigned long> { static const char* value() { return "L"; } };
+template <> struct BufferFormat<long long> { static const char* value() { return "q"; } };
+template <> struct BufferFormat<unsigned long long> { static const char* value() { return "Q"; } };
+template <> struct BufferFormat<float> { static const char* value() { return "f"; } };
+template <> struct BufferFormat<double> { static const char* value() { return "d"; } };
+
+// Python object exporting a C++ storage through the buffer protocol (old and new style)
+// storage is released by destroy when the object is deallocated,
+// memoryviews keep a reference on the object as long as they are alive
+struct _ExportedBuffer
 {
-  return std::make_pair(key, fun);
+  PyObject_HEAD
+  void* buf;
+  Py_ssize_t len;
+  Py_ssize_t itemsize;
+  const char* format;
+  int ndim;
+  Py_ssize_t* shape;
+  Py_ssize_t* strides;
+  int readonly;
+  void* storage;
+  void (*destroy)(void*);
+};
+
+inline void _exportedBufferDealloc(PyObject* self)
+{
+  _ExportedBuffer* exported { reinterpret_cast<_ExportedBuffer*>(self) };
+  exported->destroy(exported->storage);
+  PyObject_Del(self);
 }
 
-template <class OBJ, class T>
-inline std::pair<std::string, std::function<void(OBJ&,T)>> make_mapping(const std::string &key, void (OBJ::*fun)(T))
+inline int _exportedBufferGet(PyObject* self, Py_buffer* view, int flags)
 {
-  return std::make_pair(key, fun);
+  _ExportedBuffer* exported { reinterpret_cast<_ExportedBuffer*>(self) };
+  if ((flags & PyBUF_WRITABLE) == PyBUF_WRITABLE && exported->readonly)
+  {
+    PyErr_SetString(PyExc_BufferError, "Read-only buffer");
+    return -1;
+  }
+  view->buf = exported->buf;
+  view->obj = self;
+  Py_INCREF(self);
+  view->len = exported->len;
+  view->readonly = exported->readonly;
+  view->itemsize = exported->itemsize;
+  view->format = (flags & PyBUF_FORMAT) == PyBUF_FORMAT ? const_cast<char*>(exported->format) : nullptr;
+  view->ndim = exported->ndim;
+  view->shape = (flags & PyBUF_ND) == PyBUF_ND ? exported->shape : nullptr;
+  view->strides = (flags & PyBUF_STRIDES) == PyBUF_STRIDES ? exported->strides : nullptr;
+  view->suboffsets = nullptr;
+  view->internal = nullptr;
+  return 0;
 }
 
-template <class OBJ, class T>
-inline std::pair<std::string, std::function<void(OBJ&,T)>> make_mapping(const std::string &key, T OBJ::*member)
+inline Py_ssize_t _exportedBufferSegments(PyObject* self, Py_ssize_t* len)
 {
-  return std::make_pair(key, [member](OBJ& obj, T&& value){ obj.*member = std::move(value); });
+  if (len)
+  {
+    *len = reinterpret_cast<_ExportedBuffer*>(self)->len;
+  }
+  return 1;
 }
 
-template <class OBJ, class T>
-inline std::pair<std::string, std::function<void(OBJ&,T)>> make_mapping(std::string&& key, std::function<void(OBJ&,T)> fun)
+inline Py_ssize_t _exportedBufferRead(PyObject* self, Py_ssize_t segment, void** ptr)
 {
-  return std::make_pair(std::move(key), fun);
+  if (segment != 0)
+  {
+    PyErr_SetString(PyExc_SystemError, "Accessing non-existent buffer segment");
+    return -1;
+  }
+  *ptr = reinterpret_cast<_ExportedBuffer*>(self)->buf;
+  return reinterpret_cast<_ExportedBuffer*>(self)->len;
 }
 
-template <class OBJ, class T>
-inline std::pair<std::string, std::function<void(OBJ&,T)>> make_mapping(std::string&& key, void (OBJ::*fun)(T))
+inline Py_ssize_t _exportedBufferWrite(PyObject* self, Py_ssize_t segment, void** ptr)
 {
-  return std::make_pair(std::move(key), fun);
+  if (reinterpret_cast<_ExportedBuffer*>(self)->readonly)
+  {
+    PyErr_SetString(PyExc_TypeError, "Read-only buffer");
+    return -1;
+  }
+  return _exportedBufferRead(self, segment, ptr);
 }
 
-template <class OBJ, class T>
-inline std::pair<std::string, std::function<void(OBJ&,T)>> make_mapping(std::string&& key, T OBJ::*member)
+inline Py_ssize_t _exportedBufferChars(PyObject* self, Py_ssize_t segment, char** ptr)
 {
-  return std::make_pair(std::move(key), [member](OBJ& obj, T&& value){ obj.*member = std::move(value); });
+  return _exportedBufferRead(self, segment, reinterpret_cast<void**>(ptr));
 }
 
-template <class OBJ, std::size_t pos, class... Args>
-struct CppBuilderHelper;
+inline PyTypeObject* _readyExportedBufferType()
+{
+  static PyBufferProcs procs;
+  procs.bf_getreadbuffer = &_exportedBufferRead;
+  procs.bf_getwritebuffer = &_exportedBufferWrite;
+  procs.bf_getsegcount = &_exportedBufferSegments;
+  procs.bf_getcharbuffer = &_exportedBufferChars;
+  procs.bf_getbuffer = &_exportedBufferGet;
+  procs.bf_releasebuffer = nullptr;
+  
+  static PyTypeObject type;
+  Py_REFCNT(&type) = 1;
+  type.tp_name = "py2cpp.Buffer";
+  type.tp_basicsize = sizeof(_ExportedBuffer);
+  type.tp_dealloc = &_exportedBufferDealloc;
+  type.tp_as_buffer = &procs;
+  type.tp_flags = Py_TPFLAGS_DEFAULT | Py_TPFLAGS_HAVE_NEWBUFFER;
+  type.tp_doc = "C++ storage exported through the buffer protocol";
+  if (PyType_Ready(&type) != 0)
+  {
+    PyErr_Clear();
+    throw std::runtime_error("Unable to initialize the type py2cpp.Buffer");
+  }
+  return &type;
+}
 
-template <class OBJ, std::size_t pos>
-struct CppBuilderHelper<OBJ, pos>
+// Not static: all the translation units have to share the same type object
+inline PyTypeObject* _exportedBufferType()
 {
-  CppBuilderHelper() {}
-  inline void fromDict(OBJ& obj, PyObject* pyo) const {}
-  inline void fromObject(OBJ& obj, PyObject* pyo) const {}
-  inline void fromTuple(OBJ& obj, PyObject* pyo) const {}
+  static PyTypeObject* type { _readyExportedBufferType() };
+  return type;
+}
 
-  inline bool eligibleFromDict(PyObject* pyo) const { return true; }
-  inline bool eligibleFromObject(PyObject* pyo) const { return true; }
-  inline bool eligibleFromTuple(PyObject* pyo) const { return true; }
+// Storage of an _ExportedBuffer: the C++ container and the description of its N dimensions
+template <class CONTAINER, std::size_t N>
+struct _BufferStorage
+{
+  CONTAINER values;
+  std::array<Py_ssize_t, N> shape;
+  std::array<Py_ssize_t, N> strides;
+  
+  static void destroy(void* storage)
+  {
+    delete static_cast<_BufferStorage*>(storage);
+  }
 };
 
-template <class OBJ, std::size_t pos, class FUNCTOR, class... Args>
-struct CppBuilderHelper<OBJ,pos,FUNCTOR,Args...>
+// Moves values into a new _ExportedBuffer describing a C-contiguous array of T
+template <class T, std::size_t N, class CONTAINER>
+static inline PyObject* _exportBuffer(CONTAINER&& values, std::array<std::size_t, N> const& shape, bool readonly)
 {
-  const std::pair<std::string, std::function<void(OBJ&, typename FUNCTOR::value_type)>> callback;
-  const CppBuilderHelper<OBJ, pos +1, Args...> subBuilder;
-  
-  // tuple's constructors
-  CppBuilderHelper(std::function<void(OBJ&, typename FUNCTOR::value_type)> fun, std::function<void(OBJ&, typename Args::value_type)>... args)
-      : callback(make_mapping("", fun)), subBuilder(args...)
-  {}
-  CppBuilderHelper(typename FUNCTOR::value_type OBJ::*member, typename Args::value_type OBJ::*... args)
-      : callback(make_mapping("", member)), subBuilder(args...)
-  {}
-  
-  // full constructors  
-  CppBuilderHelper(
-        std::pair<std::string, std::function<void(OBJ&, typename FUNCTOR::value_type)>> callback
-        , std::pair<std::string, std::function<void(OBJ&, typename Args::value_type)>>... args)
-      : callback(callback), subBuilder(args...)
-  {}
+  static_assert(std::is_trivially_copyable<T>::value, "ToBuffer<T> needs a trivially copyable T");
   
-  inline void fromDict(OBJ& obj, PyObject* pyo) const
+  std::unique_ptr<_BufferStorage<typename std::decay<CONTAINER>::type, N>> storage {
+      new _BufferStorage<typename std::decay<CONTAINER>::type, N> { std::move(values), {}, {} } };
+  Py_ssize_t stride { static_cast<Py_ssize_t>(sizeof(T)) };
+  for (std::size_t dim { N } ; dim != 0 ; --dim)
   {
-    PyObject *pyo_item { PyDict_GetItemString(pyo, callback.first.c_str()) };
-    if (pyo_item)
-    {
-      typename FUNCTOR::value_type value { FUNCTOR()(pyo_item) };
-      callback.second(obj, std::move(value));
-    }
-    subBuilder.fromDict(obj, pyo);
+    storage->shape[dim -1] = static_cast<Py_ssize_t>(shape[dim -1]);
+    storage->strides[dim -1] = stride;
+    stride *= storage->shape[dim -1];
   }
-  inline bool eligibleFromDict(PyObject* pyo) const
+  
+  _ExportedBuffer* exported { PyObject_New(_ExportedBuffer, _exportedBufferType()) };
+  if (! exported)
   {
-    PyObject *pyo_item { PyDict_GetItemString(pyo, callback.first.c_str()) };
-    return (! pyo_item || FUNCTOR().eligible(pyo_item)) && subBuilder.eligibleFromDict(pyo);
+    PyErr_Clear();
+    throw std::runtime_error("Unable to create the PyObject");
   }
-  
-  inline void fromObject(OBJ& obj, PyObject* pyo) const
+  exported->buf = const_cast<T*>(storage->values.data());
+  exported->len = stride;
+  exported->itemsize = sizeof(T);
+  exported->format = BufferFormat<T>::value();
+  exported->ndim = static_cast<int>(N);
+  exported->shape = storage->shape.data();
+  exported->strides = storage->strides.data();
+  exported->readonly = readonly ? 1 : 0;
+  exported->destroy = &_BufferStorage<typename std::decay<CONTAINER>::type, N>::destroy;
+  exported->storage = storage.release();
+  return reinterpret_cast<PyObject*>(exported);
+}
+
+template <class T>
+struct PyBuilder<ToBuffer<T>>
+{
+  // one-dimensional writable buffer, the vector is moved without copy
+  template <class ALLOC>
+  PyObject* operator() (std::vector<T, ALLOC>&& values) const
   {
-    if (PyObject_HasAttrString(pyo, callback.first.c_str()))
-    {
-      std::unique_ptr<PyObject, decref> pyo_item { PyObject_GetAttrString(pyo, callback.first.c_str()) };
-      typename FUNCTOR::value_type value { FUNCTOR()(pyo_item.get()) };
-      callback.second(obj, std::move(value));
-    }
-    subBuilder.fromObject(obj, pyo);
+    std::array<std::size_t, 1> shape {{ values.size() }};
+    return _exportBuffer<T>(std::move(values), shape, false);
   }
-  inline bool eligibleFromObject(PyObject* pyo) const
+  template <class ALLOC>
+  PyObject* operator() (std::vector<T, ALLOC> const& values) const
   {
-    bool attrEligible { true };
-    if (PyObject_HasAttrString(pyo, callback.first.c_str()))
-    {
-      std::unique_ptr<PyObject, decref> pyo_item { PyObject_GetAttrString(pyo, callback.first.c_str()) };
-      attrEligible = FUNCTOR().eligible(pyo_item.get());
-    }
-    return attrEligible && subBuilder.eligibleFromObject(pyo);
+    return (*this)(std::vector<T, ALLOC>(values));
   }
-  
-  inline void fromTuple(OBJ& obj, PyObject* pyo) const
+  // N-dimensional read-only buffer, the NdArray (and the buffer it may be viewing) is kept alive
+  template <std::size_t N>
+  PyObject* operator() (NdArray<T, N>&& values) const
   {
-    typename FUNCTOR::value_type value { FUNCTOR()(PyTuple_GetItem(pyo, pos)) };
-    callback.second(obj, std::move(value));
-    subBuilder.fromTuple(obj, pyo);
+    std::array<std::size_t, N> shape(values.shape());
+    return _exportBuffer<T>(std::move(values), shape, true);
   }
-  inline bool eligibleFromTuple(PyObject* pyo) const
+};
+
+// N-dimensional buffer copying the array
+template <class T, std::size_t N>
+struct PyBuilder<NdArray<T, N>>
+{
+  PyObject* operator() (NdArray<T, N> const& value) const
   {
-    return FUNCTOR().eligible(PyTuple_GetItem(pyo, pos)) && subBuilder.eligibleFromTuple(pyo);
+    return _exportBuffer<T>(std::vector<T>(value.begin(), value.end()), value.shape(), true);
   }
 };
 
-template <class OBJ, class... Args>
-struct CppBuilder<FromTuple<OBJ, Args...>>
+/**
+ * Conversion errors
+ */
+
+template <class BUILDER>
+inline Expected<typename BUILDER::value_type> try_convert(BUILDER const& builder, PyObject* pyo)
 {
-  typedef OBJ value_type;
-  const CppBuilderHelper<OBJ, 0, ToBuildable<Args>...> subBuilder;
-  
-  CppBuilder(std::function<void(OBJ&, typename ToBuildable<Args>::value_type)>... args)
-      : subBuilder(args...)
-  {}
-  
-  CppBuilder(typename ToBuildable<Args>::value_type OBJ::*... args)
-      : subBuilder(args...)
-  {}
-  
-  value_type operator() (PyObject* pyo) const
+  assert(pyo);
+  typedef typename BUILDER::value_type value_type;
+  ConversionError error;
+  try
   {
-    assert(pyo);
-    
-    if (PyTuple_Check(pyo))
+    _ConversionTrail trail(&error);
+    Optional<value_type> value { builder.try_build(pyo) };
+    if (value)
     {
-      if (PyTuple_Size(pyo) == sizeof...(Args))
-      {
-        OBJ obj;
-        subBuilder.fromTuple(obj, pyo);
-        return obj;
-      }
-      else
-      {
-        std::ostringstream oss;
-        oss << "PyTuple length differs from asked one: "
-            << "PyTuple(" << PyTuple_Size(pyo) << ") "
-            << "and FromTuple<...>(" << sizeof...(Args) << ")";
-        throw std::invalid_argument(oss.str());
-      }
+      return Expected<value_type>(std::move(value));
     }
-    throw std::invalid_argument("Not a PyTuple instance");
   }
-  bool eligible(PyObject* pyo) const
+  // thrown by a builder not going through _tryBuildFlat: the item cannot be located
+  catch (std::overflow_error const&)
   {
-    return PyTuple_Check(pyo)
-        && PyTuple_Size(pyo) == sizeof...(Args)
-        && subBuilder.eligibleFromTuple(pyo);
+    error = ConversionError(ConversionErrc::overflow);
   }
-};
+  catch (std::exception const& e)
+  {
+    error = ConversionError(ConversionErrc::other, e.what());
+  }
+  return Expected<value_type>(std::move(error));
+}
 
-template <class OBJ, class... Args>
-struct CppBuilder<FromDict<OBJ, Args...>>
+template <class T>
+inline Expected<typename CppBuilder<T>::value_type> try_convert(PyObject* pyo)
 {
-  typedef OBJ value_type;
-  CppBuilderHelper<OBJ, 0, ToBuildable<Args>...> subBuilder;
-  
-  CppBuilder(std::pair<std::string, std::function<void(OBJ&, typename ToBuildable<Args>::value_type)>>... args)
-      : subBuilder(args...)
-  {}
-  
-  value_type operator() (PyObject* pyo) const
+  return try_convert(CppBuilder<T>(), pyo);
+}
+
+/**
+ * Conversion statistics
+ */
+
+// Snapshot of the counters, in the order the specializations were first used
+inline std::vector<ConversionStats> conversion_stats()
+{
+  std::vector<ConversionStats> out;
+#if defined(PY2CPP_STATS)
+  _statsRegistry().for_each([&out](_StatsEntry const& entry)
   {
-    assert(pyo);
-    
-    OBJ obj;
-    if (PyDict_Check(pyo))
+    ConversionStats stats;
+    stats.builder = entry.builder;
+    stats.calls = entry.calls.load(std::memory_order_relaxed);
+    stats.elements = entry.elements.load(std::memory_order_relaxed);
+    stats.rejections = entry.rejections.load(std::memory_order_relaxed);
+    stats.exceptions = entry.exceptions.load(std::memory_order_relaxed);
+    stats.seconds = entry.nanoseconds.load(std::memory_order_relaxed) / 1e9;
+    for (auto const& size : entry.sizes)
     {
-      subBuilder.fromDict(obj, pyo);
+      stats.sizes.push_back(size.load(std::memory_order_relaxed));
     }
-    else
+    while (! stats.sizes.empty() && stats.sizes.back() == 0)
     {
-      subBuilder.fromObject(obj, pyo);
+      stats.sizes.pop_back();
     }
-    return obj;
-  }
-  bool eligible(PyObject* pyo) const
+    out.push_back(std::move(stats));
+  });
+#endif
+  return out;
+}
+
+// Counters are reset to zero, the specializations stay registered
+inline void reset_conversion_stats()
+{
+#if defined(PY2CPP_STATS)
+  _statsRegistry().for_each([](_StatsEntry& entry)
   {
-    if (PyDict_Check(pyo))
+    entry.calls.store(0, std::memory_order_relaxed);
+    entry.elements.store(0, std::memory_order_relaxed);
+    entry.rejections.store(0, std::memory_order_relaxed);
+    entry.exceptions.store(0, std::memory_order_relaxed);
+    entry.nanoseconds.store(0, std::memory_order_relaxed);
+    for (auto& size : entry.sizes)
     {
-      return subBuilder.eligibleFromDict(pyo);
+      size.store(0, std::memory_order_relaxed);
     }
-    else
+  });
+#endif
+}
+
+// GIL held: new reference on a dict {builder: {"calls": ..., "elements": ..., "rejections": ...,
+// "exceptions": ..., "seconds": ..., "sizes": [...]}}, empty without PY2CPP_STATS
+inline PyObject* conversion_stats_dict()
+{
+  typedef FromDict<ConversionStats
+      , PY2CPP_FIELD(&ConversionStats::calls), PY2CPP_FIELD(&ConversionStats::elements)
+      , PY2CPP_FIELD(&ConversionStats::rejections), PY2CPP_FIELD(&ConversionStats::exceptions)
+      , PY2CPP_FIELD(&ConversionStats::seconds), PY2CPP_FIELD(&ConversionStats::sizes)> Entry;
+  PyBuilder<Entry> entryBuilder("calls", "elements", "rejections", "exceptions", "seconds", "sizes");
+  PyBuilder<std::string> keyBuilder;
+  std::unique_ptr<PyObject, decref> pyo { _newRef(PyDict_New()) };
+  for (ConversionStats const& stats : conversion_stats())
+  {
+    std::unique_ptr<PyObject, decref> pyo_key { keyBuilder(stats.builder) };
+    std::unique_ptr<PyObject, decref> pyo_value { entryBuilder(stats) };
+    if (PyDict_SetItem(pyo.get(), pyo_key.get(), pyo_value.get()) != 0)
     {
-      return subBuilder.eligibleFromObject(pyo);
+      PyErr_Clear();
+      throw std::runtime_error("Unable to add an item to the PyDict");
     }
   }
-};
+  return pyo.release();
+}
 
 }
 }
 
+namespace std
+{
+  template <>
+  struct hash<dubzzz::Py2Cpp::PyStringRef>
+  {
+    std::size_t operator() (dubzzz::Py2Cpp::PyStringRef const& value) const
+    {
+      return value.hash();
+    }
+  };
+  
+  template <>
+  struct hash<dubzzz::Py2Cpp::InternedString>
+  {
+    std::size_t operator() (dubzzz::Py2Cpp::InternedString const& value) const
+    {
+      return value.hash();
+    }
+  };
+}
+
 #endif
 
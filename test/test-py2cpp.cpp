@@ -1,9 +1,12 @@
 #include <Python.h>
 #include "gtest/gtest.h"
 
+#include <atomic>
 #include <cfloat>
 #include <climits>
+#include <cstdlib>
 #include <memory>
+#include <new>
 #include <sstream>
 
 #include "src/py2cpp.hpp"
@@ -11,6 +14,28 @@
 
 using namespace dubzzz::Py2Cpp;
 
+// Heap allocations performed through operator new, checked by the build_into tests
+static std::atomic<std::size_t> numAllocations { 0 };
+
+// not inlined: the compiler would report a mismatch between malloc and delete expressions
+__attribute__((noinline)) void* operator new(std::size_t size)
+{
+  ++numAllocations;
+  if (void* p = std::malloc(size != 0 ? size : 1))
+  {
+    return p;
+  }
+  throw std::bad_alloc();
+}
+__attribute__((noinline)) void operator delete(void* p) noexcept
+{
+  std::free(p);
+}
+__attribute__((noinline)) void operator delete(void* p, std::size_t) noexcept
+{
+  std::free(p);
+}
+
 namespace
 {
   /**
@@ -489,12 +514,55 @@ TEST(CppBuilder_string, Unicode)
 TEST(CppBuilder_string, UnicodeExotic)
 {
   unique_ptr_ctn pyo { PyRun_String(
-      "u'\u15c7\u25d8\u0034\u2b15'", Py_eval_input, get_py_dict(), NULL) };
+      "u'\\u15c7\\u25d8\\u0034\\u2b15'", Py_eval_input, get_py_dict(), NULL) };
   ASSERT_NE(nullptr, pyo.get());
   EXPECT_EQ("\xe1\x97\x87\xe2\x97\x98\x34\xe2\xac\x95", CppBuilder<std::string>()(pyo.get()));
   EXPECT_FALSE(uncaught_exception());
 }
 
+TEST(CppBuilder_string, UnicodeLatin1)
+{
+  unique_ptr_ctn pyo { PyRun_String("u'caf\\xe9'", Py_eval_input, get_py_dict(), NULL) };
+  ASSERT_NE(nullptr, pyo.get());
+  EXPECT_EQ("caf\xc3\xa9", CppBuilder<std::string>()(pyo.get()));
+  EXPECT_FALSE(uncaught_exception());
+}
+
+TEST(CppBuilder_string, UnicodeAstral)
+{
+  unique_ptr_ctn pyo { PyRun_String("u'\\U0001f600!'", Py_eval_input, get_py_dict(), NULL) };
+  ASSERT_NE(nullptr, pyo.get());
+  EXPECT_EQ("\xf0\x9f\x98\x80!", CppBuilder<std::string>()(pyo.get()));
+  EXPECT_FALSE(uncaught_exception());
+}
+
+TEST(CppBuilder_string, UnicodeSurrogates)
+{
+  unique_ptr_ctn pyo { PyRun_String("u'\\ud83d\\ude00'", Py_eval_input, get_py_dict(), NULL) };
+  ASSERT_NE(nullptr, pyo.get());
+  std::string expected { PyString_AsString(std::unique_ptr<PyObject, decref>(PyUnicode_AsUTF8String(pyo.get())).get()) };
+  EXPECT_EQ(expected, CppBuilder<std::string>()(pyo.get()));
+  EXPECT_FALSE(uncaught_exception());
+}
+
+TEST(CppBuilder_string, UnicodeLongMixed)
+{
+  unique_ptr_ctn pyo { PyRun_String("u'a' * 1000 + u'\\u15c7' + u'b' * 1000", Py_eval_input, get_py_dict(), NULL) };
+  ASSERT_NE(nullptr, pyo.get());
+  EXPECT_EQ(std::string(1000, 'a') + "\xe1\x97\x87" + std::string(1000, 'b'), CppBuilder<std::string>()(pyo.get()));
+  EXPECT_FALSE(uncaught_exception());
+}
+
+TEST(CppBuilder_string, UnicodeLarge)
+{
+  unique_ptr_ctn pyo { PyRun_String("u'abcdefgh' * 1000000", Py_eval_input, get_py_dict(), NULL) };
+  ASSERT_NE(nullptr, pyo.get());
+  std::string ret { CppBuilder<std::string>()(pyo.get()) };
+  ASSERT_EQ(8000000, ret.size());
+  EXPECT_EQ("abcdefghabcdefgh", ret.substr(ret.size() - 16));
+  EXPECT_FALSE(uncaught_exception());
+}
+
 /** std::wstring **/
 
 TEST(CppBuilder_wstring, String)
@@ -522,6 +590,261 @@ TEST(CppBuilder_wstring, UnicodeExotic)
   EXPECT_FALSE(uncaught_exception());
 }
 
+TEST(CppBuilder_wstring, StringUtf8)
+{
+  unique_ptr_ctn pyo { PyRun_String("'caf\\xc3\\xa9 \\xf0\\x9f\\x98\\x80'", Py_eval_input, get_py_dict(), NULL) };
+  ASSERT_NE(nullptr, pyo.get());
+  EXPECT_EQ(L"caf\u00e9 \U0001f600", CppBuilder<std::wstring>()(pyo.get()));
+  EXPECT_FALSE(uncaught_exception());
+}
+
+TEST(CppBuilder_wstring, StringInvalidUtf8)
+{
+  unique_ptr_ctn pyo { PyRun_String("'a\\xffb\\xc3'", Py_eval_input, get_py_dict(), NULL) };
+  ASSERT_NE(nullptr, pyo.get());
+  EXPECT_EQ(L"a\ufffdb\ufffd", CppBuilder<std::wstring>()(pyo.get()));
+  EXPECT_FALSE(uncaught_exception());
+}
+
+/** PyStringRef **/
+
+TEST(CppBuilder_PyStringRef, String)
+{
+  unique_ptr_ctn pyo { PyRun_String("'hello'", Py_eval_input, get_py_dict(), NULL) };
+  ASSERT_NE(nullptr, pyo.get());
+  PyStringRef ret { CppBuilder<PyStringRef>()(pyo.get()) };
+  EXPECT_EQ("hello", ret.str());
+  EXPECT_EQ(pyo.get(), ret.owner());
+  EXPECT_EQ(PyString_AS_STRING(pyo.get()), ret.data()); // no copy
+  EXPECT_FALSE(uncaught_exception());
+}
+
+TEST(CppBuilder_PyStringRef, Unicode)
+{
+  unique_ptr_ctn pyo { PyRun_String("u'caf\\xe9'", Py_eval_input, get_py_dict(), NULL) };
+  ASSERT_NE(nullptr, pyo.get());
+  EXPECT_EQ("caf\xc3\xa9", CppBuilder<PyStringRef>()(pyo.get()).str());
+  EXPECT_FALSE(uncaught_exception());
+}
+
+TEST(CppBuilder_PyStringRef, OutlivesSource)
+{
+  PyStringRef ret;
+  {
+    // the view keeps a reference: unique_ptr_ctn would report it
+    std::unique_ptr<PyObject, decref> pyo { PyRun_String("''.join(['hello'] * 3)", Py_eval_input, get_py_dict(), NULL) };
+    ASSERT_NE(nullptr, pyo.get());
+    ret = CppBuilder<PyStringRef>()(pyo.get());
+  }
+  EXPECT_EQ(1, Py_REFCNT(ret.owner()));
+  EXPECT_EQ("hellohellohello", ret.str());
+  PyStringRef copy { ret };
+  EXPECT_EQ(2, Py_REFCNT(ret.owner()));
+  EXPECT_EQ(ret, copy);
+  EXPECT_FALSE(uncaught_exception());
+}
+
+TEST(CppBuilder_PyStringRef, InVector)
+{
+  unique_ptr_ctn pyo { PyRun_String("['a', u'b', 'ab', '']", Py_eval_input, get_py_dict(), NULL) };
+  ASSERT_NE(nullptr, pyo.get());
+  std::vector<PyStringRef> ret { CppBuilder<std::vector<PyStringRef>>()(pyo.get()) };
+  ASSERT_EQ(4, ret.size());
+  EXPECT_EQ("a", ret[0].str());
+  EXPECT_EQ("b", ret[1].str());
+  EXPECT_EQ("ab", ret[2].str());
+  EXPECT_TRUE(ret[3].empty());
+  EXPECT_TRUE(ret[0] < ret[2]);
+  EXPECT_TRUE(ret[2] < ret[1]);
+  EXPECT_TRUE(ret[3] < ret[0]);
+  EXPECT_FALSE(uncaught_exception());
+}
+
+TEST(CppBuilder_PyStringRef, AsMapKey)
+{
+  unique_ptr_ctn pyo { PyRun_String("{'b': 2, 'a': 1, u'c': 3}", Py_eval_input, get_py_dict(), NULL) };
+  ASSERT_NE(nullptr, pyo.get());
+  std::map<PyStringRef, int> ret { CppBuilder<std::map<PyStringRef, int>>()(pyo.get()) };
+  std::vector<std::pair<std::string, int>> entries;
+  for (auto const& entry : ret)
+  {
+    entries.emplace_back(entry.first.str(), entry.second);
+  }
+  std::vector<std::pair<std::string, int>> expected { { "a", 1 }, { "b", 2 }, { "c", 3 } };
+  EXPECT_EQ(expected, entries);
+  EXPECT_FALSE(uncaught_exception());
+}
+
+TEST(CppBuilder_PyStringRef, AsUnorderedKey)
+{
+  unique_ptr_ctn pyo { PyRun_String("set(['a', u'a', 'b'])", Py_eval_input, get_py_dict(), NULL) };
+  ASSERT_NE(nullptr, pyo.get());
+  std::unordered_set<PyStringRef> ret { CppBuilder<std::unordered_set<PyStringRef>>()(pyo.get()) };
+  EXPECT_EQ(2, ret.size());
+  unique_ptr_ctn b { PyRun_String("'b'", Py_eval_input, get_py_dict(), NULL) };
+  EXPECT_EQ(1, ret.count(CppBuilder<PyStringRef>()(b.get())));
+  EXPECT_FALSE(uncaught_exception());
+}
+
+/** InternedString **/
+
+TEST(CppBuilder_InternedString, SharedByContent)
+{
+  std::unique_ptr<PyObject, decref> pyo { PyRun_String("['red', u'red', ''.join(['r', 'e', 'd']), 'blue', '']", Py_eval_input, get_py_dict(), NULL) };
+  ASSERT_NE(nullptr, pyo.get());
+  StringPool pool;
+  StringPoolScope scope(&pool);
+  std::vector<InternedString> ret { CppBuilder<std::vector<InternedString>>()(pyo.get()) };
+  ASSERT_EQ(5, ret.size());
+  EXPECT_EQ("red", ret[0].str());
+  EXPECT_EQ(ret[0], ret[1]);
+  EXPECT_EQ(ret[0], ret[2]);
+  EXPECT_EQ(ret[0].data(), ret[2].data()); // single copy
+  EXPECT_EQ("blue", ret[3].str());
+  EXPECT_NE(ret[0], ret[3]);
+  EXPECT_TRUE(ret[3] < ret[0]);
+  EXPECT_EQ(InternedString(), ret[4]);
+  EXPECT_EQ(2, pool.size());
+  pool.release_identity_cache();
+  EXPECT_FALSE(uncaught_exception());
+}
+
+TEST(CppBuilder_InternedString, IdentityCache)
+{
+  unique_ptr_ctn pyo { PyRun_String("''.join(['caf', u'\\xe9'])", Py_eval_input, get_py_dict(), NULL) };
+  ASSERT_NE(nullptr, pyo.get());
+  StringPool pool;
+  CppBuilder<InternedString> builder(&pool);
+  InternedString first { builder(pyo.get()) };
+  EXPECT_EQ("caf\xc3\xa9", first.str());
+  EXPECT_EQ(first.data(), pool.find(pyo.get())->data());
+  
+  std::size_t before { numAllocations };
+  EXPECT_EQ(first, builder(pyo.get()));
+  EXPECT_EQ(before, numAllocations);
+  pool.release_identity_cache();
+  EXPECT_EQ(nullptr, pool.find(pyo.get()));
+  EXPECT_EQ(first, builder(pyo.get()));
+  pool.release_identity_cache();
+  EXPECT_FALSE(uncaught_exception());
+}
+
+TEST(CppBuilder_InternedString, IdentityCapacity)
+{
+  std::unique_ptr<PyObject, decref> pyo { PyRun_String("['k%d' % i for i in range(10)] * 2", Py_eval_input, get_py_dict(), NULL) };
+  ASSERT_NE(nullptr, pyo.get());
+  StringPool pool(4);
+  StringPoolScope scope(&pool);
+  auto ret = CppBuilder<std::vector<InternedString>>()(pyo.get());
+  ASSERT_EQ(20, ret.size());
+  EXPECT_EQ(ret[3], ret[13]);
+  EXPECT_EQ(10, pool.size());
+  pool.release_identity_cache();
+  EXPECT_EQ(2, Py_REFCNT(PyList_GET_ITEM(pyo.get(), 0))); // twice in the list only
+  EXPECT_FALSE(uncaught_exception());
+}
+
+TEST(CppBuilder_InternedString, Scope)
+{
+  std::unique_ptr<PyObject, decref> pyo { PyRun_String("[{'kind': 'a'}, {'kind': 'b'}, {'kind': 'a'}]", Py_eval_input, get_py_dict(), NULL) };
+  ASSERT_NE(nullptr, pyo.get());
+  StringPool pool;
+  {
+    StringPoolScope scope(&pool);
+    auto ret = CppBuilder<std::vector<std::unordered_map<InternedString, InternedString>>>()(pyo.get());
+    ASSERT_EQ(3, ret.size());
+    EXPECT_EQ(ret[0].begin()->first, ret[1].begin()->first);
+    EXPECT_EQ(ret[0].begin()->second, ret[2].begin()->second);
+    EXPECT_NE(ret[0].begin()->second, ret[1].begin()->second);
+  }
+  EXPECT_EQ(3, pool.size());
+  pool.release_identity_cache();
+  EXPECT_FALSE(uncaught_exception());
+}
+
+TEST(CppBuilder_InternedString, DefaultPoolKeepsNoReference)
+{
+  unique_ptr_ctn pyo { PyRun_String("''.join(['default', '-pool'])", Py_eval_input, get_py_dict(), NULL) };
+  ASSERT_NE(nullptr, pyo.get());
+  InternedString value { CppBuilder<InternedString>()(pyo.get()) };
+  EXPECT_EQ("default-pool", value.str());
+  EXPECT_EQ(nullptr, default_string_pool()->find(pyo.get()));
+  EXPECT_FALSE(uncaught_exception());
+}
+
+namespace
+{
+  StringPool* reentrantPool { nullptr };
+  
+  PyObject* internInReentrantPool(PyObject*, PyObject* arg)
+  {
+    reentrantPool->intern(arg);
+    Py_RETURN_NONE;
+  }
+}
+
+TEST(CppBuilder_InternedString, ReentrantRelease)
+{
+  static PyMethodDef def { "pool_intern", &internInReentrantPool, METH_O, nullptr };
+  std::unique_ptr<PyObject, decref> fn { PyCFunction_New(&def, nullptr) };
+  ASSERT_NE(nullptr, fn.get());
+  PyDict_SetItemString(get_py_dict(), "pool_intern", fn.get());
+  PyRun_SimpleString("class ReentrantStr(str):\n   def __del__(self): pool_intern(''.join(['de', 'l']))");
+  
+  StringPool pool(2);
+  reentrantPool = &pool;
+  {
+    std::unique_ptr<PyObject, decref> pyo { PyRun_String("ReentrantStr('released')", Py_eval_input, get_py_dict(), NULL) };
+    ASSERT_NE(nullptr, pyo.get());
+    pool.intern(pyo.get());
+  }
+  pool.release_identity_cache(); // runs __del__, interning into the pool
+  {
+    std::unique_ptr<PyObject, decref> pyo { PyRun_String("ReentrantStr('evicted')", Py_eval_input, get_py_dict(), NULL) };
+    ASSERT_NE(nullptr, pyo.get());
+    pool.intern(pyo.get());
+  }
+  std::unique_ptr<PyObject, decref> others { PyRun_String("['k%d' % i for i in range(64)]", Py_eval_input, get_py_dict(), NULL) };
+  ASSERT_NE(nullptr, others.get());
+  for (Py_ssize_t i { 0 } ; i != PyList_GET_SIZE(others.get()) ; ++i)
+  {
+    pool.intern(PyList_GET_ITEM(others.get(), i)); // evicts ReentrantStr('evicted') at some point
+  }
+  pool.release_identity_cache();
+  reentrantPool = nullptr;
+  
+  EXPECT_NE(nullptr, pool.intern(std::string("del")));
+  EXPECT_EQ(67, pool.size()); // released, evicted, del and the 64 others
+  PyDict_DelItemString(get_py_dict(), "pool_intern");
+  EXPECT_FALSE(uncaught_exception());
+}
+
+TEST(CppBuilder_InternedString, Threads)
+{
+  StringPool pool;
+  std::vector<std::vector<const std::string*>> interned(4);
+  std::vector<std::thread> threads;
+  for (auto& out : interned)
+  {
+    threads.emplace_back([&pool, &out]() {
+        for (int i { 0 } ; i != 1000 ; ++i)
+        {
+          out.push_back(pool.intern(std::to_string(i % 100)));
+        }
+    });
+  }
+  for (auto& thread : threads)
+  {
+    thread.join();
+  }
+  EXPECT_EQ(100, pool.size());
+  for (auto const& out : interned)
+  {
+    EXPECT_EQ(interned[0], out);
+  }
+  EXPECT_FALSE(uncaught_exception());
+}
+
 /** tuple **/
 
 TEST(CppBuilder_tuple, FromTuple)
@@ -566,6 +889,15 @@ TEST(CppBuilder_vector, FromList)
   EXPECT_FALSE(uncaught_exception());
 }
 
+TEST(CppBuilder_vector, FromTuple)
+{
+  unique_ptr_ctn pyo { PyRun_String("(1,8,3)", Py_eval_input, get_py_dict(), NULL) };
+  std::vector<int> expected { 1, 8, 3 };
+  ASSERT_NE(nullptr, pyo.get());
+  EXPECT_EQ(expected, CppBuilder<std::vector<int>>()(pyo.get()));
+  EXPECT_FALSE(uncaught_exception());
+}
+
 TEST(CppBuilder_vector, FromInvalidList)
 {
   unique_ptr_ctn pyo { PyRun_String("[1,'string',3]", Py_eval_input, get_py_dict(), NULL) };
@@ -574,6 +906,158 @@ TEST(CppBuilder_vector, FromInvalidList)
   EXPECT_FALSE(uncaught_exception());
 }
 
+TEST(CppBuilder_vector, HomogeneousInts)
+{
+  unique_ptr_ctn pyo { PyRun_String("range(-500, 500)", Py_eval_input, get_py_dict(), NULL) };
+  ASSERT_NE(nullptr, pyo.get());
+  std::vector<int> expected;
+  for (int i { -500 } ; i != 500 ; ++i)
+  {
+    expected.push_back(i);
+  }
+  EXPECT_EQ(expected, CppBuilder<std::vector<int>>()(pyo.get()));
+  EXPECT_EQ(std::vector<long long>(expected.begin(), expected.end()), CppBuilder<std::vector<long long>>()(pyo.get()));
+  EXPECT_EQ(std::vector<double>(expected.begin(), expected.end()), CppBuilder<std::vector<double>>()(pyo.get()));
+  EXPECT_THROW(CppBuilder<std::vector<unsigned int>>()(pyo.get()), std::overflow_error);
+  EXPECT_FALSE(uncaught_exception());
+}
+
+TEST(CppBuilder_vector, HomogeneousOutOfRange)
+{
+  unique_ptr_ctn pyo { PyRun_String("[0] * 700 + [2 ** 31] + [0] * 100", Py_eval_input, get_py_dict(), NULL) };
+  ASSERT_NE(nullptr, pyo.get());
+  EXPECT_THROW(CppBuilder<std::vector<int>>()(pyo.get()), std::overflow_error);
+  EXPECT_EQ(801, CppBuilder<std::vector<unsigned int>>()(pyo.get()).size());
+  EXPECT_FALSE(uncaught_exception());
+}
+
+TEST(CppBuilder_vector, HomogeneousSmallLongs)
+{
+  unique_ptr_ctn pyo { PyRun_String("[0L, 1L, -2L, 2L ** 40, -(2L ** 59)]", Py_eval_input, get_py_dict(), NULL) };
+  ASSERT_NE(nullptr, pyo.get());
+  std::vector<long long> expected { 0, 1, -2, 1LL << 40, -(1LL << 59) };
+  EXPECT_EQ(expected, CppBuilder<std::vector<long long>>()(pyo.get()));
+  EXPECT_THROW(CppBuilder<std::vector<unsigned long>>()(pyo.get()), std::overflow_error);
+  EXPECT_FALSE(uncaught_exception());
+}
+
+TEST(CppBuilder_vector, HomogeneousDoubles)
+{
+  unique_ptr_ctn pyo { PyRun_String("[i / 3. for i in xrange(300)]", Py_eval_input, get_py_dict(), NULL) };
+  unique_ptr_ctn pyoInf { PyRun_String("[.5] * 300 + [float('-inf')]", Py_eval_input, get_py_dict(), NULL) };
+  ASSERT_NE(nullptr, pyo.get());
+  ASSERT_NE(nullptr, pyoInf.get());
+  std::vector<double> ret { CppBuilder<std::vector<double>>()(pyo.get()) };
+  ASSERT_EQ(300, ret.size());
+  EXPECT_EQ(299 / 3., ret[299]);
+  EXPECT_THROW(CppBuilder<std::vector<double>>()(pyoInf.get()), std::overflow_error);
+  EXPECT_FALSE(uncaught_exception());
+}
+
+TEST(CppBuilder_vector, MixedNumbers)
+{
+  unique_ptr_ctn pyo { PyRun_String("[1, 2L ** 70, 3]", Py_eval_input, get_py_dict(), NULL) };
+  unique_ptr_ctn pyoMixed { PyRun_String("[1, 2L, 3.5]", Py_eval_input, get_py_dict(), NULL) };
+  ASSERT_NE(nullptr, pyo.get());
+  ASSERT_NE(nullptr, pyoMixed.get());
+  EXPECT_THROW(CppBuilder<std::vector<long>>()(pyo.get()), std::overflow_error);
+  EXPECT_EQ(std::vector<double>({ 1., 2., 3.5 }), CppBuilder<std::vector<double>>()(pyoMixed.get()));
+  EXPECT_THROW(CppBuilder<std::vector<long>>()(pyoMixed.get()), std::invalid_argument);
+  EXPECT_FALSE(uncaught_exception());
+}
+
+/** iterable **/
+
+TEST(CppBuilder_iterable, Generator)
+{
+  unique_ptr_ctn pyo { PyRun_String("(i * i for i in xrange(5))", Py_eval_input, get_py_dict(), NULL) };
+  ASSERT_NE(nullptr, pyo.get());
+  std::vector<int> expected { 0, 1, 4, 9, 16 };
+  EXPECT_EQ(expected, CppBuilder<FromIterable<int>>()(pyo.get()));
+  EXPECT_TRUE(CppBuilder<FromIterable<int>>()(pyo.get()).empty()); // consumed
+  EXPECT_FALSE(uncaught_exception());
+}
+
+TEST(CppBuilder_iterable, LengthHint)
+{
+  unique_ptr_ctn pyo { PyRun_String("iter(xrange(1000))", Py_eval_input, get_py_dict(), NULL) };
+  ASSERT_NE(nullptr, pyo.get());
+  unique_ptr_ctn pyWarmUp { PyRun_String("iter([0])", Py_eval_input, get_py_dict(), NULL) };
+  CppBuilder<FromIterable<long>>()(pyWarmUp.get()); // registers the statistics with PY2CPP_STATS
+  std::size_t before { numAllocations };
+  std::vector<long> ret { CppBuilder<FromIterable<long>>()(pyo.get()) };
+  EXPECT_EQ(before +1, numAllocations); // reserved once
+  ASSERT_EQ(1000, ret.size());
+  EXPECT_EQ(999, ret.back());
+  EXPECT_FALSE(uncaught_exception());
+}
+
+TEST(CppBuilder_iterable, Containers)
+{
+  unique_ptr_ctn pySet { PyRun_String("set(['a'])", Py_eval_input, get_py_dict(), NULL) };
+  unique_ptr_ctn pyDict { PyRun_String("{1: 'a', 2: 'b'}", Py_eval_input, get_py_dict(), NULL) };
+  unique_ptr_ctn pyList { PyRun_String("[[1], [2, 3]]", Py_eval_input, get_py_dict(), NULL) };
+  ASSERT_NE(nullptr, pySet.get());
+  ASSERT_NE(nullptr, pyDict.get());
+  ASSERT_NE(nullptr, pyList.get());
+  EXPECT_EQ(std::vector<std::string>({ "a" }), CppBuilder<FromIterable<std::string>>()(pySet.get()));
+  std::vector<int> keys { CppBuilder<FromIterable<int>>()(pyDict.get()) };
+  std::sort(keys.begin(), keys.end());
+  EXPECT_EQ(std::vector<int>({ 1, 2 }), keys);
+  EXPECT_EQ(std::vector<std::vector<int>>({ { 1 }, { 2, 3 } }), CppBuilder<FromIterable<std::vector<int>>>()(pyList.get()));
+  EXPECT_FALSE(uncaught_exception());
+}
+
+TEST(CppBuilder_iterable, Errors)
+{
+  PyRun_SimpleString("def failing():\n  yield 1\n  raise ValueError()");
+  unique_ptr_ctn pyFailing { PyRun_String("failing()", Py_eval_input, get_py_dict(), NULL) };
+  unique_ptr_ctn pyInvalid { PyRun_String("iter([1, 'a'])", Py_eval_input, get_py_dict(), NULL) };
+  unique_ptr_ctn pyInt { PyRun_String("1", Py_eval_input, get_py_dict(), NULL) };
+  ASSERT_NE(nullptr, pyFailing.get());
+  ASSERT_NE(nullptr, pyInvalid.get());
+  EXPECT_THROW(CppBuilder<FromIterable<int>>()(pyFailing.get()), std::runtime_error);
+  EXPECT_EQ(nullptr, PyErr_Occurred());
+  EXPECT_FALSE(CppBuilder<FromIterable<int>>().try_build(pyInvalid.get()));
+  EXPECT_THROW(CppBuilder<FromIterable<int>>()(pyInt.get()), std::invalid_argument);
+  EXPECT_EQ(nullptr, PyErr_Occurred());
+  EXPECT_FALSE(uncaught_exception());
+}
+
+TEST(CppBuilder_iterable, Stream)
+{
+  unique_ptr_ctn pyo { PyRun_String("('%030d' % i for i in xrange(10))", Py_eval_input, get_py_dict(), NULL) };
+  ASSERT_NE(nullptr, pyo.get());
+  std::vector<std::size_t> sizes;
+  std::vector<std::string> all;
+  std::size_t count { CppBuilder<FromIterable<std::string>>().stream(pyo.get(), 4, [&](std::vector<std::string>& chunk) {
+      sizes.push_back(chunk.size());
+      all.insert(all.end(), chunk.begin(), chunk.end());
+  }) };
+  EXPECT_EQ(10, count);
+  EXPECT_EQ(std::vector<std::size_t>({ 4, 4, 2 }), sizes);
+  ASSERT_EQ(10, all.size());
+  EXPECT_EQ(std::string(29, '0') + "9", all.back());
+  EXPECT_FALSE(uncaught_exception());
+}
+
+TEST(CppBuilder_iterable, StreamReusesChunk)
+{
+  unique_ptr_ctn pyo { PyRun_String("('%030d' % i for i in xrange(12))", Py_eval_input, get_py_dict(), NULL) };
+  ASSERT_NE(nullptr, pyo.get());
+  std::vector<std::size_t> allocations;
+  std::size_t last { numAllocations };
+  CppBuilder<FromIterable<std::string>>().stream(pyo.get(), 4, [&](std::vector<std::string>& chunk) {
+      allocations.push_back(numAllocations - last);
+      last = numAllocations;
+  });
+  ASSERT_EQ(3, allocations.size());
+  EXPECT_NE(0, allocations[0]);
+  EXPECT_EQ(0, allocations[1]); // same buffers
+  EXPECT_EQ(0, allocations[2]);
+  EXPECT_FALSE(uncaught_exception());
+}
+
 /** set **/
 
 TEST(CppBuilder_set, FromSet)
@@ -598,6 +1082,31 @@ TEST(CppBuilder_set, InputUnmodified)
   EXPECT_FALSE(uncaught_exception());
 }
 
+TEST(CppBuilder_set, FromFrozenSet)
+{
+  unique_ptr_ctn pyo { PyRun_String("frozenset([1,8,3])", Py_eval_input, get_py_dict(), NULL) };
+  std::set<int> expected { 1, 8, 3 };
+  ASSERT_NE(nullptr, pyo.get());
+  EXPECT_EQ(expected, CppBuilder<std::set<int>>()(pyo.get()));
+  EXPECT_FALSE(uncaught_exception());
+}
+
+TEST(CppBuilder_set, InputOrderUnmodified)
+{
+  PyRun_SimpleString("CppBuilder_set_InputOrderUnmodified = set(range(0, 1000, 7))");
+  PyRun_SimpleString("CppBuilder_set_InputOrderUnmodified_order = list(CppBuilder_set_InputOrderUnmodified)");
+  unique_ptr_ctn pyo { PyRun_String("CppBuilder_set_InputOrderUnmodified", Py_eval_input, get_py_dict(), NULL) };
+  ASSERT_NE(nullptr, pyo.get());
+  EXPECT_EQ(143, CppBuilder<std::set<int>>()(pyo.get()).size());
+  EXPECT_TRUE(CppBuilder<std::set<int>>().eligible(pyo.get()));
+  EXPECT_FALSE(uncaught_exception());
+  
+  unique_ptr_ctn pyo_check { PyRun_String(
+      "CppBuilder_set_InputOrderUnmodified_order == list(CppBuilder_set_InputOrderUnmodified)", Py_eval_input, get_py_dict(), NULL) };
+  EXPECT_TRUE(CppBuilder<bool>()(pyo_check.get()));
+  EXPECT_FALSE(uncaught_exception());
+}
+
 /** map **/
 
 TEST(CppBuilder_map, FromDict)
@@ -611,39 +1120,467 @@ TEST(CppBuilder_map, FromDict)
   EXPECT_FALSE(uncaught_exception());
 }
 
-/** struct/class **/
+TEST(CppBuilder_map, FromLargeDict)
+{
+  unique_ptr_ctn pyo { PyRun_String("dict((i, [i, -i]) for i in xrange(1000, 0, -1))", Py_eval_input, get_py_dict(), NULL) };
+  std::map<int, std::vector<int>> expected;
+  for (int i { 1 } ; i <= 1000 ; ++i)
+  {
+    expected[i] = { i, -i };
+  }
+  ASSERT_NE(nullptr, pyo.get());
+  auto ret = CppBuilder<std::map<int, std::vector<int>>>()(pyo.get());
+  EXPECT_EQ(expected, ret);
+  EXPECT_FALSE(uncaught_exception());
+}
 
-namespace
+TEST(CppBuilder_map, SameCppKeys)
 {
-  class Point
+  // '\xc3\xa9' and u'\xe9' are distinct keys of the dict but give the same std::string
+  unique_ptr_ctn pyo { PyRun_String("{'\\xc3\\xa9': 1, u'\\xe9': 2, 'x': 3}", Py_eval_input, get_py_dict(), NULL) };
+  ASSERT_NE(nullptr, pyo.get());
+  ASSERT_EQ(3, PyDict_Size(pyo.get()));
+  int last { 0 };
+  PyObject *key, *value;
+  Py_ssize_t pos = 0;
+  while (PyDict_Next(pyo.get(), &pos, &key, &value))
   {
-    int x, y, z;
-    void setX(int x) {this->x = x;}
-    void setY(int y) {this->y = y;}
-    void setZ(int z) {this->z = z;}
-  
-  public:
-    Point() : x(0), y(0), z(0) {}
-    Point(int x, int y, int z) : x(x), y(y), z(z) {}
-    Point(const Point&) = default;
-    bool operator==(const Point& p) const {return x == p.x && y == p.y && z == p.z;}
-    bool operator<(const Point& p) const {return x < p.x || (x == p.x && (y < p.y || (y == p.y && z < p.z)));}
-    
-    struct FromPy : CppBuilder<FromTuple<Point, int, int, int>>
-    {
-      FromPy() : CppBuilder<FromTuple<Point, int, int, int>>(&Point::setX, &Point::setY, &Point::setZ) {}
-    };
-    struct FromPyArgs : CppBuilder<FromTuple<Point, int, int, int>>
-    {
-      FromPyArgs() : CppBuilder<FromTuple<Point, int, int, int>>(&Point::x, &Point::y, &Point::z) {}
-    };
-    struct FromPyDict : CppBuilder<FromDict<Point, int, int, int>>
+    if (PyUnicode_Check(key) || PyString_AS_STRING(key)[0] != 'x')
     {
-      FromPyDict() : CppBuilder<FromDict<Point, int, int, int>>(
-            make_mapping("x", &Point::setX)
-            , make_mapping("y", &Point::setY)
-            , make_mapping("z", &Point::setZ)) {}
-    };
+      last = PyInt_AsLong(value);
+    }
+  }
+  std::map<std::string, int> expected { {"\xc3\xa9", last}, {"x", 3} };
+  auto ret = CppBuilder<std::map<std::string, int>>()(pyo.get());
+  EXPECT_EQ(expected, ret);
+  EXPECT_FALSE(uncaught_exception());
+}
+
+/** unordered_map **/
+
+TEST(CppBuilder_unordered_map, FromDict)
+{
+  unique_ptr_ctn pyo { PyRun_String("{'x': 1, 'y': 3}", Py_eval_input, get_py_dict(), NULL) };
+  std::unordered_map<std::string, int> expected { {"x", 1}, {"y", 3} };
+  ASSERT_NE(nullptr, pyo.get());
+
+  auto Functor =  CppBuilder<std::unordered_map<std::string, int>>();
+  EXPECT_EQ(expected, Functor(pyo.get()));
+  EXPECT_FALSE(uncaught_exception());
+}
+
+TEST(CppBuilder_unordered_map, FromDictWithTupleKeys)
+{
+  unique_ptr_ctn pyo { PyRun_String("{(0, 1, .5): 1, (1, 0, .5): 3}", Py_eval_input, get_py_dict(), NULL) };
+  ASSERT_NE(nullptr, pyo.get());
+
+  auto ret = CppBuilder<std::unordered_map<std::tuple<int, int, double>, int>>()(pyo.get());
+  EXPECT_EQ(2, ret.size());
+  EXPECT_EQ(1, ret[std::make_tuple(0, 1, .5)]);
+  EXPECT_EQ(3, ret[std::make_tuple(1, 0, .5)]);
+  EXPECT_FALSE(uncaught_exception());
+}
+
+TEST(CppBuilder_unordered_map, SameCppKeys)
+{
+  // '\xc3\xa9' and u'\xe9' are distinct keys of the dict but give the same std::string
+  unique_ptr_ctn pyo { PyRun_String("{'\\xc3\\xa9': 1, u'\\xe9': 2, 'x': 3}", Py_eval_input, get_py_dict(), NULL) };
+  ASSERT_NE(nullptr, pyo.get());
+  ASSERT_EQ(3, PyDict_Size(pyo.get()));
+  int last { 0 };
+  PyObject *key, *value;
+  Py_ssize_t pos = 0;
+  while (PyDict_Next(pyo.get(), &pos, &key, &value))
+  {
+    if (PyUnicode_Check(key) || PyString_AS_STRING(key)[0] != 'x')
+    {
+      last = PyInt_AsLong(value);
+    }
+  }
+  std::unordered_map<std::string, int> expected { {"\xc3\xa9", last}, {"x", 3} };
+  CppBuilder<std::unordered_map<std::string, int>> builder;
+  EXPECT_EQ(expected, builder(pyo.get()));
+
+  Expected<std::unordered_map<std::string, int>> tried { try_convert(builder, pyo.get()) };
+  ASSERT_TRUE(tried);
+  EXPECT_EQ(expected, *tried);
+
+  std::unordered_map<std::string, int> into { {"\xc3\xa9", 0}, {"x", 0} };
+  builder.build_into(into, pyo.get());
+  EXPECT_EQ(expected, into);
+  EXPECT_FALSE(uncaught_exception());
+}
+
+/** unordered_set **/
+
+TEST(CppBuilder_unordered_set, FromSet)
+{
+  unique_ptr_ctn pyo { PyRun_String("set([1,8,3])", Py_eval_input, get_py_dict(), NULL) };
+  std::unordered_set<int> expected { 1, 8, 3 };
+  ASSERT_NE(nullptr, pyo.get());
+  EXPECT_EQ(expected, CppBuilder<std::unordered_set<int>>()(pyo.get()));
+  EXPECT_FALSE(uncaught_exception());
+}
+
+TEST(CppBuilder_unordered_set, FromFrozenSetOfTuples)
+{
+  unique_ptr_ctn pyo { PyRun_String("frozenset([(1, 'a'), (2, 'b')])", Py_eval_input, get_py_dict(), NULL) };
+  ASSERT_NE(nullptr, pyo.get());
+  auto ret = CppBuilder<std::unordered_set<std::tuple<int, std::string>>>()(pyo.get());
+  EXPECT_EQ(2, ret.size());
+  EXPECT_EQ(1, ret.count(std::make_tuple(1, "a")));
+  EXPECT_EQ(1, ret.count(std::make_tuple(2, "b")));
+  EXPECT_FALSE(uncaught_exception());
+}
+
+/** arena **/
+
+TEST(CppBuilder_arena, VectorOfStrings)
+{
+  unique_ptr_ctn pyo { PyRun_String("['a' * i for i in xrange(100)] + [u'caf\\xe9' * 10]", Py_eval_input, get_py_dict(), NULL) };
+  ASSERT_NE(nullptr, pyo.get());
+  ArenaEstimate estimate { estimate_arena<ArenaVector<ArenaString>>(pyo.get()) };
+  EXPECT_EQ(103, estimate.allocations); // vector, 100 PyString and 2 for the PyUnicode
+  
+  MonotonicArena arena(estimate.size());
+  ArenaScope scope(&arena);
+  auto ret = CppBuilder<ArenaVector<ArenaString>>()(pyo.get());
+  ASSERT_EQ(101, ret.size());
+  EXPECT_EQ(ArenaString(42, 'a'), ret[42]);
+  ArenaString expected;
+  for (int i { 0 } ; i != 10 ; ++i)
+  {
+    expected += "caf\xc3\xa9";
+  }
+  EXPECT_EQ(expected, ret[100]);
+  EXPECT_EQ(&arena, ret.get_allocator().resource());
+  EXPECT_EQ(&arena, ret[99].get_allocator().resource());
+  EXPECT_EQ(1, arena.blocks());
+  EXPECT_LE(arena.used(), estimate.size());
+  EXPECT_FALSE(uncaught_exception());
+}
+
+TEST(CppBuilder_arena, MapOfVectors)
+{
+  unique_ptr_ctn pyo { PyRun_String("dict(('key%d' % i, range(i)) for i in xrange(200))", Py_eval_input, get_py_dict(), NULL) };
+  ASSERT_NE(nullptr, pyo.get());
+  typedef ArenaMap<ArenaString, ArenaVector<int>> Type;
+  
+  MonotonicArena arena(estimate_arena<Type>(pyo.get()).size());
+  ArenaScope scope(&arena);
+  auto ret = CppBuilder<Type>()(pyo.get());
+  ASSERT_EQ(200, ret.size());
+  EXPECT_EQ(ArenaVector<int>({ 0, 1, 2 }), ret.at("key3"));
+  EXPECT_EQ(&arena, ret.at("key199").get_allocator().resource());
+  EXPECT_EQ(1, arena.blocks());
+  EXPECT_FALSE(uncaught_exception());
+}
+
+TEST(CppBuilder_arena, UnorderedAndSets)
+{
+  unique_ptr_ctn pyo { PyRun_String("({'x': set([1, 2]), u'y': set([3])}, frozenset(['a', 'b']))", Py_eval_input, get_py_dict(), NULL) };
+  ASSERT_NE(nullptr, pyo.get());
+  typedef std::tuple<ArenaUnorderedMap<ArenaString, ArenaSet<int>>, ArenaUnorderedSet<ArenaString>> Type;
+  
+  MonotonicArena arena(estimate_arena<Type>(pyo.get()).size());
+  ArenaScope scope(&arena);
+  auto ret = CppBuilder<Type>()(pyo.get());
+  EXPECT_EQ(ArenaSet<int>({ 1, 2 }), std::get<0>(ret).at("x"));
+  EXPECT_EQ(ArenaSet<int>({ 3 }), std::get<0>(ret).at("y"));
+  EXPECT_EQ(2, std::get<1>(ret).size());
+  EXPECT_EQ(1, std::get<1>(ret).count("b"));
+  EXPECT_EQ(1, arena.blocks());
+  EXPECT_FALSE(uncaught_exception());
+}
+
+TEST(CppBuilder_arena, GrowsWithoutEstimate)
+{
+  unique_ptr_ctn pyo { PyRun_String("[str(i) * 20 for i in xrange(1000)]", Py_eval_input, get_py_dict(), NULL) };
+  ASSERT_NE(nullptr, pyo.get());
+  MonotonicArena arena(0);
+  {
+    ArenaScope scope(&arena);
+    auto ret = CppBuilder<ArenaVector<ArenaString>>()(pyo.get());
+    EXPECT_EQ(CppBuilder<std::vector<std::string>>()(pyo.get())[999], std::string(ret[999].c_str()));
+  }
+  EXPECT_LT(1, arena.blocks());
+  arena.release();
+  EXPECT_EQ(0, arena.blocks());
+  EXPECT_EQ(0, arena.used());
+  EXPECT_EQ(new_delete_resource(), current_memory_resource());
+  EXPECT_FALSE(uncaught_exception());
+}
+
+TEST(CppBuilder_arena, DefaultResource)
+{
+  unique_ptr_ctn pyo { PyRun_String("[[1, 2], [3]]", Py_eval_input, get_py_dict(), NULL) };
+  ASSERT_NE(nullptr, pyo.get());
+  auto ret = CppBuilder<ArenaVector<ArenaVector<int>>>()(pyo.get());
+  EXPECT_EQ(new_delete_resource(), ret[1].get_allocator().resource());
+  EXPECT_EQ(ArenaVector<int>({ 3 }), ret[1]);
+  EXPECT_EQ(0, estimate_arena<std::vector<std::string>>(pyo.get()).allocations);
+  EXPECT_FALSE(uncaught_exception());
+}
+
+/** buffer **/
+
+TEST(CppBuilder_buffer, ViewFromCtypesArray)
+{
+  PyRun_SimpleString("import ctypes");
+  unique_ptr_ctn pyo { PyRun_String("(ctypes.c_double * 3)(1.5, 2., -4.)", Py_eval_input, get_py_dict(), NULL) };
+  ASSERT_NE(nullptr, pyo.get());
+  {
+    BufferView<double> view { CppBuilder<BufferView<double>>()(pyo.get()) };
+    ASSERT_EQ(3, view.size());
+    EXPECT_EQ(pyo.get(), view.owner());
+    EXPECT_EQ(1.5, view[0]);
+    EXPECT_EQ(2., view[1]);
+    EXPECT_EQ(-4., view[2]);
+  }
+  EXPECT_FALSE(uncaught_exception());
+}
+
+TEST(CppBuilder_buffer, ViewFromString)
+{
+  unique_ptr_ctn pyo { PyRun_String("'abc'", Py_eval_input, get_py_dict(), NULL) };
+  ASSERT_NE(nullptr, pyo.get());
+  {
+    BufferView<char> view { CppBuilder<BufferView<char>>()(pyo.get()) };
+    EXPECT_EQ("abc", std::string(view.begin(), view.end()));
+  }
+  EXPECT_FALSE(uncaught_exception());
+}
+
+TEST(CppBuilder_buffer, ViewWithWrongFormat)
+{
+  PyRun_SimpleString("import ctypes");
+  unique_ptr_ctn pyo { PyRun_String("(ctypes.c_int * 3)(1, 2, 3)", Py_eval_input, get_py_dict(), NULL) };
+  ASSERT_NE(nullptr, pyo.get());
+  EXPECT_FALSE(CppBuilder<BufferView<double>>().eligible(pyo.get()));
+  EXPECT_FALSE(CppBuilder<BufferView<unsigned int>>().eligible(pyo.get()));
+  EXPECT_TRUE(CppBuilder<BufferView<int>>().eligible(pyo.get()));
+  EXPECT_THROW(CppBuilder<BufferView<double>>()(pyo.get()), std::invalid_argument);
+  EXPECT_FALSE(uncaught_exception());
+}
+
+TEST(CppBuilder_buffer, CopyFromCtypesArray)
+{
+  PyRun_SimpleString("import ctypes");
+  unique_ptr_ctn pyo { PyRun_String("(ctypes.c_double * 3)(1.5, 2., -4.)", Py_eval_input, get_py_dict(), NULL) };
+  std::vector<double> expected { 1.5, 2., -4. };
+  ASSERT_NE(nullptr, pyo.get());
+  EXPECT_EQ(expected, CppBuilder<FromBuffer<double>>()(pyo.get()));
+  EXPECT_FALSE(uncaught_exception());
+}
+
+TEST(CppBuilder_buffer, CopyFromList)
+{
+  unique_ptr_ctn pyo { PyRun_String("[1.5, 2., -4.]", Py_eval_input, get_py_dict(), NULL) };
+  ASSERT_NE(nullptr, pyo.get());
+  EXPECT_FALSE(CppBuilder<FromBuffer<double>>().eligible(pyo.get()));
+  EXPECT_THROW(CppBuilder<FromBuffer<double>>()(pyo.get()), std::invalid_argument);
+  EXPECT_FALSE(uncaught_exception());
+}
+
+TEST(CppBuilder_ndarray, ViewOnCtypesMatrix)
+{
+  PyRun_SimpleString("import ctypes");
+  unique_ptr_ctn pyo { PyRun_String("((ctypes.c_double * 3) * 2)((1., 2., 3.), (4., 5., 6.))", Py_eval_input, get_py_dict(), NULL) };
+  ASSERT_NE(nullptr, pyo.get());
+  {
+    Matrix<double> ret { CppBuilder<Matrix<double>>()(pyo.get()) };
+    EXPECT_TRUE(ret.is_view());
+    EXPECT_EQ(pyo.get(), ret.owner());
+    EXPECT_EQ(2, ret.shape(0));
+    EXPECT_EQ(3, ret.shape(1));
+    EXPECT_EQ(6, ret.size());
+    EXPECT_EQ(2., ret(0, 1));
+    EXPECT_EQ(4., ret(1, 0));
+    EXPECT_EQ(std::vector<double>({ 1., 2., 3., 4., 5., 6. }), std::vector<double>(ret.begin(), ret.end()));
+  }
+  EXPECT_FALSE(uncaught_exception());
+}
+
+TEST(CppBuilder_ndarray, View3D)
+{
+  PyRun_SimpleString("import ctypes");
+  unique_ptr_ctn pyo { PyRun_String("(((ctypes.c_int * 2) * 3) * 2)(((0, 1), (2, 3), (4, 5)), ((6, 7), (8, 9), (10, 11)))", Py_eval_input, get_py_dict(), NULL) };
+  ASSERT_NE(nullptr, pyo.get());
+  {
+    NdArray<int, 3> ret { CppBuilder<NdArray<int, 3>>()(pyo.get()) };
+    std::array<std::size_t, 3> expected { { 2, 3, 2 } };
+    EXPECT_EQ(expected, ret.shape());
+    EXPECT_EQ(9, ret(1, 1, 1));
+  }
+  EXPECT_FALSE(uncaught_exception());
+}
+
+TEST(CppBuilder_ndarray, MismatchedRankOrType)
+{
+  PyRun_SimpleString("import ctypes");
+  unique_ptr_ctn pyo { PyRun_String("((ctypes.c_double * 3) * 2)()", Py_eval_input, get_py_dict(), NULL) };
+  ASSERT_NE(nullptr, pyo.get());
+  EXPECT_TRUE(CppBuilder<Matrix<double>>().eligible(pyo.get()));
+  typedef NdArray<double, 1> Vector1D;
+  typedef NdArray<double, 3> Vector3D;
+  EXPECT_FALSE(CppBuilder<Vector1D>().eligible(pyo.get()));
+  EXPECT_FALSE(CppBuilder<Vector3D>().eligible(pyo.get()));
+  EXPECT_FALSE(CppBuilder<Matrix<int>>().eligible(pyo.get()));
+  EXPECT_FALSE(CppBuilder<Matrix<float>>().try_build(pyo.get()).has_value());
+  EXPECT_THROW(CppBuilder<Vector3D>()(pyo.get()), std::invalid_argument);
+  EXPECT_FALSE(uncaught_exception());
+}
+
+TEST(CppBuilder_ndarray, GatherStrided)
+{
+  // transposed view on a 3x2 row-major matrix
+  double raw[] = { 1., 2., 3., 4., 5., 6. };
+  Py_ssize_t shape[] = { 2, 3 };
+  Py_ssize_t strides[] = { sizeof(double), 2 * sizeof(double) };
+  Py_buffer view {};
+  view.buf = raw;
+  view.len = sizeof(raw);
+  view.itemsize = sizeof(double);
+  view.ndim = 2;
+  view.shape = shape;
+  view.strides = strides;
+  
+  Matrix<double> ret { _ndArrayFromBuffer<double, 2>(view) };
+  EXPECT_FALSE(ret.is_view());
+  EXPECT_EQ(std::vector<double>({ 1., 3., 5., 2., 4., 6. }), std::vector<double>(ret.begin(), ret.end()));
+  EXPECT_EQ(5., ret(0, 2));
+}
+
+/** lazy views **/
+
+TEST(CppBuilder_lazy, VectorOnAccess)
+{
+  unique_ptr_ctn pyo { PyRun_String("[1, 2, 'three', 4]", Py_eval_input, get_py_dict(), NULL) };
+  ASSERT_NE(nullptr, pyo.get());
+  {
+    LazyVector<int> ret { CppBuilder<LazyVector<int>>()(pyo.get()) };
+    EXPECT_EQ(pyo.get(), ret.owner());
+    ASSERT_EQ(4, ret.size());
+    EXPECT_EQ(2, ret[1]);
+    EXPECT_EQ(4, ret.at(3));
+    EXPECT_THROW(ret[2], std::invalid_argument);
+    EXPECT_THROW(ret.at(4), std::out_of_range);
+    int sum { 0 };
+    for (auto it = ret.begin() ; it != ret.end() && it != std::next(ret.begin(), 2) ; ++it)
+    {
+      sum += *it;
+    }
+    EXPECT_EQ(3, sum);
+  }
+  EXPECT_THROW(CppBuilder<LazyVector<int>>()(get_py_dict()), std::invalid_argument);
+  EXPECT_FALSE(uncaught_exception());
+}
+
+TEST(CppBuilder_lazy, VectorMemoized)
+{
+  unique_ptr_ctn pyo { PyRun_String("(['a' * 40, 'b' * 40], ['c' * 40])", Py_eval_input, get_py_dict(), NULL) };
+  ASSERT_NE(nullptr, pyo.get());
+  LazyVector<std::vector<std::string>, true> ret { CppBuilder<LazyVector<std::vector<std::string>, true>>()(pyo.get()) };
+  std::vector<std::string> const& first { ret[0] };
+  ASSERT_EQ(2, first.size());
+  std::size_t before { numAllocations };
+  EXPECT_EQ(&first, &ret[0]);
+  EXPECT_EQ(&first, &*ret.begin());
+  EXPECT_EQ(before, numAllocations);
+  EXPECT_EQ(std::string(40, 'c'), ret.back()[0]);
+  EXPECT_EQ(&first, &ret[0]); // still valid after other conversions
+  EXPECT_EQ(2, ret.materialize().size());
+  EXPECT_FALSE(uncaught_exception());
+}
+
+TEST(CppBuilder_lazy, OutlivesSource)
+{
+  LazyVector<double> ret;
+  {
+    std::unique_ptr<PyObject, decref> pyo { PyRun_String("[.5, 1.5]", Py_eval_input, get_py_dict(), NULL) };
+    ASSERT_NE(nullptr, pyo.get());
+    ret = CppBuilder<LazyVector<double>>()(pyo.get());
+  }
+  EXPECT_EQ(1, Py_REFCNT(ret.owner()));
+  LazyVector<double> copy { ret };
+  EXPECT_EQ(2, Py_REFCNT(ret.owner()));
+  EXPECT_EQ(1.5, copy[1]);
+  EXPECT_FALSE(uncaught_exception());
+}
+
+TEST(CppBuilder_lazy, Map)
+{
+  unique_ptr_ctn pyo { PyRun_String("{'a': [1, 2], u'b': [3], 'c': None}", Py_eval_input, get_py_dict(), NULL) };
+  ASSERT_NE(nullptr, pyo.get());
+  LazyMap<std::string, std::vector<int>> ret { CppBuilder<LazyMap<std::string, std::vector<int>>>()(pyo.get()) };
+  EXPECT_EQ(3, ret.size());
+  EXPECT_EQ(1, ret.count("b"));
+  EXPECT_EQ(0, ret.count("d"));
+  EXPECT_EQ(std::vector<int>({ 1, 2 }), ret.at("a"));
+  EXPECT_EQ(std::vector<int>({ 3 }), ret.at("b"));
+  EXPECT_THROW(ret.at("c"), std::invalid_argument);
+  EXPECT_THROW(ret.at("d"), std::out_of_range);
+  
+  std::set<std::string> keys;
+  for (auto it = ret.begin() ; it != ret.end() ; ++it)
+  {
+    keys.insert(it.key());
+  }
+  EXPECT_EQ(std::set<std::string>({ "a", "b", "c" }), keys);
+  EXPECT_FALSE(uncaught_exception());
+}
+
+TEST(CppBuilder_lazy, MapMemoized)
+{
+  unique_ptr_ctn pyo { PyRun_String("{1: 'one' * 10, 2: 'two' * 10}", Py_eval_input, get_py_dict(), NULL) };
+  ASSERT_NE(nullptr, pyo.get());
+  auto ret = CppBuilder<LazyMap<int, std::string, true>>()(pyo.get());
+  std::string const& one { ret.at(1) };
+  std::size_t before { numAllocations };
+  EXPECT_EQ(&one, &ret.at(1));
+  EXPECT_EQ(before, numAllocations);
+  std::map<int, std::string> entries;
+  for (auto const& entry : ret)
+  {
+    entries.insert(entry);
+  }
+  EXPECT_EQ((CppBuilder<std::map<int, std::string>>()(pyo.get())), entries);
+  EXPECT_FALSE(uncaught_exception());
+}
+
+/** struct/class **/
+
+namespace
+{
+  class Point
+  {
+    int x, y, z;
+    void setX(int x) {this->x = x;}
+    void setY(int y) {this->y = y;}
+    void setZ(int z) {this->z = z;}
+  
+  public:
+    Point() : x(0), y(0), z(0) {}
+    Point(int x, int y, int z) : x(x), y(y), z(z) {}
+    Point(const Point&) = default;
+    bool operator==(const Point& p) const {return x == p.x && y == p.y && z == p.z;}
+    bool operator<(const Point& p) const {return x < p.x || (x == p.x && (y < p.y || (y == p.y && z < p.z)));}
+    
+    struct FromPy : CppBuilder<FromTuple<Point, int, int, int>>
+    {
+      FromPy() : CppBuilder<FromTuple<Point, int, int, int>>(&Point::setX, &Point::setY, &Point::setZ) {}
+    };
+    struct FromPyArgs : CppBuilder<FromTuple<Point, int, int, int>>
+    {
+      FromPyArgs() : CppBuilder<FromTuple<Point, int, int, int>>(&Point::x, &Point::y, &Point::z) {}
+    };
+    struct FromPyDict : CppBuilder<FromDict<Point, int, int, int>>
+    {
+      FromPyDict() : CppBuilder<FromDict<Point, int, int, int>>(
+            make_mapping("x", &Point::setX)
+            , make_mapping("y", &Point::setY)
+            , make_mapping("z", &Point::setZ)) {}
+    };
     struct FromPyDictArgs : CppBuilder<FromDict<Point, int, int, int>>
     {
       FromPyDictArgs() : CppBuilder<FromDict<Point, int, int, int>>(
@@ -651,6 +1588,26 @@ namespace
             , make_mapping("y", &Point::y)
             , make_mapping("z", &Point::z)) {}
     };
+    struct FromPyFields : CppBuilder<FromTuple<Point, PY2CPP_FIELD(&Point::setX), PY2CPP_FIELD(&Point::setY), PY2CPP_FIELD(&Point::setZ)>>
+    {};
+    struct FromPyDictFields : CppBuilder<FromDict<Point, PY2CPP_FIELD(&Point::x), PY2CPP_FIELD(&Point::y), PY2CPP_FIELD(&Point::z)>>
+    {
+      FromPyDictFields() : CppBuilder<FromDict<Point, PY2CPP_FIELD(&Point::x), PY2CPP_FIELD(&Point::y), PY2CPP_FIELD(&Point::z)>>("x", "y", "z") {}
+    };
+    struct FromPyDictMixed : CppBuilder<FromDict<Point, PY2CPP_FIELD(&Point::x), int, PY2CPP_FIELD(&Point::setZ)>>
+    {
+      FromPyDictMixed() : CppBuilder<FromDict<Point, PY2CPP_FIELD(&Point::x), int, PY2CPP_FIELD(&Point::setZ)>>(
+            "x"
+            , make_mapping("y", &Point::y)
+            , "z") {}
+    };
+    struct FromPyDictScan : CppBuilder<FromDictScan<Point, int, int, int>>
+    {
+      FromPyDictScan() : CppBuilder<FromDictScan<Point, int, int, int>>(
+            make_mapping("x", &Point::x)
+            , make_mapping("y", &Point::y)
+            , make_mapping("z", &Point::z)) {}
+    };
   };
   class Line
   {
@@ -729,156 +1686,1083 @@ namespace
     };
     struct FromPyMethod : CppBuilder<FromDict<OnlyMoveOfOnlyMove, OnlyMove::FromPy>>
     {
-      FromPyMethod() : CppBuilder<FromDict<OnlyMoveOfOnlyMove, OnlyMove::FromPy>>(
-            make_mapping("nmove", &OnlyMoveOfOnlyMove::setOnlyMove)) {}
+      FromPyMethod() : CppBuilder<FromDict<OnlyMoveOfOnlyMove, OnlyMove::FromPy>>(
+            make_mapping("nmove", &OnlyMoveOfOnlyMove::setOnlyMove)) {}
+    };
+  };
+}
+
+TEST(CppBuilder_struct, FromTuple)
+{
+  unique_ptr_ctn pyo { PyRun_String("(1, 3, 4)", Py_eval_input, get_py_dict(), NULL) };
+  Point expected { 1, 3, 4 };
+  ASSERT_NE(nullptr, pyo.get());
+  EXPECT_EQ(expected, Point::FromPy()(pyo.get()));
+  EXPECT_FALSE(uncaught_exception());
+}
+
+TEST(CppBuilder_struct, FromTooSmallTuple)
+{
+  unique_ptr_ctn pyo { PyRun_String("(1,)", Py_eval_input, get_py_dict(), NULL) };
+  ASSERT_NE(nullptr, pyo.get());
+  EXPECT_THROW(Point::FromPy()(pyo.get()), std::invalid_argument);
+  EXPECT_FALSE(uncaught_exception());
+}
+
+TEST(CppBuilder_struct, FromTooLargeTuple)
+{
+  unique_ptr_ctn pyo { PyRun_String("(1, 2, 3, 4)", Py_eval_input, get_py_dict(), NULL) };
+  ASSERT_NE(nullptr, pyo.get());
+  EXPECT_THROW(Point::FromPy()(pyo.get()), std::invalid_argument);
+  EXPECT_FALSE(uncaught_exception());
+}
+
+TEST(CppBuilder_struct, FromTupleArgs)
+{
+  unique_ptr_ctn pyo { PyRun_String("(1, 3, 4)", Py_eval_input, get_py_dict(), NULL) };
+  Point expected { 1, 3, 4 };
+  ASSERT_NE(nullptr, pyo.get());
+  EXPECT_EQ(expected, Point::FromPyArgs()(pyo.get()));
+  EXPECT_FALSE(uncaught_exception());
+}
+
+TEST(CppBuilder_struct, FromDict)
+{
+  unique_ptr_ctn pyo { PyRun_String("{'y': 3, 'x': 1, 'z': 4}", Py_eval_input, get_py_dict(), NULL) };
+  Point expected { 1, 3, 4 };
+  ASSERT_NE(nullptr, pyo.get());
+  EXPECT_EQ(expected, Point::FromPyDict()(pyo.get()));
+  EXPECT_FALSE(uncaught_exception());
+}
+
+TEST(CppBuilder_struct, FromDictArgs)
+{
+  unique_ptr_ctn pyo { PyRun_String("{'y': 3, 'x': 1, 'z': 4}", Py_eval_input, get_py_dict(), NULL) };
+  Point expected { 1, 3, 4 };
+  ASSERT_NE(nullptr, pyo.get());
+  EXPECT_EQ(expected, Point::FromPyDictArgs()(pyo.get()));
+  EXPECT_FALSE(uncaught_exception());
+}
+
+TEST(CppBuilder_struct, FromTupleFields)
+{
+  unique_ptr_ctn pyo { PyRun_String("(1, 3, 4)", Py_eval_input, get_py_dict(), NULL) };
+  Point expected { 1, 3, 4 };
+  ASSERT_NE(nullptr, pyo.get());
+  EXPECT_EQ(expected, Point::FromPyFields()(pyo.get()));
+  EXPECT_FALSE(uncaught_exception());
+}
+
+TEST(CppBuilder_struct, FromDictFields)
+{
+  unique_ptr_ctn pyo { PyRun_String("{'y': 3, 'x': 1, 'z': 4}", Py_eval_input, get_py_dict(), NULL) };
+  Point expected { 1, 3, 4 };
+  ASSERT_NE(nullptr, pyo.get());
+  EXPECT_EQ(expected, Point::FromPyDictFields()(pyo.get()));
+  EXPECT_EQ(expected, Point::FromPyDictMixed()(pyo.get()));
+  EXPECT_FALSE(uncaught_exception());
+}
+
+TEST(CppBuilder_struct, FromDictFieldsCustomBuilder)
+{
+  struct Segment
+  {
+    Point from, to;
+    std::vector<int> tags;
+  };
+  typedef CppBuilder<FromDict<Segment
+      , Field<decltype(&Segment::from), &Segment::from, Point::FromPy>
+      , Field<decltype(&Segment::to), &Segment::to, Point::FromPyDict>
+      , PY2CPP_FIELD(&Segment::tags)>> Builder;
+  unique_ptr_ctn pyo { PyRun_String("{'from': (1, 2, 3), 'to': {'x': 4, 'y': 5, 'z': 6}, 'tags': [7, 8]}", Py_eval_input, get_py_dict(), NULL) };
+  ASSERT_NE(nullptr, pyo.get());
+  Segment ret { Builder("from", "to", "tags")(pyo.get()) };
+  EXPECT_EQ(Point(1, 2, 3), ret.from);
+  EXPECT_EQ(Point(4, 5, 6), ret.to);
+  EXPECT_EQ(std::vector<int>({ 7, 8 }), ret.tags);
+  EXPECT_FALSE(uncaught_exception());
+}
+
+TEST(CppBuilder_struct, FromDictScan)
+{
+  unique_ptr_ctn pyo { PyRun_String("{'y': 3, 'unknown': 'toto', u'x': 1, 'z': 4, 5: 6}", Py_eval_input, get_py_dict(), NULL) };
+  Point expected { 1, 3, 4 };
+  ASSERT_NE(nullptr, pyo.get());
+  EXPECT_EQ(expected, Point::FromPyDictScan()(pyo.get()));
+  EXPECT_FALSE(uncaught_exception());
+}
+
+TEST(CppBuilder_struct, FromDictScanMissingKeys)
+{
+  unique_ptr_ctn pyo { PyRun_String("{'z': 4}", Py_eval_input, get_py_dict(), NULL) };
+  Point expected { 0, 0, 4 };
+  ASSERT_NE(nullptr, pyo.get());
+  EXPECT_EQ(expected, Point::FromPyDictScan()(pyo.get()));
+  EXPECT_FALSE(uncaught_exception());
+}
+
+TEST(CppBuilder_struct, FromDictScanCopiedBuilder)
+{
+  unique_ptr_ctn pyo { PyRun_String("{'y': 3, 'x': 1, 'z': 4}", Py_eval_input, get_py_dict(), NULL) };
+  Point expected { 1, 3, 4 };
+  ASSERT_NE(nullptr, pyo.get());
+  std::unique_ptr<Point::FromPyDictScan> original { new Point::FromPyDictScan() };
+  Point::FromPyDictScan copy { *original };
+  original.reset();
+  EXPECT_EQ(expected, copy(pyo.get()));
+  EXPECT_FALSE(uncaught_exception());
+}
+
+TEST(CppBuilder_struct, FromDictScanDuplicatedKeys)
+{
+  typedef CppBuilder<FromDictScan<Point, int, int>> Builder;
+  std::function<void(Point&, int)> ignore { [](Point&, int) {} };
+  EXPECT_THROW(Builder(make_mapping("x", ignore), make_mapping("x", ignore)), std::invalid_argument);
+}
+
+TEST(CppBuilder_struct, FromObjectScan)
+{
+  PyRun_SimpleString("class Point:\n   x = 5\n   z = 14");
+  unique_ptr_ctn pyo { PyRun_String("Point", Py_eval_input, get_py_dict(), NULL) };
+  Point expected { 5, 0, 14 };
+  ASSERT_NE(nullptr, pyo.get());
+  EXPECT_EQ(expected, Point::FromPyDictScan()(pyo.get()));
+  EXPECT_FALSE(uncaught_exception());
+}
+
+TEST(CppBuilder_struct, FromObject)
+{
+  PyRun_SimpleString("class Point:\n   x = 5\n   z = 14");
+  unique_ptr_ctn pyo { PyRun_String("Point", Py_eval_input, get_py_dict(), NULL) };
+  Point expected { 5, 0, 14 };
+  ASSERT_NE(nullptr, pyo.get());
+  EXPECT_EQ(expected, Point::FromPyDictArgs()(pyo.get()));
+  EXPECT_FALSE(uncaught_exception());
+}
+
+TEST(CppBuilder_struct, FromDictUnicodeKeys)
+{
+  unique_ptr_ctn pyo { PyRun_String("{u'y': 3, u'x': 1, 'z': 4}", Py_eval_input, get_py_dict(), NULL) };
+  Point expected { 1, 3, 4 };
+  ASSERT_NE(nullptr, pyo.get());
+  EXPECT_EQ(expected, Point::FromPyDictArgs()(pyo.get()));
+  EXPECT_FALSE(uncaught_exception());
+}
+
+TEST(CppBuilder_struct, FromObjectFailingProperty)
+{
+  PyRun_SimpleString("class PointProperty(object):\n   x = 5\n   @property\n   def y(self): raise ValueError()");
+  unique_ptr_ctn pyo { PyRun_String("PointProperty()", Py_eval_input, get_py_dict(), NULL) };
+  Point expected { 5, 0, 0 };
+  ASSERT_NE(nullptr, pyo.get());
+  EXPECT_EQ(expected, Point::FromPyDictArgs()(pyo.get()));
+  EXPECT_EQ(nullptr, PyErr_Occurred());
+  EXPECT_FALSE(uncaught_exception());
+}
+
+TEST(CppBuilder_struct, FromInstances)
+{
+  PyRun_SimpleString(
+      "class PointOld:\n"
+      "   y = 2\n"
+      "   def __init__(self): self.x = 1\n"
+      "class PointNew(object):\n"
+      "   y = 2\n"
+      "   def __init__(self): self.x = 1\n"
+      "class PointSlots(object):\n"
+      "   __slots__ = ('x', 'y')\n"
+      "   def __init__(self): self.x = 1\n"
+      "class PointProperties(object):\n"
+      "   x = property(lambda self: 1)\n"
+      "   def __getattr__(self, name): return 2 if name == 'y' else object.__getattribute__(self, name)\n");
+  Point expected { 1, 2, 0 };
+  Point expectedSlots { 1, 0, 0 };
+  auto builder = Point::FromPyDictArgs();
+  for (unsigned run { 0 } ; run != 2 ; ++run) // second run uses the cached resolution
+  {
+    {
+      unique_ptr_ctn pyo { PyRun_String("PointOld()", Py_eval_input, get_py_dict(), NULL) };
+      ASSERT_NE(nullptr, pyo.get());
+      EXPECT_EQ(expected, builder(pyo.get()));
+    }
+    {
+      unique_ptr_ctn pyo { PyRun_String("PointNew()", Py_eval_input, get_py_dict(), NULL) };
+      ASSERT_NE(nullptr, pyo.get());
+      EXPECT_EQ(expected, builder(pyo.get()));
+    }
+    {
+      unique_ptr_ctn pyo { PyRun_String("PointSlots()", Py_eval_input, get_py_dict(), NULL) };
+      ASSERT_NE(nullptr, pyo.get());
+      EXPECT_EQ(expectedSlots, builder(pyo.get()));
+    }
+    {
+      unique_ptr_ctn pyo { PyRun_String("PointProperties()", Py_eval_input, get_py_dict(), NULL) };
+      ASSERT_NE(nullptr, pyo.get());
+      EXPECT_EQ(expected, builder(pyo.get()));
+    }
+  }
+  EXPECT_EQ(nullptr, PyErr_Occurred());
+  EXPECT_FALSE(uncaught_exception());
+}
+
+TEST(CppBuilder_struct, FromInstanceOfModifiedClass)
+{
+  PyRun_SimpleString("class PointModified(object):\n   def __init__(self): self.x = 1");
+  auto builder = Point::FromPyDictArgs();
+  {
+    unique_ptr_ctn pyo { PyRun_String("PointModified()", Py_eval_input, get_py_dict(), NULL) };
+    ASSERT_NE(nullptr, pyo.get());
+    EXPECT_EQ(Point(1, 0, 0), builder(pyo.get()));
+  }
+  PyRun_SimpleString("PointModified.y = property(lambda self: 5)\nPointModified.z = 7");
+  {
+    unique_ptr_ctn pyo { PyRun_String("PointModified()", Py_eval_input, get_py_dict(), NULL) };
+    ASSERT_NE(nullptr, pyo.get());
+    EXPECT_EQ(Point(1, 5, 7), builder(pyo.get()));
+  }
+  EXPECT_FALSE(uncaught_exception());
+}
+
+TEST(CppBuilder_struct, VectorOfStructs)
+{
+  unique_ptr_ctn pyo { PyRun_String("[(1, 3, 4), (1, 5, 5), (0, -1, 0)]", Py_eval_input, get_py_dict(), NULL) };
+  Point pts[] = { { 1, 3, 4 }, { 1, 5, 5 }, { 0, -1, 0 } };
+  
+  ASSERT_NE(nullptr, pyo.get());
+  auto ret = CppBuilder<std::vector<Point::FromPy>>()(pyo.get());
+  EXPECT_EQ(3, ret.size());
+  EXPECT_EQ(pts[0], ret[0]);
+  EXPECT_EQ(pts[1], ret[1]);
+  EXPECT_EQ(pts[2], ret[2]);
+  EXPECT_FALSE(uncaught_exception());
+}
+
+TEST(CppBuilder_struct, SetOfStructs)
+{
+  unique_ptr_ctn pyo { PyRun_String("set([(1, 3, 4), (1, 5, 5), (0, -1, 0)])", Py_eval_input, get_py_dict(), NULL) };
+  Point pts[] = { { 1, 3, 4 }, { 1, 5, 5 }, { 0, -1, 0 } };
+  
+  ASSERT_NE(nullptr, pyo.get());
+  auto ret = CppBuilder<std::set<Point::FromPy>>()(pyo.get());
+  EXPECT_EQ(3, ret.size());
+  EXPECT_NE(ret.end(), ret.find(pts[0]));
+  EXPECT_NE(ret.end(), ret.find(pts[1]));
+  EXPECT_NE(ret.end(), ret.find(pts[2]));
+  EXPECT_FALSE(uncaught_exception());
+}
+
+TEST(CppBuilder_struct, MapOfIntStructs)
+{
+  unique_ptr_ctn pyo { PyRun_String("{'x': (1, 0, 4), 'y': (0, 5, 9)}", Py_eval_input, get_py_dict(), NULL) };
+  Point pts[] = { { 1, 0, 4 }, { 0, 5, 9 } };
+  
+  ASSERT_NE(nullptr, pyo.get());
+  auto ret = CppBuilder<std::map<std::string, Point::FromPy>>()(pyo.get());
+  EXPECT_EQ(2, ret.size());
+  EXPECT_NE(ret.end(), ret.find("x"));
+  EXPECT_NE(ret.end(), ret.find("y"));
+  EXPECT_EQ(pts[0], ret.find("x")->second);
+  EXPECT_EQ(pts[1], ret.find("y")->second);
+  EXPECT_FALSE(uncaught_exception());
+}
+
+TEST(CppBuilder_struct, MapOfKeysStructAndValuesStruct)
+{
+  unique_ptr_ctn pyo { PyRun_String("{(0, 0, 0): (1, 0, 4), (1, 1, 2): (0, 5, 9)}", Py_eval_input, get_py_dict(), NULL) };
+  Point keys[] = { { 0, 0, 0 }, { 1, 1, 2 } };
+  Point pts[] = { { 1, 0, 4 }, { 0, 5, 9 } };
+  
+  ASSERT_NE(nullptr, pyo.get());
+  auto ret = CppBuilder<std::map<Point::FromPy, Point::FromPy>>()(pyo.get());
+  EXPECT_EQ(2, ret.size());
+  EXPECT_NE(ret.end(), ret.find(keys[0]));
+  EXPECT_NE(ret.end(), ret.find(keys[1]));
+  EXPECT_EQ(pts[0], ret.find(keys[0])->second);
+  EXPECT_EQ(pts[1], ret.find(keys[1])->second);
+  EXPECT_FALSE(uncaught_exception());
+}
+
+TEST(CppBuilder_struct, StructOfStructs)
+{
+  unique_ptr_ctn pyo { PyRun_String("{'oriented': True, 'pt1': (0, 0, 0), 'pt2': (1, 0, 4)}", Py_eval_input, get_py_dict(), NULL) };
+  Point pt1 { 0, 0, 0 };
+  Point pt2 { 1, 0, 4 };
+  Line line { pt1, pt2, true };
+
+  ASSERT_NE(nullptr, pyo.get());
+  EXPECT_EQ(line, Line::FromPy()(pyo.get()));
+  EXPECT_FALSE(uncaught_exception());
+}
+
+TEST(CppBuilder_struct, StructOfComplexStructs)
+{
+  unique_ptr_ctn pyo { PyRun_String("{'length': 56, 'path': [(0, 0, 0), (1, 0, 4), (1, 1, 2), (0, 5, 9)]}", Py_eval_input, get_py_dict(), NULL) };
+  std::vector<Point> pts = { { 0, 0, 0 }, { 1, 0, 4 }, { 1, 1, 2 }, { 0, 5, 9 } };
+  Path path { pts, 56 };
+
+  ASSERT_NE(nullptr, pyo.get());
+  EXPECT_EQ(path, Path::FromPy()(pyo.get()));
+  EXPECT_FALSE(uncaught_exception());
+}
+
+namespace
+{
+  class SchemaPoint
+  {
+    int x, y;
+  
+  public:
+    SchemaPoint() : x(0), y(0) {}
+    SchemaPoint(int x, int y) : x(x), y(y) {}
+    bool operator==(const SchemaPoint& p) const {return x == p.x && y == p.y;}
+    
+    PY2CPP_STRUCT(SchemaPoint, x, y);
+  };
+  struct SchemaPath
+  {
+    std::string name;
+    std::vector<SchemaPoint> points;
+    
+    PY2CPP_STRUCT(SchemaPath, name, points);
+  };
+  
+  // schema keys are interned on first use and then kept alive by the builders
+  void internSchemaKeys()
+  {
+    std::unique_ptr<PyObject, decref> pyo { PyRun_String("{'name': '', 'points': [{}]}", Py_eval_input, get_py_dict(), NULL) };
+    CppBuilder<SchemaPath>()(pyo.get());
+  }
+}
+
+TEST(CppBuilder_struct, SchemaFromDict)
+{
+  internSchemaKeys();
+  unique_ptr_ctn pyo { PyRun_String("{'y': 3, 'x': 1, 'z': 4}", Py_eval_input, get_py_dict(), NULL) };
+  ASSERT_NE(nullptr, pyo.get());
+  EXPECT_EQ(SchemaPoint(1, 3), SchemaPoint::FromPy()(pyo.get()));
+  EXPECT_EQ(SchemaPoint(1, 3), CppBuilder<SchemaPoint::py2cpp_schema>()(pyo.get()));
+  EXPECT_FALSE(uncaught_exception());
+}
+
+TEST(CppBuilder_struct, SchemaFromObject)
+{
+  internSchemaKeys();
+  PyRun_SimpleString("class SchemaPointObj(object):\n   y = 2\n   def __init__(self): self.x = 1");
+  {
+    unique_ptr_ctn pyo { PyRun_String("SchemaPointObj()", Py_eval_input, get_py_dict(), NULL) };
+    ASSERT_NE(nullptr, pyo.get());
+    EXPECT_EQ(SchemaPoint(1, 2), SchemaPoint::FromPy()(pyo.get()));
+    EXPECT_EQ(SchemaPoint(1, 2), SchemaPoint::FromPy()(pyo.get())); // cached resolution
+  }
+  {
+    unique_ptr_ctn pyo { PyRun_String("{'y': 5}", Py_eval_input, get_py_dict(), NULL) };
+    ASSERT_NE(nullptr, pyo.get());
+    EXPECT_EQ(SchemaPoint(0, 5), SchemaPoint::FromPy()(pyo.get()));
+  }
+  EXPECT_FALSE(uncaught_exception());
+}
+
+TEST(CppBuilder_struct, SchemaNested)
+{
+  internSchemaKeys();
+  unique_ptr_ctn pyo { PyRun_String("{'name': 'p', 'points': [{'x': 1, 'y': 2}, {'x': 3, 'y': 4}]}", Py_eval_input, get_py_dict(), NULL) };
+  ASSERT_NE(nullptr, pyo.get());
+  SchemaPath path { CppBuilder<SchemaPath>()(pyo.get()) };
+  EXPECT_EQ("p", path.name);
+  ASSERT_EQ(2, path.points.size());
+  EXPECT_EQ(SchemaPoint(1, 2), path.points[0]);
+  EXPECT_EQ(SchemaPoint(3, 4), path.points[1]);
+  
+  unique_ptr_ctn pyos { PyRun_String("[{'name': 'q'}]", Py_eval_input, get_py_dict(), NULL) };
+  ASSERT_NE(nullptr, pyos.get());
+  std::vector<SchemaPath> paths { CppBuilder<std::vector<SchemaPath>>()(pyos.get()) };
+  ASSERT_EQ(1, paths.size());
+  EXPECT_EQ("q", paths[0].name);
+  EXPECT_TRUE(paths[0].points.empty());
+  EXPECT_FALSE(uncaught_exception());
+}
+
+TEST(CppBuilder_struct, SchemaInvalid)
+{
+  internSchemaKeys();
+  unique_ptr_ctn pyo { PyRun_String("{'name': 'p', 'points': [{'x': 1, 'y': 'a'}]}", Py_eval_input, get_py_dict(), NULL) };
+  ASSERT_NE(nullptr, pyo.get());
+  EXPECT_THROW(CppBuilder<SchemaPath>()(pyo.get()), std::invalid_argument);
+  EXPECT_FALSE(CppBuilder<SchemaPath>().eligible(pyo.get()));
+  EXPECT_FALSE(CppBuilder<SchemaPath>().try_build(pyo.get()));
+  EXPECT_FALSE(uncaught_exception());
+}
+
+TEST(CppBuilder_struct, SchemaBuildInto)
+{
+  internSchemaKeys();
+  unique_ptr_ctn pyo { PyRun_String("{'name': 'p', 'points': [{'x': 1, 'y': 2}, {'x': 3, 'y': 4}]}", Py_eval_input, get_py_dict(), NULL) };
+  ASSERT_NE(nullptr, pyo.get());
+  SchemaPath path;
+  CppBuilder<SchemaPath> builder;
+  builder.build_into(path, pyo.get());
+  builder.build_into(path, pyo.get());
+  const SchemaPoint* data { path.points.data() };
+  
+  std::size_t before { numAllocations };
+  builder.build_into(path, pyo.get());
+  EXPECT_EQ(before, numAllocations);
+  EXPECT_EQ(data, path.points.data());
+  EXPECT_EQ(SchemaPoint(3, 4), path.points[1]);
+  EXPECT_TRUE(builder.eligible(pyo.get()));
+  EXPECT_TRUE(builder.try_build(pyo.get()));
+  EXPECT_FALSE(uncaught_exception());
+}
+
+/** PyBuilder **/
+
+namespace
+{
+  struct Pixel
+  {
+    int x, y;
+    std::string color;
+  };
+  
+  // true if pyo == expected in Python
+  bool pyEquals(PyObject* pyo, const char* expected)
+  {
+    std::unique_ptr<PyObject, decref> pyExpected { PyRun_String(expected, Py_eval_input, get_py_dict(), NULL) };
+    return pyo && pyExpected && PyObject_RichCompareBool(pyo, pyExpected.get(), Py_EQ) == 1;
+  }
+}
+
+TEST(PyBuilder, Scalars)
+{
+  unique_ptr_ctn pyTrue { PyBuilder<bool>()(true) };
+  unique_ptr_ctn pySmall { PyBuilder<int>()(5) };
+  unique_ptr_ctn pyInt { PyBuilder<unsigned long>()(123456) };
+  unique_ptr_ctn pyLong { PyBuilder<unsigned long long>()(18446744073709551615ULL) };
+  unique_ptr_ctn pyNegative { PyBuilder<long long>()(-4) };
+  unique_ptr_ctn pyDouble { PyBuilder<double>()(1.5) };
+  EXPECT_EQ(Py_True, pyTrue.get());
+  EXPECT_TRUE(PyInt_CheckExact(pySmall.get()));
+  EXPECT_TRUE(PyInt_CheckExact(pyInt.get()));
+  EXPECT_TRUE(PyLong_CheckExact(pyLong.get()));
+  EXPECT_TRUE(pyEquals(pySmall.get(), "5"));
+  EXPECT_TRUE(pyEquals(pyInt.get(), "123456"));
+  EXPECT_TRUE(pyEquals(pyLong.get(), "18446744073709551615"));
+  EXPECT_TRUE(pyEquals(pyNegative.get(), "-4"));
+  EXPECT_TRUE(pyEquals(pyDouble.get(), "1.5"));
+  
+  unique_ptr_ctn pyCached { PyInt_FromLong(5) };
+  EXPECT_EQ(pyCached.get(), pySmall.get());
+  EXPECT_FALSE(uncaught_exception());
+}
+
+TEST(PyBuilder, Strings)
+{
+  unique_ptr_ctn pyString { PyBuilder<std::string>()(std::string("h\0llo", 5)) };
+  unique_ptr_ctn pyUnicode { PyBuilder<std::wstring>()(L"\u00e9t\u00e9") };
+  EXPECT_TRUE(PyString_CheckExact(pyString.get()));
+  EXPECT_TRUE(pyEquals(pyString.get(), "'h\\x00llo'"));
+  EXPECT_TRUE(PyUnicode_CheckExact(pyUnicode.get()));
+  EXPECT_TRUE(pyEquals(pyUnicode.get(), "u'\\xe9t\\xe9'"));
+  EXPECT_FALSE(uncaught_exception());
+}
+
+TEST(PyBuilder, Containers)
+{
+  std::map<std::string, std::vector<std::tuple<int, double>>> value {
+      { "a", { std::make_tuple(1, .5), std::make_tuple(2, 1.5) } }, { "b", {} } };
+  unique_ptr_ctn pyo { PyBuilder<decltype(value)>()(value) };
+  EXPECT_TRUE(pyEquals(pyo.get(), "{'a': [(1, .5), (2, 1.5)], 'b': []}"));
+  
+  std::set<int> values { 3, 1, 2 };
+  unique_ptr_ctn pySet { PyBuilder<std::set<int>>()(values) };
+  EXPECT_TRUE(pyEquals(pySet.get(), "set([1, 2, 3])"));
+  EXPECT_EQ(values, CppBuilder<std::set<int>>()(pySet.get()));
+  
+  std::unordered_map<int, std::vector<bool>> flags { { 1, { true, false } } };
+  unique_ptr_ctn pyFlags { PyBuilder<std::unordered_map<int, std::vector<bool>>>()(flags) };
+  EXPECT_TRUE(pyEquals(pyFlags.get(), "{1: [True, False]}"));
+  EXPECT_FALSE(uncaught_exception());
+}
+
+TEST(PyBuilder, Structs)
+{
+  internSchemaKeys();
+  SchemaPath path;
+  path.name = "p";
+  path.points = { SchemaPoint(1, 2) };
+  unique_ptr_ctn pyPath { PyBuilder<SchemaPath>()(path) };
+  EXPECT_TRUE(pyEquals(pyPath.get(), "{'name': 'p', 'points': [{'x': 1, 'y': 2}]}"));
+  
+  Pixel pixel { 3, 4, "red" };
+  typedef PyBuilder<FromTuple<Pixel, PY2CPP_FIELD(&Pixel::x), PY2CPP_FIELD(&Pixel::y)>> TupleBuilder;
+  typedef PyBuilder<FromDict<Pixel, PY2CPP_FIELD(&Pixel::x), PY2CPP_FIELD(&Pixel::color)>> DictBuilder;
+  DictBuilder dictBuilder("x", "color"); // holds the keys of pyDict
+  unique_ptr_ctn pyTuple { TupleBuilder()(pixel) };
+  unique_ptr_ctn pyDict { dictBuilder(pixel) };
+  EXPECT_TRUE(pyEquals(pyTuple.get(), "(3, 4)"));
+  EXPECT_TRUE(pyEquals(pyDict.get(), "{'x': 3, 'color': 'red'}"));
+  EXPECT_FALSE(uncaught_exception());
+}
+
+TEST(PyBuilder, ToBufferVector)
+{
+  std::vector<double> values { 1., 2.5, -3. };
+  const double* data { values.data() };
+  unique_ptr_ctn pyo { PyBuilder<ToBuffer<double>>()(std::move(values)) };
+  ASSERT_NE(nullptr, pyo.get());
+  
+  Py_buffer view;
+  ASSERT_EQ(0, PyObject_GetBuffer(pyo.get(), &view, PyBUF_RECORDS));
+  EXPECT_EQ(data, view.buf);
+  EXPECT_EQ(3 * sizeof(double), view.len);
+  EXPECT_STREQ("d", view.format);
+  EXPECT_EQ(1, view.ndim);
+  EXPECT_EQ(3, view.shape[0]);
+  EXPECT_EQ(sizeof(double), view.strides[0]);
+  static_cast<double*>(view.buf)[1] = 4.;
+  PyBuffer_Release(&view);
+  
+  std::vector<double> expected { 1., 4., -3. };
+  EXPECT_EQ(expected, CppBuilder<FromBuffer<double>>()(pyo.get()));
+  EXPECT_FALSE(uncaught_exception());
+}
+
+TEST(PyBuilder, ToBufferOutlivesOwner)
+{
+  PyObject* pyo { PyBuilder<ToBuffer<int>>()(std::vector<int>(1000, 7)) };
+  ASSERT_NE(nullptr, pyo);
+  PyObject* view { PyMemoryView_FromObject(pyo) };
+  ASSERT_NE(nullptr, view);
+  Py_DECREF(pyo);
+  
+  std::vector<int> expected(1000, 7);
+  EXPECT_EQ(expected, CppBuilder<FromBuffer<int>>()(view));
+  std::size_t before { numAllocations };
+  Py_DECREF(view);
+  EXPECT_EQ(before, numAllocations);
+  EXPECT_FALSE(uncaught_exception());
+}
+
+TEST(PyBuilder, ToBufferNdArray)
+{
+  PyRun_SimpleString("import ctypes");
+  unique_ptr_ctn pyo { PyRun_String("(ctypes.c_double * 3 * 2)(*[(ctypes.c_double * 3)(*[j + 3*i for j in range(3)]) for i in range(2)])", Py_eval_input, get_py_dict(), NULL) };
+  ASSERT_NE(nullptr, pyo.get());
+  Matrix<double> matrix { CppBuilder<Matrix<double>>()(pyo.get()) };
+  ASSERT_TRUE(matrix.is_view());
+  const double* data { matrix.data() };
+  
+  unique_ptr_ctn pyCopy { PyBuilder<Matrix<double>>()(matrix) };
+  unique_ptr_ctn pyExported { PyBuilder<ToBuffer<double>>()(std::move(matrix)) };
+  for (PyObject* exported : { pyCopy.get(), pyExported.get() })
+  {
+    Matrix<double> back { CppBuilder<Matrix<double>>()(exported) };
+    ASSERT_EQ(2, back.shape(0));
+    ASSERT_EQ(3, back.shape(1));
+    EXPECT_EQ(5., back(1, 2));
+  }
+  Py_buffer view;
+  ASSERT_EQ(0, PyObject_GetBuffer(pyExported.get(), &view, PyBUF_RECORDS_RO));
+  EXPECT_EQ(data, view.buf);
+  PyBuffer_Release(&view);
+  EXPECT_NE(0, PyObject_GetBuffer(pyExported.get(), &view, PyBUF_RECORDS));
+  PyErr_Clear();
+  EXPECT_FALSE(uncaught_exception());
+}
+
+/** TwoPhase **/
+
+TEST(CppBuilder_TwoPhase, Vector)
+{
+  unique_ptr_ctn pyo { PyRun_String("[(i, str(i), [float(i)] * (i % 3)) for i in xrange(10000)]", Py_eval_input, get_py_dict(), NULL) };
+  ASSERT_NE(nullptr, pyo.get());
+  typedef std::vector<std::tuple<int, std::string, std::vector<double>>> Type;
+  Type expected { CppBuilder<Type>()(pyo.get()) };
+  for (std::size_t numThreads : { 1, 3 })
+  {
+    TwoPhaseStats stats;
+    EXPECT_EQ(expected, CppBuilder<TwoPhase<Type>>(numThreads)(pyo.get(), stats));
+    EXPECT_LE(0., stats.gil_held_ms);
+    EXPECT_LE(0., stats.gil_free_ms);
+    EXPECT_LT(10000, stats.items);
+    Optional<Type> tried { CppBuilder<TwoPhase<Type>>(numThreads).try_build(pyo.get()) };
+    ASSERT_TRUE(tried.has_value());
+    EXPECT_EQ(expected, *tried);
+  }
+  EXPECT_FALSE(uncaught_exception());
+}
+
+TEST(CppBuilder_TwoPhase, SetAndMap)
+{
+  // unique_ptr_ctn would reorder the large set when checking its elements
+  std::unique_ptr<PyObject, decref> pySet { PyRun_String("set(str(i * 7919 % 20011) for i in xrange(20000))", Py_eval_input, get_py_dict(), NULL) };
+  unique_ptr_ctn pyMap { PyRun_String("dict((i * 7919 % 20011, [i]) for i in xrange(20000))", Py_eval_input, get_py_dict(), NULL) };
+  ASSERT_NE(nullptr, pySet.get());
+  ASSERT_NE(nullptr, pyMap.get());
+  for (std::size_t numThreads : { 1, 4 })
+  {
+    EXPECT_EQ(CppBuilder<std::set<std::string>>()(pySet.get()), CppBuilder<TwoPhase<std::set<std::string>>>(numThreads)(pySet.get()));
+    auto expected = CppBuilder<std::map<int, std::vector<int>>>()(pyMap.get());
+    auto ret = CppBuilder<TwoPhase<std::map<int, std::vector<int>>>>(numThreads)(pyMap.get());
+    EXPECT_EQ(expected, ret);
+  }
+  EXPECT_FALSE(uncaught_exception());
+}
+
+TEST(CppBuilder_TwoPhase, SameCppKeys)
+{
+  // '\xc3\xa9' and u'\xe9' are distinct keys of the dict but give the same std::string
+  unique_ptr_ctn pyo { PyRun_String("dict([(str(i), i) for i in xrange(20000)] + [('\\xc3\\xa9', -1), (u'\\xe9', -2)])", Py_eval_input, get_py_dict(), NULL) };
+  ASSERT_NE(nullptr, pyo.get());
+  auto expected = CppBuilder<std::map<std::string, int>>()(pyo.get());
+  auto expectedUnordered = CppBuilder<std::unordered_map<std::string, int>>()(pyo.get());
+  for (std::size_t numThreads : { 1, 4 })
+  {
+    auto ret = CppBuilder<TwoPhase<std::map<std::string, int>>>(numThreads)(pyo.get());
+    EXPECT_EQ(expected, ret);
+    auto retUnordered = CppBuilder<TwoPhase<std::unordered_map<std::string, int>>>(numThreads)(pyo.get());
+    EXPECT_EQ(expectedUnordered, retUnordered);
+  }
+  EXPECT_FALSE(uncaught_exception());
+}
+
+TEST(CppBuilder_TwoPhase, Nested)
+{
+  unique_ptr_ctn pyo { PyRun_String("{u'caf\\xe9': set([1, 2]), 'b': set()}", Py_eval_input, get_py_dict(), NULL) };
+  ASSERT_NE(nullptr, pyo.get());
+  typedef std::unordered_map<std::wstring, std::unordered_set<unsigned long>> Type;
+  EXPECT_EQ(CppBuilder<Type>()(pyo.get()), CppBuilder<TwoPhase<Type>>()(pyo.get()));
+  EXPECT_FALSE(uncaught_exception());
+}
+
+TEST(CppBuilder_TwoPhase, InvalidInput)
+{
+  unique_ptr_ctn pyo { PyRun_String("[1, 2, 'toto']", Py_eval_input, get_py_dict(), NULL) };
+  ASSERT_NE(nullptr, pyo.get());
+  EXPECT_FALSE(CppBuilder<TwoPhase<std::vector<int>>>().eligible(pyo.get()));
+  EXPECT_FALSE(CppBuilder<TwoPhase<std::vector<int>>>().try_build(pyo.get()).has_value());
+  EXPECT_THROW(CppBuilder<TwoPhase<std::vector<int>>>()(pyo.get()), std::invalid_argument);
+
+  Expected<std::vector<int>> tried { try_convert(CppBuilder<TwoPhase<std::vector<int>>>(), pyo.get()) };
+  ASSERT_FALSE(tried);
+  EXPECT_EQ(ConversionErrc::type_mismatch, tried.error().code());
+  EXPECT_EQ("[2]", tried.error().path());
+
+  unique_ptr_ctn pyNested { PyRun_String("{'a': [(1, 'x')], 'b': [(2, 'y'), (3,)]}", Py_eval_input, get_py_dict(), NULL) };
+  ASSERT_NE(nullptr, pyNested.get());
+  typedef std::map<std::string, std::vector<std::tuple<int, std::string>>> Type;
+  Expected<Type> nested { try_convert(CppBuilder<TwoPhase<Type>>(), pyNested.get()) };
+  ASSERT_FALSE(nested);
+  EXPECT_EQ(ConversionErrc::length_mismatch, nested.error().code());
+  EXPECT_EQ("['b'][1]", nested.error().path());
+  EXPECT_FALSE(uncaught_exception());
+}
+
+/** build_into **/
+
+namespace
+{
+  struct Sample
+  {
+    std::string name;
+    std::vector<double> values;
+    std::map<std::string, std::vector<std::string>> tags;
+    
+    bool operator==(Sample const& other) const { return name == other.name && values == other.values && tags == other.tags; }
+    
+    struct FromPy : CppBuilder<FromDict<Sample, PY2CPP_FIELD(&Sample::name), PY2CPP_FIELD(&Sample::values), PY2CPP_FIELD(&Sample::tags)>>
+    {
+      FromPy() : CppBuilder<FromDict<Sample, PY2CPP_FIELD(&Sample::name), PY2CPP_FIELD(&Sample::values), PY2CPP_FIELD(&Sample::tags)>>("name", "values", "tags") {}
     };
   };
 }
 
-TEST(CppBuilder_struct, FromTuple)
+TEST(CppBuilder_build_into, VectorNoAllocation)
 {
-  unique_ptr_ctn pyo { PyRun_String("(1, 3, 4)", Py_eval_input, get_py_dict(), NULL) };
-  Point expected { 1, 3, 4 };
+  unique_ptr_ctn pyo { PyRun_String("[(i, 'long enough to be on the heap %d' % i, [float(i)] * (i % 5)) for i in xrange(100)]", Py_eval_input, get_py_dict(), NULL) };
   ASSERT_NE(nullptr, pyo.get());
-  EXPECT_EQ(expected, Point::FromPy()(pyo.get()));
+  typedef std::vector<std::tuple<int, std::string, std::vector<double>>> Type;
+  Type out;
+  CppBuilder<Type>().build_into(out, pyo.get()); // fresh containers
+  CppBuilder<Type>().build_into(out, pyo.get()); // steady state from now on
+  EXPECT_EQ(CppBuilder<Type>()(pyo.get()), out);
+  
+  std::size_t before { numAllocations };
+  CppBuilder<Type>().build_into(out, pyo.get());
+  EXPECT_EQ(before, numAllocations);
+  EXPECT_EQ(CppBuilder<Type>()(pyo.get()), out);
   EXPECT_FALSE(uncaught_exception());
 }
 
-TEST(CppBuilder_struct, FromTooSmallTuple)
+TEST(CppBuilder_build_into, ContainersNoAllocation)
 {
-  unique_ptr_ctn pyo { PyRun_String("(1,)", Py_eval_input, get_py_dict(), NULL) };
+  unique_ptr_ctn pyo { PyRun_String("({'a': set([1, 2]), 'b': set()}, {1: u'caf\\xe9 ' * 10, 2: 'x'}, frozenset([3, 4]))", Py_eval_input, get_py_dict(), NULL) };
   ASSERT_NE(nullptr, pyo.get());
-  EXPECT_THROW(Point::FromPy()(pyo.get()), std::invalid_argument);
+  typedef std::tuple<std::map<std::string, std::set<int>>, std::unordered_map<int, std::wstring>, std::unordered_set<long>> Type;
+  Type out;
+  CppBuilder<Type>().build_into(out, pyo.get()); // fresh containers
+  CppBuilder<Type>().build_into(out, pyo.get()); // steady state from now on
+  EXPECT_EQ(CppBuilder<Type>()(pyo.get()), out);
+  
+  std::size_t before { numAllocations };
+  CppBuilder<Type>().build_into(out, pyo.get());
+  EXPECT_EQ(before, numAllocations);
+  EXPECT_EQ(CppBuilder<Type>()(pyo.get()), out);
   EXPECT_FALSE(uncaught_exception());
 }
 
-TEST(CppBuilder_struct, FromTooLargeTuple)
+TEST(CppBuilder_build_into, StructNoAllocation)
 {
-  unique_ptr_ctn pyo { PyRun_String("(1, 2, 3, 4)", Py_eval_input, get_py_dict(), NULL) };
+  unique_ptr_ctn pyo { PyRun_String("{'name': 'a sample with a long name', 'values': [.5, 1.5], 'tags': {'k': ['a long tag value to allocate']}}", Py_eval_input, get_py_dict(), NULL) };
   ASSERT_NE(nullptr, pyo.get());
-  EXPECT_THROW(Point::FromPy()(pyo.get()), std::invalid_argument);
+  Sample out;
+  Sample::FromPy().build_into(out, pyo.get());
+  Sample::FromPy().build_into(out, pyo.get());
+  EXPECT_EQ(Sample::FromPy()(pyo.get()), out);
+  
+  std::size_t before { numAllocations };
+  Sample::FromPy().build_into(out, pyo.get());
+  EXPECT_EQ(before, numAllocations);
+  EXPECT_EQ(Sample::FromPy()(pyo.get()), out);
   EXPECT_FALSE(uncaught_exception());
 }
 
-TEST(CppBuilder_struct, FromTupleArgs)
+TEST(CppBuilder_build_into, DifferentShapes)
 {
-  unique_ptr_ctn pyo { PyRun_String("(1, 3, 4)", Py_eval_input, get_py_dict(), NULL) };
-  Point expected { 1, 3, 4 };
+  unique_ptr_ctn pyo1 { PyRun_String("([1, 2, 3], {'a': [1], 'b': [2]}, set(['x', 'y']), (1, 2, 3))", Py_eval_input, get_py_dict(), NULL) };
+  unique_ptr_ctn pyo2 { PyRun_String("([4], {'b': [3, 4], 'c': []}, set(['\\xc3\\xa9', u'\\xe9']), (4, 5, 6))", Py_eval_input, get_py_dict(), NULL) };
+  unique_ptr_ctn pyo3 { PyRun_String("([5, 6, 7, 8], {'c': [5]}, set(['\\xc3\\xa9', 'z']), (7, 8, 9))", Py_eval_input, get_py_dict(), NULL) };
+  ASSERT_NE(nullptr, pyo1.get());
+  ASSERT_NE(nullptr, pyo2.get());
+  ASSERT_NE(nullptr, pyo3.get());
+  typedef std::tuple<std::vector<int>, std::map<std::string, std::vector<int>>, std::set<std::string>, Point::FromPy> Type;
+  CppBuilder<Type>::value_type out;
+  for (PyObject* pyo : { pyo1.get(), pyo2.get(), pyo3.get(), pyo1.get() })
+  {
+    CppBuilder<Type>().build_into(out, pyo);
+    EXPECT_EQ(CppBuilder<Type>()(pyo), out);
+  }
+  EXPECT_FALSE(uncaught_exception());
+}
+
+TEST(CppBuilder_build_into, StaleKeysOnly)
+{
+  unique_ptr_ctn pyo1 { PyRun_String("({'a': [1], 'b': [2], 'c': [3]}, set([1, 2, 3]))", Py_eval_input, get_py_dict(), NULL) };
+  unique_ptr_ctn pyo2 { PyRun_String("({'a': [4], 'c': [5], 'd': [6]}, set([1, 3, 4]))", Py_eval_input, get_py_dict(), NULL) };
+  ASSERT_NE(nullptr, pyo1.get());
+  ASSERT_NE(nullptr, pyo2.get());
+  typedef std::tuple<std::map<std::string, std::vector<int>>, std::unordered_set<int>> Type;
+  CppBuilder<Type>::value_type out;
+  CppBuilder<Type>().build_into(out, pyo1.get());
+  const void* nodeA { &*std::get<0>(out).find("a") };
+  const void* nodeC { &*std::get<0>(out).find("c") };
+  const void* node3 { &*std::get<1>(out).find(3) };
+
+  // the nodes of the keys still present are kept, only the stale ones are erased
+  CppBuilder<Type>().build_into(out, pyo2.get());
+  EXPECT_EQ(CppBuilder<Type>()(pyo2.get()), out);
+  EXPECT_EQ(nodeA, &*std::get<0>(out).find("a"));
+  EXPECT_EQ(nodeC, &*std::get<0>(out).find("c"));
+  EXPECT_EQ(node3, &*std::get<1>(out).find(3));
+  EXPECT_FALSE(uncaught_exception());
+}
+
+TEST(CppBuilder_build_into, InvalidInput)
+{
+  unique_ptr_ctn pyo { PyRun_String("[1, 2, 'toto']", Py_eval_input, get_py_dict(), NULL) };
   ASSERT_NE(nullptr, pyo.get());
-  EXPECT_EQ(expected, Point::FromPyArgs()(pyo.get()));
+  std::vector<int> out { 5 };
+  EXPECT_THROW(CppBuilder<std::vector<int>>().build_into(out, pyo.get()), std::invalid_argument);
+  typedef std::map<int, int> MapType;
+  MapType outMap;
+  EXPECT_THROW(CppBuilder<MapType>().build_into(outMap, pyo.get()), std::invalid_argument);
   EXPECT_FALSE(uncaught_exception());
 }
 
-TEST(CppBuilder_struct, FromDict)
+/** try_convert **/
+
+TEST(try_convert, Valid)
 {
-  unique_ptr_ctn pyo { PyRun_String("{'y': 3, 'x': 1, 'z': 4}", Py_eval_input, get_py_dict(), NULL) };
-  Point expected { 1, 3, 4 };
+  unique_ptr_ctn pyo { PyRun_String("[1, 2, 3]", Py_eval_input, get_py_dict(), NULL) };
   ASSERT_NE(nullptr, pyo.get());
-  EXPECT_EQ(expected, Point::FromPyDict()(pyo.get()));
+  Expected<std::vector<int>> value { try_convert<std::vector<int>>(pyo.get()) };
+  ASSERT_TRUE(value.has_value());
+  EXPECT_EQ((std::vector<int> { 1, 2, 3 }), *value);
+  EXPECT_EQ(3, value->size());
   EXPECT_FALSE(uncaught_exception());
 }
 
-TEST(CppBuilder_struct, FromDictArgs)
+TEST(try_convert, RejectedRoot)
 {
-  unique_ptr_ctn pyo { PyRun_String("{'y': 3, 'x': 1, 'z': 4}", Py_eval_input, get_py_dict(), NULL) };
-  Point expected { 1, 3, 4 };
+  unique_ptr_ctn pyo { PyRun_String("'abc'", Py_eval_input, get_py_dict(), NULL) };
   ASSERT_NE(nullptr, pyo.get());
-  EXPECT_EQ(expected, Point::FromPyDictArgs()(pyo.get()));
+  Expected<int> value { try_convert<int>(pyo.get()) };
+  ASSERT_FALSE(value);
+  EXPECT_EQ(ConversionErrc::type_mismatch, value.error().code());
+  EXPECT_EQ("", value.error().path());
+  EXPECT_EQ("Type mismatch", value.error().message());
+  EXPECT_THROW(value.value(), std::logic_error);
   EXPECT_FALSE(uncaught_exception());
 }
 
-TEST(CppBuilder_struct, FromObject)
+TEST(try_convert, NestedPath)
 {
-  PyRun_SimpleString("class Point:\n   x = 5\n   z = 14");
-  unique_ptr_ctn pyo { PyRun_String("Point", Py_eval_input, get_py_dict(), NULL) };
-  Point expected { 5, 0, 14 };
+  internSchemaKeys();
+  unique_ptr_ctn pyo { PyRun_String("{'name': 'p', 'points': [{'x': 1, 'y': 2}, {'x': 'a', 'y': 4}]}", Py_eval_input, get_py_dict(), NULL) };
   ASSERT_NE(nullptr, pyo.get());
-  EXPECT_EQ(expected, Point::FromPyDictArgs()(pyo.get()));
+  Expected<SchemaPath> value { try_convert<SchemaPath>(pyo.get()) };
+  ASSERT_FALSE(value);
+  EXPECT_EQ(ConversionErrc::type_mismatch, value.error().code());
+  EXPECT_EQ("['points'][1]['x']", value.error().path());
+  EXPECT_EQ("Type mismatch at ['points'][1]['x']", value.error().message());
   EXPECT_FALSE(uncaught_exception());
 }
 
-TEST(CppBuilder_struct, VectorOfStructs)
+TEST(try_convert, Overflow)
 {
-  unique_ptr_ctn pyo { PyRun_String("[(1, 3, 4), (1, 5, 5), (0, -1, 0)]", Py_eval_input, get_py_dict(), NULL) };
-  Point pts[] = { { 1, 3, 4 }, { 1, 5, 5 }, { 0, -1, 0 } };
-  
+  unique_ptr_ctn pyo { PyRun_String("{'a': [1, 2], 'b': [3, 2**40]}", Py_eval_input, get_py_dict(), NULL) };
   ASSERT_NE(nullptr, pyo.get());
-  auto ret = CppBuilder<std::vector<Point::FromPy>>()(pyo.get());
-  EXPECT_EQ(3, ret.size());
-  EXPECT_EQ(pts[0], ret[0]);
-  EXPECT_EQ(pts[1], ret[1]);
-  EXPECT_EQ(pts[2], ret[2]);
+  Expected<std::map<std::string, std::vector<int>>> value { try_convert<std::map<std::string, std::vector<int>>>(pyo.get()) };
+  ASSERT_FALSE(value);
+  EXPECT_EQ(ConversionErrc::overflow, value.error().code());
+  EXPECT_EQ("['b'][1]", value.error().path());
+  EXPECT_EQ("Out of boundaries at ['b'][1]", value.error().message());
+
+  // outside of try_convert, overflows are still thrown
+  EXPECT_THROW((CppBuilder<std::map<std::string, std::vector<int>>>().try_build(pyo.get())), std::overflow_error);
   EXPECT_FALSE(uncaught_exception());
 }
 
-TEST(CppBuilder_struct, SetOfStructs)
+template <class T>
+static void expectOverflowAt(const char* input, std::string const& path)
 {
-  unique_ptr_ctn pyo { PyRun_String("set([(1, 3, 4), (1, 5, 5), (0, -1, 0)])", Py_eval_input, get_py_dict(), NULL) };
-  Point pts[] = { { 1, 3, 4 }, { 1, 5, 5 }, { 0, -1, 0 } };
-  
+  unique_ptr_ctn pyo { PyRun_String(input, Py_eval_input, get_py_dict(), NULL) };
   ASSERT_NE(nullptr, pyo.get());
-  auto ret = CppBuilder<std::set<Point::FromPy>>()(pyo.get());
-  EXPECT_EQ(3, ret.size());
-  EXPECT_NE(ret.end(), ret.find(pts[0]));
-  EXPECT_NE(ret.end(), ret.find(pts[1]));
-  EXPECT_NE(ret.end(), ret.find(pts[2]));
+  Expected<T> value { try_convert<T>(pyo.get()) };
+  ASSERT_FALSE(value) << input;
+  EXPECT_EQ(ConversionErrc::overflow, value.error().code()) << input;
+  EXPECT_EQ(path, value.error().path()) << input;
+  EXPECT_EQ(nullptr, PyErr_Occurred()) << input;
+  PyErr_Clear();
+}
+
+TEST(try_convert, OverflowOfEachNumber)
+{
+  expectOverflowAt<std::vector<int>>("[1, -2**40]", "[1]");
+  expectOverflowAt<std::vector<int>>("[1, 2**70]", "[1]");
+  expectOverflowAt<std::vector<unsigned int>>("[1, -1]", "[1]");
+  expectOverflowAt<std::vector<unsigned int>>("[1, 2**40]", "[1]");
+  expectOverflowAt<std::vector<long>>("[1, 2**70]", "[1]");
+  expectOverflowAt<std::vector<unsigned long>>("[1, -1L]", "[1]");
+  expectOverflowAt<std::vector<unsigned long>>("[1, 2**70]", "[1]");
+  expectOverflowAt<std::vector<long long>>("[1, -2**70]", "[1]");
+  expectOverflowAt<std::vector<unsigned long long>>("[1, -1]", "[1]");
+  expectOverflowAt<std::vector<unsigned long long>>("[1, 2**70]", "[1]");
+  expectOverflowAt<std::vector<double>>("[1., float('inf')]", "[1]");
+  expectOverflowAt<std::vector<double>>("[1., 10**400]", "[1]");
   EXPECT_FALSE(uncaught_exception());
 }
 
-TEST(CppBuilder_struct, MapOfIntStructs)
+TEST(try_convert, TupleLength)
 {
-  unique_ptr_ctn pyo { PyRun_String("{'x': (1, 0, 4), 'y': (0, 5, 9)}", Py_eval_input, get_py_dict(), NULL) };
-  Point pts[] = { { 1, 0, 4 }, { 0, 5, 9 } };
-  
+  unique_ptr_ctn pyo { PyRun_String("[(1, 2), (3, 4, 5)]", Py_eval_input, get_py_dict(), NULL) };
   ASSERT_NE(nullptr, pyo.get());
-  auto ret = CppBuilder<std::map<std::string, Point::FromPy>>()(pyo.get());
-  EXPECT_EQ(2, ret.size());
-  EXPECT_NE(ret.end(), ret.find("x"));
-  EXPECT_NE(ret.end(), ret.find("y"));
-  EXPECT_EQ(pts[0], ret.find("x")->second);
-  EXPECT_EQ(pts[1], ret.find("y")->second);
+  Expected<std::vector<std::tuple<int, int>>> value { try_convert<std::vector<std::tuple<int, int>>>(pyo.get()) };
+  ASSERT_FALSE(value);
+  EXPECT_EQ(ConversionErrc::length_mismatch, value.error().code());
+  EXPECT_EQ("[1]", value.error().path());
+
+  unique_ptr_ctn pyo_item { PyRun_String("[(1, 2), (3, 'a')]", Py_eval_input, get_py_dict(), NULL) };
+  ASSERT_NE(nullptr, pyo_item.get());
+  Expected<std::vector<std::tuple<int, int>>> item { try_convert<std::vector<std::tuple<int, int>>>(pyo_item.get()) };
+  ASSERT_FALSE(item);
+  EXPECT_EQ(ConversionErrc::type_mismatch, item.error().code());
+  EXPECT_EQ("[1][1]", item.error().path());
   EXPECT_FALSE(uncaught_exception());
 }
 
-TEST(CppBuilder_struct, MapOfKeysStructAndValuesStruct)
+TEST(try_convert, KeysAndElements)
 {
-  unique_ptr_ctn pyo { PyRun_String("{(0, 0, 0): (1, 0, 4), (1, 1, 2): (0, 5, 9)}", Py_eval_input, get_py_dict(), NULL) };
-  Point keys[] = { { 0, 0, 0 }, { 1, 1, 2 } };
-  Point pts[] = { { 1, 0, 4 }, { 0, 5, 9 } };
-  
+  unique_ptr_ctn pyo_map { PyRun_String("{1: 2, 'a': 3}", Py_eval_input, get_py_dict(), NULL) };
+  ASSERT_NE(nullptr, pyo_map.get());
+  Expected<std::unordered_map<int, int>> map { try_convert<std::unordered_map<int, int>>(pyo_map.get()) };
+  ASSERT_FALSE(map);
+  EXPECT_EQ("{'a'}", map.error().path());
+
+  unique_ptr_ctn pyo_set { PyRun_String("[set([1]), set([2, 3.5])]", Py_eval_input, get_py_dict(), NULL) };
+  ASSERT_NE(nullptr, pyo_set.get());
+  Expected<std::vector<std::set<int>>> set { try_convert<std::vector<std::set<int>>>(pyo_set.get()) };
+  ASSERT_FALSE(set);
+  EXPECT_EQ("[1]{3.5}", set.error().path());
+  EXPECT_FALSE(uncaught_exception());
+}
+
+TEST(try_convert, LazyPath)
+{
+  PyRun_SimpleString("lazy_repr_calls = 0\n"
+                     "class LazyReprKey(object):\n"
+                     "   def __repr__(self):\n"
+                     "      global lazy_repr_calls\n"
+                     "      lazy_repr_calls += 1\n"
+                     "      return 'LazyReprKey()'");
+  // the error keeps a reference on the rejected key, it outlives the dict
+  std::unique_ptr<PyObject, decref> pyo { PyRun_String("{LazyReprKey(): 1}", Py_eval_input, get_py_dict(), NULL) };
   ASSERT_NE(nullptr, pyo.get());
-  auto ret = CppBuilder<std::map<Point::FromPy, Point::FromPy>>()(pyo.get());
-  EXPECT_EQ(2, ret.size());
-  EXPECT_NE(ret.end(), ret.find(keys[0]));
-  EXPECT_NE(ret.end(), ret.find(keys[1]));
-  EXPECT_EQ(pts[0], ret.find(keys[0])->second);
-  EXPECT_EQ(pts[1], ret.find(keys[1])->second);
+  Expected<std::map<int, int>> map { try_convert<std::map<int, int>>(pyo.get()) };
+  ASSERT_FALSE(map);
+  pyo.reset();
+  std::unique_ptr<PyObject, decref> calls_before { PyRun_String("lazy_repr_calls", Py_eval_input, get_py_dict(), NULL) };
+  ASSERT_NE(nullptr, calls_before.get());
+  EXPECT_EQ(0, PyInt_AsLong(calls_before.get()));
+
+  ConversionError error { map.error() };
+  EXPECT_EQ("Type mismatch at {LazyReprKey()}", error.message());
+  std::unique_ptr<PyObject, decref> calls_after { PyRun_String("lazy_repr_calls", Py_eval_input, get_py_dict(), NULL) };
+  ASSERT_NE(nullptr, calls_after.get());
+  EXPECT_EQ(1, PyInt_AsLong(calls_after.get()));
   EXPECT_FALSE(uncaught_exception());
 }
 
-TEST(CppBuilder_struct, StructOfStructs)
+TEST(try_convert, Attributes)
 {
-  unique_ptr_ctn pyo { PyRun_String("{'oriented': True, 'pt1': (0, 0, 0), 'pt2': (1, 0, 4)}", Py_eval_input, get_py_dict(), NULL) };
-  Point pt1 { 0, 0, 0 };
-  Point pt2 { 1, 0, 4 };
-  Line line { pt1, pt2, true };
+  internSchemaKeys();
+  PyRun_SimpleString("class TryConvertPoint(object):\n   def __init__(self): self.x = 1; self.y = 'a'");
+  unique_ptr_ctn pyo { PyRun_String("(0, TryConvertPoint())", Py_eval_input, get_py_dict(), NULL) };
+  ASSERT_NE(nullptr, pyo.get());
+  Expected<std::tuple<int, SchemaPoint>> value { try_convert<std::tuple<int, SchemaPoint>>(pyo.get()) };
+  ASSERT_FALSE(value);
+  EXPECT_EQ("[1].y", value.error().path());
+  EXPECT_FALSE(uncaught_exception());
+}
 
+TEST(try_convert, CustomBuilder)
+{
+  unique_ptr_ctn pyo { PyRun_String("[{'x': 1, 'y': 2, 'z': 3}, {'x': 3, 'y': 4.5}]", Py_eval_input, get_py_dict(), NULL) };
   ASSERT_NE(nullptr, pyo.get());
-  EXPECT_EQ(line, Line::FromPy()(pyo.get()));
+  Point::FromPyDict builder;
+  Expected<Point> valid { try_convert(builder, PyList_GET_ITEM(pyo.get(), 0)) };
+  ASSERT_TRUE(valid);
+  EXPECT_EQ(Point(1, 2, 3), *valid);
+  Expected<Point> invalid { try_convert(builder, PyList_GET_ITEM(pyo.get(), 1)) };
+  ASSERT_FALSE(invalid);
+  EXPECT_EQ("['y']", invalid.error().path());
   EXPECT_FALSE(uncaught_exception());
 }
 
-TEST(CppBuilder_struct, StructOfComplexStructs)
+/** conversion statistics **/
+
+#if defined(PY2CPP_STATS)
+
+template <class BUILDER>
+static ConversionStats statsOf()
 {
-  unique_ptr_ctn pyo { PyRun_String("{'length': 56, 'path': [(0, 0, 0), (1, 0, 4), (1, 1, 2), (0, 5, 9)]}", Py_eval_input, get_py_dict(), NULL) };
-  std::vector<Point> pts = { { 0, 0, 0 }, { 1, 0, 4 }, { 1, 1, 2 }, { 0, 5, 9 } };
-  Path path { pts, 56 };
+  for (ConversionStats const& stats : conversion_stats())
+  {
+    if (stats.builder == _typeName<BUILDER>())
+    {
+      return stats;
+    }
+  }
+  return ConversionStats {};
+}
 
+TEST(ConversionStats, CallsElementsAndSizes)
+{
+  unique_ptr_ctn pyo { PyRun_String("[[1, 2, 3], [], [4]]", Py_eval_input, get_py_dict(), NULL) };
   ASSERT_NE(nullptr, pyo.get());
-  EXPECT_EQ(path, Path::FromPy()(pyo.get()));
+  reset_conversion_stats();
+  CppBuilder<std::vector<std::vector<int>>>()(pyo.get());
+  
+  ConversionStats outer { statsOf<CppBuilder<std::vector<std::vector<int>>>>() };
+  EXPECT_EQ(1, outer.calls);
+  EXPECT_EQ(3, outer.elements);
+  EXPECT_EQ(0, outer.rejections);
+  EXPECT_EQ(0, outer.exceptions);
+  EXPECT_EQ((std::vector<unsigned long long> { 0, 0, 1 }), outer.sizes);
+  
+  ConversionStats inner { statsOf<CppBuilder<std::vector<int>>>() };
+  EXPECT_EQ(3, inner.calls);
+  EXPECT_EQ(4, inner.elements);
+  EXPECT_EQ((std::vector<unsigned long long> { 1, 1, 1 }), inner.sizes); // 0, 1 and 3 items
+  EXPECT_LE(inner.seconds, outer.seconds);
+  EXPECT_NE(std::string::npos, inner.builder.find("CppBuilder<std::vector<int"));
+  EXPECT_FALSE(uncaught_exception());
+}
+
+TEST(ConversionStats, RejectionsAndExceptions)
+{
+  unique_ptr_ctn pyo { PyRun_String("[1, 'two']", Py_eval_input, get_py_dict(), NULL) };
+  ASSERT_NE(nullptr, pyo.get());
+  reset_conversion_stats();
+  EXPECT_FALSE(CppBuilder<std::vector<int>>().eligible(pyo.get()));
+  EXPECT_FALSE(CppBuilder<std::vector<int>>().try_build(pyo.get()).has_value());
+  EXPECT_THROW(CppBuilder<std::vector<int>>()(pyo.get()), std::invalid_argument);
+  
+  ConversionStats vector { statsOf<CppBuilder<std::vector<int>>>() };
+  EXPECT_EQ(2, vector.calls); // try_build and operator()
+  EXPECT_EQ(2, vector.rejections);
+  EXPECT_EQ(1, vector.exceptions);
+  ConversionStats item { statsOf<CppBuilder<int>>() };
+  EXPECT_EQ(2, item.rejections); // 'two' by eligible and try_build
+  EXPECT_EQ(1, item.exceptions);
+  EXPECT_EQ(2, item.calls - item.exceptions); // 1 converted twice
+  EXPECT_EQ(2, item.elements);
+  EXPECT_FALSE(uncaught_exception());
+}
+
+TEST(ConversionStats, Reset)
+{
+  unique_ptr_ctn pyo { PyRun_String("{'a': 1.5}", Py_eval_input, get_py_dict(), NULL) };
+  ASSERT_NE(nullptr, pyo.get());
+  CppBuilder<std::map<std::string, double>>()(pyo.get());
+  EXPECT_LT(0, (statsOf<CppBuilder<std::map<std::string, double>>>().calls));
+  reset_conversion_stats();
+  ConversionStats stats { statsOf<CppBuilder<std::map<std::string, double>>>() };
+  EXPECT_FALSE(stats.builder.empty()); // still registered
+  EXPECT_EQ(0, stats.calls);
+  EXPECT_EQ(0, stats.seconds);
+  EXPECT_TRUE(stats.sizes.empty());
+  EXPECT_FALSE(uncaught_exception());
+}
+
+TEST(ConversionStats, ToPython)
+{
+  unique_ptr_ctn pyo { PyRun_String("[(1, 'a'), (2, 'b')]", Py_eval_input, get_py_dict(), NULL) };
+  ASSERT_NE(nullptr, pyo.get());
+  reset_conversion_stats();
+  CppBuilder<std::vector<std::tuple<int, std::string>>>()(pyo.get());
+  
+  std::unique_ptr<PyObject, decref> pyStats { conversion_stats_dict() };
+  ASSERT_TRUE(PyDict_Check(pyStats.get()));
+  PyObject* pyVector { PyDict_GetItemString(pyStats.get(), _typeName<CppBuilder<std::vector<std::tuple<int, std::string>>>>().c_str()) };
+  ASSERT_NE(nullptr, pyVector);
+  ASSERT_TRUE(PyDict_Check(pyVector));
+  EXPECT_EQ(1, PyInt_AsLong(PyDict_GetItemString(pyVector, "calls")));
+  EXPECT_EQ(2, PyInt_AsLong(PyDict_GetItemString(pyVector, "elements")));
+  EXPECT_EQ(0, PyInt_AsLong(PyDict_GetItemString(pyVector, "rejections")));
+  EXPECT_EQ(0, PyInt_AsLong(PyDict_GetItemString(pyVector, "exceptions")));
+  EXPECT_TRUE(PyFloat_Check(PyDict_GetItemString(pyVector, "seconds")));
+  EXPECT_EQ((std::vector<unsigned long long> { 0, 0, 1 }), CppBuilder<std::vector<unsigned long long>>()(PyDict_GetItemString(pyVector, "sizes")));
+  EXPECT_FALSE(uncaught_exception());
+}
+
+#else
+
+TEST(ConversionStats, Disabled)
+{
+  unique_ptr_ctn pyo { PyRun_String("[1, 2]", Py_eval_input, get_py_dict(), NULL) };
+  ASSERT_NE(nullptr, pyo.get());
+  CppBuilder<std::vector<int>>()(pyo.get());
+  EXPECT_TRUE(conversion_stats().empty());
+  reset_conversion_stats();
+  std::unique_ptr<PyObject, decref> pyStats { conversion_stats_dict() };
+  ASSERT_TRUE(PyDict_Check(pyStats.get()));
+  EXPECT_EQ(0, PyDict_Size(pyStats.get()));
   EXPECT_FALSE(uncaught_exception());
 }
 
+#endif
+
 /** ALWAYS use move semantics when available              **/
 /** some containers do not support .emplace with g++ <4.8 **/
 /** following code will not compile if it not the case    **/
@@ -934,6 +2818,17 @@ TEST(CppBuilder_move, InOtherObject_MethodWithMove)
   EXPECT_FALSE(uncaught_exception());
 }
 
+TEST(CppBuilder_move, InMap)
+{
+  unique_ptr_ctn pyo { PyRun_String("{'b': (2,), 'a': (1,)}", Py_eval_input, get_py_dict(), NULL) };
+  ASSERT_NE(nullptr, pyo.get());
+  auto ret = CppBuilder<std::map<std::string, OnlyMove::FromPy>>()(pyo.get());
+  ASSERT_EQ(2, ret.size());
+  EXPECT_TRUE(OnlyMove { 1 } == ret.find("a")->second);
+  EXPECT_TRUE(OnlyMove { 2 } == ret.find("b")->second);
+  EXPECT_FALSE(uncaught_exception());
+}
+
 /** MISC **/
 
 TEST(CppBuilder_mix, AnyValue)
@@ -984,12 +2879,29 @@ static void filterThrow(BUILDER const& builder, PyObject* pyo)
   catch(...) {}
 }
 
+// true if try_build succeeded or failed for another reason than eligibility
+template <class BUILDER>
+static bool tryBuildFilterThrow(BUILDER const& builder, PyObject* pyo)
+{
+  try
+  {
+    return static_cast<bool>(builder.try_build(pyo));
+  }
+  catch(std::invalid_argument const&)
+  {
+    throw;
+  }
+  catch(...) {}
+  return true;
+}
+
 template <class BUILDER>
 static void shouldBeEligible(BUILDER const& builder, std::string const& pyQuery)
 {
   unique_ptr_ctn pyo { PyRun_String(pyQuery.c_str(), Py_eval_input, get_py_dict(), NULL) };
   EXPECT_TRUE(builder.eligible(pyo.get())) << "Conversion should be possible for: '" << pyQuery << "'";
   EXPECT_NO_THROW(filterThrow(builder, pyo.get())) << "Conversion should be possible for: '" << pyQuery << "'";;
+  EXPECT_TRUE(tryBuildFilterThrow(builder, pyo.get())) << "Conversion should be possible for: '" << pyQuery << "'";
 }
 template <class BUILDER>
 static void shouldNotBeEligible(BUILDER const& builder, std::string const& pyQuery)
@@ -997,6 +2909,7 @@ static void shouldNotBeEligible(BUILDER const& builder, std::string const& pyQue
   unique_ptr_ctn pyo { PyRun_String(pyQuery.c_str(), Py_eval_input, get_py_dict(), NULL) };
   EXPECT_FALSE(builder.eligible(pyo.get())) << "Conversion should not be possible for: '" << pyQuery << "'";
   EXPECT_THROW(builder(pyo.get()), std::invalid_argument) << "Conversion should not be possible for: '" << pyQuery << "'";
+  EXPECT_FALSE(builder.try_build(pyo.get())) << "Conversion should not be possible for: '" << pyQuery << "'";
 }
 
 TEST(CppBuilder_eligible, bool)
@@ -1108,6 +3021,14 @@ TEST(CppBuilder_eligible, wstring)
 {
   testString<std::wstring>();
 }
+TEST(CppBuilder_eligible, PyStringRef)
+{
+  testString<PyStringRef>();
+}
+TEST(CppBuilder_eligible, InternedString)
+{
+  testString<InternedString>();
+}
 
 TEST(CppBuilder_eligible, tuple)
 {
@@ -1135,6 +3056,8 @@ TEST(CppBuilder_eligible, vector)
   
   shouldBeEligible(builder, "[]");
   shouldBeEligible(builder, "[1,2,3]");
+  shouldBeEligible(builder, "()");
+  shouldBeEligible(builder, "(1,2,3)");
 
   shouldNotBeEligible(builder, "None");
   shouldNotBeEligible(builder, "True");
@@ -1143,10 +3066,26 @@ TEST(CppBuilder_eligible, vector)
   shouldNotBeEligible(builder, "1.2");
   shouldNotBeEligible(builder, "'This is a string'");
   shouldNotBeEligible(builder, "u'This is a unicode string'");
-  shouldNotBeEligible(builder, "(1,2,3)");
   shouldNotBeEligible(builder, "['string']");
+  shouldNotBeEligible(builder, "(1,'string')");
+  shouldNotBeEligible(builder, "set([1,2,3])");
+  shouldNotBeEligible(builder, "{'x': 1, 'y': 2, 'z': 3}");
+}
+
+TEST(CppBuilder_eligible, lazy)
+{
+  auto builder = CppBuilder<LazyVector<int>>();
+  auto mapBuilder = CppBuilder<LazyMap<int, int>>();
+  
+  shouldBeEligible(builder, "[1,2,3]");
+  shouldBeEligible(builder, "(1,2,3)");
+  shouldBeEligible(builder, "['string']"); // items are checked on access
+  shouldBeEligible(mapBuilder, "{'x': 1}");
+
+  shouldNotBeEligible(builder, "None");
   shouldNotBeEligible(builder, "set([1,2,3])");
   shouldNotBeEligible(builder, "{'x': 1, 'y': 2, 'z': 3}");
+  shouldNotBeEligible(mapBuilder, "[1,2,3]");
 }
 
 TEST(CppBuilder_eligible, set)
@@ -1155,6 +3094,7 @@ TEST(CppBuilder_eligible, set)
   
   shouldBeEligible(builder, "set([])");
   shouldBeEligible(builder, "set([1,2,3])");
+  shouldBeEligible(builder, "frozenset([1,2,3])");
 
   shouldNotBeEligible(builder, "None");
   shouldNotBeEligible(builder, "True");
@@ -1189,6 +3129,36 @@ TEST(CppBuilder_eligible, map)
   shouldNotBeEligible(builder, "{0: 1, 1: 2, 2: 3}");
 }
 
+TEST(CppBuilder_eligible, unordered_map)
+{
+  auto builder = CppBuilder<std::unordered_map<std::string, int>>();
+  
+  shouldBeEligible(builder, "{}");
+  shouldBeEligible(builder, "{'x': 1, 'y': 2, 'z': 3}");
+
+  shouldNotBeEligible(builder, "None");
+  shouldNotBeEligible(builder, "(1,2,3)");
+  shouldNotBeEligible(builder, "[1,2,3]");
+  shouldNotBeEligible(builder, "set([1,2,3])");
+  shouldNotBeEligible(builder, "{0: 1, 1: 2, 2: 3}");
+  shouldNotBeEligible(builder, "{'x': 'y'}");
+}
+
+TEST(CppBuilder_eligible, unordered_set)
+{
+  auto builder = CppBuilder<std::unordered_set<int>>();
+  
+  shouldBeEligible(builder, "set([])");
+  shouldBeEligible(builder, "set([1,2,3])");
+  shouldBeEligible(builder, "frozenset([1,2,3])");
+
+  shouldNotBeEligible(builder, "None");
+  shouldNotBeEligible(builder, "(1,2,3)");
+  shouldNotBeEligible(builder, "[1,2,3]");
+  shouldNotBeEligible(builder, "set(['string'])");
+  shouldNotBeEligible(builder, "{'x': 1, 'y': 2, 'z': 3}");
+}
+
 TEST(CppBuilder_eligible, object_from_tuple)
 {
   auto builder = Point::FromPy();
@@ -1221,6 +3191,19 @@ TEST(CppBuilder_eligible, object_from_dict)
   shouldNotBeEligible(builder, "{0: 1, 1: 2, 2: 3, 'x': 'toto'}");
 }
 
+TEST(CppBuilder_eligible, object_from_dict_scan)
+{
+  auto builder = Point::FromPyDictScan();
+  
+  shouldBeEligible(builder, "{}");
+  shouldBeEligible(builder, "{'x': 1, 'y': 2, 'z': 3}");
+  shouldBeEligible(builder, "{'x': 1, 'y': 2, 'z': 3, 'r': 'toto'}");
+  shouldBeEligible(builder, "{0: 1, 1: 2, 2: 3}");
+
+  shouldNotBeEligible(builder, "{0: 1, 1: 2, 2: 3, 'x': 'toto'}");
+  shouldNotBeEligible(builder, "{'y': 2, u'z': 'toto'}");
+}
+
 TEST(CppBuilder_eligible, object_from_instance)
 {
   auto builder = Point::FromPyDict();
@@ -1237,6 +3220,85 @@ TEST(CppBuilder_eligible, object_from_instance)
   shouldNotBeEligible(builder, "SuperPoint(1,2,'3',4)");
 }
 
+/** CppBuilder<T>::try_build **/
+
+TEST(CppBuilder_try_build, Int)
+{
+  unique_ptr_ctn pyo { PyRun_String("5", Py_eval_input, get_py_dict(), NULL) };
+  ASSERT_NE(nullptr, pyo.get());
+  Optional<int> ret { CppBuilder<int>().try_build(pyo.get()) };
+  ASSERT_TRUE(ret.has_value());
+  EXPECT_EQ(5, *ret);
+  EXPECT_FALSE(uncaught_exception());
+}
+
+TEST(CppBuilder_try_build, Overflow)
+{
+  std::ostringstream out; out << INT_MAX << "+1";
+  unique_ptr_ctn pyo { PyRun_String(out.str().c_str(), Py_eval_input, get_py_dict(), NULL) };
+  ASSERT_NE(nullptr, pyo.get());
+  EXPECT_THROW(CppBuilder<int>().try_build(pyo.get()), std::overflow_error);
+  EXPECT_FALSE(uncaught_exception());
+}
+
+TEST(CppBuilder_try_build, NestedContainers)
+{
+  unique_ptr_ctn pyo { PyRun_String("{'x': [(1, 'a'), (2, 'b')], 'y': []}", Py_eval_input, get_py_dict(), NULL) };
+  std::map<std::string, std::vector<std::tuple<int, std::string>>> expected {
+      { "x", { std::make_tuple(1, "a"), std::make_tuple(2, "b") } }
+      , { "y", {} } };
+  ASSERT_NE(nullptr, pyo.get());
+  auto ret = CppBuilder<std::map<std::string, std::vector<std::tuple<int, std::string>>>>().try_build(pyo.get());
+  ASSERT_TRUE(ret.has_value());
+  EXPECT_EQ(expected, *ret);
+  EXPECT_FALSE(uncaught_exception());
+}
+
+TEST(CppBuilder_try_build, InvalidNestedContainers)
+{
+  unique_ptr_ctn pyo { PyRun_String("{'x': [(1, 'a'), (2, 3)], 'y': []}", Py_eval_input, get_py_dict(), NULL) };
+  ASSERT_NE(nullptr, pyo.get());
+  auto ret = CppBuilder<std::map<std::string, std::vector<std::tuple<int, std::string>>>>().try_build(pyo.get());
+  EXPECT_FALSE(ret.has_value());
+  EXPECT_FALSE(uncaught_exception());
+}
+
+TEST(CppBuilder_try_build, SetInputUnmodified)
+{
+  PyRun_SimpleString("CppBuilder_try_build_SetInputUnmodified = set([1,8,'3'])");
+  unique_ptr_ctn pyo { PyRun_String("CppBuilder_try_build_SetInputUnmodified", Py_eval_input, get_py_dict(), NULL) };
+  ASSERT_NE(nullptr, pyo.get());
+  EXPECT_FALSE(CppBuilder<std::set<int>>().try_build(pyo.get()).has_value());
+  EXPECT_FALSE(uncaught_exception());
+  
+  unique_ptr_ctn pyo_check { PyRun_String("CppBuilder_try_build_SetInputUnmodified == set([1,8,'3'])", Py_eval_input, get_py_dict(), NULL) };
+  EXPECT_TRUE(CppBuilder<bool>()(pyo_check.get()));
+  EXPECT_FALSE(uncaught_exception());
+}
+
+TEST(CppBuilder_try_build, Struct)
+{
+  unique_ptr_ctn pyo { PyRun_String("{'pt1': (0, 0, 0), 'pt2': (1, 0, 4), 'oriented': True}", Py_eval_input, get_py_dict(), NULL) };
+  Line expected { Point { 0, 0, 0 }, Point { 1, 0, 4 }, true };
+  ASSERT_NE(nullptr, pyo.get());
+  Optional<Line> ret { Line::FromPy().try_build(pyo.get()) };
+  ASSERT_TRUE(ret.has_value());
+  EXPECT_EQ(expected, *ret);
+  EXPECT_FALSE(uncaught_exception());
+}
+
+TEST(CppBuilder_try_build, MoveOnly)
+{
+  unique_ptr_ctn pyo { PyRun_String("[{'nmove': (2,)}, {'nmove': (3,)}]", Py_eval_input, get_py_dict(), NULL) };
+  ASSERT_NE(nullptr, pyo.get());
+  auto ret = CppBuilder<std::vector<OnlyMoveOfOnlyMove::FromPy>>().try_build(pyo.get());
+  ASSERT_TRUE(ret.has_value());
+  ASSERT_EQ(2, ret->size());
+  EXPECT_TRUE(OnlyMoveOfOnlyMove { 2 } == (*ret)[0]);
+  EXPECT_TRUE(OnlyMoveOfOnlyMove { 3 } == (*ret)[1]);
+  EXPECT_FALSE(uncaught_exception());
+}
+
 /**
  * Launch all the tests
  */